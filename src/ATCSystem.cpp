@@ -3,31 +3,51 @@
 #include <iostream>
 #include <unistd.h>
 #include <ctime>
+#include <chrono>
 #include <sys/dispatch.h>
 #include "ATCSystem.h"
+#include "SimulationClock.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "ConflictCheck.h"
 
 /* RESPONSIBILITIES
- * 	- Runs ATCSystem::monitorAirspace() on a 1 second timer.
- * 		- Gets all aircraft from the Radar::runRadar() method, sends the info to the display to show to the console.
+ * 	- Runs ATCSystem::monitorAirspace() on the scan timer (1 second unless changed with "setscan").
+ * 		One scan at a time: an expiry that comes while the last scan is still running is skipped and
+ * 		counted in atc_timer_overruns_total.
+ * 		- Gets all aircraft from the Radar::runRadar() method, or their tracks with "--sensor".
  * 		- Computes if there will be violations in the future. If there is, will send a message to the display to display violations
- * 	- Runs ATCSystem::logState() on a 30 second timer.
- * 		- Logs the current aircraft grid to the VM's internal file system as a TXT file.
- *  - Starts a child thread which listens for a command to change prediction time. Changes if nessecary.
+ * 			With "--sectors" every sector computes its own on its own thread (see SectorEngine.h).
+ * 			Pairs with an aircraft flying a flight plan are decided along the plan (see TrajectoryCache.h).
+ * 		- Checks every aircraft against the restricted zones, and alerts the incursions with the
+ * 			violations (see RestrictedAirspace.h).
+ * 		- Publishes the scan once on the radar bus (see RadarBus.h).
+ * 	- Consumes the radar bus on two threads:
+ * 		- Appends every scan to the binary airspace history (see HistoryRecorder.h).
+ * 		- Publishes the changes to the display and other subscribers (see RadarPublisher.h).
+ * 	- Runs ATCSystem::logState() on the display log timer (30 seconds unless changed with "setlog").
+ * 		- Logs the aircraft grid of the newest scan to the VM's internal file system as a TXT file.
+ *  - Starts a child thread which listens for a command to change prediction time, and publishes it
+ *  	in the runtime config (see RuntimeConfig.h).
 */
 
 extern std::mutex coutMutex;
-extern std::mutex predTimeMutex;
-extern std::mutex ATCSystemRadarData;
-
-typedef struct {
-	std::vector<Aircraft> aircraftData;
-	bool received;
-} radar_msg;
+extern RadarBus radarBus;
+extern RuntimeConfig runtimeConfig;
+extern FlightPlans flightPlans;
+extern RestrictedAirspace restrictedAirspace;
 
 typedef struct{
 	int aircraft1ID;
 	int aircraft2ID;
 	bool received;
+	int rank;					// 1 is the most urgent alert of the scan
+	int flagged;				// violations in the scan, alerted or not
+	float timeToConflict;		// seconds
+	float severity;				// 0 to 1
+	int zoneID;					// -1, else aircraft1ID flies into this restricted zone
+	int advisoryCount;
+	advisory advisories[ADVISORY_MAX];	// best first
 } violation_msg;
 
 typedef struct {
@@ -37,9 +57,52 @@ typedef struct {
 
 
 ATCSystem::ATCSystem(Radar iRadar, Display iDisplay, CommunicationSystem iCommSystem):
-		radar(iRadar), display(iDisplay), commSystem(iCommSystem)
+		radar(iRadar), display(iDisplay), commSystem(iCommSystem),
+		recorder(HISTORY_DIRECTORY, 64 * 1024 * 1024, 16), scanTimer(), logTimer(), armedConfig(nullptr), timerConfigVersion(0)
 {
+	sectorLayout.columns = 1;
+	sectorLayout.rows = 1;
+	sectorLayout.pinThreads = false;
+}
 
+void ATCSystem::setSectorLayout(sector_layout iLayout)
+{
+	sectorLayout = iLayout;
+	publisher.setSectorLayout(iLayout);
+
+	// One conflict check thread per sector, from the first scan on
+	if(sectorLayout.columns * sectorLayout.rows > 1){
+		sectors = std::make_shared<SectorEngine>(sectorLayout);
+		sectors->start();
+
+		std::lock_guard<std::mutex> guard(coutMutex);
+		std::cout << "ATCSystem: " << sectorLayout.columns << " x " << sectorLayout.rows
+				<< " sectors, one conflict check thread each" << (sectorLayout.pinThreads ? ", pinned" : "") << std::endl;
+	}
+}
+
+void ATCSystem::setIncremental(bool iIncremental)
+{
+	if(iIncremental){
+		conflictCache = std::make_shared<ConflictCache>();
+
+		std::lock_guard<std::mutex> guard(coutMutex);
+		std::cout << "ATCSystem: Incremental conflict check, cached pair intervals" << std::endl;
+	}else{
+		conflictCache.reset();
+	}
+}
+
+void ATCSystem::setBroadPhase(broad_phase_kind iKind)
+{
+	if(iKind == BROAD_PHASE_BRUTE){
+		broadPhase.reset();
+		return;
+	}
+	broadPhase = std::make_shared<BroadPhase>(iKind);
+
+	std::lock_guard<std::mutex> guard(coutMutex);
+	std::cout << "ATCSystem: " << BroadPhase::kindName(iKind) << " broad phase" << std::endl;
 }
 
 void deleteLogFile() {
@@ -48,7 +111,7 @@ void deleteLogFile() {
 }
 
 // Checks for aircraft violations
-void ATCSystem::checkViolations(std::vector<Aircraft>* radarOutput)
+std::vector<violation_pair> ATCSystem::checkViolations(std::vector<Aircraft>* radarOutput, const runtime_config* config, int64_t timeMs)
 {
 	// The constraint to check is if 2 aircrafts are less than 1000 feet apart in hight or
 	// 3000 feet apart in width
@@ -57,92 +120,255 @@ void ATCSystem::checkViolations(std::vector<Aircraft>* radarOutput)
 	// the alarm in Display.cpp
 
 	std::vector<Aircraft>& radarFindings = *radarOutput; //deref the pointer
+	TraceScope trace("checkViolations", "conflict");
+	trace.setArg("aircraft", radarFindings.size());
+
+	static Counter& pairsEvaluated = metrics().counter("atc_pairs_evaluated_total", "Aircraft pairs checked for violations");
+	static Counter& violationsEmitted = metrics().counter("atc_violations_total", "Violations found by the conflict check");
 
-	{ // Critical Section
-		std::lock_guard<std::mutex> guard(ATCSystemRadarData);
-		radarData = radarFindings;
+	int VERTICAL_CONSTRAINT = config->verticalSeparation;
+	int HORIZONTAL_CONSTRAINT = config->horizontalSeparation;
+	int predTime = config->predictionSeconds;
+
+	// predict N seconds ahead of time for each aircraft, one read of its state each
+	std::vector<aircraft_state> states(radarFindings.size());
+	std::vector<aircraft_state> projections(radarFindings.size());
+	for (size_t i = 0; i < radarFindings.size(); i++) {
+		states[i] = radarFindings[i].getState();
+		projections[i] = projectState(states[i], predTime);
 	}
 
-	int VERTICAL_CONSTRAINT = 1000;
-	int HORIZONTAL_CONSTRAINT = 3000;
+	std::vector<violation_pair> violations = checkProjections(radarFindings, states, projections, timeMs,
+			HORIZONTAL_CONSTRAINT, VERTICAL_CONSTRAINT, predTime);
+
+	// Aircraft flying a plan don't go where their projection is
+	pairsEvaluated.add(trajectories.check(flightPlans.get(), radarFindings, states, HORIZONTAL_CONSTRAINT,
+			VERTICAL_CONSTRAINT, predTime, violations));
+
+	violationsEmitted.add(violations.size());
+	return violations;
+}
+
+// The violations of the straight-line projections, with whichever check the system was started with
+std::vector<violation_pair> ATCSystem::checkProjections(std::vector<Aircraft>& radarFindings, const std::vector<aircraft_state>& states,
+		const std::vector<aircraft_state>& projections, int64_t timeMs, int HORIZONTAL_CONSTRAINT, int VERTICAL_CONSTRAINT, int predTime)
+{
+	static Counter& pairsEvaluated = metrics().counter("atc_pairs_evaluated_total", "Aircraft pairs checked for violations");
+
+	std::vector<violation_pair> violations;
+
+	if (conflictCache) {
+		uint64_t pairsTested = 0;
+		bool cached = conflictCache->check(timeMs, radarFindings, states, HORIZONTAL_CONSTRAINT, VERTICAL_CONSTRAINT, predTime, violations, pairsTested);
+		pairsEvaluated.add(pairsTested);
+		if (cached) {
+			return violations;
+		}
+	}
+
+	if (sectors) {
+		uint64_t pairsTested = 0;
+		violations = sectors->check(timeMs, radarFindings, projections, HORIZONTAL_CONSTRAINT, VERTICAL_CONSTRAINT, pairsTested);
+		pairsEvaluated.add(pairsTested);
+		return violations;
+	}
+
+	if (broadPhase) {
+		std::vector<std::pair<size_t, size_t> > candidates;
+		broadPhase->candidates(states, projections, HORIZONTAL_CONSTRAINT, VERTICAL_CONSTRAINT, candidates);
+		for (size_t p = 0; p < candidates.size(); p++) {
+			size_t i = candidates[p].first, j = candidates[p].second;
+			if (separationLost(projections[i], projections[j], HORIZONTAL_CONSTRAINT, VERTICAL_CONSTRAINT)) {
+				violation_pair violation;
+				violation.aircraft1ID = radarFindings[i].getID();
+				violation.aircraft2ID = radarFindings[j].getID();
+				violations.push_back(violation);
+			}
+		}
+		pairsEvaluated.add(candidates.size());
+		return violations;
+	}
 
 	//check each aircraft against each other aircraft
 	for (size_t i = 0; i < radarFindings.size(); i++) {
 		for (size_t j = i + 1; j < radarFindings.size(); j++) {
-			Aircraft aircraft1Projection = radarFindings[i];
-			Aircraft aircraft2Projection = radarFindings[j];
-
-			int predTime;
-			{
-				std::lock_guard<std::mutex> guard(predTimeMutex);
-				predTime = predictionTimeSeconds;
+			if (separationLost(projections[i], projections[j], HORIZONTAL_CONSTRAINT, VERTICAL_CONSTRAINT)) {
+				//VIOLATION DETECTED
+				violation_pair violation;
+				violation.aircraft1ID = radarFindings[i].getID();
+				violation.aircraft2ID = radarFindings[j].getID();
+				violations.push_back(violation);
 			}
+		}
+	}
 
-			// predict N seconds ahead of time for each aircraft
-			float aircraft1ProjX = (radarFindings[i].getXPos() + (radarFindings[i].getXSpeed() * predTime));
-			float aircraft1ProjY = (radarFindings[i].getYPos() + (radarFindings[i].getYSpeed() * predTime));
-			float aircraft1ProjZ = (radarFindings[i].getZPos() + (radarFindings[i].getZSpeed() * predTime));
-			aircraft1Projection.setPos(aircraft1ProjX, aircraft1ProjY, aircraft1ProjZ);
-
-			float aircraft2ProjX = (radarFindings[j].getXPos() + (radarFindings[j].getXSpeed() * predTime));
-			float aircraft2ProjY = (radarFindings[j].getYPos() + (radarFindings[j].getYSpeed() * predTime));
-			float aircraft2ProjZ = (radarFindings[j].getZPos() + (radarFindings[j].getZSpeed() * predTime));
-			aircraft2Projection.setPos(aircraft2ProjX, aircraft2ProjY, aircraft2ProjZ);
-
-			//calculate airspace needed around aircraft 1
-			int x1Min = aircraft1Projection.getXPos() - HORIZONTAL_CONSTRAINT;
-			int x1Max = aircraft1Projection.getXPos() + HORIZONTAL_CONSTRAINT;
-			int y1Min = aircraft1Projection.getYPos() - HORIZONTAL_CONSTRAINT;
-			int y1Max = aircraft1Projection.getYPos() + HORIZONTAL_CONSTRAINT;
-			int z1Min = aircraft1Projection.getZPos() - VERTICAL_CONSTRAINT;
-			int z1Max = aircraft1Projection.getZPos() + VERTICAL_CONSTRAINT;
-
-			//calculate airspace needed around aircraft 2
-			int x2Min = aircraft2Projection.getXPos() - HORIZONTAL_CONSTRAINT;
-			int x2Max = aircraft2Projection.getXPos() + HORIZONTAL_CONSTRAINT;
-			int y2Min = aircraft2Projection.getYPos() - HORIZONTAL_CONSTRAINT;
-			int y2Max = aircraft2Projection.getYPos() + HORIZONTAL_CONSTRAINT;
-			int z2Min = aircraft2Projection.getZPos() - VERTICAL_CONSTRAINT;
-			int z2Max = aircraft2Projection.getZPos() + VERTICAL_CONSTRAINT;
-
-			//if two boxes overlap
-			if ((x1Max >= x2Min && x2Max >= x1Min)
-					&& (y1Max >= y2Min && y2Max >= y1Min)
-					&& (z1Max >= z2Min && z2Max >= z1Min)) {
-				//VIOLATION DETECTED
+	uint64_t n = radarFindings.size();
+	pairsEvaluated.add(n < 2 ? 0 : n * (n - 1) / 2);
+
+	return violations;
+}
+
+//Send violation info the Display
+void ATCSystem::sendViolation(const conflict_alert& alert, int rank, int flagged, const advisory* advisories, int advisoryCount)
+{
+	const violation_pair& violation = alert.pair;
+	static channel_metrics ipc = metrics().channel("atc_to_display_violations");
+	TRACE_SCOPE("send atc_to_display_violations", "ipc");
+
+	std::string channelName = "atc_to_display_violations";
+	int coid = name_open(channelName.c_str(), 0);
+	ipc.opens->add();
+	if(coid == -1){
+		perror("name_open");
+		ipc.failures->add();
+	}
+
+	violation_msg msg;
+	msg.received = false;
+	msg.aircraft1ID = violation.aircraft1ID;
+	msg.aircraft2ID = violation.aircraft2ID;
+	msg.rank = rank;
+	msg.flagged = flagged;
+	msg.timeToConflict = alert.timeToConflict;
+	msg.severity = alert.severity;
+	msg.zoneID = alert.zoneID;
+	msg.advisoryCount = advisoryCount;
+	for(int a = 0; a < advisoryCount; a++){
+		msg.advisories[a] = advisories[a];
+	}
+	violation_msg reply;
+	reply.received = false;
+	int status = MsgSend(coid, &msg, sizeof(msg), &reply, sizeof(reply));
+	ipc.sends->add();
+	if(status == -1){
+		perror("MsgSend");
+		ipc.failures->add();
+	}
+
+	//if no reply
+	if(reply.received == false){
+		perror("No reply from display");
+	}
+	name_close(coid);
+}
+
+std::vector<violation_pair> ATCSystem::scanAirspace(int64_t timeMs, std::vector<Aircraft>& radarFindings)
+{
+	std::lock_guard<std::mutex> scanning(scanMutex);
+	return scanAirspaceLocked(timeMs, radarFindings);
+}
 
-				//Send violation info the Display
-				std::string channelName = "atc_to_display_violations";
-				int coid = name_open(channelName.c_str(), 0);
-				if(coid == -1){
-					perror("name_open");
-				}
-
-				violation_msg msg;
-				msg.received = false;
-				msg.aircraft1ID = radarFindings[i].getID();
-				msg.aircraft2ID = radarFindings[j].getID();
-				violation_msg reply;
-				reply.received = false;
-				int status = MsgSend(coid, &msg, sizeof(msg), &reply, sizeof(reply));
-				if(status == -1){
-					perror("MsgSend");
-				}
-
-				//if no reply
-				if(reply.received == false){
-					perror("No reply from display");
-				}
+std::vector<violation_pair> ATCSystem::scanAirspaceLocked(int64_t timeMs, std::vector<Aircraft>& radarFindings)
+{
+	static Counter& scans = metrics().counter("atc_scans_total", "Radar scans completed, rate() gives scans per second");
+	static Histogram& scanDuration = metrics().histogram("atc_scan_duration_seconds", "Radar scan, conflict check and alerts");
+	static Gauge& tracked = metrics().gauge("atc_aircraft_tracked", "Aircraft in the airspace in the last scan");
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	TRACE_SCOPE("scanAirspace", "radar");
+
+	// Get info of all flights from the radar
+	radarFindings = radar.runRadar(timeMs);
+
+	// Check for airspace violations. One load of the config for the whole scan, changes made
+	// during it count from the next one
+	const runtime_config* config = runtimeConfig.get();
+	std::vector<violation_pair> violations = checkViolations(&radarFindings, config, timeMs);
+
+	// And for restricted zones, only alerted (the radar bus and the replay digest don't carry them)
+	const ZoneIndex* zones = restrictedAirspace.get();
+	std::vector<zone_incursion> incursions;
+	if(alertsToDisplay && zones->size() > 0){
+		static Counter& incursionsFound = metrics().counter("atc_zone_incursions_total", "Aircraft inside or predicted into a restricted zone");
+		TRACE_SCOPE("restricted zones", "conflict");
+		for(size_t i = 0; i < radarFindings.size(); i++){
+			zones->incursions(radarFindings[i].getID(), radarFindings[i].getState(), config->predictionSeconds, incursions);
+		}
+		incursionsFound.add(incursions.size());
+	}
+
+	if(alertsToDisplay && (!violations.empty() || !incursions.empty())){
+		static Counter& advised = metrics().counter("atc_advisories_total", "Resolution advisories attached to alerts");
+		static Counter& unadvised = metrics().counter("atc_alerts_without_advisories_total", "Alerts sent without advisories, none found or out of budget");
+		static Counter& notShown = metrics().counter("atc_alerts_not_shown_total", "Violations less urgent than the top alerts of their scan");
+		static Histogram& adviseDuration = metrics().histogram("atc_advisory_seconds", "Advisories of one scan");
+
+		{
+			TRACE_SCOPE("index advisories", "conflict");
+			advisor.index(radarFindings, config->horizontalSeparation, config->verticalSeparation, config->predictionSeconds);
+		}
+
+		// Only the most urgent are alerted, however many pairs were flagged
+		alertQueue.clear();
+		for(size_t i = 0; i < violations.size(); i++){
+			const aircraft_state* a = advisor.stateOf(violations[i].aircraft1ID);
+			const aircraft_state* b = advisor.stateOf(violations[i].aircraft2ID);
+			if(a != nullptr && b != nullptr){
+				conflict_alert alert = AlertQueue::assess(violations[i], *a, *b, config->horizontalSeparation,
+						config->verticalSeparation, config->predictionSeconds);
+				// Along the flight plans, when there are any
+				trajectories.lossOf(violations[i], alert.timeToConflict, alert.severity);
+				alertQueue.push(alert);
+			}
+		}
+		for(size_t i = 0; i < incursions.size(); i++){
+			conflict_alert alert;
+			alert.pair.aircraft1ID = incursions[i].aircraftID;
+			alert.pair.aircraft2ID = -1;
+			alert.timeToConflict = incursions[i].timeToIncursion;
+			alert.severity = incursions[i].severity;
+			alert.zoneID = incursions[i].zoneID;
+			alertQueue.push(alert);
+		}
+		std::vector<conflict_alert> alerts = alertQueue.sorted();
+		notShown.add(alertQueue.getFlagged() - alerts.size());
+
+		// Advisories for the alerts in order, as long as the budget of the scan lasts
+		std::chrono::steady_clock::time_point adviseStart = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point adviseEnd = adviseStart + std::chrono::microseconds(ADVISORY_BUDGET_US);
+		std::vector<advisory> advisories(alerts.size() * ADVISORY_MAX);
+		std::vector<int> advisoryCounts(alerts.size(), 0);
+		for(size_t i = 0; i < alerts.size() && std::chrono::steady_clock::now() < adviseEnd; i++){
+			if(alerts[i].zoneID >= 0){
+				continue;
+			}
+			advisoryCounts[i] = advisor.advise(alerts[i].pair, &advisories[i * ADVISORY_MAX], ADVISORY_MAX);
+			advised.add(advisoryCounts[i]);
+		}
+		adviseDuration.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - adviseStart).count());
+
+		for(size_t i = 0; i < alerts.size(); i++){
+			if(advisoryCounts[i] == 0 && alerts[i].zoneID < 0){
+				unadvised.add();
 			}
+			sendViolation(alerts[i], i + 1, alertQueue.getFlagged(), &advisories[i * ADVISORY_MAX], advisoryCounts[i]);
+		}
+	}
+
+	// Hand the scan to the recorder, radar update publisher, display log, showaircrafts and the
+	// conflict selector of bulk commands
+	radarBus.publish(timeMs, radarFindings, violations);
 
+	int entered = 0;
+	for(size_t i = 0; i < radarFindings.size(); i++){
+		if((int64_t)radarFindings[i].getEntryTime() * 1000 <= timeMs){
+			entered++;
 		}
 	}
+	tracked.set(entered);
+	scans.add();
+	scanDuration.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+
+	return violations;
 }
 
 // Gives a log statement of the airspace
 void ATCSystem::logState(union sigval sv)
 {
     ATCSystem* ATCSys = static_cast<ATCSystem*>(sv.sival_ptr);
+    static Counter& logBytes = metrics().counter("atc_log_bytes_total", "Bytes written to logs", "log=\"display\"");
+    Trace::setThreadName("ATCSystem log timer");
+    TRACE_SCOPE("logState", "log");
 
     {
         std::lock_guard<std::mutex> guard(coutMutex);
@@ -156,21 +382,22 @@ void ATCSystem::logState(union sigval sv)
         return; // Exit the function if the file cannot be opened
     }
 
-    // Create a copy of the radar data to avoid modifying shared state
-    std::vector<Aircraft> radarDataCopy;
-    {
-        std::lock_guard<std::mutex> guard(ATCSystemRadarData); // Assuming ATCSystemRadarData is a mutex for radarData
-        radarDataCopy = ATCSys->radarData;
+    // The newest scan from the radar bus, shared, no copy
+    radar_snapshot_ptr snapshot;
+    if (!ATCSys->logSubscription->latest(snapshot)) {
+        close(fd);
+        return;
     }
 
     // Generate the display string
-    std::string displayString = ATCSys->display.buildGrid(radarDataCopy);
+    std::string displayString = ATCSys->display.buildGrid(snapshot->aircraftData);
 
     // Write the string to the file
     ssize_t bytesWritten = write(fd, displayString.c_str(), displayString.size());
     if (bytesWritten == -1) {
         perror("ATCSystem: Error writing to log file");
     } else {
+        logBytes.add(bytesWritten);
         {
             std::lock_guard<std::mutex> guard(coutMutex);
             std::cout << "ATCSystem: Successfully logged state to file." << std::endl;
@@ -186,35 +413,82 @@ void ATCSystem::logState(union sigval sv)
 
 void ATCSystem::monitorAirspace(union sigval sv){
 	ATCSystem* ATCSys = static_cast<ATCSystem*>(sv.sival_ptr);
+	static Counter& overruns = metrics().counter("atc_timer_overruns_total", "Timer expirations missed because the handler was late", "timer=\"scan\"");
 
-	// Get info of all flights from the radar
-	std::vector<Aircraft> radarFindings = ATCSys->radar.runRadar();
+	// Timer threads can be new for every expiry, so the name is set every time
+	Trace::setThreadName("ATCSystem scan timer");
 
-	// Check for airspace violations
-	ATCSys->checkViolations(&radarFindings);
+	int missed = timer_getoverrun(ATCSys->scanTimer);
+	if(missed > 0){
+		overruns.add(missed);
+	}
 
-	// Send radar data to the display
-	std::string channelName = "radar_to_display";
-	int coid = name_open(channelName.c_str(), 0);
-	if (coid == -1) {
-		perror("name_open");
+	// A tuning command changed a timer period since the last scan
+	const runtime_config* config = runtimeConfig.get();
+	if(config->version != ATCSys->timerConfigVersion.load(std::memory_order_relaxed)){
+		ATCSys->applyTimerPeriods(config);
 	}
 
-	radar_msg msg;
-	msg.received = false;
-	msg.aircraftData = radarFindings;
-	radar_msg reply;
-	msg.received = false;
-	reply.aircraftData = radarFindings;
-	int status = MsgSend(coid, &msg, sizeof(msg), &reply, sizeof(reply));
-	if(status == -1){
-		perror("MsgSend");
+	// Expiries get a thread each, so a scan running late would overlap this one: skip it instead
+	std::unique_lock<std::mutex> scanning(ATCSys->scanMutex, std::try_to_lock);
+	if(!scanning.owns_lock()){
+		overruns.add();
+		return;
 	}
 
-	if(reply.received == false){
-		perror("No reply from Display");
+	std::vector<Aircraft> radarFindings;
+	ATCSys->scanAirspaceLocked(getElapsedTimeMs(), radarFindings);
+}
+
+static bool armTimer(timer_t timer, int periodMs) {
+	struct itimerspec its;
+	its.it_value.tv_sec = periodMs / 1000;
+	its.it_value.tv_nsec = (long)(periodMs % 1000) * 1000000;
+	its.it_interval = its.it_value;
+	return timer_settime(timer, 0, &its, nullptr) != -1;
+}
+
+// Re-arms the scan and display log timers with the periods of config, at most once per version
+void ATCSystem::applyTimerPeriods(const runtime_config* config){
+	std::lock_guard<std::mutex> lock(timerMutex);
+	if(armedConfig != nullptr && armedConfig->version >= config->version){
+		return;
+	}
+
+	// The first time (from start()) the timers are armed whatever their period
+	const runtime_config* previous = armedConfig;
+	if(previous == nullptr || previous->scanPeriodMs != config->scanPeriodMs){
+		if(!armTimer(scanTimer, config->scanPeriodMs)){
+			std::cerr << "Error setting timer for ATCSystem Collision Check: " << strerror(errno) << std::endl;
+		}
+	}
+	if(previous == nullptr || previous->logPeriodMs != config->logPeriodMs){
+		if(!armTimer(logTimer, config->logPeriodMs)){
+			std::cerr << "Error setting timer for ATC display log: " << strerror(errno) << std::endl;
+		}
+	}
+	armedConfig = config;
+	timerConfigVersion.store(config->version, std::memory_order_relaxed);
+}
+
+// Appends every scan from the radar bus to the history
+void* ATCSystem::recordScans(){
+	Trace::setThreadName("ATCSystem history");
+	radar_snapshot_ptr snapshot;
+	while(recorderSubscription->next(snapshot)){
+		recorder.recordScan(snapshot->timeMs, snapshot->aircraftData);
 	}
+	return nullptr;
+}
 
+// Sends the display and other subscribers what changed in the newest scan
+void* ATCSystem::publishUpdates(){
+	Trace::setThreadName("ATCSystem radar updates");
+	radar_snapshot_ptr snapshot;
+	while(publisherSubscription->next(snapshot)){
+		publisher.publish(snapshot->timeMs, snapshot->aircraftData);
+	}
+	return nullptr;
 }
 
 
@@ -227,14 +501,31 @@ void* ATCSystem::start() {
 	// Delete past log file
 	deleteLogFile();
 
+	// Map the airspace history, the ring keeps what previous runs recorded
+	recorder.open();
+
 	// Start thread for listening for prediction time change
 	pthread_t ATCSysListenerThread;
 	pthread_create(&ATCSysListenerThread, NULL, &ATCSystem::startListenerThread, this);
 
+	// Start thread for radar update subscriptions
+	pthread_t publisherListenerThread;
+	pthread_create(&publisherListenerThread, NULL, &RadarPublisher::startListenerThread, &publisher);
+
+	// Consumers of the radar bus. The history must see every scan, the others only need the newest.
+	recorderSubscription = radarBus.subscribe("history", 16, BUS_BLOCK);
+	publisherSubscription = radarBus.subscribe("radar updates", 1, BUS_LATEST);
+	logSubscription = radarBus.subscribe("display log", 1, BUS_LATEST);
+
+	pthread_t recorderThread;
+	pthread_create(&recorderThread, NULL, &ATCSystem::startRecorderThread, this);
+
+	pthread_t publisherThread;
+	pthread_create(&publisherThread, NULL, &ATCSystem::startPublisherThread, this);
+
 	// Start timer for collision checking
-	timer_t collisionCheck_timer_id;
+	timer_t& collisionCheck_timer_id = scanTimer;
 	struct sigevent sevC;
-	struct itimerspec itsC;
 
 	sevC.sigev_notify = SIGEV_THREAD;
 	sevC.sigev_notify_function = ATCSystem::monitorAirspace;
@@ -245,38 +536,21 @@ void* ATCSystem::start() {
 		std::cerr << "Error creating timer for ATCSystem Collision Check: " << strerror(errno) << std::endl;
 	}
 
-	//repeats every second
-	itsC.it_value.tv_sec = 1;
-	itsC.it_value.tv_nsec = 0;
-	itsC.it_interval.tv_sec = 1;
-	itsC.it_interval.tv_nsec = 0;
-
-	if(timer_settime(collisionCheck_timer_id, 0, &itsC, nullptr) == -1){
-		std::cerr << "Error setting timer for ATCSystem Collision Check: " << strerror(errno) << std::endl;
-	}
-
-	// TODO start timer for file logging every 30 seconds
-	timer_t log30_timer_id;
+	// Start timer for the display log
+	timer_t& log_timer_id = logTimer;
 	struct sigevent sevL;
-	struct itimerspec itsL;
 
 	sevL.sigev_notify = SIGEV_THREAD;
 	sevL.sigev_notify_function = ATCSystem::logState;
 	sevL.sigev_value.sival_ptr = this;
 	sevL.sigev_notify_attributes = nullptr;
 
-	if(timer_create(CLOCK_REALTIME, &sevL, &log30_timer_id) == -1){
-		std::cerr << "Error creating timer for ATCSystem 30 second display log: " << strerror(errno) << std::endl;
+	if(timer_create(CLOCK_REALTIME, &sevL, &log_timer_id) == -1){
+		std::cerr << "Error creating timer for ATCSystem display log: " << strerror(errno) << std::endl;
 	}
 
-	itsL.it_value.tv_sec = 30;
-	itsL.it_value.tv_nsec = 0;
-	itsL.it_interval.tv_sec = 30;
-	itsL.it_interval.tv_nsec = 0;
-
-	if(timer_settime(log30_timer_id, 0, &itsL, nullptr) == -1){
-		std::cerr << "Error setting timer for ATC 30 second display log: " << strerror(errno) << std::endl;
-	}
+	// Every scan period and every log period of the runtime config (1 s and 30 s by default)
+	applyTimerPeriods(runtimeConfig.get());
 
 	return nullptr;
 
@@ -304,10 +578,8 @@ void* ATCSystem::startListener(){
 			std::cout << "ATCSystem: Received request to change prediction time. " << std::endl;
 		}
 
-		{
-			std::lock_guard<std::mutex> guard(predTimeMutex);
-			this->setPredTime(msg.predTime);
-		}
+		int predTime = msg.predTime;
+		runtimeConfig.update([predTime](runtime_config& config){ config.predictionSeconds = predTime; });
 
 		MsgReply(rcvid, EOK, NULL, 0);
 	}
@@ -321,3 +593,11 @@ void* ATCSystem::startThread(void* context){
 void* ATCSystem::startListenerThread(void* context){
 	return static_cast<ATCSystem*>(context)->startListener();
 }
+
+void* ATCSystem::startRecorderThread(void* context){
+	return static_cast<ATCSystem*>(context)->recordScans();
+}
+
+void* ATCSystem::startPublisherThread(void* context){
+	return static_cast<ATCSystem*>(context)->publishUpdates();
+}
@@ -2,33 +2,111 @@
 #define ATCSYSTEM_H_
 
 #include <vector>
+#include <ctime>
+#include <atomic>
+#include <mutex>
 #include "Radar.h"
 #include "Display.h"
 #include "Aircraft.h"
 #include "CommunicationSystem.h"
+#include "HistoryRecorder.h"
+#include "RadarPublisher.h"
+#include "RadarBus.h"
+#include "RuntimeConfig.h"
+#include "SectorEngine.h"
+#include "ConflictCache.h"
+#include "BroadPhase.h"
+#include "ResolutionAdvisor.h"
+#include "AlertQueue.h"
+#include "FlightPlan.h"
+#include "TrajectoryCache.h"
+#include "RestrictedAirspace.h"
 
 class ATCSystem {
 private:
     Radar radar;
     Display display;
     CommunicationSystem commSystem;
-    std::vector<Aircraft> radarData;
 
-    //how far forward we predict collisions
-    int predictionTimeSeconds = 180;
+    // what this component takes from the radar bus
+    std::shared_ptr<RadarSubscription> recorderSubscription;
+    std::shared_ptr<RadarSubscription> publisherSubscription;
+    std::shared_ptr<RadarSubscription> logSubscription;
+
+    // binary history of every scan, for incident reconstruction
+    HistoryRecorder recorder;
+
+    // radar updates to the display and other subscribers
+    RadarPublisher publisher;
+
+    // the scan and display log timers, re-armed when their period in the runtime config changes
+    timer_t scanTimer;
+    timer_t logTimer;
+    std::mutex timerMutex;
+    const runtime_config* armedConfig;
+    std::atomic<uint64_t> timerConfigVersion;
+
+    void applyTimerPeriods(const runtime_config* config);
+
+    // one conflict check per sector, on their own threads, instead of one for the whole airspace
+    sector_layout sectorLayout;
+    std::shared_ptr<SectorEngine> sectors;
+
+    // cached conflict intervals, only the pairs near a conflict are checked (replaces the sectors)
+    std::shared_ptr<ConflictCache> conflictCache;
+
+    // the pairs worth testing, when it isn't every pair (brute force)
+    std::shared_ptr<BroadPhase> broadPhase;
+
+    // the trajectories of aircraft flying a flight plan, which decide their pairs
+    TrajectoryCache trajectories;
+
+    std::vector<violation_pair> checkProjections(std::vector<Aircraft>& radarFindings, const std::vector<aircraft_state>& states,
+    		const std::vector<aircraft_state>& projections, int64_t timeMs, int horizontal, int vertical, int predTime);
+
+    // held for a whole scan: the conflict cache, broad phase, trajectories, advisor, alert queue
+    // and the radar's tracker are the state of one scan at a time. A late scan timer expiry is
+    // skipped instead of waiting for it (see monitorAirspace()).
+    std::mutex scanMutex;
+
+    // scanAirspace() with scanMutex held
+    std::vector<violation_pair> scanAirspaceLocked(int64_t timeMs, std::vector<Aircraft>& radarFindings);
+
+    // a replay collects the violations itself instead of alerting the display
+    bool alertsToDisplay = true;
+
+    // the most urgent violations of a scan, the only ones alerted, and their advisories
+    AlertQueue alertQueue;
+    ResolutionAdvisor advisor;
+
+    void sendViolation(const conflict_alert& alert, int rank, int flagged, const advisory* advisories, int advisoryCount);
 
 public:
     ATCSystem(Radar iRadar, Display iDisplay, CommunicationSystem iCommSystem);
 
-    void setPredTime(int iPredictionTimeSeconds) { predictionTimeSeconds = iPredictionTimeSeconds; }
-
     void setRadar(Radar iRadar);
 
+    void setAlertsToDisplay(bool iAlertsToDisplay) { alertsToDisplay = iAlertsToDisplay; }
+
+    // Before the first scan: more than one sector starts a SectorEngine and its threads
+    void setSectorLayout(sector_layout iLayout);
+
+    // Before the first scan: check the airspace incrementally with a ConflictCache
+    void setIncremental(bool iIncremental);
+
+    // Before the first scan: the broad phase of the single conflict check
+    void setBroadPhase(broad_phase_kind iKind);
+
     // While loop to continously run the system
     void run();
 
-    // Checks for aircraft violations
-    void checkViolations(std::vector<Aircraft>* radarFindings);
+    // Checks for aircraft violations with the separations and prediction of config, in the order
+    // the pairs are checked (the same with sectors)
+    std::vector<violation_pair> checkViolations(std::vector<Aircraft>* radarFindings, const runtime_config* config, int64_t timeMs = 0);
+
+    // One scan: radar, violation check and alerts, radar bus. Returns the violations found.
+    // Waits for a scan in progress to finish.
+    std::vector<violation_pair> scanAirspace(int64_t timeMs, std::vector<Aircraft>& radarFindings);
 
     // Gives a log statement of the airspace
     static void logState(union sigval sv);
@@ -38,10 +116,14 @@ public:
     //thread routine
 	void* start();
 	void* startListener();
+	void* recordScans();
+	void* publishUpdates();
 
 	//routine started by the thread
 	static void* startThread(void* context);
 	static void* startListenerThread(void* context);
+	static void* startRecorderThread(void* context);
+	static void* startPublisherThread(void* context);
 };
 
 #endif /* ATCSYSTEM_H_ */
@@ -4,25 +4,36 @@
 #include <ctime>
 #include <sys/dispatch.h>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
 
 #include "CommunicationSystem.h"
 #include "Aircraft.h"
+#include "SimulationClock.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "FlightPlan.h"
 
 /* RESPONSIBILITIES
  * Each aircraft has a thread, which runs start();
- * Each aircraft updates its position every second on a timer
+ * Each aircraft updates its position every second on a timer (or when a replay calls advance())
  * Each aircraft listens for a changespeed command to change its speed
+ * Each aircraft with a flight plan flies it, its progress is kept and read with its position
+ * Position and speed are one SeqLock: the timer, the changespeed listener and the Fleet write
+ * 	it without blocking the radar reply, and the radar reply never sees half of a write
  * Each aircraft
  */
 
 extern std::mutex coutMutex;
-extern std::chrono::steady_clock::time_point programStartTime;
+extern FlightPlans flightPlans;
 
 typedef struct {
 	int entryTime;
 	int aircraftID;
 	float X, Y, Z;
 	float mSpeedX, mSpeedY, mSpeedZ;
+	plan_progress progress;
 	CommunicationSystem commSystem;
 } aircraft_msg;
 
@@ -34,29 +45,37 @@ typedef struct {
 	float zSpeed;
 } changespeed_cmd;
 
-inline int getElapsedTime() {
-    auto now = std::chrono::steady_clock::now();
-    return std::chrono::duration_cast<std::chrono::seconds>(now - programStartTime).count();
-}
-
 // Aircraft constructor
 Aircraft::Aircraft(int iEntryTime , int iId, float iX, float iY, float iZ, float iSpeedX, float iSpeedY, float iSpeedZ, CommunicationSystem iCommSystem) :
-	mEntryTime(iEntryTime), mId(iId), mX(iX), mY(iY), mZ(iZ), mSpeedX(iSpeedX), mSpeedY(iSpeedY), mSpeedZ(iSpeedZ), commSystem(iCommSystem)
+	mEntryTime(iEntryTime), mId(iId), mState(), mManualClock(false), mPositionTimer(), commSystem(iCommSystem)
 {
+	flight_state state;
+	state.state.x = iX;
+	state.state.y = iY;
+	state.state.z = iZ;
+	state.state.speedX = iSpeedX;
+	state.state.speedY = iSpeedY;
+	state.state.speedZ = iSpeedZ;
+	state.progress.leg = 0;
+	state.progress.planVersion = 0;
+	state.unreportedSeconds = 0;
+	mState.write(state);
+
 	// Creates each aircraft object from an input text file
 }
 
 // Debug method, not used in final version
 void Aircraft::coutDebug(){
+	aircraft_state state = getState();
 	{
 		std::lock_guard<std::mutex> guard(coutMutex);
 		std::cout << "Debug: Info from Aircraft ID: " << mId << std::endl;
-		std::cout << "X: " << mX << std::endl;
-		std::cout << "Y: " << mY << std::endl;
-		std::cout << "Z: " << mZ << std::endl;
-		std::cout << "X Speed: " << mSpeedX << std::endl;
-		std::cout << "Y Speed: " << mSpeedY << std::endl;
-		std::cout << "Z Speed: " << mSpeedZ << std::endl;
+		std::cout << "X: " << state.x << std::endl;
+		std::cout << "Y: " << state.y << std::endl;
+		std::cout << "Z: " << state.z << std::endl;
+		std::cout << "X Speed: " << state.speedX << std::endl;
+		std::cout << "Y Speed: " << state.speedY << std::endl;
+		std::cout << "Z Speed: " << state.speedZ << std::endl;
 	}
 }
 
@@ -65,11 +84,35 @@ void Aircraft::coutDebug(){
 void Aircraft::updatePosition(union sigval sv)
 {
 	Aircraft* aircraft = static_cast<Aircraft*>(sv.sival_ptr);
+	static Counter& overruns = metrics().counter("atc_timer_overruns_total", "Timer expirations missed because the handler was late", "timer=\"aircraft_position\"");
 
-	if (aircraft->getEntryTime() <= getElapsedTime()) {
-		aircraft->mX += aircraft->mSpeedX;
-		aircraft->mY += aircraft->mSpeedY;
-		aircraft->mZ += aircraft->mSpeedZ;
+	int missed = timer_getoverrun(aircraft->mPositionTimer);
+	if(missed > 0){
+		overruns.add(missed);
+	}
+
+	aircraft->advance();
+}
+
+// One second of flight, once the aircraft has entered the airspace
+void Aircraft::advance()
+{
+	static Counter& positionUpdates = metrics().counter("atc_aircraft_position_updates_total", "Seconds of flight applied to aircraft");
+
+	if (getEntryTime() <= getElapsedTime()) {
+		const flight_plan* plan = FlightPlans::find(flightPlans.get(), mId);
+		bool report = false;
+		mState.modify([plan, &report](flight_state& f){
+			FlightPlans::fly(f.state, f.progress, plan);
+			// Every aircraft adding each second would contend on the counter's cache line
+			if(++f.unreportedSeconds == POSITION_UPDATES_BATCH){
+				f.unreportedSeconds = 0;
+				report = true;
+			}
+		});
+		if(report){
+			positionUpdates.add(POSITION_UPDATES_BATCH);
+		}
 	}
 }
 
@@ -83,29 +126,30 @@ void* Aircraft::start()
 		std::cout << "Aircraft: Aircraft Thread started" << std::endl << std::flush;
 	}
 
-	// Create timer to update plane location.
-	timer_t plane_timer_id;
+	// Create timer to update plane location, unless a replay moves the aircraft itself.
+	timer_t& plane_timer_id = mPositionTimer;
 	struct sigevent sev;
 	struct itimerspec its;
 
-	sev.sigev_notify = SIGEV_THREAD; //Notify via thread
-	sev.sigev_notify_function = Aircraft::updatePosition;
-	sev.sigev_value.sival_ptr = this; // Pass this Aircraft instance
-	sev.sigev_notify_attributes = nullptr; // Default thread attributes
-
+	if(!mManualClock){
+		sev.sigev_notify = SIGEV_THREAD; //Notify via thread
+		sev.sigev_notify_function = Aircraft::updatePosition;
+		sev.sigev_value.sival_ptr = this; // Pass this Aircraft instance
+		sev.sigev_notify_attributes = nullptr; // Default thread attributes
 
-	if(timer_create(CLOCK_REALTIME, &sev, &plane_timer_id) == -1){
-		std::cerr << "Error creating timer for Aircraft: " << strerror(errno) << std::endl;
-	}
+		if(timer_create(CLOCK_REALTIME, &sev, &plane_timer_id) == -1){
+			std::cerr << "Error creating timer for Aircraft: " << strerror(errno) << std::endl;
+		}
 
-	// Set time timer to expire after 1 second, and then repeat every 1 second.
-	its.it_value.tv_sec = 1;  // Initial expiration after 1 seconds
-	its.it_value.tv_nsec = 0;
-	its.it_interval.tv_sec = 1; // Repeat every 1 second
-	its.it_interval.tv_nsec = 0;
+		// Set time timer to expire after 1 second, and then repeat every 1 second.
+		its.it_value.tv_sec = 1;  // Initial expiration after 1 seconds
+		its.it_value.tv_nsec = 0;
+		its.it_interval.tv_sec = 1; // Repeat every 1 second
+		its.it_interval.tv_nsec = 0;
 
-	if(timer_settime(plane_timer_id, 0, &its, nullptr) == -1){
-		std::cerr << "Error setting timer for Aircraft: " << strerror(errno) << std::endl;
+		if(timer_settime(plane_timer_id, 0, &its, nullptr) == -1){
+			std::cerr << "Error setting timer for Aircraft: " << strerror(errno) << std::endl;
+		}
 	}
 
 	//start thread to listen from communicaiton system
@@ -120,6 +164,8 @@ void* Aircraft::start()
 		perror("name_attach");
 	}
 
+	Trace::setThreadName(("Aircraft " + std::to_string(this->getId())).c_str());
+
 	int rcvid;
 	aircraft_msg msg;
 
@@ -131,16 +177,21 @@ void* Aircraft::start()
 		if (rcvid == -1) {
 			perror("MsgReceive");
 		}
+		TRACE_SCOPE("radar reply", "ipc");
 
+		// One read, so position, speed and plan progress are from the same moment
+		flight_state flight = mState.read();
+		const aircraft_state& state = flight.state;
 		aircraft_msg reply;
 		reply.entryTime = this->getEntryTime();
 		reply.aircraftID = this->getId();
-		reply.X = this->getXPos();
-		reply.Y = this->getYPos();
-		reply.Z = this->getZPos();
-		reply.mSpeedX = this->getXSpeed();
-		reply.mSpeedY = this->getYSpeed();
-		reply.mSpeedZ = this->getZSpeed();
+		reply.X = state.x;
+		reply.Y = state.y;
+		reply.Z = state.z;
+		reply.mSpeedX = state.speedX;
+		reply.mSpeedY = state.speedY;
+		reply.mSpeedZ = state.speedZ;
+		reply.progress = flight.progress;
 		reply.commSystem = this->getCommSystem();
 
 		int status = MsgReply(rcvid, 0, &reply, sizeof(reply));
@@ -164,6 +215,8 @@ void* Aircraft::startCommListener(){
 		perror("name_attach");
 	}
 
+	static Counter& speedChanges = metrics().counter("atc_aircraft_speed_changes_total", "changespeed commands applied by aircraft");
+
 	int rcvid;
 	changespeed_cmd msg;
 
@@ -180,6 +233,7 @@ void* Aircraft::startCommListener(){
 		}
 
 		this->setSpeed(msg.xSpeed, msg.ySpeed, msg.zSpeed);
+		speedChanges.add();
 
 		MsgReply(rcvid, EOK, NULL, 0);
 	}
@@ -189,3 +243,71 @@ void* Aircraft::startCommListener(){
 void* Aircraft::startCommListenerThread(void* context){
 	return static_cast<Aircraft*>(context)->startCommListener();
 }
+
+// The three writers of a live aircraft (position timer, changespeed listener, Fleet) and the
+// readers run flat out against one aircraft. Every write keeps x == y == z and
+// speedX == speedY == speedZ, so a state that breaks either was torn.
+int Aircraft::stressTest(int seconds, int readers, std::ostream& out) {
+	CommunicationSystem commSystem;
+	Aircraft aircraft(0, 1, 0, 0, 0, 1, 1, 1, commSystem);
+	std::atomic<bool> stop(false);
+	std::atomic<uint64_t> writes(0), reads(0), retries(0), torn(0);
+
+	out << "+-------------+ Aircraft state stress test: 3 writers, " << readers << " readers, " << seconds << " s +-------------+" << std::endl;
+
+	std::vector<std::thread> threads;
+	threads.push_back(std::thread([&]{
+		uint64_t count = 0;
+		while(!stop.load(std::memory_order_relaxed)){
+			aircraft.advance();
+			count++;
+		}
+		writes += count;
+	}));
+	threads.push_back(std::thread([&]{
+		uint64_t count = 0;
+		while(!stop.load(std::memory_order_relaxed)){
+			float speed = (float)(count % 1000) - 500;
+			aircraft.setSpeed(speed, speed, speed);
+			count++;
+		}
+		writes += count;
+	}));
+	threads.push_back(std::thread([&]{
+		uint64_t count = 0;
+		while(!stop.load(std::memory_order_relaxed)){
+			// Keeps the position small enough that x, y and z stay exact
+			float position = (float)(count % 100000);
+			aircraft.setPos(position, position, position);
+			count++;
+		}
+		writes += count;
+	}));
+	for(int r = 0; r < readers; r++){
+		threads.push_back(std::thread([&]{
+			uint64_t count = 0, bad = 0;
+			unsigned retried = 0;
+			while(!stop.load(std::memory_order_relaxed)){
+				aircraft_state state = aircraft.mState.read(&retried).state;
+				if(state.x != state.y || state.y != state.z || state.speedX != state.speedY || state.speedY != state.speedZ){
+					bad++;
+				}
+				count++;
+			}
+			reads += count;
+			retries += retried;
+			torn += bad;
+		}));
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	stop = true;
+	for(size_t i = 0; i < threads.size(); i++){
+		threads[i].join();
+	}
+
+	out << "| writes: " << writes << " (" << writes / seconds << "/s), reads: " << reads << " (" << reads / seconds << "/s)" << std::endl;
+	out << "| reads retried because a write overlapped: " << retries << ", torn states seen: " << torn << std::endl;
+	out << "+-------------+ " << (torn == 0 ? "No torn reads" : "TORN READS") << " +-------------+" << std::endl;
+	return torn == 0 ? 0 : 1;
+}
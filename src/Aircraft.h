@@ -2,14 +2,40 @@
 #define AIRCRAFT_H_
 
 #include <iostream>
+#include <ctime>
+#include <stdint.h>
 #include "CommunicationSystem.h"
+#include "SeqLock.h"
+
+// Position and speed, always read and written together
+typedef struct {
+	float x, y, z;
+	float speedX, speedY, speedZ;
+} aircraft_state;
+
+// Seconds of flight an aircraft adds to atc_aircraft_position_updates_total at once
+#define POSITION_UPDATES_BATCH 10
+
+// How far an aircraft is along its flight plan (see FlightPlan.h)
+typedef struct {
+	int leg;				// the waypoint it is flying to
+	uint32_t planVersion;	// of the plan leg counts in, 0 before it had one
+} plan_progress;
 
 class Aircraft {
 private:
 	int mEntryTime;
     int mId;
-    float mX, mY, mZ;     // Position coordinates
-    float mSpeedX, mSpeedY, mSpeedZ; // Speed coordinates
+    // Written by the position timer, the changespeed listener and the Fleet, read by the
+    // radar reply thread: each read sees one whole write, see SeqLock.h
+    typedef struct {
+    	aircraft_state state;
+    	plan_progress progress;
+    	uint32_t unreportedSeconds;	// flown but not yet added to the position update counter
+    } flight_state;
+    SeqLock<flight_state> mState;
+    bool mManualClock; // no position timer, advance() is called by a replay
+    timer_t mPositionTimer; // for its overrun count
 
     CommunicationSystem commSystem;
 
@@ -20,27 +46,46 @@ private:
 public:
 	int getId() const { return mId; }
 	int getID() const { return mId; }
-	float getXPos() const { return mX; }
-	float getYPos() const { return mY; }
-	float getZPos() const { return mZ; }
-	float getXSpeed() const { return mSpeedX; }
-	float getYSpeed() const { return mSpeedY; }
-	float getZSpeed() const { return mSpeedZ; }
+	// Each getter reads the whole state, use getState() for more than one field of a live aircraft
+	aircraft_state getState() const { return mState.read().state; }
+	float getXPos() const { return mState.read().state.x; }
+	float getYPos() const { return mState.read().state.y; }
+	float getZPos() const { return mState.read().state.z; }
+	float getXSpeed() const { return mState.read().state.speedX; }
+	float getYSpeed() const { return mState.read().state.speedY; }
+	float getZSpeed() const { return mState.read().state.speedZ; }
+	plan_progress getPlanProgress() const { return mState.read().progress; }
 	int getEntryTime() const { return mEntryTime; }
 	CommunicationSystem getCommSystem() const { return commSystem; }
 
-	void setXPos(float iX) { mX = iX; }
-	void setYPos(float iY) { mY = iY; }
-	void setZPos(float iZ) { mZ = iZ; }
-	void setPos(float iX, float iY, float iZ) { mX = iX; mY = iY; mZ = iZ; }
-	void setXSpeed(float iSpeedX) { mSpeedX = iSpeedX; }
-	void setYSpeed(float iSpeedY) { mSpeedY = iSpeedY; }
-	void setZSpeed(float iSpeedZ) { mSpeedZ = iSpeedZ; }
+	void setXPos(float iX) { mState.modify([=](flight_state& f){ f.state.x = iX; }); }
+	void setYPos(float iY) { mState.modify([=](flight_state& f){ f.state.y = iY; }); }
+	void setZPos(float iZ) { mState.modify([=](flight_state& f){ f.state.z = iZ; }); }
+	void setPos(float iX, float iY, float iZ) {
+		mState.modify([=](flight_state& f){ f.state.x = iX; f.state.y = iY; f.state.z = iZ; }); }
+	void setXSpeed(float iSpeedX) { mState.modify([=](flight_state& f){ f.state.speedX = iSpeedX; }); }
+	void setYSpeed(float iSpeedY) { mState.modify([=](flight_state& f){ f.state.speedY = iSpeedY; }); }
+	void setZSpeed(float iSpeedZ) { mState.modify([=](flight_state& f){ f.state.speedZ = iSpeedZ; }); }
 	void setSpeed(float iSpeedX, float iSpeedY, float iSpeedZ) {
-		mSpeedX = iSpeedX; mSpeedY = iSpeedY; mSpeedZ = iSpeedZ; }
+		mState.modify([=](flight_state& f){ f.state.speedX = iSpeedX; f.state.speedY = iSpeedY; f.state.speedZ = iSpeedZ; }); }
+	// Climbs (or descends) by feet in one write, safe against a concurrent advance()
+	void changeAltitude(float feet) { mState.modify([=](flight_state& f){ f.state.z += feet; }); }
+	// The radar copies it from the reply, with the position
+	void setPlanProgress(plan_progress iProgress) { mState.modify([=](flight_state& f){ f.progress = iProgress; }); }
+
+	// Replays call advance() themselves instead of running the 1 second position timer
+	void setManualClock(bool iManualClock) { mManualClock = iManualClock; }
+
+	// Moves the aircraft by one second of its speed (if it has entered the airspace), along its
+	// flight plan if it has one
+	void advance();
 
 	void coutDebug();
 
+	// Writers hammering one aircraft while readers check every state they read is whole.
+	// Returns 1 if a torn state was seen.
+	static int stressTest(int seconds, int readers, std::ostream& out);
+
     // Aircraft constructor
     Aircraft(int iEntryTime, int iId, float iX, float iY, float iZ, float iSpeedX, float iSpeedY, float iSpeedZ, CommunicationSystem iCommSystem);
     // Getter for ID
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+#include "AlertQueue.h"
+
+/* RESPONSIBILITIES
+ *	- The ATCSystem pushes every violation of a scan it alerts on, then advises and sends only the
+ *		sorted top ALERT_TOP_K to the Display, most urgent first, with how many there were in all.
+ *	- "Main --bench-alerts" times the queue against a full sort.
+ *	- The violations of the radar bus (recorder, replay digest, conflict selector) keep the order of
+ *		the conflict check, only the alerts are ranked.
+ */
+
+AlertQueue::AlertQueue(size_t iCapacity) :
+	mCapacity(std::max(iCapacity, (size_t)1)), mFlagged(0)
+{
+	mHeap.reserve(mCapacity);
+}
+
+conflict_alert AlertQueue::assess(const violation_pair& pair, const aircraft_state& a, const aircraft_state& b,
+		int horizontal, int vertical, int predTime) {
+	const float distance[3] = { a.x - b.x, a.y - b.y, a.z - b.z };
+	const float closing[3] = { a.speedX - b.speedX, a.speedY - b.speedY, a.speedZ - b.speedZ };
+	const float limit[3] = { 2.0f * horizontal, 2.0f * horizontal, 2.0f * vertical };
+
+	conflict_alert alert;
+	alert.pair = pair;
+	alert.timeToConflict = 0;
+	alert.severity = 1;
+	alert.zoneID = -1;
+	for(int axis = 0; axis < 3; axis++){
+		// When the boxes start to overlap on this axis, moving towards the projection
+		if(std::fabs(distance[axis]) > limit[axis] && closing[axis] != 0){
+			float start = (std::fabs(distance[axis]) - limit[axis]) / std::fabs(closing[axis]);
+			alert.timeToConflict = std::max(alert.timeToConflict, start);
+		}
+
+		float projected = std::fabs(distance[axis] + closing[axis] * predTime);
+		float depth = limit[axis] > 0 ? 1 - projected / limit[axis] : 0;
+		alert.severity = std::min(alert.severity, std::max(depth, 0.0f));
+	}
+	alert.timeToConflict = std::min(alert.timeToConflict, (float)predTime);
+	return alert;
+}
+
+bool AlertQueue::moreUrgent(const conflict_alert& a, const conflict_alert& b) {
+	if(a.timeToConflict != b.timeToConflict){
+		return a.timeToConflict < b.timeToConflict;
+	}
+	if(a.severity != b.severity){
+		return a.severity > b.severity;
+	}
+	// Ties by flight id
+	if(a.pair.aircraft1ID != b.pair.aircraft1ID){
+		return a.pair.aircraft1ID < b.pair.aircraft1ID;
+	}
+	if(a.pair.aircraft2ID != b.pair.aircraft2ID){
+		return a.pair.aircraft2ID < b.pair.aircraft2ID;
+	}
+	return a.zoneID < b.zoneID;
+}
+
+void AlertQueue::clear() {
+	mHeap.clear();
+	mFlagged = 0;
+}
+
+void AlertQueue::push(const conflict_alert& alert) {
+	mFlagged++;
+	if(mHeap.size() < mCapacity){
+		mHeap.push_back(alert);
+		std::push_heap(mHeap.begin(), mHeap.end(), moreUrgent);
+	}else if(moreUrgent(alert, mHeap.front())){
+		std::pop_heap(mHeap.begin(), mHeap.end(), moreUrgent);
+		mHeap.back() = alert;
+		std::push_heap(mHeap.begin(), mHeap.end(), moreUrgent);
+	}
+}
+
+std::vector<conflict_alert> AlertQueue::sorted() const {
+	std::vector<conflict_alert> alerts = mHeap;
+	std::sort(alerts.begin(), alerts.end(), moreUrgent);
+	return alerts;
+}
+
+int AlertQueue::benchmark(int flaggedCount, std::ostream& out) {
+	const int horizontal = 3000, vertical = 1000, predTime = 180;
+	const int scans = 5;
+
+	// Pairs closing from anywhere within the prediction time
+	std::vector<conflict_alert> flagged(flaggedCount);
+	unsigned int seed = 12345;
+	for(int i = 0; i < flaggedCount; i++){
+		aircraft_state a = { 0, 0, 10000, 0, 0, 0 };
+		aircraft_state b = a;
+		seed = seed * 1103515245 + 12345;
+		float start = (seed >> 8) % 60000;
+		seed = seed * 1103515245 + 12345;
+		b.x = start;
+		b.speedX = -(float)(start + (int)((seed >> 8) % 6000) - 3000) / predTime;
+		violation_pair pair = { i, flaggedCount + i };
+		flagged[i] = assess(pair, a, b, horizontal, vertical, predTime);
+	}
+
+	out << "+-------------+ Alert queue benchmark: " << flaggedCount << " violations, top " << ALERT_TOP_K << " +-------------+" << std::endl;
+
+	AlertQueue queue;
+	std::vector<conflict_alert> top;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for(int scan = 0; scan < scans; scan++){
+		queue.clear();
+		for(int i = 0; i < flaggedCount; i++){
+			queue.push(flagged[i]);
+		}
+		top = queue.sorted();
+	}
+	double queueMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / scans;
+
+	std::vector<conflict_alert> all;
+	begin = std::chrono::steady_clock::now();
+	for(int scan = 0; scan < scans; scan++){
+		all = flagged;
+		std::sort(all.begin(), all.end(), moreUrgent);
+	}
+	double sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / scans;
+
+	bool same = top.size() == std::min((size_t)ALERT_TOP_K, all.size());
+	for(size_t k = 0; same && k < top.size(); k++){
+		same = top[k].pair.aircraft1ID == all[k].pair.aircraft1ID && top[k].pair.aircraft2ID == all[k].pair.aircraft2ID;
+	}
+
+	out << "| top " << ALERT_TOP_K << " queue: " << queueMs << " ms/scan, " << ALERT_TOP_K * sizeof(conflict_alert) << " bytes kept" << std::endl;
+	out << "| full sort: " << sortMs << " ms/scan, " << all.size() * sizeof(conflict_alert) << " bytes kept" << std::endl;
+	if(!top.empty()){
+		out << "| most urgent: flights " << top[0].pair.aircraft1ID << " and " << top[0].pair.aircraft2ID << " in "
+				<< top[0].timeToConflict << " s, severity " << top[0].severity << std::endl;
+	}
+	out << "+-------------+ " << (same ? "The queue kept the same top alerts as the sort" : "QUEUE DISAGREES WITH THE SORT") << " +-------------+" << std::endl;
+	return same ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#ifndef SRC_ALERTQUEUE_H_
+#define SRC_ALERTQUEUE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+#include "Aircraft.h"
+#include "RadarBus.h"
+
+/* Responsible for:
+	- Ranking the violations of a scan by urgency: how soon the two aircraft lose separation, then
+		how much separation they lose.
+	- Keeping only the most urgent ALERT_TOP_K of them, in a heap of that size, however many
+		pairs were flagged.
+	- Benchmarking that against sorting every flagged pair.
+ */
+
+/*	checkViolations() flags a pair when the projected boxes overlap at the prediction time. Both
+ * 	aircraft fly straight until then, so the boxes start to overlap at the latest time at which
+ * 	they start to overlap on each axis: that is the time to conflict (0 if they already do).
+ * 	The severity is how deep the projections are inside each other's box, on the axis where they
+ * 	are the least deep: 0 at the edge, 1 when they are at the same place.
+ *
+ * 	Restricted zone incursions are ranked with them (see RestrictedAirspace.h): the time to
+ * 	conflict is when the aircraft enters the zone, the severity the share of the prediction time
+ * 	it spends inside.
+ */
+
+#define ALERT_TOP_K 10
+
+typedef struct {
+	violation_pair pair;
+	float timeToConflict;	// seconds
+	float severity;			// 0 to 1
+	int zoneID;				// -1 for a pair, else pair.aircraft1ID flies into restricted zone zoneID
+} conflict_alert;
+
+class AlertQueue {
+public:
+	AlertQueue(size_t iCapacity = ALERT_TOP_K);
+
+	// Time to conflict and severity of a flagged pair, with a and b their states this scan
+	static conflict_alert assess(const violation_pair& pair, const aircraft_state& a, const aircraft_state& b,
+			int horizontal, int vertical, int predTime);
+
+	// a comes before b
+	static bool moreUrgent(const conflict_alert& a, const conflict_alert& b);
+
+	void clear();
+
+	// Keeps alert if it is among the capacity most urgent so far
+	void push(const conflict_alert& alert);
+
+	// Pairs pushed since clear(), kept or not
+	uint64_t getFlagged() const { return mFlagged; }
+
+	// The kept alerts, most urgent first
+	std::vector<conflict_alert> sorted() const;
+
+	// The top alerts of n flagged pairs against sorting all of them
+	static int benchmark(int flaggedCount, std::ostream& out);
+
+private:
+	size_t mCapacity;
+	std::vector<conflict_alert> mHeap;		// the least urgent kept alert on top
+	uint64_t mFlagged;
+};
+
+#endif /* SRC_ALERTQUEUE_H_ */
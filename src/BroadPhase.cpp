@@ -0,0 +1,320 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "BroadPhase.h"
+#include "ConflictCheck.h"
+#include "RadarDelta.h"
+
+/* RESPONSIBILITIES
+ *	- "Main --broad-phase {brute|grid|sweep}" gives the ATCSystem a BroadPhase; checkViolations()
+ *		runs separationLost() on its candidates only. Only the scan timer thread uses it.
+ *	- "Main --bench-broad-phase" times the three of them on the same traffic.
+ */
+
+BroadPhase::BroadPhase(broad_phase_kind iKind) :
+	mKind(iKind), mAxis(0), mSwaps(0)
+{
+}
+
+bool BroadPhase::parseKind(const std::string& name, broad_phase_kind& kind) {
+	if(name == "brute"){
+		kind = BROAD_PHASE_BRUTE;
+	}else if(name == "grid"){
+		kind = BROAD_PHASE_GRID;
+	}else if(name == "sweep"){
+		kind = BROAD_PHASE_SWEEP;
+	}else{
+		return false;
+	}
+	return true;
+}
+
+const char* BroadPhase::kindName(broad_phase_kind kind) {
+	switch(kind){
+	case BROAD_PHASE_GRID:
+		return "grid";
+	case BROAD_PHASE_SWEEP:
+		return "sweep";
+	default:
+		return "brute";
+	}
+}
+
+static inline bool overlaps(float min1, float max1, float min2, float max2) {
+	return max1 >= min2 && max2 >= min1;
+}
+
+void BroadPhase::candidates(const std::vector<aircraft_state>& states, const std::vector<aircraft_state>& projections,
+		int horizontal, int vertical, std::vector<std::pair<size_t, size_t> >& pairs) {
+	// From now to the projection, padded by the minima and the truncation
+	float padH = horizontal + 1, padV = vertical + 1;
+	mBounds.resize(states.size());
+	for(size_t i = 0; i < states.size(); i++){
+		swept_bounds& b = mBounds[i];
+		b.minX = std::min(states[i].x, projections[i].x) - padH;
+		b.maxX = std::max(states[i].x, projections[i].x) + padH;
+		b.minY = std::min(states[i].y, projections[i].y) - padH;
+		b.maxY = std::max(states[i].y, projections[i].y) + padH;
+		b.minZ = std::min(states[i].z, projections[i].z) - padV;
+		b.maxZ = std::max(states[i].z, projections[i].z) + padV;
+	}
+
+	pairs.clear();
+	switch(mKind){
+	case BROAD_PHASE_SWEEP:
+		sweep(pairs);
+		break;
+	case BROAD_PHASE_GRID:
+		grid(vertical, pairs);
+		break;
+	default:
+		brute(pairs);
+		return;
+	}
+	sortPairs(pairs);
+}
+
+void BroadPhase::sortPairs(std::vector<std::pair<size_t, size_t> >& pairs) {
+	// By first position in one counting pass, then each aircraft's few partners
+	std::vector<size_t> starts(mBounds.size() + 1, 0);
+	for(size_t p = 0; p < pairs.size(); p++){
+		starts[pairs[p].first + 1]++;
+	}
+	for(size_t i = 0; i < mBounds.size(); i++){
+		starts[i + 1] += starts[i];
+	}
+	mSorted.resize(pairs.size());
+	for(size_t p = 0; p < pairs.size(); p++){
+		mSorted[starts[pairs[p].first]++] = pairs[p];
+	}
+	size_t begin = 0;
+	for(size_t i = 0; i < mBounds.size(); i++){
+		std::sort(mSorted.begin() + begin, mSorted.begin() + starts[i]);
+		begin = starts[i];
+	}
+	pairs.swap(mSorted);
+}
+
+void BroadPhase::brute(std::vector<std::pair<size_t, size_t> >& pairs) {
+	for(size_t i = 0; i < mBounds.size(); i++){
+		for(size_t j = i + 1; j < mBounds.size(); j++){
+			pairs.push_back(std::make_pair(i, j));
+		}
+	}
+}
+
+void BroadPhase::sweep(std::vector<std::pair<size_t, size_t> >& pairs) {
+	size_t n = mBounds.size();
+
+	// A new list is sorted from scratch along the axis where the bounds overlap least (the one
+	// with the smallest bounds for the spread of the traffic), the previous order only needs a few swaps
+	mSwaps = 0;
+	if(mOrder.size() != n){
+		float low[3] = { 0, 0, 0 }, high[3] = { 0, 0, 0 };
+		double extent[3] = { 0, 0, 0 };
+		for(size_t i = 0; i < n; i++){
+			for(int axis = 0; axis < 3; axis++){
+				float minimum = (&mBounds[i].minX)[2 * axis], maximum = (&mBounds[i].minX)[2 * axis + 1];
+				low[axis] = i == 0 ? minimum : std::min(low[axis], minimum);
+				high[axis] = i == 0 ? maximum : std::max(high[axis], maximum);
+				extent[axis] += maximum - minimum;
+			}
+		}
+		mAxis = 0;
+		for(int axis = 1; axis < 3; axis++){
+			if(extent[axis] * (high[mAxis] - low[mAxis]) < extent[mAxis] * (high[axis] - low[axis])){
+				mAxis = axis;
+			}
+		}
+
+		mOrder.resize(n);
+		for(size_t i = 0; i < n; i++){
+			mOrder[i] = i;
+		}
+		std::sort(mOrder.begin(), mOrder.end(), [this](size_t a, size_t b){ return lowOf(a) < lowOf(b); });
+	}else{
+		for(size_t k = 1; k < n; k++){
+			size_t moving = mOrder[k];
+			float key = lowOf(moving);
+			size_t at = k;
+			while(at > 0 && lowOf(mOrder[at - 1]) > key){
+				mOrder[at] = mOrder[at - 1];
+				at--;
+			}
+			mOrder[at] = moving;
+			mSwaps += k - at;
+		}
+	}
+
+	// Along the axis: everything still open overlaps the next one on it
+	mOpen.clear();
+	for(size_t k = 0; k < n; k++){
+		size_t i = mOrder[k];
+		const swept_bounds& b = mBounds[i];
+		float low = lowOf(i);
+		size_t kept = 0;
+		for(size_t o = 0; o < mOpen.size(); o++){
+			size_t j = mOpen[o];
+			const swept_bounds& other = mBounds[j];
+			if(highOf(j) < low){
+				continue;
+			}
+			mOpen[kept++] = j;
+			if(overlaps(b.minX, b.maxX, other.minX, other.maxX) && overlaps(b.minY, b.maxY, other.minY, other.maxY)
+					&& overlaps(b.minZ, b.maxZ, other.minZ, other.maxZ)){
+				pairs.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+			}
+		}
+		mOpen.resize(kept);
+		mOpen.push_back(i);
+	}
+}
+
+static inline int64_t cellOf(float position, float size) {
+	return (int64_t)std::floor(position / size);
+}
+
+static inline uint64_t cellKey(int64_t column, int64_t row, int64_t level) {
+	return ((uint64_t)(column & 0x1fffff) << 42) | ((uint64_t)(row & 0x1fffff) << 21) | (uint64_t)(level & 0x1fffff);
+}
+
+void BroadPhase::grid(int vertical, std::vector<std::pair<size_t, size_t> >& pairs) {
+	// Flight levels the height of the vertical bounds of an aircraft in level flight
+	float height = 2 * vertical + 2;
+	float width = BROAD_PHASE_CELL_FEET;
+
+	// The cells are kept, so their lists keep their capacity from scan to scan
+	for(std::unordered_map<uint64_t, std::vector<size_t> >::iterator c = mCells.begin(); c != mCells.end(); ++c){
+		c->second.clear();
+	}
+	for(size_t i = 0; i < mBounds.size(); i++){
+		const swept_bounds& b = mBounds[i];
+		for(int64_t column = cellOf(b.minX, width); column <= cellOf(b.maxX, width); column++){
+			for(int64_t row = cellOf(b.minY, width); row <= cellOf(b.maxY, width); row++){
+				for(int64_t level = cellOf(b.minZ, height); level <= cellOf(b.maxZ, height); level++){
+					mCells[cellKey(column, row, level)].push_back(i);
+				}
+			}
+		}
+	}
+
+	for(std::unordered_map<uint64_t, std::vector<size_t> >::iterator c = mCells.begin(); c != mCells.end(); ++c){
+		const std::vector<size_t>& inCell = c->second;
+		for(size_t a = 0; a < inCell.size(); a++){
+			const swept_bounds& b = mBounds[inCell[a]];
+			for(size_t o = a + 1; o < inCell.size(); o++){
+				const swept_bounds& other = mBounds[inCell[o]];
+				if(!overlaps(b.minX, b.maxX, other.minX, other.maxX) || !overlaps(b.minY, b.maxY, other.minY, other.maxY)
+						|| !overlaps(b.minZ, b.maxZ, other.minZ, other.maxZ)){
+					continue;
+				}
+				// Only the cell with the low corner of the overlap reports the pair
+				if(cellKey(cellOf(std::max(b.minX, other.minX), width), cellOf(std::max(b.minY, other.minY), width),
+						cellOf(std::max(b.minZ, other.minZ), height)) != c->first){
+					continue;
+				}
+				pairs.push_back(std::make_pair(std::min(inCell[a], inCell[o]), std::max(inCell[a], inCell[o])));
+			}
+		}
+	}
+}
+
+int BroadPhase::benchmark(int aircraftCount, int scans, std::ostream& out) {
+	const int horizontal = 3000, vertical = 1000, predTime = 180;
+	const char* traffics[] = { "uniform", "clustered" };
+	const broad_phase_kind kinds[] = { BROAD_PHASE_BRUTE, BROAD_PHASE_GRID, BROAD_PHASE_SWEEP };
+
+	out << "+-------------+ Broad phase benchmark: " << aircraftCount << " aircraft, " << scans
+			<< " scans, swept bounds over " << predTime << " s +-------------+" << std::endl;
+	out << "| traffic | broad phase | ms/scan | speedup | candidates/scan | conflicts/scan | sort swaps/scan | same as brute force" << std::endl;
+
+	bool allSame = true;
+	for(int t = 0; t < 2; t++){
+		// Uniform over the airspace, or around 8 airports a few miles wide; a third climb or descend
+		std::vector<aircraft_state> start(aircraftCount);
+		unsigned int seed = 12345;
+		for(int i = 0; i < aircraftCount; i++){
+			aircraft_state& s = start[i];
+			seed = seed * 1103515245 + 12345;
+			unsigned int first = seed >> 8;
+			seed = seed * 1103515245 + 12345;
+			unsigned int second = seed >> 8;
+			if(t == 0){
+				s.x = first % RADAR_AIRSPACE_SIZE;
+				s.y = second % RADAR_AIRSPACE_SIZE;
+			}else{
+				int airport = i % 8;
+				s.x = (airport % 4) * (RADAR_AIRSPACE_SIZE / 4) + RADAR_AIRSPACE_SIZE / 8 + (int)(first % 20000) - 10000;
+				s.y = (airport / 4) * (RADAR_AIRSPACE_SIZE / 2) + RADAR_AIRSPACE_SIZE / 4 + (int)(second % 20000) - 10000;
+			}
+			s.z = 10000 + (i % 20) * 1000;
+			s.speedX = (i % 9) * 50 - 200;
+			s.speedY = (i % 7) * 50 - 150;
+			s.speedZ = (i % 3 == 0) ? ((i / 3) % 3 - 1) * 15 : 0;
+		}
+
+		double bruteMs = 0;
+		std::vector<std::vector<std::pair<size_t, size_t> > > expected(scans);
+		for(size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++){
+			BroadPhase broadPhase(kinds[k]);
+			std::vector<aircraft_state> states = start, projections(aircraftCount);
+			std::vector<std::pair<size_t, size_t> > pairs;
+			uint64_t candidates = 0, conflicts = 0, swaps = 0;
+			double ms = 0;
+			bool same = true;
+			for(int scan = 0; scan < scans; scan++){
+				for(int i = 0; i < aircraftCount; i++){
+					states[i].x += states[i].speedX;
+					states[i].y += states[i].speedY;
+					states[i].z += states[i].speedZ;
+					projections[i] = projectState(states[i], predTime);
+				}
+
+				// Broad and narrow phase, as in ATCSystem::checkViolations()
+				std::vector<std::pair<size_t, size_t> > found;
+				std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+				if(kinds[k] == BROAD_PHASE_BRUTE){
+					// Without a list of n * (n - 1) / 2 pairs, like checkViolations() does
+					for(int i = 0; i < aircraftCount; i++){
+						for(int j = i + 1; j < aircraftCount; j++){
+							if(separationLost(projections[i], projections[j], horizontal, vertical)){
+								found.push_back(std::make_pair(i, j));
+							}
+						}
+					}
+					candidates += (uint64_t)aircraftCount * (aircraftCount - 1) / 2;
+				}else{
+					broadPhase.candidates(states, projections, horizontal, vertical, pairs);
+					for(size_t p = 0; p < pairs.size(); p++){
+						if(separationLost(projections[pairs[p].first], projections[pairs[p].second], horizontal, vertical)){
+							found.push_back(pairs[p]);
+						}
+					}
+					candidates += pairs.size();
+				}
+				ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+				conflicts += found.size();
+				swaps += broadPhase.getLastSwaps();
+
+				if(kinds[k] == BROAD_PHASE_BRUTE){
+					expected[scan] = found;
+				}else{
+					same = same && found == expected[scan];
+				}
+			}
+			ms /= scans;
+			if(kinds[k] == BROAD_PHASE_BRUTE){
+				bruteMs = ms;
+			}
+			allSame = allSame && same;
+
+			out << "| " << traffics[t] << " | " << kindName(kinds[k]) << " | " << ms << " | " << bruteMs / ms << " | "
+					<< candidates / scans << " | " << conflicts / scans << " | " << swaps / scans << " | " << (same ? "yes" : "NO") << std::endl;
+		}
+	}
+
+	out << "+-------------+ " << (allSame ? "Every broad phase found the same conflicts" : "BROAD PHASES DISAGREE") << " +-------------+" << std::endl;
+	return allSame ? 0 : 1;
+}
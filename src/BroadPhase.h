@@ -0,0 +1,93 @@
+#ifndef SRC_BROADPHASE_H_
+#define SRC_BROADPHASE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include "Aircraft.h"
+
+/* Responsible for:
+	- The broad phase of the conflict check: the pairs of aircraft worth the exact test of
+		separationLost(), instead of all n * (n - 1) / 2 of them.
+	- Three strategies chosen at startup: brute force (every pair), a grid hash, and sweep and
+		prune, which keeps its order from scan to scan with an insertion sort.
+	- Benchmarking them against each other on uniform and clustered traffic.
+ */
+
+/*	Every strategy works on the swept bounds of an aircraft: the box from its current position to
+ * 	its projected one, padded by the separation minima (and a foot for the truncation of
+ * 	separationLost()). Two aircraft whose projections conflict have overlapping swept bounds, so the
+ * 	candidates always include every conflict, and the violations stay those of the brute force.
+ *
+ * 	Sweep and prune sorts the aircraft by the low end of their bounds on one axis and sweeps along
+ * 	it, keeping the aircraft whose bounds are still open. The axis is the one where the bounds
+ * 	overlap least, chosen when the order is built; from one second to the next the order barely
+ * 	changes, so the insertion sort of the previous order costs about one pass.
+ *
+ * 	The grid hash puts the bounds in every cell they touch, BROAD_PHASE_CELL_FEET square and one
+ * 	2 * vertical separation flight level high, and a pair is a candidate in the one cell holding
+ * 	the low corner of its overlap.
+ */
+
+#define BROAD_PHASE_CELL_FEET 10000
+
+enum broad_phase_kind {
+	BROAD_PHASE_BRUTE,
+	BROAD_PHASE_GRID,
+	BROAD_PHASE_SWEEP
+};
+
+class BroadPhase {
+public:
+	BroadPhase(broad_phase_kind iKind);
+
+	broad_phase_kind getKind() const { return mKind; }
+
+	// "brute", "grid" or "sweep"
+	static bool parseKind(const std::string& name, broad_phase_kind& kind);
+	static const char* kindName(broad_phase_kind kind);
+
+	// Candidate pairs of radar list positions (i < j), sorted, for the aircraft at states, whose
+	// projections are at projections
+	void candidates(const std::vector<aircraft_state>& states, const std::vector<aircraft_state>& projections,
+			int horizontal, int vertical, std::vector<std::pair<size_t, size_t> >& pairs);
+
+	// Swaps made by the insertion sort of the last sweep
+	uint64_t getLastSwaps() const { return mSwaps; }
+
+	// Every strategy on uniform and clustered traffic of n aircraft, checked against the brute force
+	static int benchmark(int aircraftCount, int scans, std::ostream& out);
+
+private:
+	typedef struct {
+		float minX, maxX;
+		float minY, maxY;
+		float minZ, maxZ;
+	} swept_bounds;
+
+	broad_phase_kind mKind;
+	std::vector<swept_bounds> mBounds;
+
+	// sweep and prune: radar list positions by the low end on the sweep axis, kept from the previous scan
+	std::vector<size_t> mOrder;
+	std::vector<size_t> mOpen;
+	int mAxis;			// 0 x, 1 y, 2 z
+	uint64_t mSwaps;
+
+	// grid hash: cell (x, y and level packed) to the aircraft touching it
+	std::unordered_map<uint64_t, std::vector<size_t> > mCells;
+
+	std::vector<std::pair<size_t, size_t> > mSorted;
+
+	float lowOf(size_t i) const { return (&mBounds[i].minX)[2 * mAxis]; }
+	float highOf(size_t i) const { return (&mBounds[i].minX)[2 * mAxis + 1]; }
+
+	void brute(std::vector<std::pair<size_t, size_t> >& pairs);
+	void sweep(std::vector<std::pair<size_t, size_t> >& pairs);
+	void grid(int vertical, std::vector<std::pair<size_t, size_t> >& pairs);
+	void sortPairs(std::vector<std::pair<size_t, size_t> >& pairs);
+};
+
+#endif /* SRC_BROADPHASE_H_ */
@@ -0,0 +1,267 @@
+#include <mutex>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "CommandJournal.h"
+#include "SimulationClock.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+/* RESPONSIBILITIES
+ *	- OperatorConsole appends each command with CommandJournal::append(). This only copies
+ *		the command into a preallocated buffer, no heap allocation and no system call.
+ *	- The commit thread wakes every flush interval (or early, when someone is waiting on a
+ *		record) and writes everything appended since the last commit with a single write().
+ *	- If sync on commit is enabled the write is followed by one fsync(), shared by every
+ *		record in the batch (group commit).
+ *	- A failed write or fsync latches the journal as failed: the records of that commit are not
+ *		reported committed, and nothing is written after a possibly torn record. Waiters are woken
+ *		and told, later appends are refused.
+ *	- CommandJournal::readJournal() turns a journal file back into a command timeline, used by
+ *		"Main --read-journal <file>" for post-incident review.
+ */
+
+CommandJournal::CommandJournal(std::string iPath, bool iSyncOnCommit, int iFlushIntervalMs) :
+	mPath(iPath), mSyncOnCommit(iSyncOnCommit), mFlushIntervalMs(iFlushIntervalMs), mFd(-1),
+	mActive(mBufferA), mActiveUsed(0), mNextSequence(1), mCommittedSequence(0),
+	mCommitRequested(false), mCommitInProgress(false), mStopping(false), mFailed(false), mThreadStarted(false)
+{
+
+}
+
+CommandJournal::~CommandJournal() {
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mStopping = true;
+		mCommitNeeded.notify_all();
+	}
+
+	if(mThreadStarted){
+		pthread_join(mCommitThread, nullptr);
+	}
+
+	// Whatever is left after the commit thread stopped
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		commitLocked(lock);
+	}
+
+	if(mFd != -1){
+		close(mFd);
+	}
+}
+
+bool CommandJournal::open() {
+	mFd = ::open(mPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(mFd == -1){
+		perror("CommandJournal: Cannot create journal file");
+		return false;
+	}
+
+	if(write(mFd, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != sizeof(JOURNAL_MAGIC)){
+		perror("CommandJournal: Cannot write journal header");
+		close(mFd);
+		mFd = -1;
+		return false;
+	}
+
+	if(pthread_create(&mCommitThread, NULL, &CommandJournal::startThread, this) == 0){
+		mThreadStarted = true;
+	}else{
+		perror("CommandJournal: Cannot start commit thread");
+	}
+
+	return true;
+}
+
+uint32_t CommandJournal::append(const std::string& cmd) {
+	size_t length = cmd.length();
+	if(length > MAX_COMMAND_LENGTH){
+		length = MAX_COMMAND_LENGTH;
+	}
+
+	journal_record_header header;
+	header.length = length;
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	header.wallTimeNs = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+	header.elapsedMs = getElapsedTimeMs();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mFd == -1 || mFailed){
+		return 0;
+	}
+
+	// Buffer is full, commit it on this thread before copying
+	if(mActiveUsed + sizeof(header) + length > BUFFER_SIZE){
+		commitLocked(lock);
+	}
+
+	header.sequence = mNextSequence++;
+	memcpy(mActive + mActiveUsed, &header, sizeof(header));
+	memcpy(mActive + mActiveUsed + sizeof(header), cmd.data(), length);
+	mActiveUsed += sizeof(header) + length;
+
+	return header.sequence;
+}
+
+bool CommandJournal::waitForCommit(uint32_t sequence) {
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(sequence == 0 || mFd == -1){
+		return false;
+	}
+	if(mCommittedSequence >= sequence){
+		return true;
+	}
+
+	// Wake the commit thread now instead of waiting out the flush interval
+	mCommitRequested = true;
+	mCommitNeeded.notify_one();
+	mCommitDone.wait(lock, [&]{ return mCommittedSequence >= sequence || mFailed || mStopping; });
+	return mCommittedSequence >= sequence;
+}
+
+void CommandJournal::commitLocked(std::unique_lock<std::mutex>& lock) {
+	static Counter& logBytes = metrics().counter("atc_log_bytes_total", "Bytes written to logs", "log=\"journal\"");
+
+	// Only one commit writes at a time, so records reach the file in order
+	mCommitDone.wait(lock, [&]{ return !mCommitInProgress; });
+
+	if(mActiveUsed == 0 || mFd == -1 || mFailed){
+		return;
+	}
+	TRACE_SCOPE("journal commit", "log");
+
+	char* full = mActive;
+	size_t fullUsed = mActiveUsed;
+	uint32_t lastSequence = mNextSequence - 1;
+
+	mActive = (mActive == mBufferA) ? mBufferB : mBufferA;
+	mActiveUsed = 0;
+	mCommitInProgress = true;
+
+	// Appends can continue into the other buffer while we write
+	lock.unlock();
+
+	bool failed = false;
+	size_t written = 0;
+	while(written < fullUsed){
+		ssize_t status = write(mFd, full + written, fullUsed - written);
+		if(status == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			perror("CommandJournal: Error writing journal");
+			failed = true;
+			break;
+		}
+		written += status;
+	}
+	logBytes.add(written);
+
+	if(!failed && mSyncOnCommit && fsync(mFd) == -1){
+		perror("CommandJournal: Error syncing journal");
+		failed = true;
+	}
+
+	lock.lock();
+	if(failed){
+		// The file may end mid-record, anything written after it would be unreadable
+		mFailed = true;
+	}else{
+		mCommittedSequence = lastSequence;
+	}
+	mCommitInProgress = false;
+	mCommitDone.notify_all();
+}
+
+void* CommandJournal::start() {
+	std::unique_lock<std::mutex> lock(mMutex);
+	while(!mStopping){
+		mCommitNeeded.wait_for(lock, std::chrono::milliseconds(mFlushIntervalMs),
+				[&]{ return mCommitRequested || mStopping; });
+		mCommitRequested = false;
+		commitLocked(lock);
+	}
+
+	return nullptr;
+}
+
+void* CommandJournal::startThread(void* context) {
+	return static_cast<CommandJournal*>(context)->start();
+}
+
+bool CommandJournal::loadJournal(std::string path, std::vector<journal_entry>& entries, bool& truncated) {
+	truncated = false;
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if(!in){
+		return false;
+	}
+
+	char magic[sizeof(JOURNAL_MAGIC)];
+	if(!in.read(magic, sizeof(magic)) || memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0){
+		return false;
+	}
+
+	char command[MAX_COMMAND_LENGTH];
+	journal_entry entry;
+	while(in.read(reinterpret_cast<char*>(&entry.header), sizeof(entry.header))){
+		// A crash mid-write can leave a partial record at the end of the file
+		if(entry.header.length > MAX_COMMAND_LENGTH || !in.read(command, entry.header.length)){
+			truncated = true;
+			break;
+		}
+		entry.command.assign(command, entry.header.length);
+		entries.push_back(entry);
+	}
+
+	// Header cut off part way
+	if(in.gcount() != 0 && in.gcount() != (std::streamsize)sizeof(entry.header)){
+		truncated = true;
+	}
+
+	return true;
+}
+
+int CommandJournal::readJournal(std::string path, std::ostream& out) {
+	std::vector<journal_entry> entries;
+	bool truncated;
+	if(!loadJournal(path, entries, truncated)){
+		out << "CommandJournal: " << path << " is not a command journal" << std::endl;
+		return -1;
+	}
+
+	out << "+-------------+ Command timeline: " << path << " +-------------+" << std::endl;
+
+	for(size_t i = 0; i < entries.size(); i++){
+		const journal_record_header& header = entries[i].header;
+
+		time_t wallSeconds = header.wallTimeNs / 1000000000LL;
+		int wallMillis = (header.wallTimeNs / 1000000LL) % 1000;
+		struct tm wallTime;
+		localtime_r(&wallSeconds, &wallTime);
+		char wallString[32];
+		strftime(wallString, sizeof(wallString), "%Y-%m-%d %H:%M:%S", &wallTime);
+
+		out << "| #" << std::setw(5) << std::left << header.sequence << std::right
+			<< " T+" << std::setw(6) << header.elapsedMs / 1000 << "." << std::setfill('0') << std::setw(3) << header.elapsedMs % 1000
+			<< std::setfill(' ') << "s  " << wallString << "." << std::setfill('0') << std::setw(3) << wallMillis << std::setfill(' ')
+			<< "  " << entries[i].command << std::endl;
+	}
+
+	if(truncated){
+		out << "| (truncated record after #" << entries.size() << ")" << std::endl;
+	}
+
+	out << "+-------------+ " << entries.size() << " commands +-------------+" << std::endl;
+	return entries.size();
+}
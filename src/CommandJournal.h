@@ -0,0 +1,102 @@
+#ifndef SRC_COMMANDJOURNAL_H_
+#define SRC_COMMANDJOURNAL_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <pthread.h>
+
+/* Responsible for:
+	- Recording every operator command with a timestamp in a binary, length-prefixed journal.
+	- Batching records in preallocated buffers and writing them with one write() per group commit.
+	- Optionally fsync'ing each group commit so a command is durable before it is sent.
+ */
+
+/*	Format of the journal file:
+ * 	"ATCJRNL1" file magic, then one record per command:
+ * 	journal_record_header (24 bytes), followed by header.length bytes of command text (no terminator)
+ */
+
+#define COMMAND_JOURNAL_PATH "/data/home/qnxuser/commandjournal.bin"
+
+const char JOURNAL_MAGIC[8] = { 'A', 'T', 'C', 'J', 'R', 'N', 'L', '1' };
+
+typedef struct {
+	uint32_t length;		// bytes of command text following this header
+	uint32_t sequence;		// 1, 2, 3... in order of entry
+	int64_t wallTimeNs;		// CLOCK_REALTIME when the command was entered
+	int64_t elapsedMs;		// ms since programStartTime, same timeline as the simulation
+} journal_record_header;
+
+// One command read back from a journal
+typedef struct {
+	journal_record_header header;
+	std::string command;
+} journal_entry;
+
+class CommandJournal {
+public:
+	// Each of the two buffers holds a whole group commit
+	static const size_t BUFFER_SIZE = 64 * 1024;
+	// Longer commands are truncated so a record always fits in an empty buffer
+	static const size_t MAX_COMMAND_LENGTH = 1024;
+
+	CommandJournal(std::string iPath, bool iSyncOnCommit, int iFlushIntervalMs);
+	virtual ~CommandJournal();
+
+	// Creates the journal file and starts the group commit thread
+	bool open();
+
+	// Copies the command into the active buffer, returns its sequence number (0 if closed or failed)
+	uint32_t append(const std::string& cmd);
+
+	// Blocks until the record with this sequence number has been written (and fsync'd if enabled).
+	// False if it never will be: the journal is closed or a commit failed.
+	bool waitForCommit(uint32_t sequence);
+
+	bool isSyncOnCommit() const { return mSyncOnCommit; }
+
+	// Reads every complete record, false if the file is not a journal. truncated is set if it ends mid-record.
+	static bool loadJournal(std::string path, std::vector<journal_entry>& entries, bool& truncated);
+
+	// Reader tool, prints the command timeline of a journal file. Returns the number of records.
+	static int readJournal(std::string path, std::ostream& out);
+
+	void* start();
+
+	static void* startThread(void* context);
+
+private:
+	std::string mPath;
+	bool mSyncOnCommit;
+	int mFlushIntervalMs;
+	int mFd;
+
+	// Double buffer: appends go to mActive while the commit thread writes the other one
+	char mBufferA[BUFFER_SIZE];
+	char mBufferB[BUFFER_SIZE];
+	char* mActive;
+	size_t mActiveUsed;
+
+	uint32_t mNextSequence;		// sequence given to the next append
+	uint32_t mCommittedSequence;	// highest sequence on disk
+	bool mCommitRequested;
+	bool mCommitInProgress;
+	bool mStopping;
+	bool mFailed;				// latched by a failed commit, the file may end mid-record
+
+	pthread_t mCommitThread;
+	bool mThreadStarted;
+
+	std::mutex mMutex;
+	std::condition_variable mCommitNeeded;
+	std::condition_variable mCommitDone;
+
+	// Swaps the buffers and writes out the full one, mMutex must be held by the caller's lock
+	void commitLocked(std::unique_lock<std::mutex>& lock);
+};
+
+#endif /* SRC_COMMANDJOURNAL_H_ */
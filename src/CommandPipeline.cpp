@@ -0,0 +1,109 @@
+#include <mutex>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+#include "CommandPipeline.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+/* RESPONSIBILITIES
+ *	- CommunicationSystem::send() submits every command that parsed. Submitting only takes the
+ *		queue lock, so the console is ready for the next command straight away.
+ *	- The pipeline thread (started by startSystem() and the replays) executes the commands one
+ *		at a time in the order they were typed, and prints an acknowledgement for each:
+ *			CommSys: #3 changespeed 1 100 0 0 applied in 0.412 ms (0.020 ms queued)
+ *			CommSys: #4 climb band(11000,12000) 1000 applied to 7 aircraft in 0.093 ms (0.015 ms queued)
+ *			CommSys: #5 changespeed 99 1 1 1 failed after 0.031 ms: no channel aircraft_commsys_99
+ *	- The latency is measured from submit() until the component replied, which every component
+ *		does after applying the command.
+ */
+
+extern std::mutex coutMutex;
+
+CommandPipeline::CommandPipeline() :
+	mNextSequence(1), mBusy(false)
+{
+
+}
+
+bool CommandPipeline::submit(operator_command& command) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(mQueue.size() < COMMAND_QUEUE_LIMIT){
+			command.sequence = mNextSequence++;
+			mQueue.push_back(command);
+			mQueued.notify_one();
+			return true;
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(coutMutex);
+	std::cout << "CommSys: " << COMMAND_QUEUE_LIMIT << " commands are waiting, rejected: " << command.text << std::endl;
+	return false;
+}
+
+void CommandPipeline::waitForIdle() {
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIdle.wait(lock, [&]{ return mQueue.empty() && !mBusy; });
+}
+
+static double millisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+void* CommandPipeline::start() {
+	static Histogram& latency = metrics().histogram("atc_command_latency_seconds", "Operator command from submit until its component applied it");
+	static Counter& failures = metrics().counter("atc_command_failures_total", "Operator commands whose component was missing, failed or timed out");
+
+	Trace::setThreadName("CommandPipeline");
+
+	while(true){
+		operator_command command;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mQueued.wait(lock, [&]{ return !mQueue.empty(); });
+			command = mQueue.front();
+			mQueue.pop_front();
+			mBusy = true;
+		}
+
+		std::chrono::steady_clock::time_point dequeued = std::chrono::steady_clock::now();
+		std::string result;
+		bool applied = commSystem.execute(command, result);
+		std::chrono::steady_clock::time_point done = std::chrono::steady_clock::now();
+
+		double totalMs = millisecondsBetween(command.submitted, done);
+		if(applied){
+			latency.observe(totalMs / 1000);
+		}else{
+			failures.add();
+		}
+
+		{
+			std::ostringstream ack;
+			ack << std::fixed << std::setprecision(3) << "CommSys: #" << command.sequence << " " << command.text;
+			if(applied){
+				ack << " applied" << (result.empty() ? "" : " to " + result) << " in " << totalMs
+					<< " ms (" << millisecondsBetween(command.submitted, dequeued) << " ms queued)";
+			}else{
+				ack << " failed after " << totalMs << " ms: " << result;
+			}
+
+			std::lock_guard<std::mutex> guard(coutMutex);
+			std::cout << ack.str() << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mBusy = false;
+		if(mQueue.empty()){
+			mIdle.notify_all();
+		}
+	}
+
+	return nullptr;
+}
+
+void* CommandPipeline::startThread(void* context) {
+	return static_cast<CommandPipeline*>(context)->start();
+}
@@ -0,0 +1,45 @@
+#ifndef SRC_COMMANDPIPELINE_H_
+#define SRC_COMMANDPIPELINE_H_
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "OperatorCommand.h"
+#include "CommunicationSystem.h"
+
+/* Responsible for:
+	- Queueing parsed operator commands so the console never waits on a component.
+	- Dispatching them in order on its own thread through CommunicationSystem::execute().
+	- Acknowledging each one on the console with whether it took effect and the latency from
+		the operator pressing enter to the component having applied it.
+ */
+
+// Commands waiting beyond this are rejected instead of queued
+#define COMMAND_QUEUE_LIMIT 64
+
+class CommandPipeline {
+public:
+	CommandPipeline();
+
+	// Returns false (and prints why) if the queue is full
+	bool submit(operator_command& command);
+
+	// Blocks until every submitted command has been acknowledged (replays stay deterministic)
+	void waitForIdle();
+
+	void* start();
+	static void* startThread(void* context);
+
+private:
+	CommunicationSystem commSystem;
+
+	std::mutex mMutex;
+	std::condition_variable mQueued;
+	std::condition_variable mIdle;
+	std::deque<operator_command> mQueue;
+	uint32_t mNextSequence;
+	bool mBusy;
+};
+
+#endif /* SRC_COMMANDPIPELINE_H_ */
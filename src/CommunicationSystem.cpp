@@ -1,16 +1,36 @@
 #include <mutex>
 #include <iostream>
-#include <iostream>
+#include <sstream>
+#include <cstdlib>
 #include <unistd.h>
 #include <ctime>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <errno.h>
 #include <sys/dispatch.h>
+#include <sys/neutrino.h>
 
 #include "Aircraft.h"
 #include "CommunicationSystem.h"
+#include "HistoryIndex.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "CommandPipeline.h"
+#include "Fleet.h"
+#include "RadarDelta.h"
+#include "RuntimeConfig.h"
+#include "RadarPublisher.h"
+#include "FlightPlan.h"
+#include "RestrictedAirspace.h"
 
 /* RESPONSIBILITIES
- *	- OperatorConsole triggers the CommunicationSystem::send(R, m) method, which
- *		sends the appropriate command by IPC message to the appropriate component
+ *	- OperatorConsole triggers the CommunicationSystem::send(R, m) method, which parses the
+ *		command and queues it on the CommandPipeline.
+ *	- The pipeline thread calls CommunicationSystem::execute(), which sends the command by IPC
+ *		message to the appropriate component and waits (at most COMMAND_TIMEOUT_MS) until it
+ *		has been applied.
  *	- Listens for responses from the radar for showaircrafts, and prints them to console.
  *
  * COMMANDS
@@ -22,6 +42,33 @@
  * 				changes the speed of an aircraft
  * 		3. Change prediction time
  * 				CMD: changepred {timeInSeconds}
+ * 		4. Positions of an aircraft from the recorded history
+ * 				CMD: history {id} {t1} {t2}
+ * 		5. Aircraft that were near another one in the recorded history
+ * 				CMD: nearby {id} {t} {radius} [{t2}]
+ * 		6. Zoom the console grid to a level (0 is the whole airspace), or one level in or out
+ * 				CMD: zoom {level|in|out}
+ * 		7. Move the console grid by a number of tiles, or show only the aircraft one sector owns
+ * 			(when started with "--sectors")
+ * 				CMD: pan {dx} {dy}
+ * 				CMD: sector {n|all}
+ * 		8. Change the speed of, or climb, every aircraft a selector picks, in one message
+ * 				CMD: changespeed {selector} {x} {y} {z}
+ * 				CMD: climb {id|selector} {feet}
+ * 			selectors (no spaces): 101,1350 | ids(101,1350) | box(x1,y1,x2,y2) | cell(x,y) | band(z1,z2) | conflict
+ * 		9. Start tracing, or stop and write the Chrome trace (default /data/home/qnxuser/trace.json)
+ * 				CMD: trace on
+ * 				CMD: trace off [{file}]
+ * 		10. Show the runtime config, or change it (applied from the next scan or frame)
+ * 				CMD: config
+ * 				CMD: setsep {horizontalFeet} {verticalFeet}
+ * 				CMD: setscan {ms}
+ * 				CMD: setlog {ms}
+ * 				CMD: setrefresh {ms}
+ * 		11. Give aircraft a flight plan, flown from the next second, or take it away (no waypoints)
+ * 				CMD: route {id|ids} [{x,y,z} ...]
+ * 		12. Load the restricted zones from a zone file (see RestrictedAirspace.h), or remove them
+ * 				CMD: zones {file|off}
  */
 
 typedef struct {
@@ -42,11 +89,155 @@ typedef struct {
 	int predTime;
 } changepredtime_cmd;
 
+typedef struct {
+	bool received;
+	int zoomLevel;
+	int zoomChange;
+	int panX;
+	int panY;
+	int sector;
+} display_view_cmd;
+
 extern std::mutex coutMutex;
+extern CommandPipeline commandPipeline;
+extern RuntimeConfig runtimeConfig;
+extern FlightPlans flightPlans;
+extern RestrictedAirspace restrictedAirspace;
 
 const std::string SHOW_AIRCRAFT_CMD = "showaircrafts";
 const std::string CHANGE_SPEED_CMD = "changespeed";
 const std::string CHANGE_PRED_TIME_CMD = "changepred";
+const std::string HISTORY_CMD = "history";
+const std::string NEARBY_CMD = "nearby";
+const std::string ZOOM_CMD = "zoom";
+const std::string PAN_CMD = "pan";
+const std::string TRACE_CMD = "trace";
+const std::string CLIMB_CMD = "climb";
+const std::string SECTOR_CMD = "sector";
+const std::string CONFIG_CMD = "config";
+const std::string SET_SEPARATION_CMD = "setsep";
+const std::string SET_SCAN_CMD = "setscan";
+const std::string SET_LOG_CMD = "setlog";
+const std::string SET_REFRESH_CMD = "setrefresh";
+const std::string ROUTE_CMD = "route";
+const std::string ZONES_CMD = "zones";
+
+// Shortest scan, display log or display refresh period that can be set. A scan longer than the
+// period doesn't overlap the next: the ATCSystem skips the late expiry and counts an overrun.
+#define MIN_PERIOD_MS 100
+
+// cell(x,y) are the tiles of the console grid showing the whole airspace
+#define SELECTOR_CELLS 20
+
+// Whole string must be an integer in the range of an int
+static bool parseInt(const std::string& text, int& value) {
+	char* end;
+	errno = 0;
+	long parsed = strtol(text.c_str(), &end, 10);
+	if(text.empty() || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX){
+		return false;
+	}
+	value = (int)parsed;
+	return true;
+}
+
+// Whole string must be a finite number in the range of a float
+static bool parseFloat(const std::string& text, float& value) {
+	char* end;
+	errno = 0;
+	float parsed = strtof(text.c_str(), &end);
+	if(text.empty() || *end != '\0' || errno == ERANGE || !std::isfinite(parsed)){
+		return false;
+	}
+	value = parsed;
+	return true;
+}
+
+// Comma separated items between "name(" and ")"
+static bool parseItems(const std::string& text, const std::string& name, std::vector<std::string>& items) {
+	if(text.size() < name.size() + 2 || text.compare(0, name.size() + 1, name + "(") != 0 || text[text.size() - 1] != ')'){
+		return false;
+	}
+
+	std::string list = text.substr(name.size() + 1, text.size() - name.size() - 2);
+	size_t start = 0;
+	while(true){
+		size_t comma = list.find(',', start);
+		items.push_back(list.substr(start, comma - start));
+		if(comma == std::string::npos){
+			return true;
+		}
+		start = comma + 1;
+	}
+}
+
+// Comma separated numbers between "name(" and ")"
+static bool parseList(const std::string& text, const std::string& name, std::vector<float>& values) {
+	std::vector<std::string> items;
+	if(!parseItems(text, name, items)){
+		return false;
+	}
+	for(size_t i = 0; i < items.size(); i++){
+		float value;
+		if(!parseFloat(items[i], value)){
+			return false;
+		}
+		values.push_back(value);
+	}
+	return true;
+}
+
+// Comma separated aircraft ids between "ids(" and ")", each once in the order first given
+static bool parseIds(const std::string& text, std::vector<int>& ids) {
+	std::vector<std::string> items;
+	if(!parseItems(text, "ids", items)){
+		return false;
+	}
+	for(size_t i = 0; i < items.size(); i++){
+		int id;
+		if(!parseInt(items[i], id)){
+			return false;
+		}
+		if(std::find(ids.begin(), ids.end(), id) == ids.end()){
+			ids.push_back(id);
+		}
+	}
+	return true;
+}
+
+static bool parseSelector(const std::string& text, aircraft_selector& selector) {
+	std::vector<float> values;
+	if(text == "conflict"){
+		selector.type = SELECT_CONFLICT;
+		return true;
+	}else if(parseList(text, "box", values) && values.size() == 4){
+		selector.type = SELECT_BOX;
+		std::copy(values.begin(), values.end(), selector.bounds);
+		return true;
+	}else if(parseList(text, "cell", values) && values.size() == 2){
+		float cellSize = (float)RADAR_AIRSPACE_SIZE / SELECTOR_CELLS;
+		selector.type = SELECT_BOX;
+		selector.bounds[0] = values[0] * cellSize;
+		selector.bounds[1] = values[1] * cellSize;
+		selector.bounds[2] = (values[0] + 1) * cellSize;
+		selector.bounds[3] = (values[1] + 1) * cellSize;
+		return true;
+	}else if(parseList(text, "band", values) && values.size() == 2){
+		selector.type = SELECT_BAND;
+		selector.bounds[0] = values[0];
+		selector.bounds[1] = values[1];
+		return true;
+	}
+
+	// ids(101,1350), 101,1350 or a single id
+	std::vector<int> ids;
+	if(!parseIds(text, ids) && !parseIds("ids(" + text + ")", ids)){
+		return false;
+	}
+	selector.type = SELECT_IDS;
+	selector.ids.insert(selector.ids.end(), ids.begin(), ids.end());
+	return true;
+}
 
 CommunicationSystem::CommunicationSystem() {
 
@@ -55,72 +246,362 @@ CommunicationSystem::CommunicationSystem() {
 CommunicationSystem::~CommunicationSystem() {
 }
 
+bool CommunicationSystem::parse(const std::vector<std::string>& m, operator_command& command, std::string& error) {
+	command.aircraftID = -1;
+	command.xSpeed = command.ySpeed = command.zSpeed = 0;
+	command.predTime = 0;
+	command.zoomLevel = -1;
+	command.zoomChange = 0;
+	command.panX = command.panY = 0;
+	command.sector = VIEW_SECTOR_UNCHANGED;
+	command.traceOn = false;
+	command.setting = CONFIG_SHOW;
+	command.configValues[0] = command.configValues[1] = 0;
+	command.climbFeet = 0;
+	command.selector.type = SELECT_IDS;
+	std::fill(command.selector.bounds, command.selector.bounds + 4, 0.0f);
+
+	if(m.empty()){
+		error = "Empty command";
+		return false;
+	}
+
+	if(m[0] == SHOW_AIRCRAFT_CMD){
+		command.type = CMD_SHOW_AIRCRAFT;
+		return true;
+	}else if(m[0] == CHANGE_SPEED_CMD){
+		// A single id goes to the aircraft itself, a selector to the Fleet
+		command.type = CMD_CHANGE_SPEED;
+		command.action = FLEET_CHANGE_SPEED;
+		if(m.size() == 5 && parseFloat(m[2], command.xSpeed) && parseFloat(m[3], command.ySpeed) && parseFloat(m[4], command.zSpeed)){
+			if(parseInt(m[1], command.aircraftID)){
+				return true;
+			}
+			if(parseSelector(m[1], command.selector)){
+				command.type = CMD_FLEET;
+				return true;
+			}
+		}
+		error = "Usage: changespeed {id|selector} {x} {y} {z}";
+		return false;
+	}else if(m[0] == CLIMB_CMD){
+		command.type = CMD_FLEET;
+		command.action = FLEET_CLIMB;
+		if(m.size() == 3 && parseSelector(m[1], command.selector) && parseFloat(m[2], command.climbFeet)){
+			return true;
+		}
+		error = "Usage: climb {id|selector} {feet}";
+		return false;
+	}else if(m[0] == CHANGE_PRED_TIME_CMD){
+		command.type = CMD_CHANGE_PRED_TIME;
+		if(m.size() == 2 && parseInt(m[1], command.predTime) && command.predTime >= 0){
+			return true;
+		}
+		error = "Usage: changepred {timeInSeconds}";
+		return false;
+	}else if(m[0] == HISTORY_CMD || m[0] == NEARBY_CMD){
+		// HistoryQuery checks the arguments and prints its own usage
+		command.type = CMD_HISTORY_QUERY;
+		command.words = m;
+		return true;
+	}else if(m[0] == SECTOR_CMD){
+		command.type = CMD_DISPLAY_VIEW;
+		if(m.size() == 2 && m[1] == "all"){
+			command.sector = RADAR_ALL_SECTORS;
+			return true;
+		}else if(m.size() == 2 && parseInt(m[1], command.sector) && command.sector >= 0){
+			return true;
+		}
+		error = "Usage: sector {n|all}";
+		return false;
+	}else if(m[0] == ZOOM_CMD || m[0] == PAN_CMD){
+		command.type = CMD_DISPLAY_VIEW;
+		bool valid;
+		if(m[0] == ZOOM_CMD){
+			valid = m.size() == 2;
+			if(valid && m[1] == "in"){
+				command.zoomChange = 1;
+			}else if(valid && m[1] == "out"){
+				command.zoomChange = -1;
+			}else{
+				valid = valid && parseInt(m[1], command.zoomLevel) && command.zoomLevel >= 0;
+			}
+		}else{
+			valid = m.size() == 3 && parseInt(m[1], command.panX) && parseInt(m[2], command.panY);
+		}
+		if(!valid){
+			error = "Usage: zoom {level|in|out}, pan {dx} {dy}";
+		}
+		return valid;
+	}else if(m[0] == TRACE_CMD){
+		command.type = CMD_TRACE;
+		if(m.size() == 2 && m[1] == "on"){
+			command.traceOn = true;
+			return true;
+		}else if((m.size() == 2 || m.size() == 3) && m[1] == "off"){
+			command.tracePath = (m.size() == 3) ? m[2] : TRACE_PATH;
+			return true;
+		}
+		error = "Usage: trace on, trace off [file]";
+		return false;
+	}else if(m[0] == CONFIG_CMD){
+		command.type = CMD_CONFIG;
+		command.setting = CONFIG_SHOW;
+		if(m.size() == 1){
+			return true;
+		}
+		error = "Usage: config";
+		return false;
+	}else if(m[0] == SET_SEPARATION_CMD){
+		command.type = CMD_CONFIG;
+		command.setting = CONFIG_SEPARATION;
+		if(m.size() == 3 && parseInt(m[1], command.configValues[0]) && parseInt(m[2], command.configValues[1])
+				&& command.configValues[0] > 0 && command.configValues[1] > 0){
+			return true;
+		}
+		error = "Usage: setsep {horizontalFeet} {verticalFeet}";
+		return false;
+	}else if(m[0] == SET_SCAN_CMD || m[0] == SET_LOG_CMD || m[0] == SET_REFRESH_CMD){
+		command.type = CMD_CONFIG;
+		command.setting = (m[0] == SET_SCAN_CMD) ? CONFIG_SCAN_PERIOD : (m[0] == SET_LOG_CMD) ? CONFIG_LOG_PERIOD : CONFIG_DISPLAY_REFRESH;
+		if(m.size() == 2 && parseInt(m[1], command.configValues[0]) && command.configValues[0] >= MIN_PERIOD_MS){
+			return true;
+		}
+		error = "Usage: " + m[0] + " {ms}, at least " + std::to_string(MIN_PERIOD_MS) + " ms";
+		return false;
+	}else if(m[0] == ROUTE_CMD){
+		command.type = CMD_FLIGHT_PLAN;
+		bool valid = m.size() >= 2 && parseSelector(m[1], command.selector) && command.selector.type == SELECT_IDS;
+		for(size_t w = 2; valid && w < m.size(); w++){
+			std::vector<float> values;
+			valid = parseList("waypoint(" + m[w] + ")", "waypoint", values) && values.size() == 3;
+			command.route.insert(command.route.end(), values.begin(), values.end());
+		}
+		if(valid){
+			return true;
+		}
+		error = "Usage: route {id|ids} [{x,y,z} ...]";
+		return false;
+	}else if(m[0] == ZONES_CMD){
+		command.type = CMD_RESTRICTED_ZONES;
+		if(m.size() == 2){
+			command.zonePath = (m[1] == "off") ? "" : m[1];
+			return true;
+		}
+		error = "Usage: zones {file|off}";
+		return false;
+	}
+
+	error = "Unknown command";
+	return false;
+}
+
 // Project defined method which we need to use. God it causes a huge headache for very little gain.
 int CommunicationSystem::send(int R, std::vector<std::string> m)
 {
-	// None of these actually use the reply.
-	// If there is a reply, it will be sent to the CommSys's <cmd_name>Listener thread
-	if (m[0] == SHOW_AIRCRAFT_CMD) {
-		// Send command
-		std::string channelName = "commsys_to_radar";
-		int coid = name_open(channelName.c_str(), 0);
-		if(coid == -1){
-			perror("name_open: commsys_to_radar:");
-		}
+	static Counter& commands = metrics().counter("atc_commands_total", "Operator commands sent through the communication system");
+	static Counter& rejected = metrics().counter("atc_commands_rejected_total", "Operator commands that did not parse or did not fit in the queue");
+	commands.add();
 
-		showaircrafts_cmd msg;
-		msg.received = false;
-		int status = MsgSend(coid, &msg, sizeof(msg), NULL, 0);
-		if(status == -1) {
-			perror("MsgSend");
-		}
+	// Parsed here, once. The pipeline thread does the IPC, so a slow or missing component
+	// never holds up the console.
+	operator_command command;
+	std::string error;
+	if(!parse(m, command, error)){
+		rejected.add();
+		std::lock_guard<std::mutex> guard(coutMutex);
+		std::cout << "CommSys: " << error << std::endl;
+		return -1;
+	}
 
-		return 0;
-	} else if (m[0] == CHANGE_SPEED_CMD) {
-		// Send command
-		std::string channelName = "aircraft_commsys_" + m[1];
-		int coid = name_open(channelName.c_str(), 0);
-		if(coid == -1){
-			perror("name_open: aircraft_commsys: Aircraft ID may not exist. ");
-		}
+	for(size_t i = 0; i < m.size(); i++){
+		command.text += (i == 0 ? "" : " ") + m[i];
+	}
+	command.submitted = std::chrono::steady_clock::now();
 
-		changespeed_cmd msg;
-		msg.received = false;
-		msg.aircraftID = std::stoi(m[1]);
-		msg.xSpeed = std::stof(m[2]);
-		msg.ySpeed = std::stof(m[3]);
-		msg.zSpeed = std::stof(m[4]);
-		int status = MsgSend(coid, &msg, sizeof(msg), NULL, 0);
-		if(status == -1) {
-			perror("MsgSend: aircraft_commsys:");
-		}
+	if(!commandPipeline.submit(command)){
+		rejected.add();
+		return -1;
+	}
+	return 0;
+}
 
-		return 0;
-	} else if (m[0] == CHANGE_PRED_TIME_CMD) {
-		std::string channelName = "commsys_to_atcsystem";
-		int coid = name_open(channelName.c_str(), 0);
-		if(coid == -1){
-			perror("name_open: commsys_to_atcsystem: ");
-		}
+// name_open, MsgSend and name_close, giving up on a component that doesn't reply in time
+static bool sendToComponent(const std::string& channelName, const channel_metrics& ipc, const void* msg, size_t size,
+		std::string& error, void* reply = NULL, size_t replySize = 0) {
+	int coid = name_open(channelName.c_str(), 0);
+	ipc.opens->add();
+	if(coid == -1){
+		ipc.failures->add();
+		error = "no channel " + channelName;
+		return false;
+	}
 
+	uint64_t timeout = (uint64_t)COMMAND_TIMEOUT_MS * 1000000;
+	TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_SEND | _NTO_TIMEOUT_REPLY, NULL, &timeout, NULL);
+	int status = MsgSend(coid, msg, size, reply, replySize);
+	ipc.sends->add();
+	if(status == -1){
+		ipc.failures->add();
+		error = (errno == ETIMEDOUT) ? "no reply from " + channelName + " within " + std::to_string(COMMAND_TIMEOUT_MS) + " ms"
+				: channelName + ": " + strerror(errno);
+	}
+	name_close(coid);
+	return status != -1;
+}
+
+bool CommunicationSystem::execute(const operator_command& command, std::string& result)
+{
+	TRACE_SCOPE("command", "ipc");
+
+	// Every component replies once it has applied the command
+	switch(command.type){
+	case CMD_SHOW_AIRCRAFT: {
+		static channel_metrics ipc = metrics().channel("commsys_to_radar");
+		showaircrafts_cmd msg;
+		msg.received = false;
+		return sendToComponent("commsys_to_radar", ipc, &msg, sizeof(msg), result);
+	}
+	case CMD_CHANGE_SPEED: {
+		static channel_metrics ipc = metrics().channel("aircraft_commsys");
+		changespeed_cmd msg;
+		msg.received = false;
+		msg.aircraftID = command.aircraftID;
+		msg.xSpeed = command.xSpeed;
+		msg.ySpeed = command.ySpeed;
+		msg.zSpeed = command.zSpeed;
+		return sendToComponent("aircraft_commsys_" + std::to_string(command.aircraftID), ipc, &msg, sizeof(msg), result);
+	}
+	case CMD_CHANGE_PRED_TIME: {
+		static channel_metrics ipc = metrics().channel("commsys_to_atcsystem");
 		changepredtime_cmd msg;
 		msg.received = false;
-		msg.predTime = std::stoi(m[1]);
-		int status = MsgSend(coid, &msg, sizeof(msg), NULL, 0);
-		if(status == -1) {
-			perror("MsgSend: commsys_to_atcsystem");
+		msg.predTime = command.predTime;
+		return sendToComponent("commsys_to_atcsystem", ipc, &msg, sizeof(msg), result);
+	}
+	case CMD_HISTORY_QUERY: {
+		// Answered from the history files, no component has to be asked
+		std::ostringstream answer;
+		int status = HistoryQuery::runCommand(HISTORY_DIRECTORY, command.words, answer);
+
+		std::lock_guard<std::mutex> guard(coutMutex);
+		std::cout << answer.str();
+		if(status < 0){
+			result = "query failed";
 		}
+		return status >= 0;
+	}
+	case CMD_DISPLAY_VIEW: {
+		static channel_metrics ipc = metrics().channel("commsys_to_display");
+		display_view_cmd msg;
+		msg.received = false;
+		msg.zoomLevel = command.zoomLevel;
+		msg.zoomChange = command.zoomChange;
+		msg.panX = command.panX;
+		msg.panY = command.panY;
+		msg.sector = command.sector;
+		return sendToComponent("commsys_to_display", ipc, &msg, sizeof(msg), result);
+	}
+	case CMD_FLEET: {
+		// One message for every aircraft selected, the ids (if any) right after the header
+		static channel_metrics ipc = metrics().channel("commsys_to_fleet");
+		fleet_cmd msg;
+		msg.action = command.action;
+		msg.values[0] = (command.action == FLEET_CLIMB) ? command.climbFeet : command.xSpeed;
+		msg.values[1] = command.ySpeed;
+		msg.values[2] = command.zSpeed;
+		msg.selector = command.selector.type;
+		std::copy(command.selector.bounds, command.selector.bounds + 4, msg.bounds);
+		msg.idCount = command.selector.ids.size();
 
-		return 0;
-	};
+		std::vector<char> buffer(sizeof(msg) + msg.idCount * sizeof(int));
+		memcpy(buffer.data(), &msg, sizeof(msg));
+		if(msg.idCount > 0){
+			memcpy(buffer.data() + sizeof(msg), command.selector.ids.data(), msg.idCount * sizeof(int));
+		}
 
-	{
+		fleet_reply reply;
+		reply.selected = 0;
+		if(!sendToComponent(FLEET_CHANNEL, ipc, buffer.data(), buffer.size(), result, &reply, sizeof(reply))){
+			return false;
+		}
+		result = std::to_string(reply.selected) + " aircraft";
+		return true;
+	}
+	case CMD_TRACE: {
+		// Tracing is in this process, no component has to be asked
+		if(command.traceOn){
+			Trace::enable();
+			return true;
+		}
+		Trace::disable();
+		long events = Trace::writeFile(command.tracePath);
+		if(events < 0){
+			result = "cannot write " + command.tracePath;
+			return false;
+		}
 		std::lock_guard<std::mutex> guard(coutMutex);
-		std::cout << "CommSys: Unknown command. " << std::endl;
+		std::cout << "CommSys: Wrote " << events << " trace events to " << command.tracePath << std::endl;
+		return true;
+	}
+	case CMD_CONFIG: {
+		// The config is in this process, readers pick up the new version on their own
+		const runtime_config* config = runtimeConfig.get();
+		if(command.setting != CONFIG_SHOW){
+			config = runtimeConfig.update([&command](runtime_config& next){
+				switch(command.setting){
+				case CONFIG_SEPARATION:
+					next.horizontalSeparation = command.configValues[0];
+					next.verticalSeparation = command.configValues[1];
+					break;
+				case CONFIG_SCAN_PERIOD:
+					next.scanPeriodMs = command.configValues[0];
+					break;
+				case CONFIG_LOG_PERIOD:
+					next.logPeriodMs = command.configValues[0];
+					break;
+				case CONFIG_DISPLAY_REFRESH:
+					next.displayRefreshMs = command.configValues[0];
+					break;
+				case CONFIG_SHOW:
+					break;
+				}
+			});
+		}
+		std::lock_guard<std::mutex> guard(coutMutex);
+		std::cout << "CommSys: Config ";
+		RuntimeConfig::write(*config, std::cout);
+		std::cout << std::endl;
+		return true;
+	}
+	case CMD_FLIGHT_PLAN: {
+		// The plans are in this process, aircraft and the ATCSystem pick the new table up on their own
+		std::vector<waypoint> route(command.route.size() / 3);
+		for(size_t w = 0; w < route.size(); w++){
+			route[w].x = command.route[3 * w];
+			route[w].y = command.route[3 * w + 1];
+			route[w].z = command.route[3 * w + 2];
+		}
+		flightPlans.set(command.selector.ids, route);
+		result = std::to_string(command.selector.ids.size()) + " aircraft";
+		return true;
+	}
+	case CMD_RESTRICTED_ZONES: {
+		// The zones are in this process, the next scan checks against the new ones
+		std::vector<restricted_zone> zones;
+		if(!command.zonePath.empty() && !RestrictedAirspace::readFile(command.zonePath, zones)){
+			result = "cannot read " + command.zonePath;
+			return false;
+		}
+		static Gauge& loaded = metrics().gauge("atc_restricted_zones", "Restricted zones the scan checks aircraft against");
+		loaded.set(restrictedAirspace.load(zones)->size());
+		result = std::to_string(zones.size()) + " zones";
+		return true;
+	}
 	}
 
-
-	return 0;
+	result = "not dispatched";
+	return false;
 }
 
 void* CommunicationSystem::start(){
@@ -133,6 +614,7 @@ void* CommunicationSystem::start(){
 
 	int rcvid;
 	showaircrafts_cmd msg;
+	Trace::setThreadName("CommSys showaircrafts");
 	while(true){
 		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), NULL);
 		if(rcvid == -1){
@@ -2,15 +2,28 @@
 #define SRC_COMMUNICATIONSYSTEM_H_
 
 #include <vector>
+#include <string>
+#include "OperatorCommand.h"
+
+// How long a command waits for its component before it is reported as failed
+#define COMMAND_TIMEOUT_MS 2000
 
 class CommunicationSystem {
 public:
 	CommunicationSystem();
 	virtual ~CommunicationSystem();
 
-	// R is aircraft ID, m is message
+	// R is aircraft ID, m is message. Queues the command on the CommandPipeline,
+	// returns -1 if it doesn't parse or the queue is full.
 	int send(int R, std::vector<std::string> m);
 
+	// Converts every argument up front, never throws. error says what is wrong.
+	static bool parse(const std::vector<std::string>& m, operator_command& command, std::string& error);
+
+	// Called by the CommandPipeline thread, returns once the component has applied the command.
+	// result says why it failed, or (if not empty) what it did.
+	bool execute(const operator_command& command, std::string& result);
+
 	void* start();
 
 	static void* startThread(void* context);
@@ -0,0 +1,321 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "ConflictCache.h"
+#include "ConflictCheck.h"
+#include "RadarDelta.h"
+
+/* RESPONSIBILITIES
+ *	- "Main --incremental" gives the ATCSystem a ConflictCache, which replaces the full check of
+ *		ATCSystem::checkViolations() (and the sectors). Only the scan timer thread uses it.
+ *	- Correctness never depends on the intervals being tight: they only decide which pairs get the
+ *		exact test, and every aircraft is checked against its line on every scan.
+ *	- "Main --bench-incremental" compares it with the full check.
+ */
+
+ConflictCache::ConflictCache() :
+	mGeneration(0), mScan(0), mHorizontal(-1), mVertical(-1), mPredTime(-1)
+{
+	mReanchored = &metrics().counter("atc_cache_reanchored_total", "Aircraft whose conflict intervals were computed again");
+	mCached = &metrics().gauge("atc_cache_pairs", "Aircraft pairs with a cached conflict interval");
+	mActiveGauge = &metrics().gauge("atc_cache_active_pairs", "Aircraft pairs inside their conflict interval");
+}
+
+uint64_t ConflictCache::pairKey(int id1, int id2) {
+	if(id1 > id2){
+		std::swap(id1, id2);
+	}
+	return ((uint64_t)(uint32_t)id1 << 32) | (uint32_t)id2;
+}
+
+void ConflictCache::clear() {
+	mTracks.clear();
+	mPairs.clear();
+	mPending = std::priority_queue<pending_pair, std::vector<pending_pair>, later_first>();
+	mActive.clear();
+}
+
+bool ConflictCache::onLine(const track& t, const aircraft_state& state, double now) {
+	double dx = state.x - t.anchor.x;
+	double dy = state.y - t.anchor.y;
+	double dz = state.z - t.anchor.z;
+	double speed2 = (double)t.moveX * t.moveX + (double)t.moveY * t.moveY + (double)t.moveZ * t.moveZ;
+
+	// How long it has flown, judging by where it is
+	double flown = 0;
+	if(speed2 > 0){
+		flown = (dx * t.moveX + dy * t.moveY + dz * t.moveZ) / speed2;
+		if(std::fabs(flown - (now - t.anchorTime)) > CACHE_SLACK_SECONDS){
+			return false;
+		}
+	}
+	return std::fabs(dx - t.moveX * flown) <= CACHE_DRIFT_FEET
+			&& std::fabs(dy - t.moveY * flown) <= CACHE_DRIFT_FEET
+			&& std::fabs(dz - t.moveZ * flown) <= CACHE_DRIFT_FEET;
+}
+
+bool ConflictCache::interval(const track& a, const track& b, double& begin, double& end) const {
+	// The projection of a track at time t is anchor + move * (t - anchorTime) + speed * predTime
+	const double aAt[3] = { a.anchor.x - a.moveX * a.anchorTime + a.anchor.speedX * mPredTime,
+			a.anchor.y - a.moveY * a.anchorTime + a.anchor.speedY * mPredTime,
+			a.anchor.z - a.moveZ * a.anchorTime + a.anchor.speedZ * mPredTime };
+	const double bAt[3] = { b.anchor.x - b.moveX * b.anchorTime + b.anchor.speedX * mPredTime,
+			b.anchor.y - b.moveY * b.anchorTime + b.anchor.speedY * mPredTime,
+			b.anchor.z - b.moveZ * b.anchorTime + b.anchor.speedZ * mPredTime };
+	const double aMove[3] = { a.moveX, a.moveY, a.moveZ };
+	const double bMove[3] = { b.moveX, b.moveY, b.moveZ };
+	const int separation[3] = { mHorizontal, mHorizontal, mVertical };
+
+	begin = -std::numeric_limits<double>::infinity();
+	end = std::numeric_limits<double>::infinity();
+	for(int axis = 0; axis < 3; axis++){
+		// separationLost() truncates the bounds, and each aircraft can be off its line
+		double limit = 2.0 * separation[axis] + 2 + 2 * CACHE_DRIFT_FEET
+				+ CACHE_SLACK_SECONDS * (std::fabs(aMove[axis]) + std::fabs(bMove[axis]));
+		double distance = aAt[axis] - bAt[axis];
+		double closing = aMove[axis] - bMove[axis];
+		if(closing == 0){
+			if(std::fabs(distance) > limit){
+				return false;
+			}
+			continue;
+		}
+		double t1 = (-limit - distance) / closing;
+		double t2 = (limit - distance) / closing;
+		begin = std::max(begin, std::min(t1, t2));
+		end = std::min(end, std::max(t1, t2));
+	}
+	return begin <= end;
+}
+
+bool ConflictCache::check(int64_t timeMs, const std::vector<Aircraft>& radarFindings, const std::vector<aircraft_state>& states,
+		int horizontal, int vertical, int predTime, std::vector<violation_pair>& violations, uint64_t& pairsTested) {
+	if(horizontal != mHorizontal || vertical != mVertical || predTime != mPredTime){
+		clear();
+		mHorizontal = horizontal;
+		mVertical = vertical;
+		mPredTime = predTime;
+	}
+	mScan++;
+	double now = timeMs / 1000.0;
+
+	std::unordered_map<int, size_t> positions;
+	positions.reserve(radarFindings.size());
+	for(size_t i = 0; i < radarFindings.size(); i++){
+		if(!positions.emplace(radarFindings[i].getID(), i).second){
+			clear();
+			return false;
+		}
+	}
+
+	// Aircraft that entered, changed speed, jumped or are new get a new line
+	std::vector<int> changed;
+	for(size_t i = 0; i < radarFindings.size(); i++){
+		const aircraft_state& state = states[i];
+		bool entered = (int64_t)radarFindings[i].getEntryTime() * 1000 <= timeMs;
+		float moveX = entered ? state.speedX : 0;
+		float moveY = entered ? state.speedY : 0;
+		float moveZ = entered ? state.speedZ : 0;
+
+		std::unordered_map<int, track>::iterator found = mTracks.find(radarFindings[i].getID());
+		bool anchor = found == mTracks.end();
+		track& t = anchor ? mTracks[radarFindings[i].getID()] : found->second;
+		if(!anchor){
+			anchor = t.anchor.speedX != state.speedX || t.anchor.speedY != state.speedY || t.anchor.speedZ != state.speedZ
+					|| t.moveX != moveX || t.moveY != moveY || t.moveZ != moveZ || !onLine(t, state, now);
+		}
+		t.seen = mScan;
+		t.changed = anchor;
+		if(anchor){
+			t.anchor = state;
+			t.anchorTime = now;
+			t.moveX = moveX;
+			t.moveY = moveY;
+			t.moveZ = moveZ;
+			changed.push_back(radarFindings[i].getID());
+		}
+	}
+	mReanchored->add(changed.size());
+
+	// Aircraft that left take their pairs with them
+	if(mTracks.size() > radarFindings.size()){
+		std::vector<int> left;
+		for(std::unordered_map<int, track>::iterator t = mTracks.begin(); t != mTracks.end(); ++t){
+			if(t->second.seen != mScan){
+				left.push_back(t->first);
+			}
+		}
+		for(size_t l = 0; l < left.size(); l++){
+			mTracks.erase(left[l]);
+			for(std::unordered_map<int, track>::iterator t = mTracks.begin(); t != mTracks.end(); ++t){
+				mPairs.erase(pairKey(left[l], t->first));
+			}
+		}
+	}
+
+	// New intervals for every pair of a changed aircraft, once per pair
+	for(size_t c = 0; c < changed.size(); c++){
+		const track& a = mTracks[changed[c]];
+		for(std::unordered_map<int, track>::iterator t = mTracks.begin(); t != mTracks.end(); ++t){
+			if(t->first == changed[c] || (t->second.changed && t->first < changed[c])){
+				continue;
+			}
+			uint64_t key = pairKey(changed[c], t->first);
+			double begin, end;
+			pairsTested++;
+			if(!interval(a, t->second, begin, end) || end < now){
+				mPairs.erase(key);
+				continue;
+			}
+			pair_interval& cached = mPairs[key];
+			cached.begin = begin;
+			cached.end = end;
+			cached.generation = ++mGeneration;
+			pending_pair pending = { begin, key, cached.generation };
+			if(begin <= now){
+				mActive.push_back(pending);
+			}else{
+				mPending.push(pending);
+			}
+		}
+	}
+
+	// Pairs whose interval has started
+	while(!mPending.empty() && mPending.top().begin <= now){
+		pending_pair pending = mPending.top();
+		mPending.pop();
+		std::unordered_map<uint64_t, pair_interval>::iterator cached = mPairs.find(pending.key);
+		if(cached != mPairs.end() && cached->second.generation == pending.generation){
+			mActive.push_back(pending);
+		}
+	}
+
+	// The exact test for the pairs inside their interval, dropping the stale and the finished ones
+	std::vector<std::pair<size_t, size_t> > found;
+	size_t kept = 0;
+	for(size_t a = 0; a < mActive.size(); a++){
+		std::unordered_map<uint64_t, pair_interval>::iterator cached = mPairs.find(mActive[a].key);
+		if(cached == mPairs.end() || cached->second.generation != mActive[a].generation){
+			continue;
+		}
+		if(cached->second.end < now){
+			mPairs.erase(cached);
+			continue;
+		}
+		mActive[kept++] = mActive[a];
+
+		size_t i = positions[(int)(uint32_t)(mActive[a].key >> 32)];
+		size_t j = positions[(int)(uint32_t)mActive[a].key];
+		pairsTested++;
+		if(separationLost(projectState(states[i], predTime), projectState(states[j], predTime), horizontal, vertical)){
+			found.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+		}
+	}
+	mActive.resize(kept);
+	mCached->set(mPairs.size());
+	mActiveGauge->set(mActive.size());
+
+	// In the order of the full check
+	std::sort(found.begin(), found.end());
+	violations.clear();
+	for(size_t k = 0; k < found.size(); k++){
+		violation_pair violation;
+		violation.aircraft1ID = radarFindings[found[k].first].getID();
+		violation.aircraft2ID = radarFindings[found[k].second].getID();
+		violations.push_back(violation);
+	}
+	return true;
+}
+
+int ConflictCache::benchmark(int aircraftCount, int scans, std::ostream& out) {
+	const int horizontal = 3000, vertical = 1000, predTime = 180;
+	const int changeCounts[] = { 0, 1, 10, 100 };
+	CommunicationSystem commSystem;
+
+	out << "+-------------+ Incremental conflict benchmark: " << aircraftCount << " aircraft, " << scans
+			<< " scans, full check against cached intervals +-------------+" << std::endl;
+	out << "| speed changes/scan | full ms/scan | first scan ms | incremental ms/scan | speedup | pairs tested/scan"
+			<< " | cached pairs | active pairs | conflicts/scan | same as full check" << std::endl;
+
+	bool allSame = true;
+	for(size_t c = 0; c < sizeof(changeCounts) / sizeof(changeCounts[0]); c++){
+		int changes = std::min(changeCounts[c], aircraftCount);
+
+		// The traffic of the sector benchmark, entered at 0
+		std::vector<Aircraft> radarFindings;
+		unsigned int seed = 12345;
+		for(int i = 0; i < aircraftCount; i++){
+			seed = seed * 1103515245 + 12345;
+			float x = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+			seed = seed * 1103515245 + 12345;
+			float y = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+			radarFindings.push_back(Aircraft(0, i, x, y, 10000 + (i % 20) * 1000, (i % 9) * 50 - 200, (i % 7) * 50 - 150, 0, commSystem));
+		}
+
+		ConflictCache cache;
+		std::vector<aircraft_state> states(aircraftCount), projections(aircraftCount);
+		std::vector<violation_pair> violations;
+		double fullMs = 0, firstMs = 0, cacheMs = 0;
+		uint64_t pairsTested = 0, conflicts = 0;
+		bool same = true;
+		for(int scan = 0; scan <= scans; scan++){
+			// One second of flight, then a few controllers' changespeed
+			for(int i = 0; scan > 0 && i < aircraftCount; i++){
+				aircraft_state s = radarFindings[i].getState();
+				radarFindings[i].setPos(s.x + s.speedX, s.y + s.speedY, s.z + s.speedZ);
+			}
+			for(int k = 0; scan > 0 && k < changes; k++){
+				seed = seed * 1103515245 + 12345;
+				Aircraft& changing = radarFindings[(seed >> 8) % aircraftCount];
+				changing.setSpeed((int)((seed >> 4) % 9) * 50 - 200, (int)((seed >> 12) % 7) * 50 - 150, 0);
+			}
+			for(int i = 0; i < aircraftCount; i++){
+				states[i] = radarFindings[i].getState();
+				projections[i] = projectState(states[i], predTime);
+			}
+
+			std::vector<std::pair<size_t, size_t> > expected;
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			for(int i = 0; i < aircraftCount; i++){
+				for(int j = i + 1; j < aircraftCount; j++){
+					if(separationLost(projections[i], projections[j], horizontal, vertical)){
+						expected.push_back(std::make_pair(i, j));
+					}
+				}
+			}
+			fullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+			uint64_t tested = 0;
+			begin = std::chrono::steady_clock::now();
+			cache.check((int64_t)scan * 1000, radarFindings, states, horizontal, vertical, predTime, violations, tested);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+			if(scan == 0){
+				firstMs = ms;
+			}else{
+				cacheMs += ms;
+				pairsTested += tested;
+				conflicts += violations.size();
+			}
+
+			bool scanSame = violations.size() == expected.size();
+			for(size_t k = 0; scanSame && k < expected.size(); k++){
+				scanSame = violations[k].aircraft1ID == radarFindings[expected[k].first].getID()
+						&& violations[k].aircraft2ID == radarFindings[expected[k].second].getID();
+			}
+			same = same && scanSame;
+		}
+		allSame = allSame && same;
+
+		int steadyScans = std::max(scans, 1);
+		out << "| " << changes << " | " << fullMs / (scans + 1) << " | " << firstMs << " | " << cacheMs / steadyScans << " | "
+				<< (cacheMs > 0 ? (fullMs / (scans + 1)) / (cacheMs / steadyScans) : 0) << " | " << pairsTested / steadyScans << " | "
+				<< cache.getCachedPairs() << " | " << cache.getActivePairs() << " | " << conflicts / steadyScans << " | "
+				<< (same ? "yes" : "NO") << std::endl;
+	}
+
+	out << "+-------------+ " << (allSame ? "The cache found the same conflicts on every scan" : "CACHE DISAGREES WITH THE FULL CHECK") << " +-------------+" << std::endl;
+	return allSame ? 0 : 1;
+}
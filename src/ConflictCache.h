@@ -0,0 +1,107 @@
+#ifndef SRC_CONFLICTCACHE_H_
+#define SRC_CONFLICTCACHE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <iostream>
+#include "Aircraft.h"
+#include "RadarBus.h"
+#include "Metrics.h"
+
+/* Responsible for:
+	- Checking the airspace incrementally: aircraft fly in straight lines, so the time interval in
+		which two of them can conflict is known in advance and only changes when one of them changes
+		speed, enters, leaves or jumps (changealtitude).
+	- Caching that interval for every pair that can still conflict, and testing a pair only while
+		the scan time is inside its interval.
+	- Finding exactly the violations of ATCSystem::checkViolations(), in the same order.
+ */
+
+/*	How a scan is checked:
+ * 	- Every aircraft is read once and compared with the straight line it was last anchored on. A new
+ * 		aircraft, a new speed, entering the airspace, or a position more than CACHE_DRIFT_FEET off
+ * 		the line re-anchors it, and the intervals of all its pairs are computed again.
+ * 	- A pair's interval is when the two projections are within 2 * separation on all three axes,
+ * 		plus truncation, drift, and the distance each flies in CACHE_SLACK_SECONDS: aircraft move once
+ * 		a second while scans come at any time, so an aircraft can be that far behind or ahead of its
+ * 		line. Pairs that can never conflict again are not kept.
+ * 	- Pairs whose interval starts later wait in a queue ordered by start time; the pairs inside
+ * 		their interval get the exact test of separationLost() on this scan's projections.
+ * 	So a steady scan costs one read per aircraft plus the pairs near a conflict, and each change
+ * 	costs one interval per other aircraft, instead of n * (n - 1) / 2 tests every scan.
+ */
+
+#define CACHE_DRIFT_FEET 1.0
+#define CACHE_SLACK_SECONDS 2.0
+
+class ConflictCache {
+public:
+	ConflictCache();
+
+	// One scan at timeMs (the time of the aircraft clock), states being the aircraft of radarFindings
+	// read once. false if the cache cannot be used for this scan (two aircraft with one id), the
+	// caller checks it in full then.
+	bool check(int64_t timeMs, const std::vector<Aircraft>& radarFindings, const std::vector<aircraft_state>& states,
+			int horizontal, int vertical, int predTime, std::vector<violation_pair>& violations, uint64_t& pairsTested);
+
+	size_t getCachedPairs() const { return mPairs.size(); }
+	size_t getActivePairs() const { return mActive.size(); }
+
+	// Full check against the cache for n aircraft while 0 to 100 of them change speed every scan
+	static int benchmark(int aircraftCount, int scans, std::ostream& out);
+
+private:
+	typedef struct {
+		aircraft_state anchor;		// state when anchored
+		double anchorTime;			// seconds
+		float moveX, moveY, moveZ;	// feet per second it flies, 0 before it enters
+		bool changed;				// re-anchored this scan
+		uint64_t seen;				// last scan it was on the radar
+	} track;
+
+	typedef struct {
+		double begin;
+		double end;
+		uint64_t generation;
+	} pair_interval;
+
+	typedef struct {
+		double begin;
+		uint64_t key;
+		uint64_t generation;
+	} pending_pair;
+
+	struct later_first {
+		bool operator()(const pending_pair& a, const pending_pair& b) const { return a.begin > b.begin; }
+	};
+
+	std::unordered_map<int, track> mTracks;
+	std::unordered_map<uint64_t, pair_interval> mPairs;		// by pairKey()
+	std::priority_queue<pending_pair, std::vector<pending_pair>, later_first> mPending;
+	std::vector<pending_pair> mActive;						// begin is unused
+	uint64_t mGeneration;
+	uint64_t mScan;
+
+	// the settings the intervals were computed with, any change empties the cache
+	int mHorizontal;
+	int mVertical;
+	int mPredTime;
+
+	Counter* mReanchored;
+	Gauge* mCached;
+	Gauge* mActiveGauge;
+
+	static uint64_t pairKey(int id1, int id2);
+
+	// Whether the projections of a and b can conflict at some time in [begin, end]
+	bool interval(const track& a, const track& b, double& begin, double& end) const;
+
+	// Whether state is where t has flown to by now, give or take the slack and the drift
+	static bool onLine(const track& t, const aircraft_state& state, double now);
+
+	void clear();
+};
+
+#endif /* SRC_CONFLICTCACHE_H_ */
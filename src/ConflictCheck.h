@@ -0,0 +1,46 @@
+#ifndef SRC_CONFLICTCHECK_H_
+#define SRC_CONFLICTCHECK_H_
+
+#include "Aircraft.h"
+
+/* Responsible for:
+	- The violation test of one pair of aircraft, shared by ATCSystem::checkViolations() and the
+		sector engines so that every way of checking the airspace finds exactly the same pairs.
+ */
+
+// Where an aircraft will be predTime seconds from now at its current speed
+inline aircraft_state projectState(const aircraft_state& state, int predTime) {
+	aircraft_state projection = state;
+	projection.x = state.x + (state.speedX * predTime);
+	projection.y = state.y + (state.speedY * predTime);
+	projection.z = state.z + (state.speedZ * predTime);
+	return projection;
+}
+
+// The airspace needed around two projected aircraft overlaps. The bounds are truncated to whole
+// feet like they always were, so two aircraft up to 2 * horizontal + 2 feet apart can conflict.
+inline bool separationLost(const aircraft_state& aircraft1Projection, const aircraft_state& aircraft2Projection,
+		int horizontal, int vertical) {
+	//calculate airspace needed around aircraft 1
+	int x1Min = aircraft1Projection.x - horizontal;
+	int x1Max = aircraft1Projection.x + horizontal;
+	int y1Min = aircraft1Projection.y - horizontal;
+	int y1Max = aircraft1Projection.y + horizontal;
+	int z1Min = aircraft1Projection.z - vertical;
+	int z1Max = aircraft1Projection.z + vertical;
+
+	//calculate airspace needed around aircraft 2
+	int x2Min = aircraft2Projection.x - horizontal;
+	int x2Max = aircraft2Projection.x + horizontal;
+	int y2Min = aircraft2Projection.y - horizontal;
+	int y2Max = aircraft2Projection.y + horizontal;
+	int z2Min = aircraft2Projection.z - vertical;
+	int z2Max = aircraft2Projection.z + vertical;
+
+	//if two boxes overlap
+	return (x1Max >= x2Min && x2Max >= x1Min)
+			&& (y1Max >= y2Min && y2Max >= y1Min)
+			&& (z1Max >= z2Min && z2Max >= z1Min);
+}
+
+#endif /* SRC_CONFLICTCHECK_H_ */
@@ -0,0 +1,86 @@
+#include <algorithm>
+
+#include "DensityPyramid.h"
+
+/* RESPONSIBILITIES
+ *	- GridRenderer calls DensityPyramid::update() once per frame with the radar data and then only
+ *		reads the tiles of the view it shows, so a zoomed view costs the same as the full one.
+ *	- The tile of each aircraft is kept by its position in the radar list, which only changes when
+ *		aircraft are added or removed. An aircraft that stays in its finest tile costs one compare.
+ *		One that moves updates each level from the finest up, stopping at the first level where its
+ *		tile did not change.
+ */
+
+DensityPyramid::DensityPyramid(int iAirspaceSize, int iBaseTiles, int iLevels, int iFactor) :
+	mAirspaceSize(iAirspaceSize), mLevels(iLevels), mFactor(iFactor)
+{
+	int tiles = iBaseTiles;
+	for(int level = 0; level < mLevels; level++){
+		mTiles.push_back(tiles);
+		mCounts.push_back(std::vector<uint32_t>((size_t)tiles * tiles, 0));
+		tiles *= mFactor;
+	}
+}
+
+void DensityPyramid::add(int x, int y, int delta) {
+	for(int level = mLevels - 1; level >= 0; level--){
+		mCounts[level][(size_t)x * mTiles[level] + y] += delta;
+		x /= mFactor;
+		y /= mFactor;
+	}
+}
+
+void DensityPyramid::update(const std::vector<Aircraft>& aircraftData, int elapsedSeconds) {
+	// Aircraft no longer in the list
+	for(size_t i = aircraftData.size(); i < mSlots.size(); i++){
+		if(mSlots[i].x != -1){
+			add(mSlots[i].x, mSlots[i].y, -1);
+		}
+	}
+	mSlots.resize(aircraftData.size(), track_tile{-1, -1});
+
+	int finest = mLevels - 1;
+	// 100000 doesn't divide into 320 tiles, so scale instead of dividing by a whole tile size
+	double tilesPerUnit = (double)mTiles[finest] / mAirspaceSize;
+
+	for(size_t i = 0; i < aircraftData.size(); i++){
+		const Aircraft& aircraft = aircraftData[i];
+		int x = -1, y = -1;
+		if(aircraft.getEntryTime() <= elapsedSeconds && aircraft.getXPos() >= 0 && aircraft.getYPos() >= 0 &&
+				aircraft.getXPos() < mAirspaceSize && aircraft.getYPos() < mAirspaceSize){
+			x = std::min((int)(aircraft.getXPos() * tilesPerUnit), mTiles[finest] - 1);
+			y = std::min((int)(aircraft.getYPos() * tilesPerUnit), mTiles[finest] - 1);
+		}
+
+		// Slots follow the radar list; a different aircraft in a slot just moves the slot's count
+		track_tile& track = mSlots[i];
+		if(track.x == x && track.y == y){
+			continue;
+		}
+
+		if(track.x != -1){
+			// Only the levels where the tile actually changed
+			int oldX = track.x, oldY = track.y, newX = x, newY = y;
+			for(int level = finest; level >= 0; level--){
+				if(newX == oldX && newY == oldY){
+					break;
+				}
+				mCounts[level][(size_t)oldX * mTiles[level] + oldY]--;
+				if(newX != -1){
+					mCounts[level][(size_t)newX * mTiles[level] + newY]++;
+				}
+				oldX /= mFactor;
+				oldY /= mFactor;
+				if(newX != -1){
+					newX /= mFactor;
+					newY /= mFactor;
+				}
+			}
+		}else{
+			add(x, y, 1);
+		}
+
+		track.x = x;
+		track.y = y;
+	}
+}
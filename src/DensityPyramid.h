@@ -0,0 +1,53 @@
+#ifndef SRC_DENSITYPYRAMID_H_
+#define SRC_DENSITYPYRAMID_H_
+
+#include <stdint.h>
+#include <vector>
+#include "Aircraft.h"
+
+/* Responsible for:
+	- Aircraft counts per tile at several resolutions of the airspace (20x20, 80x80, 320x320 by default).
+	- Keeping the counts up to date from one scan to the next by only moving the aircraft whose
+		finest tile changed, instead of recounting every level.
+ */
+
+/*
+ * Level 0 is the coarsest. Each level has `factor` times as many tiles per side as the one above,
+ * and tile (x, y) of a level covers tiles (x * factor .. x * factor + factor - 1, same for y) of the
+ * next one. Tile 0,0 is the bottom left corner of the airspace.
+ */
+
+class DensityPyramid {
+public:
+	DensityPyramid(int iAirspaceSize = 100000, int iBaseTiles = 20, int iLevels = 3, int iFactor = 4);
+
+	// Moves the aircraft that changed tile since the last update, adds the ones that entered the
+	// airspace by elapsedSeconds and removes the ones that left it or are no longer in the list
+	void update(const std::vector<Aircraft>& aircraftData, int elapsedSeconds);
+
+	int getLevels() const { return mLevels; }
+	int getTiles(int level) const { return mTiles[level]; }
+	// Airspace units from the edge to tile number `tile` of a level
+	int getTileEdge(int level, int tile) const { return (int)((int64_t)tile * mAirspaceSize / mTiles[level]); }
+	int getAirspaceSize() const { return mAirspaceSize; }
+
+	uint32_t getCount(int level, int x, int y) const { return mCounts[level][x * mTiles[level] + y]; }
+
+private:
+	typedef struct {
+		int x;			// finest level tile, -1 when outside the airspace or not entered yet
+		int y;
+	} track_tile;
+
+	int mAirspaceSize;
+	int mLevels;
+	int mFactor;
+	std::vector<int> mTiles;					// tiles per side, per level
+	std::vector<std::vector<uint32_t> > mCounts;	// per level, index x * tiles + y
+
+	std::vector<track_tile> mSlots;		// by position in the last radar list
+
+	void add(int x, int y, int delta);
+};
+
+#endif /* SRC_DENSITYPYRAMID_H_ */
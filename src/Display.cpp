@@ -1,4 +1,5 @@
 #include <mutex>
+#include <atomic>
 #include <iostream>
 #include <unistd.h>
 #include <ctime>
@@ -8,135 +9,113 @@
 
 #include "Aircraft.h"
 #include "Display.h"
+#include "SimulationClock.h"
+#include "GridRenderer.h"
+#include "RadarPublisher.h"
+#include "OperatorCommand.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "RuntimeConfig.h"
+#include "ResolutionAdvisor.h"
+#include "AlertQueue.h"
 
 extern std::mutex coutMutex;
-extern std::chrono::steady_clock::time_point programStartTime;
+extern RuntimeConfig runtimeConfig;
 
 /* RESPONSIBILITIES
- *  - Listens for radar to tell it to Display::renderGrid() to the console
+ *  - Subscribes to radar updates (keyframe then deltas, see RadarDelta.h) every displayRefreshMs of runtimeConfig,
+ *  	and renders the decoded picture with Display::renderGrid() to the console
  *  - Listens for the ATCSystem to tell it to return Display::buildGrid(), which is a string to save to a file.
+ *  - Both go through GridRenderer, each with its own renderer since they run on different threads.
+ *  - Listens for the CommunicationSystem to zoom or pan the console grid, which is redrawn straight away,
+ *  	or to follow one sector, which the radar listener subscribes to with its next update.
 */
 
-typedef struct {
-	std::vector<Aircraft> aircraftData;
-	bool received;
-} radar_msg;
-
 typedef struct{
 	int aircraft1ID;
 	int aircraft2ID;
 	bool received;
+	int rank;					// 1 is the most urgent alert of the scan
+	int flagged;				// violations in the scan, alerted or not
+	float timeToConflict;		// seconds
+	float severity;				// 0 to 1
+	int zoneID;					// -1, else aircraft1ID flies into this restricted zone
+	int advisoryCount;
+	advisory advisories[ADVISORY_MAX];	// best first
 } violation_msg;
 
-inline int getElapsedTime() {
-    auto now = std::chrono::steady_clock::now();
-    return std::chrono::duration_cast<std::chrono::seconds>(now - programStartTime).count();
-}
+typedef struct {
+	bool received;
+	int zoomLevel;		// -1 leaves the level alone
+	int zoomChange;		// +1 zoom in, -1 zoom out
+	int panX;
+	int panY;
+	int sector;			// VIEW_SECTOR_UNCHANGED, RADAR_ALL_SECTORS or a sector
+} display_view_cmd;
+
+// How far a track may drift from its dead reckoned position before it is redrawn
+#define DISPLAY_MOVE_THRESHOLD 100
+
+// The radar listener draws and the command listener changes the view of the same terminal grid
+static std::mutex terminalGridMutex;
+
+// The sector the radar listener subscribes to, set by the command listener
+static std::atomic<int> viewSector(RADAR_ALL_SECTORS);
 
 
 // Renders Aircraft positions from the list
-void Display::renderGrid(std::vector<Aircraft> aircraftData)
+void Display::renderGrid(const std::vector<Aircraft>& aircraftData)
 {
-//	std::vector<Aircraft>& aircraftData = *givenAircraftData; //deref parameter
-
 	/*
 	 * Actual size is 100,000 by 100,000 (X by Y)
 	 * with 20 row and column size, each cell is 5,000 x 5,000
 	 *
-	 * The grids 0,0 is in the bottom left corner
-	 *
-	 * . is empty, char value quantity of aircraft in the space
-	 * 				^	Because if this, if there are over 9 aircraft in the
-	 * 					5000x5000 square, it will get incremented past the
-	 * 					0 - 9 numerical symbols in ASCII. It doens't break, just
-	 * 					becomes unreadable
+	 * On a terminal only the cells that changed since the last frame are redrawn,
+	 * otherwise (output redirected to a file) the whole grid is written like before.
 	 */
+	static Histogram& renderDuration = metrics().histogram("atc_display_render_seconds", "Updating and writing one console grid frame");
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	TRACE_SCOPE("renderGrid", "render");
 
-	int Size = 100000; // 100000x100000
-	int rowSize = 20, columnSize = 20;
-	int cellSize = Size/rowSize;
-
-	// Create grid and initialize to all .'s
-	char grid[rowSize][columnSize];
-	for (int i = 0; i < rowSize; ++i) {
-	    for (int j = 0; j < columnSize; ++j) {
-	        grid[i][j] = '.';
-	    }
-	}
+	std::lock_guard<std::mutex> lock(terminalGridMutex);
+	terminalGrid.update(aircraftData, getElapsedTime());
+	drawTerminalGrid();
 
-	int xPosInGrid, yPosInGrid;
+	renderDuration.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+}
 
-	// Put aircraf locations into grid
-	for(int i = 0; i < aircraftData.size(); i++){
-		if(aircraftData[i].getEntryTime() <= getElapsedTime()){
-			xPosInGrid = (aircraftData[i].getXPos())/cellSize;
-			yPosInGrid = (aircraftData[i].getYPos())/cellSize;
+// Writes what changed in terminalGrid, caller holds terminalGridMutex
+void Display::drawTerminalGrid()
+{
+	static Counter& frames = metrics().counter("atc_display_frames_total", "Console grid frames written");
+	static Counter& frameBytes = metrics().counter("atc_display_frame_bytes_total", "Bytes of console grid frames written");
 
-			if(grid[xPosInGrid][yPosInGrid] == '.'){
-				grid[xPosInGrid][yPosInGrid] = '1';
-			}else{
-				grid[xPosInGrid][yPosInGrid] = (grid[xPosInGrid][yPosInGrid] + 1);
-			}
-		}
+	size_t length;
+	const char* frame = isatty(STDOUT_FILENO) ? terminalGrid.composeTerminalUpdate(length) : terminalGrid.composeFrame(length);
+	if(length == 0){
+		return;
 	}
+	frames.add();
+	frameBytes.add(length);
 
-	// Render grid to cout
+	// One write for the whole frame, after anything still buffered in cout
 	{
 		std::lock_guard<std::mutex> guard(coutMutex);
-		for (int j = columnSize - 1; j >= 0; --j) {
-			for (int i = 0; i < rowSize; ++i) {
-				std::cout << grid[i][j] << ' ';
-			}
-			std::cout << std::endl;
+		std::cout.flush();
+		if(write(STDOUT_FILENO, frame, length) == -1){
+			perror("Display: Cannot write grid");
 		}
-		std::cout << "\n\n\n" << std::endl;
 	}
-
 }
 
-std::string Display::buildGrid(std::vector<Aircraft> aircraftData)
+std::string Display::buildGrid(const std::vector<Aircraft>& aircraftData)
 {
-    int Size = 100000; // 100000x100000
-    int rowSize = 20, columnSize = 20;
-    int cellSize = Size / rowSize;
-
-    // Initialize grid to all '.'s
-    char grid[rowSize][columnSize];
-    for (int i = 0; i < rowSize; ++i) {
-        for (int j = 0; j < columnSize; ++j) {
-            grid[i][j] = '.';
-        }
-    }
-
-    int xPosInGrid, yPosInGrid;
-
-    // Populate grid with aircraft locations
-    for (int i = 0; i < aircraftData.size(); i++) {
-    	if(aircraftData[i].getEntryTime() <= getElapsedTime()){
-			xPosInGrid = (aircraftData[i].getXPos()) / cellSize;
-			yPosInGrid = (aircraftData[i].getYPos()) / cellSize;
-
-			if (grid[xPosInGrid][yPosInGrid] == '.') {
-				grid[xPosInGrid][yPosInGrid] = '1';
-			} else {
-				grid[xPosInGrid][yPosInGrid] = (grid[xPosInGrid][yPosInGrid] + 1);
-			}
-    	}
-    }
-
-    // Build the grid as a string
-    std::string gridString;
-    for (int j = columnSize - 1; j >= 0; --j) {
-        for (int i = 0; i < rowSize; ++i) {
-            gridString += grid[i][j];
-            gridString += ' ';
-        }
-        gridString += '\n';
-    }
-
-    gridString += "\n\n\n";
-
-    return gridString;
+	TRACE_SCOPE("buildGrid", "render");
+	logGrid.update(aircraftData, getElapsedTime());
+
+	size_t length;
+	const char* frame = logGrid.composeFrame(length);
+	return std::string(frame, length);
 }
 
 void* Display::start(){
@@ -152,6 +131,9 @@ void* Display::start(){
 	pthread_t displayViolationListenerThread;
 	pthread_create(&displayViolationListenerThread, NULL, &Display::startViolationListenerThread, this);
 
+	pthread_t displayCommandListenerThread;
+	pthread_create(&displayCommandListenerThread, NULL, &Display::startCommandListenerThread, this);
+
 	return nullptr;
 }
 
@@ -172,27 +154,59 @@ void* Display::startRadarListener(){
 		perror("name_attach");
 	}
 
+	// How often the grid is redrawn, "setrefresh" changes it
+	int refreshMs = runtimeConfig.get()->displayRefreshMs;
+	int sector = viewSector.load();
+	RadarPublisher::requestSubscription(channelName, refreshMs, DISPLAY_MOVE_THRESHOLD, sector);
+	Trace::setThreadName("Display radar listener");
+
+	static Counter& updatesReceived = metrics().counter("atc_display_radar_updates_total", "Radar updates received by the display");
+	static Counter& resyncs = metrics().counter("atc_display_radar_resyncs_total", "Keyframes the display asked for after missing an update");
+
 	int rcvid;
-	radar_msg msg;
+	struct _msg_info info;
+	std::vector<char> update(64 * 1024);
+	std::vector<Aircraft> picture;
 
-	//used to update display every 5 seconds
-	int requestNumber = 0;
 	while(true){
-		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), NULL);
+		rcvid = MsgReceive(attach->chid, update.data(), update.size(), &info);
 		if (rcvid == -1) {
 			perror("MsgReceive");
+			continue;
 		}
 
-		radar_msg reply;
-		reply.received = true;
+		// Keyframes of a large fleet don't fit, read the rest
+		size_t length = info.msglen;
+		if((size_t)info.srcmsglen > length){
+			update.resize(info.srcmsglen);
+			long status = MsgRead(rcvid, update.data() + length, info.srcmsglen - length, length);
+			if(status > 0){
+				length += status;
+			}
+		}
 
-		int status = MsgReply(rcvid, 0, &reply, sizeof(reply));
+		MsgReply(rcvid, EOK, NULL, 0);
+		updatesReceived.add();
+		TraceScope trace("radar update", "ipc");
+		trace.setArg("bytes", length);
 
-		//render the grid with the data from ATCSystems radar
-		requestNumber++;
-		if(requestNumber % 5 == 0){
-			Display::renderGrid(msg.aircraftData);
+		if(!radarPicture.apply(update.data(), length)){
+			resyncs.add();
+			// Missed an update, ask for a keyframe
+			RadarPublisher::requestSubscription(channelName, refreshMs, DISPLAY_MOVE_THRESHOLD, sector);
+			continue;
+		}
+
+		// Subscribing again changes the period or sector (and the next update is a keyframe)
+		if(runtimeConfig.get()->displayRefreshMs != refreshMs || viewSector.load() != sector){
+			refreshMs = runtimeConfig.get()->displayRefreshMs;
+			sector = viewSector.load();
+			RadarPublisher::requestSubscription(channelName, refreshMs, DISPLAY_MOVE_THRESHOLD, sector);
 		}
+
+		//render the grid with the data from ATCSystems radar
+		radarPicture.snapshot(radarPicture.getTimeMs(), picture);
+		Display::renderGrid(picture);
 	}
 }
 
@@ -207,6 +221,9 @@ void* Display::startViolationListener(){
 		perror("name_attach");
 	}
 
+	static Counter& alertsShown = metrics().counter("atc_display_violation_alerts_total", "Violation alerts shown on the console");
+	Trace::setThreadName("Display violations");
+
 	int rcvid;
 	violation_msg msg;
 
@@ -215,14 +232,40 @@ void* Display::startViolationListener(){
 		if(rcvid == -1) {
 			perror("MsgReceive");
 		}
+		TRACE_SCOPE("violation alert", "ipc");
 
 		{
 			std::lock_guard<std::mutex> guard(coutMutex);
 			std::cout << "+---- Got violation from ATCSystem ----+" << std::endl;
-			std::cout << "|Violation is between flight " << msg.aircraft1ID << " and flight " << msg.aircraft2ID << std::endl;
-			std::cout << "|Enter a command in the operator console to instruct them to change course. " << std::endl;
+			if(msg.zoneID >= 0){
+				std::cout << "|Flight " << msg.aircraft1ID;
+				if(msg.timeToConflict > 0){
+					std::cout << " enters restricted zone " << msg.zoneID << " in " << (int)msg.timeToConflict << " s";
+				}else{
+					std::cout << " is inside restricted zone " << msg.zoneID;
+				}
+				std::cout << std::endl << "|#" << msg.rank << " of " << msg.flagged << ": inside for "
+						<< (int)(msg.severity * 100) << "% of the prediction time" << std::endl;
+			}else{
+				std::cout << "|Violation is between flight " << msg.aircraft1ID << " and flight " << msg.aircraft2ID << std::endl;
+				std::cout << "|#" << msg.rank << " of " << msg.flagged << ": separation lost in " << (int)msg.timeToConflict
+						<< " s, severity " << (int)(msg.severity * 100) << "%" << std::endl;
+			}
+			if(msg.advisoryCount > 0){
+				std::cout << "|Advisories, best first:" << std::endl;
+				for(int a = 0; a < msg.advisoryCount && a < ADVISORY_MAX; a++){
+					std::cout << "|  " << ResolutionAdvisor::command(msg.advisories[a]) << "  (clears it, "
+							<< msg.advisories[a].conflicts << " other conflicts)" << std::endl;
+				}
+			}else{
+				std::cout << "|Enter a command in the operator console to instruct them to change course. " << std::endl;
+			}
+			if(msg.rank == ALERT_TOP_K && msg.flagged > ALERT_TOP_K){
+				std::cout << "|" << msg.flagged - ALERT_TOP_K << " less urgent violations not shown" << std::endl;
+			}
 			std::cout << "+--------------------------------------+" << std::endl;
 		}
+		alertsShown.add();
 
 		violation_msg reply;
 		reply.received = true;
@@ -234,3 +277,56 @@ void* Display::startViolationListener(){
 void* Display::startViolationListenerThread(void* context){
 	return static_cast<Display*>(context)->startViolationListener();
 }
+
+void* Display::startCommandListener(){
+	std::string channelName = "commsys_to_display";
+	name_attach_t *attach = name_attach(NULL, channelName.c_str(), 0);
+	if (attach == NULL){
+		perror("name_attach");
+	}
+
+	int rcvid;
+	display_view_cmd msg;
+
+	while(true){
+		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), NULL);
+		if(rcvid == -1) {
+			perror("MsgReceive");
+			continue;
+		}
+
+		std::string view;
+		bool validLevel = true;
+		{
+			std::lock_guard<std::mutex> lock(terminalGridMutex);
+			if(msg.zoomLevel >= 0){
+				validLevel = terminalGrid.setZoom(msg.zoomLevel);
+			}else if(msg.zoomChange != 0){
+				validLevel = terminalGrid.setZoom(terminalGrid.getZoom() + msg.zoomChange);
+			}
+			terminalGrid.pan(msg.panX, msg.panY);
+			if(msg.sector != VIEW_SECTOR_UNCHANGED){
+				viewSector = msg.sector;
+			}
+			view = terminalGrid.describeView();
+			drawTerminalGrid();
+		}
+
+		// After drawing, so the command's acknowledgement means the operator can see it
+		MsgReply(rcvid, EOK, NULL, 0);
+
+		std::lock_guard<std::mutex> guard(coutMutex);
+		if(!validLevel){
+			std::cout << "Display: No such zoom level" << std::endl;
+		}
+		std::cout << "Display: Showing " << view;
+		if(viewSector.load() != RADAR_ALL_SECTORS){
+			std::cout << ", sector " << viewSector.load() << " from the next update";
+		}
+		std::cout << std::endl;
+	}
+}
+
+void* Display::startCommandListenerThread(void* context){
+	return static_cast<Display*>(context)->startCommandListener();
+}
@@ -4,27 +4,41 @@
 #include <iostream>
 #include <vector>
 #include "Aircraft.h"
+#include "GridRenderer.h"
+#include "RadarDelta.h"
 
 /* Responsible for:
 	- Shows incoming collisions
-	- Simple 2d grid
+	- Simple 2d grid, which can be zoomed and panned
 */
 
 class Display {
 public:
 
 	// Renders Aircraft positions from the list
-    void renderGrid(std::vector<Aircraft> givenAircraftData);
-    std::string buildGrid(std::vector<Aircraft> givenAircraftData);
+    void renderGrid(const std::vector<Aircraft>& givenAircraftData);
+    std::string buildGrid(const std::vector<Aircraft>& givenAircraftData);
 
 
     void* start();
     void* startRadarListener();
     void* startViolationListener();
+    void* startCommandListener();
 
     static void* startThread(void* context);
     static void* startRadarListenerThread(void* context);
     static void* startViolationListenerThread(void* context);
+    static void* startCommandListenerThread(void* context);
+
+private:
+    // Console frames (radar listener thread) and log frames (ATCSystem log timer)
+    GridRenderer terminalGrid;
+    GridRenderer logGrid;
+
+    // What the radar updates have told us so far
+    RadarDeltaDecoder radarPicture;
+
+    void drawTerminalGrid();
 };
 
 
@@ -0,0 +1,148 @@
+#include <mutex>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <sys/dispatch.h>
+
+#include "Fleet.h"
+#include "SimulationClock.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+/* RESPONSIBILITIES
+ *	- The CommunicationSystem sends every changespeed or climb with a selector to FLEET_CHANNEL.
+ *	- The listener thread resolves the selector against the aircraft objects themselves (the
+ *		ids listed, or their current positions), so nothing has to be asked of each aircraft.
+ *	- The change is written to the aircraft the same way their own changespeed listener does,
+ *		and the reply goes back once all of them have it.
+ *	- climb moves an aircraft's altitude straight away, the simulation has no vertical clearance.
+ */
+
+extern std::mutex coutMutex;
+extern RadarBus radarBus;
+
+Fleet::Fleet(std::vector<Aircraft>& iAircraft) :
+	mAircraft(iAircraft)
+{
+	for(size_t i = 0; i < mAircraft.size(); i++){
+		mIndex[mAircraft[i].getId()] = i;
+	}
+}
+
+std::vector<Aircraft*> Fleet::select(int selector, const float bounds[4], const int* ids, int idCount) {
+	std::vector<Aircraft*> selected;
+
+	if(selector == SELECT_IDS){
+		for(int i = 0; i < idCount; i++){
+			std::unordered_map<int, size_t>::iterator found = mIndex.find(ids[i]);
+			if(found != mIndex.end()){
+				selected.push_back(&mAircraft[found->second]);
+			}
+		}
+	}else if(selector == SELECT_CONFLICT){
+		radar_snapshot_ptr snapshot;
+		if(mScans->latest(snapshot)){
+			std::vector<int> conflicted;
+			for(size_t i = 0; i < snapshot->violations.size(); i++){
+				conflicted.push_back(snapshot->violations[i].aircraft1ID);
+				conflicted.push_back(snapshot->violations[i].aircraft2ID);
+			}
+			std::sort(conflicted.begin(), conflicted.end());
+			conflicted.erase(std::unique(conflicted.begin(), conflicted.end()), conflicted.end());
+			return select(SELECT_IDS, bounds, conflicted.data(), conflicted.size());
+		}
+	}else{
+		int now = getElapsedTime();
+		float low0 = std::min(bounds[0], bounds[2]), high0 = std::max(bounds[0], bounds[2]);
+		float low1 = std::min(bounds[1], bounds[3]), high1 = std::max(bounds[1], bounds[3]);
+		float lowZ = std::min(bounds[0], bounds[1]), highZ = std::max(bounds[0], bounds[1]);
+
+		for(size_t i = 0; i < mAircraft.size(); i++){
+			Aircraft& aircraft = mAircraft[i];
+			if(aircraft.getEntryTime() > now){
+				continue;
+			}
+			aircraft_state state = aircraft.getState();
+			bool inside;
+			if(selector == SELECT_BOX){
+				inside = state.x >= low0 && state.x <= high0 && state.y >= low1 && state.y <= high1;
+			}else{
+				inside = state.z >= lowZ && state.z <= highZ;
+			}
+			if(inside){
+				selected.push_back(&aircraft);
+			}
+		}
+	}
+
+	return selected;
+}
+
+void* Fleet::startListener() {
+	name_attach_t *attach = name_attach(NULL, FLEET_CHANNEL, 0);
+	if(attach == NULL){
+		perror("name_attach");
+		return nullptr;
+	}
+
+	// Only the newest scan's conflicts are ever selected
+	mScans = radarBus.subscribe("fleet conflicts", 1, BUS_LATEST);
+	Trace::setThreadName("Fleet");
+
+	static Counter& changed = metrics().counter("atc_fleet_aircraft_changed_total", "Aircraft changed by bulk commands");
+
+	int rcvid;
+	struct _msg_info info;
+	std::vector<char> message(sizeof(fleet_cmd) + 256 * sizeof(int));
+
+	while(true){
+		rcvid = MsgReceive(attach->chid, message.data(), message.size(), &info);
+		if(rcvid == -1){
+			perror("MsgReceive");
+			continue;
+		}
+
+		// A long id list doesn't fit, read the rest
+		size_t length = info.msglen;
+		if((size_t)info.srcmsglen > length){
+			message.resize(info.srcmsglen);
+			long status = MsgRead(rcvid, message.data() + length, info.srcmsglen - length, length);
+			if(status > 0){
+				length += status;
+			}
+		}
+
+		fleet_cmd cmd;
+		if(length < sizeof(cmd)){
+			MsgError(rcvid, EINVAL);
+			continue;
+		}
+		memcpy(&cmd, message.data(), sizeof(cmd));
+		int idCount = std::min(std::max(cmd.idCount, 0), (int)((length - sizeof(cmd)) / sizeof(int)));
+		std::vector<int> ids(idCount);
+		memcpy(ids.data(), message.data() + sizeof(cmd), idCount * sizeof(int));
+
+		TraceScope trace("bulk command", "ipc");
+		std::vector<Aircraft*> selected = select(cmd.selector, cmd.bounds, ids.data(), idCount);
+		for(size_t i = 0; i < selected.size(); i++){
+			if(cmd.action == FLEET_CLIMB){
+				selected[i]->changeAltitude(cmd.values[0]);
+			}else{
+				selected[i]->setSpeed(cmd.values[0], cmd.values[1], cmd.values[2]);
+			}
+		}
+		trace.setArg("aircraft", selected.size());
+		changed.add(selected.size());
+
+		fleet_reply reply;
+		reply.selected = selected.size();
+		MsgReply(rcvid, EOK, &reply, sizeof(reply));
+	}
+
+	return nullptr;
+}
+
+void* Fleet::startListenerThread(void* context) {
+	return static_cast<Fleet*>(context)->startListener();
+}
@@ -0,0 +1,51 @@
+#ifndef SRC_FLEET_H_
+#define SRC_FLEET_H_
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "Aircraft.h"
+#include "OperatorCommand.h"
+#include "RadarBus.h"
+
+/* Responsible for:
+	- Bulk operator commands: picks every aircraft a selector matches (ids, box, altitude band or
+		active conflict) and applies the change to all of them, for one message and one reply
+		however many aircraft it touches.
+ */
+
+#define FLEET_CHANNEL "commsys_to_fleet"
+
+// Sent to FLEET_CHANNEL, followed by idCount ints for SELECT_IDS
+typedef struct {
+	int action;			// fleet_action
+	float values[3];	// speed x y z for FLEET_CHANGE_SPEED, feet in values[0] for FLEET_CLIMB
+	int selector;		// selector_type
+	float bounds[4];
+	int idCount;
+} fleet_cmd;
+
+// Reply: how many aircraft the selector matched, all of which were changed
+typedef struct {
+	int selected;
+} fleet_reply;
+
+class Fleet {
+public:
+	// The aircraft list of startSystem() (or a replay), whose aircraft the commands change
+	Fleet(std::vector<Aircraft>& iAircraft);
+
+	// Aircraft the selector picks, from their current positions. Box, band and conflict only
+	// pick aircraft that have entered the airspace.
+	std::vector<Aircraft*> select(int selector, const float bounds[4], const int* ids, int idCount);
+
+	void* startListener();
+	static void* startListenerThread(void* context);
+
+private:
+	std::vector<Aircraft>& mAircraft;
+	std::unordered_map<int, size_t> mIndex;		// id to position in mAircraft
+	std::shared_ptr<RadarSubscription> mScans;	// for the violations of the newest scan
+};
+
+#endif /* SRC_FLEET_H_ */
@@ -0,0 +1,119 @@
+#include <cmath>
+
+#include "FlightPlan.h"
+
+/* RESPONSIBILITIES
+ *	- Main.cpp owns the one FlightPlans of the process, flightPlans. Scenarios fill it when they are
+ *		parsed, "route" changes it (see CommunicationSystem.cpp).
+ *	- Aircraft::advance() looks its plan up every second and flies it with FlightPlans::fly().
+ *	- ATCSystem::checkViolations() reads it once per scan and predicts the planned aircraft with a
+ *		TrajectoryCache.
+ *	- Like the runtime config, every table stays alive: routes are operator commands.
+ */
+
+FlightPlans::FlightPlans() {
+	flight_plan_table* empty = new flight_plan_table();
+	empty->version = 1;
+
+	mVersions.push_back(std::unique_ptr<flight_plan_table>(empty));
+	mCurrent.store(empty, std::memory_order_release);
+}
+
+const flight_plan* FlightPlans::find(const flight_plan_table* table, int id) {
+	if(table->plans.empty()){
+		return nullptr;
+	}
+	std::unordered_map<int, flight_plan>::const_iterator found = table->plans.find(id);
+	return found == table->plans.end() ? nullptr : &found->second;
+}
+
+const flight_plan_table* FlightPlans::publish(flight_plan_table* next) {
+	mVersions.push_back(std::unique_ptr<flight_plan_table>(next));
+	mCurrent.store(next, std::memory_order_release);
+	return next;
+}
+
+const flight_plan_table* FlightPlans::set(const std::vector<int>& ids, const std::vector<waypoint>& route) {
+	std::lock_guard<std::mutex> lock(mUpdateMutex);
+
+	flight_plan_table* next = new flight_plan_table(*mCurrent.load(std::memory_order_relaxed));
+	next->version++;
+	for(size_t i = 0; i < ids.size(); i++){
+		if(route.empty()){
+			next->plans.erase(ids[i]);
+		}else{
+			flight_plan& plan = next->plans[ids[i]];
+			plan.version = next->version;
+			plan.waypoints = route;
+		}
+	}
+	return publish(next);
+}
+
+const flight_plan_table* FlightPlans::replace(const std::unordered_map<int, std::vector<waypoint> >& routes) {
+	std::lock_guard<std::mutex> lock(mUpdateMutex);
+
+	flight_plan_table* next = new flight_plan_table();
+	next->version = mCurrent.load(std::memory_order_relaxed)->version + 1;
+	for(std::unordered_map<int, std::vector<waypoint> >::const_iterator r = routes.begin(); r != routes.end(); ++r){
+		if(!r->second.empty()){
+			flight_plan& plan = next->plans[r->first];
+			plan.version = next->version;
+			plan.waypoints = r->second;
+		}
+	}
+	return publish(next);
+}
+
+void FlightPlans::fly(aircraft_state& s, plan_progress& progress, const flight_plan* plan) {
+	if(plan != nullptr && progress.planVersion != plan->version){
+		progress.planVersion = plan->version;
+		progress.leg = 0;
+	}
+	if(plan == nullptr || progress.leg >= (int)plan->waypoints.size()){
+		s.x += s.speedX;
+		s.y += s.speedY;
+		s.z += s.speedZ;
+		return;
+	}
+
+	float speed = std::sqrt(s.speedX * s.speedX + s.speedY * s.speedY + s.speedZ * s.speedZ);
+	if(speed == 0){
+		return;
+	}
+
+	// A second's worth of distance, around as many waypoints as it takes
+	float dirX = s.speedX / speed, dirY = s.speedY / speed, dirZ = s.speedZ / speed;
+	float remaining = speed;
+	while(progress.leg < (int)plan->waypoints.size()){
+		const waypoint& next = plan->waypoints[progress.leg];
+		float dx = next.x - s.x, dy = next.y - s.y, dz = next.z - s.z;
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		if(distance > 0){
+			dirX = dx / distance;
+			dirY = dy / distance;
+			dirZ = dz / distance;
+		}
+		if(distance > remaining){
+			s.x += dirX * remaining;
+			s.y += dirY * remaining;
+			s.z += dirZ * remaining;
+			remaining = 0;
+			break;
+		}
+		s.x = next.x;
+		s.y = next.y;
+		s.z = next.z;
+		remaining -= distance;
+		progress.leg++;
+	}
+
+	// Past the last waypoint, the way it arrived
+	s.x += dirX * remaining;
+	s.y += dirY * remaining;
+	s.z += dirZ * remaining;
+
+	s.speedX = dirX * speed;
+	s.speedY = dirY * speed;
+	s.speedZ = dirZ * speed;
+}
@@ -0,0 +1,70 @@
+#ifndef SRC_FLIGHTPLAN_H_
+#define SRC_FLIGHTPLAN_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "Aircraft.h"
+
+/* Responsible for:
+	- Waypoint flight plans: an aircraft with one flies straight at each waypoint in turn, at the
+		speed it has, and after the last one carries on the way it arrived.
+	- The plans of the process, published like the runtime config: readers get a consistent table
+		with one atomic load, and never block the routes being set.
+ */
+
+/*	A plan belongs to an aircraft id, not to an Aircraft object: the radar makes a new Aircraft from
+ * 	every reply, and a route command doesn't have to reach the aircraft's thread. The aircraft keeps
+ * 	its progress (plan_progress, see Aircraft.h) with its position, so one read gives both, and
+ * 	progress made on an older plan starts the new plan from its first waypoint.
+ *
+ * 	The speed of a planned aircraft is the length of its speed vector; every second it is pointed
+ * 	at the next waypoint. "changespeed" changes the speed it flies its plan at.
+ */
+
+typedef struct {
+	float x, y, z;
+} waypoint;
+
+typedef struct {
+	uint32_t version;					// the table version that set it, so a new plan is always told apart
+	std::vector<waypoint> waypoints;
+} flight_plan;
+
+typedef struct {
+	uint32_t version;
+	std::unordered_map<int, flight_plan> plans;		// by aircraft id
+} flight_plan_table;
+
+class FlightPlans {
+public:
+	FlightPlans();
+
+	// One acquire load, never blocks. A table is never changed or freed once published.
+	const flight_plan_table* get() const { return mCurrent.load(std::memory_order_acquire); }
+
+	// The plan of an aircraft, nullptr if it has none
+	static const flight_plan* find(const flight_plan_table* table, int id);
+
+	// Gives every aircraft of ids the route, an empty route takes their plan away
+	const flight_plan_table* set(const std::vector<int>& ids, const std::vector<waypoint>& route);
+
+	// Replaces every plan, with those of a scenario
+	const flight_plan_table* replace(const std::unordered_map<int, std::vector<waypoint> >& routes);
+
+	// One second of flight of state along plan from progress, straight on without a plan or past
+	// its last waypoint
+	static void fly(aircraft_state& state, plan_progress& progress, const flight_plan* plan);
+
+private:
+	std::atomic<const flight_plan_table*> mCurrent;
+	std::mutex mUpdateMutex;
+	std::vector<std::unique_ptr<flight_plan_table> > mVersions;
+
+	const flight_plan_table* publish(flight_plan_table* next);
+};
+
+#endif /* SRC_FLIGHTPLAN_H_ */
@@ -0,0 +1,270 @@
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <algorithm>
+
+#include "GridRenderer.h"
+#include "CommunicationSystem.h"
+
+/* RESPONSIBILITIES
+ *	- Display::renderGrid() calls update() and composeTerminalUpdate() (or composeFrame() when the
+ *		output is not a terminal) for every rendered radar message.
+ *	- Display::buildGrid() calls update() and composeFrame() for the 30 second display log.
+ *	- Display's command listener calls setZoom() and pan() for the zoom and pan console commands.
+ *		These only read the newly visible tiles, so the view can be redrawn without new radar data.
+ *	- The time check for entered aircraft is done once per frame, not once per aircraft.
+ *	- Aircraft outside the airspace are not counted (they used to be written outside the grid).
+ */
+
+// Fixed text around the terminal grid
+static const char CLEAR_SCREEN[] = "\x1b[2J";
+static const char SAVE_CURSOR[] = "\x1b" "7";
+static const char RESTORE_CURSOR[] = "\x1b" "8";
+
+GridRenderer::GridRenderer(int iAirspaceSize, int iCells) :
+	mAirspaceSize(iAirspaceSize), mCells(iCells), mPyramid(iAirspaceSize, iCells),
+	mLevel(0), mOriginX(0), mOriginY(0), mCounts(iCells * iCells, 0), mShown(iCells * iCells, 0), mTerminalDrawn(false), mChangedCells(0)
+{
+	// A cursor move is at most "\x1b[rrrr;ccccH", 12 bytes, plus the cell character
+	size_t fullFrame = (size_t)mCells * (mCells * 2 + 1) + 8;
+	size_t terminalFrame = (size_t)mCells * mCells * 16 + 64;
+	mBuffer.resize(fullFrame > terminalFrame ? fullFrame : terminalFrame);
+}
+
+char GridRenderer::cellChar(uint32_t count) {
+	if(count == 0){
+		return '.';
+	}
+	return count > 9 ? '+' : (char)('0' + count);
+}
+
+char* GridRenderer::appendCursorMove(char* cursor, int row, int column) {
+	// 1 based, row 1 is the top line
+	return cursor + sprintf(cursor, "\x1b[%d;%dH", row + 1, column + 1);
+}
+
+void GridRenderer::update(const std::vector<Aircraft>& aircraftData, int elapsedSeconds) {
+	mPyramid.update(aircraftData, elapsedSeconds);
+	readView();
+}
+
+void GridRenderer::readView() {
+	for(int x = 0; x < mCells; ++x){
+		for(int y = 0; y < mCells; ++y){
+			mCounts[x * mCells + y] = mPyramid.getCount(mLevel, mOriginX + x, mOriginY + y);
+		}
+	}
+}
+
+bool GridRenderer::setZoom(int level) {
+	if(level < 0 || level >= mPyramid.getLevels()){
+		return false;
+	}
+
+	// Centre of the view as a fraction of the airspace, then the same centre at the new level
+	double centreX = (mOriginX + mCells / 2.0) / mPyramid.getTiles(mLevel);
+	double centreY = (mOriginY + mCells / 2.0) / mPyramid.getTiles(mLevel);
+
+	mLevel = level;
+	mOriginX = (int)(centreX * mPyramid.getTiles(mLevel)) - mCells / 2;
+	mOriginY = (int)(centreY * mPyramid.getTiles(mLevel)) - mCells / 2;
+	pan(0, 0);
+	return true;
+}
+
+void GridRenderer::pan(int dx, int dy) {
+	int maxOrigin = mPyramid.getTiles(mLevel) - mCells;
+	mOriginX = std::min(std::max(mOriginX + dx, 0), maxOrigin);
+	mOriginY = std::min(std::max(mOriginY + dy, 0), maxOrigin);
+	readView();
+}
+
+std::string GridRenderer::describeView() const {
+	return "zoom " + std::to_string(mLevel)
+		+ ", x " + std::to_string(mPyramid.getTileEdge(mLevel, mOriginX)) + " to " + std::to_string(mPyramid.getTileEdge(mLevel, mOriginX + mCells))
+		+ ", y " + std::to_string(mPyramid.getTileEdge(mLevel, mOriginY)) + " to " + std::to_string(mPyramid.getTileEdge(mLevel, mOriginY + mCells));
+}
+
+const char* GridRenderer::composeFrame(size_t& length) {
+	char* cursor = mBuffer.data();
+	for(int y = mCells - 1; y >= 0; --y){
+		for(int x = 0; x < mCells; ++x){
+			*cursor++ = cellChar(mCounts[x * mCells + y]);
+			*cursor++ = ' ';
+		}
+		*cursor++ = '\n';
+	}
+	memcpy(cursor, "\n\n\n", 3);
+	cursor += 3;
+
+	length = cursor - mBuffer.data();
+	return mBuffer.data();
+}
+
+const char* GridRenderer::composeTerminalUpdate(size_t& length) {
+	char* cursor = mBuffer.data();
+	mChangedCells = 0;
+
+	memcpy(cursor, SAVE_CURSOR, sizeof(SAVE_CURSOR) - 1);
+	cursor += sizeof(SAVE_CURSOR) - 1;
+
+	if(!mTerminalDrawn){
+		// Grid on lines 1..mCells, a blank line, everything else scrolls below it
+		memcpy(cursor, CLEAR_SCREEN, sizeof(CLEAR_SCREEN) - 1);
+		cursor += sizeof(CLEAR_SCREEN) - 1;
+		cursor += sprintf(cursor, "\x1b[%d;r", mCells + 2);
+
+		for(int row = 0; row < mCells; ++row){
+			cursor = appendCursorMove(cursor, row, 0);
+			int y = mCells - 1 - row;
+			for(int x = 0; x < mCells; ++x){
+				*cursor++ = cellChar(mCounts[x * mCells + y]);
+				*cursor++ = ' ';
+			}
+		}
+		mShown = mCounts;
+		mChangedCells = mCells * mCells;
+		mTerminalDrawn = true;
+
+		// Park the cursor in the scrolling part instead of restoring it into the grid
+		cursor = appendCursorMove(cursor, mCells + 1, 0);
+	}else{
+		for(int x = 0; x < mCells; ++x){
+			for(int y = 0; y < mCells; ++y){
+				int cell = x * mCells + y;
+				if(mCounts[cell] == mShown[cell]){
+					continue;
+				}
+
+				cursor = appendCursorMove(cursor, mCells - 1 - y, x * 2);
+				*cursor++ = cellChar(mCounts[cell]);
+				mShown[cell] = mCounts[cell];
+				mChangedCells++;
+			}
+		}
+
+		// Nothing changed, nothing to write
+		if(mChangedCells == 0){
+			length = 0;
+			return mBuffer.data();
+		}
+
+		memcpy(cursor, RESTORE_CURSOR, sizeof(RESTORE_CURSOR) - 1);
+		cursor += sizeof(RESTORE_CURSOR) - 1;
+	}
+
+	length = cursor - mBuffer.data();
+	return mBuffer.data();
+}
+
+// The display before the shared renderer: copy of the list, full rebuild, one character at a time
+static size_t legacyFrame(std::vector<Aircraft> aircraftData, int elapsedSeconds, std::ostream& out) {
+	int Size = 100000;
+	int rowSize = 20, columnSize = 20;
+	int cellSize = Size/rowSize;
+
+	char grid[20][20];
+	for (int i = 0; i < rowSize; ++i) {
+		for (int j = 0; j < columnSize; ++j) {
+			grid[i][j] = '.';
+		}
+	}
+
+	for(size_t i = 0; i < aircraftData.size(); i++){
+		if(aircraftData[i].getEntryTime() <= elapsedSeconds){
+			int xPosInGrid = (aircraftData[i].getXPos())/cellSize;
+			int yPosInGrid = (aircraftData[i].getYPos())/cellSize;
+			if(xPosInGrid < 0 || yPosInGrid < 0 || xPosInGrid >= rowSize || yPosInGrid >= columnSize){
+				continue;
+			}
+			grid[xPosInGrid][yPosInGrid] = (grid[xPosInGrid][yPosInGrid] == '.') ? '1' : grid[xPosInGrid][yPosInGrid] + 1;
+		}
+	}
+
+	size_t bytes = 0;
+	for (int j = columnSize - 1; j >= 0; --j) {
+		for (int i = 0; i < rowSize; ++i) {
+			out << grid[i][j] << ' ';
+			bytes += 2;
+		}
+		out << std::endl;
+		bytes++;
+	}
+	out << "\n\n\n" << std::endl;
+	return bytes + 4;
+}
+
+int GridRenderer::benchmark(int maxAircraft, std::ostream& out) {
+	const int frames = 200;
+	CommunicationSystem commSystem;
+
+	out << "+-------------+ Display frame benchmark (" << frames << " frames each) +-------------+" << std::endl;
+	out << "| aircraft | old frame us | new log frame us | new terminal update us | terminal bytes/frame | cells changed/frame | zoomed view us" << std::endl;
+
+	for(int count = 10; count <= maxAircraft; count *= 10){
+		std::vector<Aircraft> aircraftData;
+		for(int i = 0; i < count; i++){
+			aircraftData.push_back(Aircraft(0, i, (i * 7919) % 100000, (i * 104729) % 100000, 10000,
+					(i % 9) * 20 - 80, (i % 7) * 20 - 60, 0, commSystem));
+		}
+
+		// Stand in for the console: a stream that is never shown
+		std::ostringstream sink;
+		GridRenderer logRenderer;
+		GridRenderer terminalRenderer;
+		double oldSeconds = 0, logSeconds = 0, terminalSeconds = 0, zoomSeconds = 0;
+		size_t terminalBytes = 0;
+		long changedCells = 0;
+
+		for(int f = 0; f < frames; f++){
+			for(int i = 0; i < count; i++){
+				Aircraft& aircraft = aircraftData[i];
+				float x = aircraft.getXPos() + aircraft.getXSpeed();
+				float y = aircraft.getYPos() + aircraft.getYSpeed();
+				aircraft.setXPos(x < 0 ? x + 100000 : (x >= 100000 ? x - 100000 : x));
+				aircraft.setYPos(y < 0 ? y + 100000 : (y >= 100000 ? y - 100000 : y));
+			}
+
+			auto begin = std::chrono::steady_clock::now();
+			legacyFrame(aircraftData, f, sink);
+			auto end = std::chrono::steady_clock::now();
+			oldSeconds += std::chrono::duration<double>(end - begin).count();
+			sink.str("");
+
+			size_t length;
+			begin = std::chrono::steady_clock::now();
+			logRenderer.update(aircraftData, f);
+			logRenderer.composeFrame(length);
+			end = std::chrono::steady_clock::now();
+			logSeconds += std::chrono::duration<double>(end - begin).count();
+
+			begin = std::chrono::steady_clock::now();
+			terminalRenderer.update(aircraftData, f);
+			terminalRenderer.composeTerminalUpdate(length);
+			end = std::chrono::steady_clock::now();
+			if(f > 0){
+				terminalSeconds += std::chrono::duration<double>(end - begin).count();
+				terminalBytes += length;
+				changedCells += terminalRenderer.getChangedCells();
+			}
+
+			// Reading a view at the finest level, without the pyramid update
+			begin = std::chrono::steady_clock::now();
+			logRenderer.setZoom(2);
+			logRenderer.pan(f % 7, f % 5);
+			logRenderer.composeFrame(length);
+			end = std::chrono::steady_clock::now();
+			zoomSeconds += std::chrono::duration<double>(end - begin).count();
+			logRenderer.setZoom(0);
+		}
+
+		out << "| " << count << " | " << oldSeconds * 1e6 / frames << " | " << logSeconds * 1e6 / frames
+			<< " | " << terminalSeconds * 1e6 / (frames - 1) << " | " << terminalBytes / (frames - 1)
+			<< " | " << (double)changedCells / (frames - 1) << " | " << zoomSeconds * 1e6 / frames << std::endl;
+	}
+
+	out << "+-------------+ Display frame benchmark end +-------------+" << std::endl;
+	return 0;
+}
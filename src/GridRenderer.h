@@ -0,0 +1,80 @@
+#ifndef SRC_GRIDRENDERER_H_
+#define SRC_GRIDRENDERER_H_
+
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+#include <string>
+#include "Aircraft.h"
+#include "DensityPyramid.h"
+
+/* Responsible for:
+	- The 2d airspace grid shared by the console display and the display log.
+	- A view of mCells x mCells tiles into a DensityPyramid, which can be zoomed and panned.
+	- Composing the frame into a preallocated buffer, so a frame is emitted with a single write().
+	- For the terminal, remembering what is on screen and only emitting the cells that changed.
+ */
+
+/*
+ * The grid's 0,0 is in the bottom left corner. A cell shows '.' when empty, the number of aircraft
+ * in it up to 9, and '+' for more than 9.
+ *
+ * Zoom 0 shows the whole airspace. Each zoom level shows a quarter of the width of the one before,
+ * and the view can be panned by whole tiles as long as it stays inside the airspace.
+ *
+ * Terminal mode draws the grid at the top of the screen and limits scrolling to the lines below it
+ * (ANSI scroll region), so console output scrolls underneath without disturbing the grid. Each
+ * update saves the cursor, moves to every changed cell, and restores the cursor.
+ */
+
+class GridRenderer {
+public:
+	GridRenderer(int iAirspaceSize = 100000, int iCells = 20);
+
+	// Updates the pyramid with the aircraft that have entered the airspace by elapsedSeconds
+	// and reads the visible tiles into the cells
+	void update(const std::vector<Aircraft>& aircraftData, int elapsedSeconds);
+
+	// Changes the view, keeping its centre where possible. Returns false if the level doesn't exist.
+	bool setZoom(int level);
+	// Moves the view by dx, dy tiles of the current level, up to the edge of the airspace
+	void pan(int dx, int dy);
+	int getZoom() const { return mLevel; }
+	// "zoom 1, x 25000 to 50000, y 0 to 25000"
+	std::string describeView() const;
+
+	// The whole grid as text, the format of displaylog.txt
+	const char* composeFrame(size_t& length);
+
+	// Escape sequences bringing the terminal from the last update to this frame (everything the first time)
+	const char* composeTerminalUpdate(size_t& length);
+
+	// Cells emitted by the last composeTerminalUpdate()
+	int getChangedCells() const { return mChangedCells; }
+
+	// Cost of a frame against aircraft count, incremental against the old full rebuild
+	static int benchmark(int maxAircraft, std::ostream& out);
+
+private:
+	int mAirspaceSize;
+	int mCells;
+
+	DensityPyramid mPyramid;
+	int mLevel;
+	int mOriginX;	// bottom left tile of the view, in tiles of mLevel
+	int mOriginY;
+
+	std::vector<uint32_t> mCounts;	// this frame, index x * mCells + y
+	std::vector<uint32_t> mShown;	// what the terminal shows
+	bool mTerminalDrawn;
+	int mChangedCells;
+
+	// Big enough for a full redraw, allocated once
+	std::vector<char> mBuffer;
+
+	static char cellChar(uint32_t count);
+	void readView();
+	char* appendCursorMove(char* cursor, int row, int column);
+};
+
+#endif /* SRC_GRIDRENDERER_H_ */
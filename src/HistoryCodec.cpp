@@ -0,0 +1,438 @@
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#include "HistoryCodec.h"
+
+/* RESPONSIBILITIES
+ *	- HistoryEncoder turns history frames (see HistoryRecorder.h) into the compressed format
+ *		described in HistoryCodec.h, HistoryDecoder turns them back.
+ *	- Both sides keep the same per track state (last position, last delta, last speed), so
+ *		a stream must be decoded from the frame after the last reset().
+ *	- "Main --bench-codec" compares it to the raw format.
+ */
+
+// Exception flags of a record
+const uint8_t CODEC_NEW_TRACK = 1;
+const uint8_t CODEC_SPEED_CHANGED = 2;
+const uint8_t CODEC_MOVE_CHANGED = 4;
+
+static inline uint64_t zigzag(int64_t value) {
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value) {
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static inline void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+	while(value >= 0x80){
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static inline bool getVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value) {
+	value = 0;
+	for(int shift = 0; shift < 64; shift += 7){
+		if(cursor == end){
+			return false;
+		}
+		uint8_t byte = *cursor++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if((byte & 0x80) == 0){
+			return true;
+		}
+	}
+	return false;
+}
+
+static inline int64_t quantize(float value) {
+	return llround((double)value * HISTORY_CODEC_SCALE);
+}
+
+static inline float unquantize(int64_t value) {
+	return (float)((double)value / HISTORY_CODEC_SCALE);
+}
+
+// Exception list: count, then the run of records without the flag before each flagged one
+static void putExceptions(std::vector<uint8_t>& out, const std::vector<int32_t>& indices) {
+	putVarint(out, indices.size());
+	int32_t previous = -1;
+	for(size_t i = 0; i < indices.size(); i++){
+		putVarint(out, indices[i] - previous - 1);
+		previous = indices[i];
+	}
+}
+
+static bool getExceptions(const uint8_t*& cursor, const uint8_t* end, std::vector<uint8_t>& flags, uint8_t flag) {
+	uint64_t k, run;
+	if(!getVarint(cursor, end, k) || k > flags.size()){
+		return false;
+	}
+
+	uint64_t index = 0;
+	for(uint64_t i = 0; i < k; i++){
+		if(!getVarint(cursor, end, run) || index + run >= flags.size()){
+			return false;
+		}
+		index += run;
+		flags[index] |= flag;
+		index++;
+	}
+	return true;
+}
+
+HistoryEncoder::HistoryEncoder() : mPreviousTimeMs(0), mPreviousTimeDelta(0) {
+
+}
+
+void HistoryEncoder::reset() {
+	mTracks.clear();
+	mPreviousIds.clear();
+	mPreviousTimeMs = 0;
+	mPreviousTimeDelta = 0;
+}
+
+void HistoryEncoder::encodeFrame(int64_t timeMs, const history_track_record* records, uint32_t count, std::vector<uint8_t>& out) {
+	int64_t timeDelta = timeMs - mPreviousTimeMs;
+	putVarint(out, zigzag(timeDelta - mPreviousTimeDelta));
+	mPreviousTimeMs = timeMs;
+	mPreviousTimeDelta = timeDelta;
+
+	putVarint(out, count);
+
+	bool sameIds = (count == mPreviousIds.size());
+	for(uint32_t i = 0; sameIds && i < count; i++){
+		sameIds = (records[i].id == mPreviousIds[i]);
+	}
+
+	if(sameIds){
+		out.push_back(0);
+	}else{
+		out.push_back(1);
+		int32_t previousId = 0;
+		mPreviousIds.resize(count);
+		for(uint32_t i = 0; i < count; i++){
+			putVarint(out, zigzag((int64_t)records[i].id - previousId));
+			previousId = records[i].id;
+			mPreviousIds[i] = records[i].id;
+		}
+
+		// Only keep the tracks that are still there
+		std::unordered_map<int32_t, TrackState> kept;
+		kept.reserve(count);
+		for(uint32_t i = 0; i < count; i++){
+			std::unordered_map<int32_t, TrackState>::iterator it = mTracks.find(records[i].id);
+			if(it != mTracks.end()){
+				kept[records[i].id] = it->second;
+			}
+		}
+		mTracks.swap(kept);
+	}
+
+	mNewTracks.clear();
+	mSpeedChanges.clear();
+	mMoveChanges.clear();
+	mFlags.assign(count, 0);
+	mPayload.resize((size_t)count * 6);
+
+	for(uint32_t i = 0; i < count; i++){
+		const history_track_record& record = records[i];
+		int64_t position[3] = { quantize(record.x), quantize(record.y), quantize(record.z) };
+		int64_t speed[3] = { quantize(record.speedX), quantize(record.speedY), quantize(record.speedZ) };
+		int64_t* payload = &mPayload[(size_t)i * 6];
+
+		std::unordered_map<int32_t, TrackState>::iterator it = mTracks.find(record.id);
+		if(it == mTracks.end()){
+			TrackState& state = mTracks[record.id];
+			for(int a = 0; a < 3; a++){
+				state.position[a] = position[a];
+				state.delta[a] = 0;
+				state.speed[a] = speed[a];
+				payload[a] = position[a];
+				payload[3 + a] = speed[a];
+			}
+			mFlags[i] = CODEC_NEW_TRACK;
+			mNewTracks.push_back(i);
+			continue;
+		}
+
+		TrackState& state = it->second;
+		bool speedChanged = false, moveChanged = false;
+		for(int a = 0; a < 3; a++){
+			int64_t delta = position[a] - state.position[a];
+			payload[a] = speed[a] - state.speed[a];
+			payload[3 + a] = delta - state.delta[a];
+			speedChanged |= (payload[a] != 0);
+			moveChanged |= (payload[3 + a] != 0);
+
+			state.position[a] = position[a];
+			state.delta[a] = delta;
+			state.speed[a] = speed[a];
+		}
+
+		if(speedChanged){
+			mFlags[i] |= CODEC_SPEED_CHANGED;
+			mSpeedChanges.push_back(i);
+		}
+		if(moveChanged){
+			mFlags[i] |= CODEC_MOVE_CHANGED;
+			mMoveChanges.push_back(i);
+		}
+	}
+
+	putExceptions(out, mNewTracks);
+	putExceptions(out, mSpeedChanges);
+	putExceptions(out, mMoveChanges);
+
+	for(uint32_t i = 0; i < count; i++){
+		const int64_t* payload = &mPayload[(size_t)i * 6];
+		if(mFlags[i] & CODEC_NEW_TRACK){
+			for(int v = 0; v < 6; v++){
+				putVarint(out, zigzag(payload[v]));
+			}
+			continue;
+		}
+		if(mFlags[i] & CODEC_SPEED_CHANGED){
+			for(int a = 0; a < 3; a++){
+				putVarint(out, zigzag(payload[a]));
+			}
+		}
+		if(mFlags[i] & CODEC_MOVE_CHANGED){
+			for(int a = 0; a < 3; a++){
+				putVarint(out, zigzag(payload[3 + a]));
+			}
+		}
+	}
+}
+
+HistoryDecoder::HistoryDecoder() : mPreviousTimeMs(0), mPreviousTimeDelta(0) {
+
+}
+
+void HistoryDecoder::reset() {
+	mTracks.clear();
+	mPreviousIds.clear();
+	mPreviousTimeMs = 0;
+	mPreviousTimeDelta = 0;
+}
+
+bool HistoryDecoder::decodeFrame(const uint8_t*& cursor, const uint8_t* end, int64_t& timeMs, std::vector<history_track_record>& records) {
+	uint64_t value, count;
+	if(!getVarint(cursor, end, value) || !getVarint(cursor, end, count) || cursor == end){
+		return false;
+	}
+
+	mPreviousTimeDelta += unzigzag(value);
+	mPreviousTimeMs += mPreviousTimeDelta;
+	timeMs = mPreviousTimeMs;
+
+	uint8_t idMode = *cursor++;
+	if(idMode == 0){
+		if(count != mPreviousIds.size()){
+			return false;
+		}
+	}else{
+		// Every id takes at least a byte, a corrupt count must not size the arrays
+		if(count > (uint64_t)(end - cursor)){
+			return false;
+		}
+		int64_t previousId = 0;
+		mPreviousIds.resize(count);
+		for(uint64_t i = 0; i < count; i++){
+			if(!getVarint(cursor, end, value)){
+				return false;
+			}
+			previousId += unzigzag(value);
+			mPreviousIds[i] = (int32_t)previousId;
+		}
+
+		std::unordered_map<int32_t, TrackState> kept;
+		kept.reserve(count);
+		for(uint64_t i = 0; i < count; i++){
+			std::unordered_map<int32_t, TrackState>::iterator it = mTracks.find(mPreviousIds[i]);
+			if(it != mTracks.end()){
+				kept[mPreviousIds[i]] = it->second;
+			}
+		}
+		mTracks.swap(kept);
+	}
+
+	// count is now the size of mPreviousIds, checked against the stream or the last frame
+	mFlags.assign(count, 0);
+	if(!getExceptions(cursor, end, mFlags, CODEC_NEW_TRACK)
+			|| !getExceptions(cursor, end, mFlags, CODEC_SPEED_CHANGED)
+			|| !getExceptions(cursor, end, mFlags, CODEC_MOVE_CHANGED)){
+		return false;
+	}
+
+	records.resize(count);
+	for(uint64_t i = 0; i < count; i++){
+		int32_t id = mPreviousIds[i];
+		TrackState* state;
+
+		if(mFlags[i] & CODEC_NEW_TRACK){
+			state = &mTracks[id];
+			for(int v = 0; v < 6; v++){
+				if(!getVarint(cursor, end, value)){
+					return false;
+				}
+				if(v < 3){
+					state->position[v] = unzigzag(value);
+					state->delta[v] = 0;
+				}else{
+					state->speed[v - 3] = unzigzag(value);
+				}
+			}
+		}else{
+			std::unordered_map<int32_t, TrackState>::iterator it = mTracks.find(id);
+			if(it == mTracks.end()){
+				return false;
+			}
+			state = &it->second;
+
+			if(mFlags[i] & CODEC_SPEED_CHANGED){
+				for(int a = 0; a < 3; a++){
+					if(!getVarint(cursor, end, value)){
+						return false;
+					}
+					state->speed[a] += unzigzag(value);
+				}
+			}
+
+			for(int a = 0; a < 3; a++){
+				if(mFlags[i] & CODEC_MOVE_CHANGED){
+					if(!getVarint(cursor, end, value)){
+						return false;
+					}
+					state->delta[a] += unzigzag(value);
+				}
+				state->position[a] += state->delta[a];
+			}
+		}
+
+		history_track_record& record = records[i];
+		record.id = id;
+		record.x = unquantize(state->position[0]);
+		record.y = unquantize(state->position[1]);
+		record.z = unquantize(state->position[2]);
+		record.speedX = unquantize(state->speed[0]);
+		record.speedY = unquantize(state->speed[1]);
+		record.speedZ = unquantize(state->speed[2]);
+	}
+
+	return true;
+}
+
+int HistoryEncoder::benchmark(int aircraftCount, int frames, std::ostream& out) {
+	// Synthetic scans in the raw history format: constant velocity, 1% of the aircraft change
+	// speed every scan and 0.1% leave and are replaced by a new id
+	std::vector<uint8_t> raw;
+	std::vector<history_track_record> fleet(aircraftCount);
+	int nextId = 1000;
+	for(int i = 0; i < aircraftCount; i++){
+		history_track_record& track = fleet[i];
+		track.id = nextId++;
+		track.x = (i * 37) % 100000;
+		track.y = (i * 91) % 100000;
+		track.z = 10000 + (i % 20) * 500;
+		track.speedX = 250 - (i % 7) * 40;
+		track.speedY = -20 + (i % 5) * 30;
+		track.speedZ = (i % 3) - 1;
+	}
+
+	unsigned int seed = 12345;
+	for(int f = 0; f < frames; f++){
+		for(int i = 0; i < aircraftCount; i++){
+			history_track_record& track = fleet[i];
+			seed = seed * 1103515245 + 12345;
+			int dice = (seed >> 8) % 1000;
+			if(dice < 10){
+				track.speedX += (dice % 3) * 10 - 10;
+				track.speedZ = -track.speedZ;
+			}else if(dice == 999){
+				track.id = nextId++;
+				track.x = (seed >> 4) % 100000;
+			}
+			track.x += track.speedX;
+			track.y += track.speedY;
+			track.z += track.speedZ;
+		}
+
+		history_frame_header header;
+		header.magic = HISTORY_FRAME_MAGIC;
+		header.count = aircraftCount;
+		header.timeMs = (int64_t)f * 1000 + (f % 3); // timer jitter
+		const uint8_t* h = reinterpret_cast<const uint8_t*>(&header);
+		const uint8_t* r = reinterpret_cast<const uint8_t*>(fleet.data());
+		raw.insert(raw.end(), h, h + sizeof(header));
+		raw.insert(raw.end(), r, r + aircraftCount * sizeof(history_track_record));
+	}
+
+	// Encode
+	HistoryEncoder encoder;
+	std::vector<uint8_t> encoded;
+	encoded.reserve(raw.size() / 4);
+	auto begin = std::chrono::steady_clock::now();
+	for(size_t offset = 0; offset < raw.size(); ){
+		const history_frame_header* header = reinterpret_cast<const history_frame_header*>(&raw[offset]);
+		encoder.encodeFrame(header->timeMs, reinterpret_cast<const history_track_record*>(header + 1), header->count, encoded);
+		offset += sizeof(history_frame_header) + header->count * sizeof(history_track_record);
+	}
+	double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	// Decode and check against the raw frames
+	HistoryDecoder decoder;
+	std::vector<history_track_record> decoded;
+	decoded.reserve(aircraftCount);
+	double decodeSeconds = 0;
+	double maxError = 0;
+	bool ok = true;
+	const uint8_t* cursor = encoded.data();
+	for(size_t offset = 0; offset < raw.size() && ok; ){
+		const history_frame_header* header = reinterpret_cast<const history_frame_header*>(&raw[offset]);
+		const history_track_record* expected = reinterpret_cast<const history_track_record*>(header + 1);
+		int64_t timeMs;
+
+		begin = std::chrono::steady_clock::now();
+		ok = decoder.decodeFrame(cursor, encoded.data() + encoded.size(), timeMs, decoded);
+		decodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		ok = ok && timeMs == header->timeMs && decoded.size() == header->count;
+		for(uint32_t i = 0; ok && i < header->count; i++){
+			ok = decoded[i].id == expected[i].id;
+			maxError = std::max(maxError, (double)std::fabs(decoded[i].x - expected[i].x));
+			maxError = std::max(maxError, (double)std::fabs(decoded[i].speedX - expected[i].speedX));
+		}
+		offset += sizeof(history_frame_header) + header->count * sizeof(history_track_record);
+	}
+
+	// Raw "decode": copy every frame's records out, as a reader of the segments does
+	begin = std::chrono::steady_clock::now();
+	uint64_t checksum = 0;
+	for(size_t offset = 0; offset < raw.size(); ){
+		const history_frame_header* header = reinterpret_cast<const history_frame_header*>(&raw[offset]);
+		decoded.resize(header->count);
+		memcpy(decoded.data(), header + 1, header->count * sizeof(history_track_record));
+		checksum += decoded[header->count / 2].id;
+		offset += sizeof(history_frame_header) + header->count * sizeof(history_track_record);
+	}
+	double rawSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	double records = (double)aircraftCount * frames;
+	double rawMegabytes = raw.size() / (1024.0 * 1024.0);
+	out << "+-------------+ History codec benchmark +-------------+" << std::endl;
+	out << "| Aircraft per scan: " << aircraftCount << ", scans: " << frames << std::endl;
+	out << "| Raw: " << raw.size() << " bytes, encoded: " << encoded.size() << " bytes" << std::endl;
+	out << "| Compression ratio: " << (double)raw.size() / encoded.size() << ":1 ("
+		<< (double)encoded.size() / records << " bytes per record)" << std::endl;
+	out << "| Encode: " << records / encodeSeconds / 1e6 << " M records/s" << std::endl;
+	out << "| Decode: " << records / decodeSeconds / 1e6 << " M records/s (" << rawMegabytes / decodeSeconds << " MB/s of raw frames)" << std::endl;
+	out << "| Raw read: " << records / rawSeconds / 1e6 << " M records/s (" << rawMegabytes / rawSeconds << " MB/s, checksum " << checksum << ")" << std::endl;
+	out << "| Round trip: " << (ok ? "ok" : "FAILED") << ", max error " << maxError << " ft" << std::endl;
+	out << "+-------------+ History codec benchmark end +-------------+" << std::endl;
+	return ok ? 0 : 1;
+}
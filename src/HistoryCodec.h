@@ -0,0 +1,93 @@
+#ifndef SRC_HISTORYCODEC_H_
+#define SRC_HISTORYCODEC_H_
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include "HistoryRecorder.h"
+
+/* Responsible for:
+	- A compressed encoding of the airspace history frames, for archiving and shipping history.
+	- Positions are coded per track as delta-of-delta, which is 0 for an aircraft flying at a
+		constant velocity. Velocities are only coded when they change.
+	- Records that need nothing (same track, same velocity, delta-of-delta 0) cost no bytes: each
+		frame lists the exceptions as run lengths of the records in between.
+	- Every number is a zigzag varint.
+ */
+
+/*	Format of an encoded frame:
+ * 	varint zigzag(timeDelta - previousTimeDelta)
+ * 	varint count
+ * 	byte   0 = same ids in the same order as the previous frame, 1 = id list follows
+ * 	[count varint zigzag(id - previousId)]
+ * 	3 exception lists (new track, velocity changed, delta-of-delta not 0), each:
+ * 		varint k, then k varint run lengths of records without the exception before the next one
+ * 	per record, in order:
+ * 		new track:			6 varint zigzag(quantized x, y, z, speedX, speedY, speedZ)
+ * 		velocity changed:	3 varint zigzag(quantized speed - previous speed)
+ * 		delta-of-delta:		3 varint zigzag(quantized (position - previous) - previous delta)
+ *
+ * 	Quantization: positions and speeds are kept to 1/HISTORY_CODEC_SCALE ft (ft/s).
+ * 	When the ids change, both sides forget the tracks that are not in the new frame.
+ */
+
+const int HISTORY_CODEC_SCALE = 100;
+
+class HistoryEncoder {
+public:
+	HistoryEncoder();
+
+	// Forget every track, the next frame can be decoded on its own
+	void reset();
+
+	// Appends one encoded frame to out
+	void encodeFrame(int64_t timeMs, const history_track_record* records, uint32_t count, std::vector<uint8_t>& out);
+
+	// Compression ratio and decode throughput against the raw frame format, on synthetic traffic
+	static int benchmark(int aircraftCount, int frames, std::ostream& out);
+
+private:
+	struct TrackState {
+		int64_t position[3];
+		int64_t delta[3];
+		int64_t speed[3];
+	};
+
+	std::unordered_map<int32_t, TrackState> mTracks;
+	std::vector<int32_t> mPreviousIds;
+	int64_t mPreviousTimeMs;
+	int64_t mPreviousTimeDelta;
+
+	// Scratch space reused by every frame
+	std::vector<int32_t> mNewTracks;
+	std::vector<int32_t> mSpeedChanges;
+	std::vector<int32_t> mMoveChanges;
+	std::vector<uint8_t> mFlags;
+	std::vector<int64_t> mPayload;
+};
+
+class HistoryDecoder {
+public:
+	HistoryDecoder();
+
+	void reset();
+
+	// Decodes the frame at cursor and moves cursor past it, false if the data is corrupt
+	bool decodeFrame(const uint8_t*& cursor, const uint8_t* end, int64_t& timeMs, std::vector<history_track_record>& records);
+
+private:
+	struct TrackState {
+		int64_t position[3];
+		int64_t delta[3];
+		int64_t speed[3];
+	};
+
+	std::unordered_map<int32_t, TrackState> mTracks;
+	std::vector<int32_t> mPreviousIds;
+	std::vector<uint8_t> mFlags;
+	int64_t mPreviousTimeMs;
+	int64_t mPreviousTimeDelta;
+};
+
+#endif /* SRC_HISTORYCODEC_H_ */
@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iomanip>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "HistoryIndex.h"
+
+/* RESPONSIBILITIES
+ *	- HistoryRecorder builds and writes a segment's index when it seals the segment, and
+ *		rewrites timeline.idx whenever the ring rotates.
+ *	- HistoryQuery only opens the segments whose time range overlaps the query. Inside a
+ *		segment the frame directory is binary searched for the time range and the id table for
+ *		the aircraft, so only the records that are part of the answer are read.
+ *	- The segment still being written has no .idx yet, its index is built by walking it.
+ */
+
+static bool writeAll(int fd, const void* data, size_t size) {
+	const char* cursor = static_cast<const char*>(data);
+	while(size > 0){
+		ssize_t status = ::write(fd, cursor, size);
+		if(status == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			return false;
+		}
+		cursor += status;
+		size -= status;
+	}
+	return true;
+}
+
+SegmentIndex::SegmentIndex() :
+	frames(nullptr), frameCount(0), tracks(nullptr), trackCount(0), entries(nullptr), entryCount(0),
+	mMap(nullptr), mMapSize(0)
+{
+
+}
+
+SegmentIndex::~SegmentIndex() {
+	unmap();
+}
+
+void SegmentIndex::unmap() {
+	if(mMap != nullptr){
+		munmap(mMap, mMapSize);
+		mMap = nullptr;
+		mMapSize = 0;
+	}
+}
+
+std::string SegmentIndex::indexPath(std::string directory, int slot) {
+	return directory + "/segment_" + std::to_string(slot) + ".idx";
+}
+
+bool SegmentIndex::build(const char* segmentBase) {
+	const history_segment_header* header = reinterpret_cast<const history_segment_header*>(segmentBase);
+
+	mOwnedFrames.clear();
+	mOwnedTracks.clear();
+	mOwnedEntries.clear();
+
+	// (id, offset) pairs, sorting them groups by id with offsets ascending
+	std::vector<uint64_t> keys;
+	uint64_t offset = HISTORY_HEADER_SIZE;
+	while(offset + sizeof(history_frame_header) <= header->writeOffset){
+		const history_frame_header* frame = reinterpret_cast<const history_frame_header*>(segmentBase + offset);
+		if(frame->magic != HISTORY_FRAME_MAGIC){
+			break;
+		}
+
+		history_index_frame indexFrame;
+		indexFrame.timeMs = frame->timeMs;
+		indexFrame.offset = offset;
+		mOwnedFrames.push_back(indexFrame);
+
+		uint64_t recordOffset = offset + sizeof(history_frame_header);
+		const history_track_record* records = reinterpret_cast<const history_track_record*>(frame + 1);
+		for(uint32_t i = 0; i < frame->count; i++){
+			keys.push_back(((uint64_t)(uint32_t)records[i].id << 32) | (recordOffset + i * sizeof(history_track_record)));
+		}
+
+		offset = recordOffset + frame->count * sizeof(history_track_record);
+	}
+
+	std::sort(keys.begin(), keys.end());
+
+	mOwnedEntries.reserve(keys.size());
+	for(size_t i = 0; i < keys.size(); i++){
+		int32_t id = (int32_t)(uint32_t)(keys[i] >> 32);
+		if(mOwnedTracks.empty() || mOwnedTracks.back().id != id){
+			history_index_track track;
+			track.id = id;
+			track.entryCount = 0;
+			track.firstEntry = i;
+			mOwnedTracks.push_back(track);
+		}
+		mOwnedTracks.back().entryCount++;
+		mOwnedEntries.push_back((uint32_t)keys[i]);
+	}
+
+	// ids were sorted as unsigned, keep the table in signed order for findTrack()
+	std::stable_sort(mOwnedTracks.begin(), mOwnedTracks.end(),
+			[](const history_index_track& a, const history_index_track& b){ return a.id < b.id; });
+
+	unmap();
+	frames = mOwnedFrames.data();
+	frameCount = mOwnedFrames.size();
+	tracks = mOwnedTracks.data();
+	trackCount = mOwnedTracks.size();
+	entries = mOwnedEntries.data();
+	entryCount = mOwnedEntries.size();
+	return true;
+}
+
+bool SegmentIndex::write(std::string path, uint64_t sequence) const {
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(fd == -1){
+		perror("SegmentIndex: Cannot create index");
+		return false;
+	}
+
+	history_index_header header;
+	memcpy(header.magic, HISTORY_INDEX_MAGIC, sizeof(HISTORY_INDEX_MAGIC));
+	header.sequence = sequence;
+	header.frameCount = frameCount;
+	header.trackCount = trackCount;
+	header.entryCount = entryCount;
+
+	bool ok = writeAll(fd, &header, sizeof(header))
+			&& writeAll(fd, frames, frameCount * sizeof(history_index_frame))
+			&& writeAll(fd, tracks, trackCount * sizeof(history_index_track))
+			&& writeAll(fd, entries, entryCount * sizeof(uint32_t));
+	if(!ok){
+		perror("SegmentIndex: Error writing index");
+	}
+
+	close(fd);
+	return ok;
+}
+
+bool SegmentIndex::load(std::string path, uint64_t sequence) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd == -1){
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(history_index_header)){
+		close(fd);
+		return false;
+	}
+
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		return false;
+	}
+
+	const history_index_header* header = static_cast<const history_index_header*>(map);
+	size_t expectedSize = sizeof(history_index_header)
+			+ header->frameCount * sizeof(history_index_frame)
+			+ header->trackCount * sizeof(history_index_track)
+			+ header->entryCount * sizeof(uint32_t);
+	if(memcmp(header->magic, HISTORY_INDEX_MAGIC, sizeof(HISTORY_INDEX_MAGIC)) != 0
+			|| header->sequence != sequence || expectedSize != (size_t)st.st_size){
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	unmap();
+	mMap = map;
+	mMapSize = st.st_size;
+
+	const char* cursor = static_cast<const char*>(map) + sizeof(history_index_header);
+	frames = reinterpret_cast<const history_index_frame*>(cursor);
+	frameCount = header->frameCount;
+	cursor += frameCount * sizeof(history_index_frame);
+	tracks = reinterpret_cast<const history_index_track*>(cursor);
+	trackCount = header->trackCount;
+	cursor += trackCount * sizeof(history_index_track);
+	entries = reinterpret_cast<const uint32_t*>(cursor);
+	entryCount = header->entryCount;
+	return true;
+}
+
+const history_index_track* SegmentIndex::findTrack(int id) const {
+	const history_index_track* end = tracks + trackCount;
+	const history_index_track* it = std::lower_bound(tracks, end, id,
+			[](const history_index_track& track, int value){ return track.id < value; });
+	if(it == end || it->id != id){
+		return nullptr;
+	}
+	return it;
+}
+
+uint64_t SegmentIndex::lowerFrame(int64_t timeMs) const {
+	return std::lower_bound(frames, frames + frameCount, timeMs,
+			[](const history_index_frame& frame, int64_t value){ return frame.timeMs < value; }) - frames;
+}
+
+void SegmentIndex::entryRange(const history_index_track* track, uint64_t beginOffset, uint64_t endOffset,
+		uint64_t& first, uint64_t& last) const {
+	const uint32_t* begin = entries + track->firstEntry;
+	const uint32_t* end = begin + track->entryCount;
+	first = std::lower_bound(begin, end, beginOffset) - entries;
+	last = std::lower_bound(begin, end, endOffset) - entries;
+}
+
+HistoryQuery::HistoryQuery(std::string iDirectory) : mDirectory(iDirectory), mLoaded(false) {
+
+}
+
+HistoryQuery::~HistoryQuery() {
+	for(size_t i = 0; i < mSegments.size(); i++){
+		if(mSegments[i].base != nullptr){
+			munmap(const_cast<char*>(mSegments[i].base), mSegments[i].size);
+		}
+		delete mSegments[i].index;
+	}
+}
+
+std::string HistoryQuery::timelinePath(std::string directory) {
+	return directory + "/timeline.idx";
+}
+
+bool HistoryQuery::writeTimeline(std::string directory, const std::vector<history_timeline_entry>& timeline) {
+	std::string path = timelinePath(directory);
+	std::string tmpPath = path + ".tmp";
+
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(fd == -1){
+		perror("HistoryQuery: Cannot create timeline");
+		return false;
+	}
+
+	bool ok = writeAll(fd, timeline.data(), timeline.size() * sizeof(history_timeline_entry));
+	close(fd);
+	if(!ok || rename(tmpPath.c_str(), path.c_str()) == -1){
+		perror("HistoryQuery: Cannot write timeline");
+		return false;
+	}
+	return true;
+}
+
+bool HistoryQuery::loadTimeline() {
+	if(mLoaded){
+		return !mSegments.empty();
+	}
+	mLoaded = true;
+
+	std::vector<history_timeline_entry> timeline;
+	int fd = open(timelinePath(mDirectory).c_str(), O_RDONLY);
+	if(fd != -1){
+		history_timeline_entry entry;
+		while(read(fd, &entry, sizeof(entry)) == sizeof(entry)){
+			timeline.push_back(entry);
+		}
+		close(fd);
+	}
+
+	// Only compare times within the newest run
+	uint64_t newest = 0;
+	int64_t newestRun = 0;
+	for(size_t i = 0; i < timeline.size(); i++){
+		if(timeline[i].sequence > newest){
+			newest = timeline[i].sequence;
+			newestRun = timeline[i].programStartWallNs;
+		}
+	}
+
+	for(size_t i = 0; i < timeline.size(); i++){
+		if(timeline[i].sequence != 0 && timeline[i].programStartWallNs == newestRun){
+			Segment segment;
+			segment.entry = timeline[i];
+			segment.base = nullptr;
+			segment.size = 0;
+			segment.index = nullptr;
+			mSegments.push_back(segment);
+		}
+	}
+
+	std::sort(mSegments.begin(), mSegments.end(),
+			[](const Segment& a, const Segment& b){ return a.entry.sequence < b.entry.sequence; });
+	return !mSegments.empty();
+}
+
+bool HistoryQuery::openSegment(Segment& segment) {
+	if(segment.index != nullptr){
+		return true;
+	}
+
+	int fd = open(HistoryRecorder::segmentPath(mDirectory, segment.entry.slot).c_str(), O_RDONLY);
+	if(fd == -1){
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) == -1 || (size_t)st.st_size < HISTORY_HEADER_SIZE){
+		close(fd);
+		return false;
+	}
+
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		return false;
+	}
+
+	// The slot may have been reused since the timeline was written
+	const history_segment_header* header = static_cast<const history_segment_header*>(map);
+	if(memcmp(header->magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0 || header->sequence != segment.entry.sequence){
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	segment.base = static_cast<const char*>(map);
+	segment.size = st.st_size;
+	segment.index = new SegmentIndex();
+
+	if(!header->sealed || !segment.index->load(SegmentIndex::indexPath(mDirectory, segment.entry.slot), header->sequence)){
+		segment.index->build(segment.base);
+	}
+	return true;
+}
+
+// The open segment's timeline entry has no end time yet
+static bool overlaps(const history_timeline_entry& entry, int64_t t1Ms, int64_t t2Ms) {
+	if(entry.firstTimeMs != -1 && entry.firstTimeMs > t2Ms){
+		return false;
+	}
+	return entry.lastTimeMs == -1 || !entry.sealed || entry.lastTimeMs >= t1Ms;
+}
+
+int HistoryQuery::history(int id, int64_t t1Ms, int64_t t2Ms, std::vector<history_sample>& out) {
+	if(!loadTimeline()){
+		return 0;
+	}
+
+	int found = 0;
+	for(size_t s = 0; s < mSegments.size(); s++){
+		Segment& segment = mSegments[s];
+		if(!overlaps(segment.entry, t1Ms, t2Ms) || !openSegment(segment)){
+			continue;
+		}
+
+		const SegmentIndex& index = *segment.index;
+		const history_index_track* track = index.findTrack(id);
+		if(track == nullptr){
+			continue;
+		}
+
+		uint64_t f1 = index.lowerFrame(t1Ms);
+		uint64_t f2 = index.lowerFrame(t2Ms + 1);
+		if(f1 >= f2){
+			continue;
+		}
+
+		uint64_t endOffset = (f2 < index.frameCount) ? index.frames[f2].offset : UINT64_MAX;
+		uint64_t first, last;
+		index.entryRange(track, index.frames[f1].offset, endOffset, first, last);
+
+		// Entries ascend with the frames, so the frame of each record is found by walking forward
+		uint64_t f = f1;
+		for(uint64_t e = first; e < last; e++){
+			uint64_t recordOffset = index.entries[e];
+			while(f + 1 < index.frameCount && index.frames[f + 1].offset < recordOffset){
+				f++;
+			}
+
+			history_sample sample;
+			sample.timeMs = index.frames[f].timeMs;
+			sample.track = *reinterpret_cast<const history_track_record*>(segment.base + recordOffset);
+			out.push_back(sample);
+			found++;
+		}
+	}
+
+	return found;
+}
+
+int HistoryQuery::nearby(int id, int64_t t1Ms, int64_t t2Ms, float radius, std::vector<history_neighbour>& out) {
+	if(!loadTimeline()){
+		return 0;
+	}
+
+	// Single time: use the last frame at or before it
+	if(t2Ms < t1Ms){
+		int64_t frameTime = -1;
+		for(size_t s = 0; s < mSegments.size(); s++){
+			Segment& segment = mSegments[s];
+			if(!overlaps(segment.entry, INT64_MIN, t1Ms) || !openSegment(segment)){
+				continue;
+			}
+			uint64_t f = segment.index->lowerFrame(t1Ms + 1);
+			if(f > 0){
+				frameTime = segment.index->frames[f - 1].timeMs;
+			}
+		}
+		if(frameTime == -1){
+			return 0;
+		}
+		t1Ms = frameTime;
+		t2Ms = frameTime;
+	}
+
+	std::map<int, history_neighbour> closest;
+	for(size_t s = 0; s < mSegments.size(); s++){
+		Segment& segment = mSegments[s];
+		if(!overlaps(segment.entry, t1Ms, t2Ms) || !openSegment(segment)){
+			continue;
+		}
+
+		const SegmentIndex& index = *segment.index;
+		const history_index_track* track = index.findTrack(id);
+		if(track == nullptr){
+			continue;
+		}
+
+		uint64_t f1 = index.lowerFrame(t1Ms);
+		uint64_t f2 = index.lowerFrame(t2Ms + 1);
+		if(f1 >= f2){
+			continue;
+		}
+
+		uint64_t endOffset = (f2 < index.frameCount) ? index.frames[f2].offset : UINT64_MAX;
+		uint64_t first, last;
+		index.entryRange(track, index.frames[f1].offset, endOffset, first, last);
+
+		uint64_t f = f1;
+		for(uint64_t e = first; e < last; e++){
+			uint64_t recordOffset = index.entries[e];
+			while(f + 1 < index.frameCount && index.frames[f + 1].offset < recordOffset){
+				f++;
+			}
+
+			// Only this one frame is scanned, for the other aircraft at the same time
+			const history_track_record* self = reinterpret_cast<const history_track_record*>(segment.base + recordOffset);
+			const history_frame_header* frame = reinterpret_cast<const history_frame_header*>(segment.base + index.frames[f].offset);
+			const history_track_record* records = reinterpret_cast<const history_track_record*>(frame + 1);
+			for(uint32_t i = 0; i < frame->count; i++){
+				if(records[i].id == id){
+					continue;
+				}
+
+				float horizontal = std::hypot(records[i].x - self->x, records[i].y - self->y);
+				if(horizontal > radius){
+					continue;
+				}
+
+				std::map<int, history_neighbour>::iterator it = closest.find(records[i].id);
+				if(it == closest.end() || horizontal < it->second.horizontalDistance){
+					history_neighbour neighbour;
+					neighbour.id = records[i].id;
+					neighbour.timeMs = frame->timeMs;
+					neighbour.horizontalDistance = horizontal;
+					neighbour.verticalDistance = std::fabs(records[i].z - self->z);
+					closest[records[i].id] = neighbour;
+				}
+			}
+		}
+	}
+
+	for(std::map<int, history_neighbour>::iterator it = closest.begin(); it != closest.end(); ++it){
+		out.push_back(it->second);
+	}
+	std::sort(out.begin(), out.end(),
+			[](const history_neighbour& a, const history_neighbour& b){ return a.horizontalDistance < b.horizontalDistance; });
+	return out.size();
+}
+
+// strtol/strtod based, so a typo is reported instead of throwing out of the console
+static bool parseNumber(const std::string& text, double& value) {
+	char* end = nullptr;
+	value = strtod(text.c_str(), &end);
+	return !text.empty() && end != nullptr && *end == '\0';
+}
+
+static void printTime(std::ostream& out, int64_t timeMs) {
+	out << "T+" << std::setw(6) << timeMs / 1000 << "." << std::setfill('0') << std::setw(3) << timeMs % 1000
+		<< std::setfill(' ') << "s";
+}
+
+int HistoryQuery::runCommand(std::string directory, const std::vector<std::string>& m, std::ostream& out) {
+	double id, t1, t2, radius;
+
+	auto begin = std::chrono::steady_clock::now();
+	HistoryQuery query(directory);
+
+	if(m.size() == 4 && m[0] == "history" && parseNumber(m[1], id) && parseNumber(m[2], t1) && parseNumber(m[3], t2)){
+		std::vector<history_sample> samples;
+		query.history((int)id, (int64_t)(t1 * 1000), (int64_t)(t2 * 1000), samples);
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		out << "+-------------+ history " << (int)id << " from " << t1 << "s to " << t2 << "s +-------------+" << std::endl;
+		for(size_t i = 0; i < samples.size(); i++){
+			const history_track_record& track = samples[i].track;
+			out << "| ";
+			printTime(out, samples[i].timeMs);
+			out << "  X, Y, Z (ft): " << track.x << ", " << track.y << ", " << track.z
+				<< "  Speed (ft/s): " << track.speedX << ", " << track.speedY << ", " << track.speedZ << std::endl;
+		}
+		out << "+-------------+ " << samples.size() << " positions in " << elapsedMs << " ms +-------------+" << std::endl;
+		return 0;
+	}
+
+	if((m.size() == 4 || m.size() == 5) && m[0] == "nearby" && parseNumber(m[1], id) && parseNumber(m[2], t1)
+			&& parseNumber(m[3], radius) && (m.size() == 4 || parseNumber(m[4], t2))){
+		if(m.size() == 4){
+			t2 = t1 - 1;
+		}
+
+		std::vector<history_neighbour> neighbours;
+		query.nearby((int)id, (int64_t)(t1 * 1000), (int64_t)(t2 * 1000), (float)radius, neighbours);
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		out << "+-------------+ nearby " << (int)id << " within " << radius << " ft +-------------+" << std::endl;
+		for(size_t i = 0; i < neighbours.size(); i++){
+			out << "| Aircraft ID: " << neighbours[i].id << "  closest at ";
+			printTime(out, neighbours[i].timeMs);
+			out << "  horizontal " << neighbours[i].horizontalDistance << " ft, vertical "
+				<< neighbours[i].verticalDistance << " ft" << std::endl;
+		}
+		out << "+-------------+ " << neighbours.size() << " aircraft in " << elapsedMs << " ms +-------------+" << std::endl;
+		return 0;
+	}
+
+	out << "Usage: history <id> <t1> <t2>" << std::endl;
+	out << "       nearby <id> <t> <radius> [<t2>]    (times in seconds since start, radius in ft)" << std::endl;
+	return -1;
+}
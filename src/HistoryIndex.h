@@ -0,0 +1,147 @@
+#ifndef SRC_HISTORYINDEX_H_
+#define SRC_HISTORYINDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "HistoryRecorder.h"
+
+/* Responsible for:
+	- The time index over the airspace history: timeline.idx lists the time range of every
+		segment in the ring, and each sealed segment has a segment_<slot>.idx with
+			- a frame directory (time -> frame offset), sorted by time
+			- an id -> record offsets table, sorted by id
+	- Answering the time-travel queries from it:
+		history <id> <t1> <t2>				where was aircraft id between t1 and t2
+		nearby <id> <t> <radius> [<t2>]		who was within radius (ft, horizontal) of id at t (or from t to t2)
+ */
+
+/*	Format of segment_<slot>.idx:
+ * 	history_index_header
+ * 	history_index_frame[frameCount]
+ * 	history_index_track[trackCount]
+ * 	uint32_t entries[entryCount]		record offsets in the segment, grouped by track, ascending
+ *
+ * 	Format of timeline.idx: history_timeline_entry[segmentCount], one per slot of the ring
+ */
+
+const char HISTORY_INDEX_MAGIC[8] = { 'A', 'T', 'C', 'H', 'I', 'D', 'X', '1' };
+
+typedef struct {
+	char magic[8];
+	uint64_t sequence;		// must match the segment, otherwise the index is stale
+	uint64_t frameCount;
+	uint64_t trackCount;
+	uint64_t entryCount;
+} history_index_header;
+
+typedef struct {
+	int64_t timeMs;
+	uint64_t offset;		// of the history_frame_header in the segment
+} history_index_frame;
+
+typedef struct {
+	int32_t id;
+	uint32_t entryCount;
+	uint64_t firstEntry;
+} history_index_track;
+
+// A position of one aircraft at one time
+typedef struct {
+	int64_t timeMs;
+	history_track_record track;
+} history_sample;
+
+// Closest approach of another aircraft to the queried one
+typedef struct {
+	int id;
+	int64_t timeMs;
+	float horizontalDistance;
+	float verticalDistance;
+} history_neighbour;
+
+// Index of one segment, either mapped from its .idx file or built by walking the segment
+class SegmentIndex {
+public:
+	const history_index_frame* frames;
+	uint64_t frameCount;
+	const history_index_track* tracks;
+	uint64_t trackCount;
+	const uint32_t* entries;
+	uint64_t entryCount;
+
+	SegmentIndex();
+	virtual ~SegmentIndex();
+
+	// Walks the committed frames of a mapped segment
+	bool build(const char* segmentBase);
+
+	// Maps an index file, false if missing or not for this segment sequence
+	bool load(std::string path, uint64_t sequence);
+
+	bool write(std::string path, uint64_t sequence) const;
+
+	const history_index_track* findTrack(int id) const;
+
+	// First frame with timeMs >= t
+	uint64_t lowerFrame(int64_t timeMs) const;
+
+	// Entries of a track whose record lies in [beginOffset, endOffset)
+	void entryRange(const history_index_track* track, uint64_t beginOffset, uint64_t endOffset,
+			uint64_t& first, uint64_t& last) const;
+
+	static std::string indexPath(std::string directory, int slot);
+
+private:
+	std::vector<history_index_frame> mOwnedFrames;
+	std::vector<history_index_track> mOwnedTracks;
+	std::vector<uint32_t> mOwnedEntries;
+	void* mMap;
+	size_t mMapSize;
+
+	void unmap();
+
+	SegmentIndex(const SegmentIndex&);
+	SegmentIndex& operator=(const SegmentIndex&);
+};
+
+class HistoryQuery {
+public:
+	HistoryQuery(std::string iDirectory);
+	virtual ~HistoryQuery();
+
+	// Every recorded position of id with t1Ms <= time <= t2Ms, in time order
+	int history(int id, int64_t t1Ms, int64_t t2Ms, std::vector<history_sample>& out);
+
+	// Aircraft within radius of id at the last frame at or before t1Ms, or at any frame up to t2Ms
+	int nearby(int id, int64_t t1Ms, int64_t t2Ms, float radius, std::vector<history_neighbour>& out);
+
+	// Runs "history ..." / "nearby ..." and prints the answer, used by the console and the command line
+	static int runCommand(std::string directory, const std::vector<std::string>& m, std::ostream& out);
+
+	static std::string timelinePath(std::string directory);
+
+	// Replaces timeline.idx atomically (write to a temporary file, then rename)
+	static bool writeTimeline(std::string directory, const std::vector<history_timeline_entry>& timeline);
+
+private:
+	struct Segment {
+		history_timeline_entry entry;
+		const char* base;
+		size_t size;
+		SegmentIndex* index;
+	};
+
+	std::string mDirectory;
+	std::vector<Segment> mSegments;	// segments of the newest run, in time order
+	bool mLoaded;
+
+	bool loadTimeline();
+	bool openSegment(Segment& segment);
+
+	HistoryQuery(const HistoryQuery&);
+	HistoryQuery& operator=(const HistoryQuery&);
+};
+
+#endif /* SRC_HISTORYINDEX_H_ */
@@ -0,0 +1,313 @@
+#include <mutex>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "HistoryRecorder.h"
+#include "HistoryIndex.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+/* RESPONSIBILITIES
+ *	- The ATCSystem's recorder thread calls HistoryRecorder::recordScan() with every scan on the radar bus.
+ *	- The frame is reserved in the mapped segment and each track is written directly into it.
+ *		The header's writeOffset is only moved once the whole frame is written, so a reader
+ *		(or a crash) never sees half a frame.
+ *	- When a frame doesn't fit, the segment is sealed and the next slot of the ring is reused,
+ *		so the history always holds the newest segmentSize * segmentCount bytes.
+ *	- On start up the ring continues after the newest existing segment instead of overwriting it.
+ *	- Sealing a segment writes its index (segment_<slot>.idx) and every rotation rewrites
+ *		timeline.idx, so queries only open the segments they need.
+ */
+
+extern std::chrono::steady_clock::time_point programStartTime;
+
+HistoryRecorder::HistoryRecorder(std::string iDirectory, size_t iSegmentSize, int iSegmentCount) :
+	mDirectory(iDirectory), mSegmentSize(iSegmentSize), mSegmentCount(iSegmentCount),
+	mSlot(-1), mSequence(0), mProgramStartWallNs(0), mFd(-1), mBase(nullptr), mHeader(nullptr),
+	mBytesWritten(0), mFramesWritten(0)
+{
+
+}
+
+HistoryRecorder::~HistoryRecorder() {
+	close();
+}
+
+std::string HistoryRecorder::segmentPath(std::string directory, int slot) {
+	return directory + "/segment_" + std::to_string(slot) + ".hist";
+}
+
+bool HistoryRecorder::open() {
+	if(mkdir(mDirectory.c_str(), S_IRWXU) == -1 && errno != EEXIST){
+		perror("HistoryRecorder: Cannot create history directory");
+		return false;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	int64_t sinceStartNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - programStartTime).count();
+	mProgramStartWallNs = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec - sinceStartNs;
+
+	// Continue after the newest segment left by a previous run, and keep its time ranges
+	mTimeline.assign(mSegmentCount, history_timeline_entry());
+	for(int slot = 0; slot < mSegmentCount; slot++){
+		history_timeline_entry& entry = mTimeline[slot];
+		memset(&entry, 0, sizeof(entry));
+		entry.slot = slot;
+
+		int fd = ::open(segmentPath(mDirectory, slot).c_str(), O_RDONLY);
+		if(fd == -1){
+			continue;
+		}
+
+		history_segment_header header;
+		if(read(fd, &header, sizeof(header)) == sizeof(header)
+				&& memcmp(header.magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) == 0){
+			entry.sealed = 1; // whatever was left open by a crash is final now
+			entry.sequence = header.sequence;
+			entry.programStartWallNs = header.programStartWallNs;
+			entry.firstTimeMs = header.firstTimeMs;
+			entry.lastTimeMs = header.lastTimeMs;
+
+			if(header.sequence >= mSequence){
+				mSequence = header.sequence;
+				mSlot = slot;
+			}
+		}
+		::close(fd);
+	}
+
+	return rotate();
+}
+
+void HistoryRecorder::sealSegment() {
+	if(mBase == nullptr){
+		return;
+	}
+
+	history_timeline_entry& entry = mTimeline[mSlot];
+	entry.firstTimeMs = mHeader->firstTimeMs;
+	entry.lastTimeMs = mHeader->lastTimeMs;
+
+	// Index it while the segment is still mapped and in the page cache
+	SegmentIndex index;
+	index.build(mBase);
+	index.write(SegmentIndex::indexPath(mDirectory, mSlot), mHeader->sequence);
+
+	mHeader->sealed = 1;
+	entry.sealed = 1;
+
+	// Let the kernel write it back in the background, the next segment doesn't wait on it
+	msync(mBase, mHeader->writeOffset, MS_ASYNC);
+	munmap(mBase, mSegmentSize);
+	::close(mFd);
+
+	mBase = nullptr;
+	mHeader = nullptr;
+	mFd = -1;
+}
+
+bool HistoryRecorder::rotate() {
+	sealSegment();
+
+	mSlot = (mSlot + 1) % mSegmentCount;
+	mSequence++;
+
+	// The old index would describe frames that are about to be overwritten
+	unlink(SegmentIndex::indexPath(mDirectory, mSlot).c_str());
+
+	std::string path = segmentPath(mDirectory, mSlot);
+	mFd = ::open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if(mFd == -1){
+		perror("HistoryRecorder: Cannot open segment");
+		return false;
+	}
+
+	if(ftruncate(mFd, mSegmentSize) == -1){
+		perror("HistoryRecorder: Cannot size segment");
+		::close(mFd);
+		mFd = -1;
+		return false;
+	}
+
+	void* base = mmap(NULL, mSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+	if(base == MAP_FAILED){
+		perror("HistoryRecorder: Cannot map segment");
+		::close(mFd);
+		mFd = -1;
+		return false;
+	}
+
+	mBase = static_cast<char*>(base);
+	mHeader = reinterpret_cast<history_segment_header*>(mBase);
+
+	// Reset the header, the old frames in a reused slot are dead past writeOffset
+	memset(mHeader, 0, sizeof(history_segment_header));
+	mHeader->version = HISTORY_VERSION;
+	mHeader->slot = mSlot;
+	mHeader->sequence = mSequence;
+	mHeader->programStartWallNs = mProgramStartWallNs;
+	mHeader->firstTimeMs = -1;
+	mHeader->lastTimeMs = -1;
+	mHeader->frameCount = 0;
+	mHeader->writeOffset = HISTORY_HEADER_SIZE;
+	mHeader->segmentSize = mSegmentSize;
+	mHeader->sealed = 0;
+	// magic last, a header without it is ignored by readers
+	memcpy(mHeader->magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+
+	history_timeline_entry& entry = mTimeline[mSlot];
+	entry.sealed = 0;
+	entry.sequence = mSequence;
+	entry.programStartWallNs = mProgramStartWallNs;
+	entry.firstTimeMs = -1;
+	entry.lastTimeMs = -1;
+	HistoryQuery::writeTimeline(mDirectory, mTimeline);
+
+	return true;
+}
+
+bool HistoryRecorder::recordScan(int64_t timeMs, const std::vector<Aircraft>& snapshot) {
+	static Counter& logBytes = metrics().counter("atc_log_bytes_total", "Bytes written to logs", "log=\"history\"");
+	TraceScope trace("recordScan", "log");
+	trace.setArg("aircraft", snapshot.size());
+
+	std::lock_guard<std::mutex> guard(mMutex);
+	if(mBase == nullptr){
+		return false;
+	}
+
+	// Upper bound, aircraft that haven't entered yet are skipped below
+	size_t frameBytes = sizeof(history_frame_header) + snapshot.size() * sizeof(history_track_record);
+	if(HISTORY_HEADER_SIZE + frameBytes > mSegmentSize){
+		std::cerr << "HistoryRecorder: Scan of " << snapshot.size() << " aircraft is larger than a segment" << std::endl;
+		return false;
+	}
+
+	if(mHeader->writeOffset + frameBytes > mSegmentSize){
+		if(!rotate()){
+			return false;
+		}
+	}
+
+	history_frame_header* frame = reinterpret_cast<history_frame_header*>(mBase + mHeader->writeOffset);
+	history_track_record* record = reinterpret_cast<history_track_record*>(frame + 1);
+
+	uint32_t count = 0;
+	for(size_t i = 0; i < snapshot.size(); i++){
+		const Aircraft& aircraft = snapshot[i];
+		if((int64_t)aircraft.getEntryTime() * 1000 > timeMs){
+			continue;
+		}
+
+		record->id = aircraft.getID();
+		record->x = aircraft.getXPos();
+		record->y = aircraft.getYPos();
+		record->z = aircraft.getZPos();
+		record->speedX = aircraft.getXSpeed();
+		record->speedY = aircraft.getYSpeed();
+		record->speedZ = aircraft.getZSpeed();
+		record++;
+		count++;
+	}
+
+	frame->magic = HISTORY_FRAME_MAGIC;
+	frame->count = count;
+	frame->timeMs = timeMs;
+
+	// Commit the frame
+	size_t written = sizeof(history_frame_header) + count * sizeof(history_track_record);
+	if(mHeader->frameCount == 0){
+		mHeader->firstTimeMs = timeMs;
+	}
+	mHeader->lastTimeMs = timeMs;
+	mHeader->frameCount++;
+	mHeader->writeOffset += written;
+
+	mBytesWritten += written;
+	logBytes.add(written);
+	mFramesWritten++;
+	return true;
+}
+
+void HistoryRecorder::close() {
+	std::lock_guard<std::mutex> guard(mMutex);
+	if(mBase != nullptr){
+		// The next run starts a new segment anyway, so this one is final
+		sealSegment();
+		HistoryQuery::writeTimeline(mDirectory, mTimeline);
+	}
+}
+
+int HistoryRecorder::benchmark(std::string directory, int aircraftCount, int frames, std::ostream& out) {
+	// Big enough that rotation is part of the measurement
+	const size_t segmentSize = 64 * 1024 * 1024;
+	const int segmentCount = 4;
+
+	std::vector<Aircraft> snapshot;
+	snapshot.reserve(aircraftCount);
+	CommunicationSystem commSystem;
+	for(int i = 0; i < aircraftCount; i++){
+		snapshot.push_back(Aircraft(0, 1000 + i, (i * 37) % 100000, (i * 91) % 100000, 10000 + (i % 20) * 500,
+				250, -20, 0, commSystem));
+	}
+
+	HistoryRecorder recorder(directory, segmentSize, segmentCount);
+	if(!recorder.open()){
+		return 1;
+	}
+
+	double writeSeconds = 0;
+	double worstFrameMs = 0;
+	for(int f = 0; f < frames; f++){
+		for(int i = 0; i < aircraftCount; i++){
+			snapshot[i].setXPos(snapshot[i].getXPos() + snapshot[i].getXSpeed());
+		}
+
+		auto begin = std::chrono::steady_clock::now();
+		recorder.recordScan((int64_t)f * 1000, snapshot);
+		double frameSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		writeSeconds += frameSeconds;
+		if(frameSeconds * 1000 > worstFrameMs){
+			worstFrameMs = frameSeconds * 1000;
+		}
+	}
+	recorder.close();
+
+	double megabytes = recorder.getBytesWritten() / (1024.0 * 1024.0);
+	out << "+-------------+ History recorder benchmark +-------------+" << std::endl;
+	out << "| Aircraft per scan: " << aircraftCount << ", scans: " << frames << std::endl;
+	out << "| Bytes written: " << recorder.getBytesWritten() << " (" << megabytes << " MB)" << std::endl;
+	out << "| Write bandwidth: " << megabytes / writeSeconds << " MB/s" << std::endl;
+	out << "| Scans per second: " << frames / writeSeconds << " (mean " << writeSeconds * 1000 / frames
+		<< " ms, worst " << worstFrameMs << " ms per scan)" << std::endl;
+	out << "| Sustainable scan rate at this fleet size: " << (int)(frames / writeSeconds) << " Hz" << std::endl;
+
+	// Query the history that was just written through the index
+	int64_t lastMs = (int64_t)(frames - 1) * 1000;
+	auto queryBegin = std::chrono::steady_clock::now();
+	std::vector<history_sample> samples;
+	HistoryQuery historyQuery(directory);
+	historyQuery.history(1000, 0, lastMs, samples);
+	double historyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queryBegin).count();
+
+	queryBegin = std::chrono::steady_clock::now();
+	std::vector<history_neighbour> neighbours;
+	HistoryQuery nearbyQuery(directory);
+	nearbyQuery.nearby(1000, lastMs / 2, lastMs / 2 - 1, 30380, neighbours);
+	double nearbyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queryBegin).count();
+
+	out << "| history 1000 over the ring: " << samples.size() << " positions in " << historyMs << " ms" << std::endl;
+	out << "| nearby 1000 within 5 NM: " << neighbours.size() << " aircraft in " << nearbyMs << " ms" << std::endl;
+	out << "+-------------+ History recorder benchmark end +-------------+" << std::endl;
+	return 0;
+}
@@ -0,0 +1,121 @@
+#ifndef SRC_HISTORYRECORDER_H_
+#define SRC_HISTORYRECORDER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iostream>
+#include "Aircraft.h"
+
+/* Responsible for:
+	- Appending every radar scan (time, id, position, velocity of each track) to a binary history.
+	- The history is a ring of fixed size segment files, each memory mapped while it is written.
+		When the active segment is full it is sealed and the oldest segment is reused.
+	- Writing the time index of each sealed segment (see HistoryIndex.h).
+ */
+
+/*	Format of a segment file (segment_<slot>.hist):
+ * 	history_segment_header, padded to HISTORY_HEADER_SIZE
+ * 	frames, one per scan: history_frame_header followed by frame.count history_track_records
+ * 	Only the bytes before header.writeOffset are valid, a frame is committed by moving writeOffset.
+ */
+
+#define HISTORY_DIRECTORY "/data/home/qnxuser/history"
+
+const char HISTORY_MAGIC[8] = { 'A', 'T', 'C', 'H', 'I', 'S', 'T', '1' };
+const uint32_t HISTORY_VERSION = 1;
+const uint32_t HISTORY_FRAME_MAGIC = 0x4D415246; // "FRAM"
+const size_t HISTORY_HEADER_SIZE = 4096;
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t slot;
+	uint64_t sequence;			// increases with every rotation, the highest sequence is the newest segment
+	int64_t programStartWallNs;	// CLOCK_REALTIME at time 0 of the frame timeline
+	int64_t firstTimeMs;		// time of the first frame, -1 when empty
+	int64_t lastTimeMs;			// time of the last frame, -1 when empty
+	uint64_t frameCount;
+	uint64_t writeOffset;		// end of the committed frames
+	uint64_t segmentSize;
+	uint32_t sealed;			// 1 once the segment is full and will not change until reused
+	uint32_t reserved;
+} history_segment_header;
+
+// One per slot of the ring in timeline.idx, see HistoryIndex.h
+typedef struct {
+	uint32_t slot;
+	uint32_t sealed;
+	uint64_t sequence;		// 0 when the slot has never been written
+	int64_t programStartWallNs;	// identifies the run, times only compare within one run
+	int64_t firstTimeMs;
+	int64_t lastTimeMs;		// -1 while the segment is still being written
+} history_timeline_entry;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t count;
+	int64_t timeMs;				// ms since programStartTime
+} history_frame_header;
+
+typedef struct {
+	int32_t id;
+	float x, y, z;
+	float speedX, speedY, speedZ;
+} history_track_record;
+
+class HistoryRecorder {
+public:
+	HistoryRecorder(std::string iDirectory, size_t iSegmentSize, int iSegmentCount);
+	virtual ~HistoryRecorder();
+
+	// Maps the first segment, false if the history directory can't be used
+	bool open();
+
+	// Appends one frame with every aircraft that has entered the airspace.
+	// The records are written straight into the mapped segment, there is no staging buffer.
+	bool recordScan(int64_t timeMs, const std::vector<Aircraft>& snapshot);
+
+	// Seals the active segment and unmaps it
+	void close();
+
+	uint64_t getBytesWritten() const { return mBytesWritten; }
+	uint64_t getFramesWritten() const { return mFramesWritten; }
+
+	static std::string segmentPath(std::string directory, int slot);
+
+	// Writes frames of aircraftCount synthetic tracks as fast as possible and prints the sustained bandwidth
+	static int benchmark(std::string directory, int aircraftCount, int frames, std::ostream& out);
+
+private:
+	std::string mDirectory;
+	size_t mSegmentSize;
+	int mSegmentCount;
+
+	int mSlot;
+	uint64_t mSequence;
+	int64_t mProgramStartWallNs;	// same for every segment of this run
+	int mFd;
+	char* mBase;
+	history_segment_header* mHeader;
+
+	uint64_t mBytesWritten;
+	uint64_t mFramesWritten;
+
+	// Time range of each slot, written to timeline.idx on every rotation
+	std::vector<history_timeline_entry> mTimeline;
+
+	// Scans come from timer threads which can overlap if one runs late
+	std::mutex mMutex;
+
+	// Seals the current segment (if any) and maps the next slot in the ring
+	bool rotate();
+	// Indexes the active segment, marks it sealed and unmaps it
+	void sealSegment();
+
+	HistoryRecorder(const HistoryRecorder&);
+	HistoryRecorder& operator=(const HistoryRecorder&);
+};
+
+#endif /* SRC_HISTORYRECORDER_H_ */
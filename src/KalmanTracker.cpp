@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "KalmanTracker.h"
+#include "RadarDelta.h"
+
+/* RESPONSIBILITIES
+ *	- The Radar owns one, fed by its sensor model when it is started with "--sensor" (see Radar.h):
+ *		the tracks, not the aircraft, are what the ATCSystem checks for violations.
+ *	- "Main --bench-tracker" measures track updates per second.
+ *	- The vectors use GCC's vector extension, which q++ supports: plain -O2 doesn't vectorize.
+ */
+
+typedef float lanes __attribute__((vector_size(TRACKER_LANES * sizeof(float))));
+
+static inline lanes load(const float* from) {
+	lanes value;
+	memcpy(&value, from, sizeof(value));
+	return value;
+}
+
+static inline void store(float* to, lanes value) {
+	memcpy(to, &value, sizeof(value));
+}
+
+KalmanTracker::KalmanTracker(float iHorizontalNoise, float iVerticalNoise) :
+	mUpdates(0)
+{
+	// No noise would make a gain of 0 / 0 for a certain track
+	mAxes[0].noise = mAxes[1].noise = std::max(iHorizontalNoise * iHorizontalNoise, 1.0f);
+	mAxes[2].noise = std::max(iVerticalNoise * iVerticalNoise, 1.0f);
+}
+
+uint32_t KalmanTracker::slotOf(int id) {
+	std::unordered_map<int, uint32_t>::iterator found = mSlots.find(id);
+	if(found != mSlots.end()){
+		return found->second;
+	}
+
+	uint32_t slot = mIds.size();
+	mSlots[id] = slot;
+	mIds.push_back(id);
+	mTracking.push_back(0);
+	size_t padded = (mIds.size() + TRACKER_LANES - 1) / TRACKER_LANES * TRACKER_LANES;
+	if(padded > mGain.size()){
+		mGain.resize(padded, 0);
+		for(int a = 0; a < 3; a++){
+			mAxes[a].position.resize(padded, 0);
+			mAxes[a].speed.resize(padded, 0);
+			mAxes[a].p00.resize(padded, 0);
+			mAxes[a].p01.resize(padded, 0);
+			mAxes[a].p11.resize(padded, 0);
+			mAxes[a].measured.resize(padded, 0);
+		}
+	}
+	return slot;
+}
+
+void KalmanTracker::step(axis& a, float seconds) {
+	const float dt = seconds, variance = TRACKER_ACCELERATION * TRACKER_ACCELERATION;
+	const float q00 = variance * dt * dt * dt * dt / 4, q01 = variance * dt * dt * dt / 2, q11 = variance * dt * dt;
+	const float noise = a.noise;
+
+	for(size_t i = 0; i < mGain.size(); i += TRACKER_LANES){
+		lanes position = load(&a.position[i]), speed = load(&a.speed[i]);
+		lanes p00 = load(&a.p00[i]), p01 = load(&a.p01[i]), p11 = load(&a.p11[i]);
+		lanes measured = load(&a.measured[i]), gain = load(&mGain[i]);
+
+		// Predict
+		position = position + speed * dt;
+		p00 = p00 + (p01 + p01 + p11 * dt) * dt + q00;
+		p01 = p01 + p11 * dt + q01;
+		p11 = p11 + q11;
+
+		// Correct, by nothing where gain is 0
+		lanes k0 = gain * p00 / (p00 + noise);
+		lanes k1 = gain * p01 / (p00 + noise);
+		lanes innovation = measured - position;
+		position = position + k0 * innovation;
+		speed = speed + k1 * innovation;
+		p11 = p11 - k1 * p01;
+		p00 = p00 - k0 * p00;
+		p01 = p01 - k0 * p01;
+
+		store(&a.position[i], position);
+		store(&a.speed[i], speed);
+		store(&a.p00[i], p00);
+		store(&a.p01[i], p01);
+		store(&a.p11[i], p11);
+	}
+}
+
+void KalmanTracker::start(uint32_t slot, const track_measurement& measurement) {
+	const float positions[3] = { measurement.x, measurement.y, measurement.z };
+	for(int a = 0; a < 3; a++){
+		mAxes[a].position[slot] = positions[a];
+		mAxes[a].speed[slot] = 0;
+		mAxes[a].p00[slot] = mAxes[a].noise;
+		mAxes[a].p01[slot] = 0;
+		mAxes[a].p11[slot] = TRACKER_INITIAL_SPEED * TRACKER_INITIAL_SPEED;
+	}
+	mTracking[slot] = 1;
+}
+
+void KalmanTracker::update(float seconds, const std::vector<track_measurement>& measurements) {
+	// Tracks measured for the first time start after the pass, at their measurement
+	std::fill(mGain.begin(), mGain.end(), 0.0f);
+	std::vector<size_t> starting;
+	for(size_t m = 0; m < measurements.size(); m++){
+		uint32_t slot = measurements[m].slot;
+		if(!mTracking[slot]){
+			starting.push_back(m);
+			continue;
+		}
+		mGain[slot] = 1;
+		mAxes[0].measured[slot] = measurements[m].x;
+		mAxes[1].measured[slot] = measurements[m].y;
+		mAxes[2].measured[slot] = measurements[m].z;
+	}
+
+	for(int a = 0; a < 3; a++){
+		step(mAxes[a], seconds);
+	}
+	for(size_t s = 0; s < starting.size(); s++){
+		start(measurements[starting[s]].slot, measurements[starting[s]]);
+	}
+	mUpdates += mIds.size();
+}
+
+aircraft_state KalmanTracker::stateOf(uint32_t slot) const {
+	aircraft_state state;
+	state.x = mAxes[0].position[slot];
+	state.y = mAxes[1].position[slot];
+	state.z = mAxes[2].position[slot];
+	state.speedX = mAxes[0].speed[slot];
+	state.speedY = mAxes[1].speed[slot];
+	state.speedZ = mAxes[2].speed[slot];
+	return state;
+}
+
+// The same filter one track at a time, each track's values together, to compare the pass with
+namespace {
+	typedef struct {
+		float position, speed, p00, p01, p11;
+	} scalar_axis;
+
+	typedef struct {
+		bool tracking;
+		scalar_axis axes[3];
+	} scalar_track;
+
+	void scalarUpdate(std::vector<scalar_track>& tracks, const float noise[3], float dt,
+			const std::vector<track_measurement>& measurements, std::vector<char>& measuredNow) {
+		const float variance = TRACKER_ACCELERATION * TRACKER_ACCELERATION;
+		const float q00 = variance * dt * dt * dt * dt / 4, q01 = variance * dt * dt * dt / 2, q11 = variance * dt * dt;
+
+		std::fill(measuredNow.begin(), measuredNow.end(), 0);
+		std::vector<const track_measurement*> bySlot(tracks.size(), nullptr);
+		for(size_t m = 0; m < measurements.size(); m++){
+			bySlot[measurements[m].slot] = &measurements[m];
+		}
+		for(size_t t = 0; t < tracks.size(); t++){
+			scalar_track& track = tracks[t];
+			const track_measurement* measurement = bySlot[t];
+			const float positions[3] = { measurement ? measurement->x : 0, measurement ? measurement->y : 0, measurement ? measurement->z : 0 };
+			if(!track.tracking){
+				if(measurement != nullptr){
+					for(int a = 0; a < 3; a++){
+						scalar_axis init = { positions[a], 0, noise[a], 0, TRACKER_INITIAL_SPEED * TRACKER_INITIAL_SPEED };
+						track.axes[a] = init;
+					}
+					track.tracking = true;
+				}
+				continue;
+			}
+			for(int a = 0; a < 3; a++){
+				scalar_axis& s = track.axes[a];
+				s.position += s.speed * dt;
+				s.p00 = s.p00 + (s.p01 + s.p01 + s.p11 * dt) * dt + q00;
+				s.p01 = s.p01 + s.p11 * dt + q01;
+				s.p11 += q11;
+				if(measurement != nullptr){
+					float k0 = s.p00 / (s.p00 + noise[a]), k1 = s.p01 / (s.p00 + noise[a]);
+					float innovation = positions[a] - s.position;
+					s.position += k0 * innovation;
+					s.speed += k1 * innovation;
+					s.p11 -= k1 * s.p01;
+					s.p00 -= k0 * s.p00;
+					s.p01 -= k0 * s.p01;
+				}
+			}
+		}
+	}
+}
+
+int KalmanTracker::benchmark(int maxTracks, int scans, std::ostream& out) {
+	const float horizontalNoise = 300, verticalNoise = 100, dropout = 0.1f;
+
+	std::vector<int> sizes;
+	for(int n = 10000; n < maxTracks; n = (n % 3 == 1) ? n * 3 : n / 3 * 10){
+		sizes.push_back(n);
+	}
+	sizes.push_back(maxTracks);
+
+	out << "+-------------+ Tracker benchmark: " << scans << " scans, noise " << horizontalNoise << " / " << verticalNoise
+			<< " feet, " << (int)(dropout * 100) << "% dropouts, " << TRACKER_LANES << " lanes +-------------+" << std::endl;
+	out << "| tracks | batched updates/s | one at a time updates/s | speedup | measured error ft | track error ft | track speed error ft/s" << std::endl;
+
+	bool same = true;
+	for(size_t s = 0; s < sizes.size(); s++){
+		int n = sizes[s];
+
+		// The traffic of the other benchmarks, its measurements made before the clock starts
+		std::vector<aircraft_state> truth(n);
+		unsigned int seed = 12345;
+		for(int i = 0; i < n; i++){
+			seed = seed * 1103515245 + 12345;
+			truth[i].x = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+			seed = seed * 1103515245 + 12345;
+			truth[i].y = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+			truth[i].z = 10000 + (i % 20) * 1000;
+			truth[i].speedX = (i % 9) * 50 - 200;
+			truth[i].speedY = (i % 7) * 50 - 150;
+			truth[i].speedZ = 0;
+		}
+		std::mt19937 random(n);
+		std::normal_distribution<float> horizontal(0, horizontalNoise), vertical(0, verticalNoise);
+		std::uniform_real_distribution<float> chance(0, 1);
+		std::vector<std::vector<track_measurement> > measurements(scans);
+		double measuredError = 0;
+		for(int scan = 0; scan < scans; scan++){
+			for(int i = 0; i < n; i++){
+				truth[i].x += truth[i].speedX;
+				truth[i].y += truth[i].speedY;
+				if(chance(random) < dropout){
+					continue;
+				}
+				track_measurement m = { (uint32_t)i, truth[i].x + horizontal(random), truth[i].y + horizontal(random), truth[i].z + vertical(random) };
+				measurements[scan].push_back(m);
+				if(scan == scans - 1){
+					measuredError += (m.x - truth[i].x) * (m.x - truth[i].x) + (m.y - truth[i].y) * (m.y - truth[i].y);
+				}
+			}
+		}
+		measuredError = std::sqrt(measuredError / std::max<size_t>(measurements[scans - 1].size(), 1));
+
+		KalmanTracker tracker(horizontalNoise, verticalNoise);
+		for(int i = 0; i < n; i++){
+			tracker.slotOf(i);
+		}
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for(int scan = 0; scan < scans; scan++){
+			tracker.update(1, measurements[scan]);
+		}
+		double batchedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		std::vector<scalar_track> tracks(n);
+		for(int i = 0; i < n; i++){
+			tracks[i].tracking = false;
+		}
+		const float noise[3] = { tracker.mAxes[0].noise, tracker.mAxes[1].noise, tracker.mAxes[2].noise };
+		std::vector<char> measuredNow(n);
+		begin = std::chrono::steady_clock::now();
+		for(int scan = 0; scan < scans; scan++){
+			scalarUpdate(tracks, noise, 1, measurements[scan], measuredNow);
+		}
+		double scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		// Both filters, and how close the tracks are to the aircraft
+		double trackError = 0, speedError = 0;
+		int tracked = 0;
+		for(int i = 0; i < n; i++){
+			if(!tracker.isTracking(i) || !tracks[i].tracking){
+				same = same && tracker.isTracking(i) == tracks[i].tracking;
+				continue;
+			}
+			aircraft_state state = tracker.stateOf(i);
+			same = same && std::fabs(state.x - tracks[i].axes[0].position) < 0.01f && std::fabs(state.y - tracks[i].axes[1].position) < 0.01f
+					&& std::fabs(state.speedX - tracks[i].axes[0].speed) < 0.001f;
+			trackError += (state.x - truth[i].x) * (state.x - truth[i].x) + (state.y - truth[i].y) * (state.y - truth[i].y);
+			speedError += (state.speedX - truth[i].speedX) * (state.speedX - truth[i].speedX)
+					+ (state.speedY - truth[i].speedY) * (state.speedY - truth[i].speedY);
+			tracked++;
+		}
+		trackError = std::sqrt(trackError / std::max(tracked, 1));
+		speedError = std::sqrt(speedError / std::max(tracked, 1));
+
+		double updates = (double)n * scans;
+		out << "| " << n << " | " << (uint64_t)(updates / batchedSeconds) << " | " << (uint64_t)(updates / scalarSeconds)
+				<< " | " << scalarSeconds / batchedSeconds << "x | " << (int)measuredError << " | " << (int)trackError
+				<< " | " << (int)speedError << std::endl;
+	}
+
+	out << "+-------------+ " << (same ? "The batched pass and one track at a time agree" : "BATCHED AND ONE AT A TIME DISAGREE")
+			<< " +-------------+" << std::endl;
+	return same ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#ifndef SRC_KALMANTRACKER_H_
+#define SRC_KALMANTRACKER_H_
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include "Aircraft.h"
+
+/* Responsible for:
+	- Smoothing noisy, intermittent radar positions into a position and speed for every track, with
+		a constant-velocity Kalman filter.
+	- Updating every track of a scan in one batched pass, several tracks per instruction.
+	- Benchmarking track updates per second, batched and one track at a time.
+ */
+
+/*	Each axis of a track is filtered on its own: the state is position and speed, the measurement
+ * 	is the position, and the speed can change by a random acceleration of TRACKER_ACCELERATION
+ * 	between measurements (aircraft turn, climb and change speed). A scan predicts every track by
+ * 	the time since the last one, then corrects the tracks measured in it; a track that wasn't
+ * 	measured only coasts, with its uncertainty growing.
+ *
+ * 	The tracks are kept as one array per value and axis (position, speed and the three values of
+ * 	the covariance), so a scan is the same few operations over contiguous floats, TRACKER_LANES at
+ * 	a time. Unmeasured tracks go through the same operations with a gain of 0, so the pass has no
+ * 	branches. A track starts at its first position with no speed, and an uncertain one.
+ */
+
+#define TRACKER_LANES 4					// floats per vector operation, 16 bytes (SSE2, NEON)
+#define TRACKER_ACCELERATION 2.0f		// feet per second squared, standard deviation
+#define TRACKER_INITIAL_SPEED 600.0f	// feet per second, standard deviation of a new track's speed
+
+// A position measured in a scan, for the track in slot
+typedef struct {
+	uint32_t slot;
+	float x, y, z;
+} track_measurement;
+
+class KalmanTracker {
+public:
+	// The standard deviations of the measured positions
+	KalmanTracker(float iHorizontalNoise = 0, float iVerticalNoise = 0);
+
+	// The slot of aircraft id, a new track (without a position until it is measured) the first time
+	uint32_t slotOf(int id);
+
+	size_t size() const { return mIds.size(); }
+
+	// Whether the track in slot has been measured yet
+	bool isTracking(uint32_t slot) const { return mTracking[slot] != 0; }
+
+	// Predicts every track by seconds, then corrects those measured, in one pass
+	void update(float seconds, const std::vector<track_measurement>& measurements);
+
+	// Smoothed position and speed of the track in slot
+	aircraft_state stateOf(uint32_t slot) const;
+
+	// Tracks updated since the tracker was made
+	uint64_t getUpdates() const { return mUpdates; }
+
+	// 10k to maxTracks tracks of noisy traffic, the batched pass against one track at a time
+	static int benchmark(int maxTracks, int scans, std::ostream& out);
+
+private:
+	// One axis of every track, padded to a whole number of lanes
+	typedef struct {
+		std::vector<float> position, speed;
+		std::vector<float> p00, p01, p11;		// covariance of position and speed
+		std::vector<float> measured;			// position measured this scan
+		float noise;							// variance of a measurement
+	} axis;
+
+	axis mAxes[3];
+	std::vector<float> mGain;					// 1 for the tracks measured this scan, else 0
+	std::vector<char> mTracking;
+	std::vector<int> mIds;
+	std::unordered_map<int, uint32_t> mSlots;	// by aircraft id
+	uint64_t mUpdates;
+
+	// One axis of every track by seconds, lanes at a time
+	void step(axis& a, float seconds);
+
+	void start(uint32_t slot, const track_measurement& measurement);
+};
+
+#endif /* SRC_KALMANTRACKER_H_ */
@@ -5,6 +5,7 @@
 #include <unistd.h>
 #include <mutex>
 #include <chrono>
+#include <algorithm>
 
 using namespace std;
 
@@ -16,56 +17,80 @@ using namespace std;
 #include "CommunicationSystem.h"
 #include "Display.h"
 #include "OperatorConsole.h"
+#include "CommandJournal.h"
+#include "Scenario.h"
+#include "HistoryRecorder.h"
+#include "HistoryIndex.h"
+#include "HistoryCodec.h"
+#include "ReplayEngine.h"
+#include "GridRenderer.h"
+#include "RadarDelta.h"
+#include "RadarBus.h"
+#include "MetricsExporter.h"
+#include "Trace.h"
+#include "SectorNode.h"
+#include "ConflictCache.h"
+#include "BroadPhase.h"
+#include "ResolutionAdvisor.h"
+#include "AlertQueue.h"
+#include "ScriptedConsole.h"
+#include "CommandPipeline.h"
+#include "Fleet.h"
+#include "RuntimeConfig.h"
+#include "SectorEngine.h"
+#include "FlightPlan.h"
+#include "TrajectoryCache.h"
+#include "RestrictedAirspace.h"
+#include "KalmanTracker.h"
 
 // Global mutexes to protect critical sections
 std::mutex coutMutex; 			// Technically a shared memory, so we must lock it when threads are writing to it
-std::mutex predTimeMutex;
-std::mutex ATCSystemRadarData;
+
+// Settings tuned at runtime (prediction time, separation, timer periods)
+RuntimeConfig runtimeConfig;
+
+// Waypoint flight plans, from the scenario and "route"
+FlightPlans flightPlans;
+
+// Restricted zones, from "zones"
+RestrictedAirspace restrictedAirspace;
+
+// Every radar scan, published once by the ATCSystem
+RadarBus radarBus;
+
+// Operator commands on their way to the components
+CommandPipeline commandPipeline;
 
 // Timer to trigger the entry of aircraft
 std::chrono::steady_clock::time_point programStartTime;
 
-void startSystem(string inputOption){
+// With a scriptedConsole the run is headless: it replaces the OperatorConsole, and the process
+// exits with its status when the script's duration is up.
+int startSystem(string inputOption, bool journalSync, sector_layout sectors, bool incremental, broad_phase_kind broadPhase,
+		sensor_model sensor, ScriptedConsole* scriptedConsole = nullptr){
 	vector<Aircraft> initialAircraftList;
-	MockStorage mockStorage;
 	string data;
 
 	// Initialize components
 	Display display;
 	CommunicationSystem commSystem;
-	OperatorConsole opConsole(commSystem);
+	OperatorConsole opConsole(commSystem, journalSync);
 
 
-	if(inputOption == "Low"){
-		data = mockStorage.lowTraffic;
-	}else if (inputOption == "Medium"){
-		data = mockStorage.mediumTraffic;
-	}else if (inputOption == "High"){
-		data = mockStorage.highTraffic;
-	}else{
-		data = mockStorage.congestedTraffic;
+	if(!loadScenario(inputOption, data)){
+		cerr << "Cannot read scenario " << inputOption << endl;
+		return 1;
 	}
 
 	// Parse aircrafts
-	stringstream dataStream(data);
-	string line;
-	while (getline(dataStream, line, ';')) {
-		stringstream ss(line);
-		int entryTime, id;
-		float x, y, z, speedX, speedY, speedZ;
-		char comma;
-
-		if (ss >> entryTime >> comma >> id >> comma >> x >> comma >> y >> comma
-			>> z >> comma >> speedX >> comma >> speedY >> comma >> speedZ) {
-			Aircraft aircraft(entryTime, id, x, y, z, speedX, speedY, speedZ, commSystem);
-			initialAircraftList.push_back(aircraft);
-
-		}
-	}
+	initialAircraftList = parseScenario(data, commSystem);
 
 	cout << "Parsed " << initialAircraftList.size() << " aircraft entries for " << inputOption << " traffic." << endl;
 
 	Radar radar(initialAircraftList);
+	if(sensor.enabled){
+		radar.setSensor(sensor);
+	}
 
 	// Initialize plane threads
 	pthread_t planeThreadArray[initialAircraftList.size()];
@@ -77,16 +102,16 @@ void startSystem(string inputOption){
 	}
 
 	ATCSystem ATCSys(radar, display, commSystem);
+	ATCSys.setSectorLayout(sectors);
+	ATCSys.setIncremental(incremental);
+	ATCSys.setBroadPhase(broadPhase);
 
 	// Initialize and start main threads
 	pthread_t ATCSystemThread;
 	pthread_create(&ATCSystemThread, NULL, &ATCSystem::startThread, &ATCSys);
 
 	pthread_t displayThread;
-	pthread_create(&displayThread, NULL, &Display::startThread, &radar);
-
-	pthread_t opConsoleThread;
-	pthread_create(&opConsoleThread, NULL, &OperatorConsole::startThread, &opConsole);
+	pthread_create(&displayThread, NULL, &Display::startThread, &display);
 
 	pthread_t radarThread;
 	pthread_create(&radarThread, NULL, &Radar::startListenerThread, &radar);
@@ -94,6 +119,27 @@ void startSystem(string inputOption){
 	pthread_t commSystemThread;
 	pthread_create(&commSystemThread, NULL, &CommunicationSystem::startThread, &commSystem);
 
+	pthread_t commandPipelineThread;
+	pthread_create(&commandPipelineThread, NULL, &CommandPipeline::startThread, &commandPipeline);
+
+	Fleet fleet(initialAircraftList);
+	pthread_t fleetThread;
+	pthread_create(&fleetThread, NULL, &Fleet::startListenerThread, &fleet);
+
+	MetricsExporter metricsExporter(METRICS_PATH, METRICS_SOCKET, 5000);
+	pthread_t metricsThread;
+	pthread_create(&metricsThread, NULL, &MetricsExporter::startThread, &metricsExporter);
+
+	if(scriptedConsole != nullptr){
+		int status = scriptedConsole->run(inputOption, initialAircraftList.size(), cout);
+		// The component threads never return, so don't join them or run static destructors under them
+		cout.flush();
+		_exit(status);
+	}
+
+	pthread_t opConsoleThread;
+	pthread_create(&opConsoleThread, NULL, &OperatorConsole::startThread, &opConsole);
+
 	//Simulator will run indefinitely until program is manually stopped.
 
 	for (size_t i = 0; i < initialAircraftList.size(); i++) {
@@ -105,12 +151,198 @@ void startSystem(string inputOption){
 	pthread_join(opConsoleThread, nullptr);
 	pthread_join(radarThread, nullptr);
 	pthread_join(commSystemThread, nullptr);
+	pthread_join(commandPipelineThread, nullptr);
+	pthread_join(fleetThread, nullptr);
+	pthread_join(metricsThread, nullptr);
 
+	return 0;
 }
 
-int main() {
+/* Command line:
+ * 	Main									interactive simulation
+ * 	Main --journal-sync						fsync every operator command before it is sent
+ * 	Main --trace							trace from startup ("trace off [file]" writes it)
+ * 	Main --sectors <columns> <rows>			one conflict check thread per sector, pinned to a core each
+ * 	Main --incremental						check only the pairs near a conflict, from cached intervals
+ * 	Main --broad-phase {brute|grid|sweep}	how the single conflict check finds the pairs to test
+ * 	Main --sensor <h> <v> <dropout> <scans>	a noisy radar (feet of error, share of lost measurements, scans
+ * 											between measurements), the tracks of a Kalman tracker are checked
+ * 	Main --headless <scenario> <seconds> [script]
+ * 											run without the console prompt for a number of seconds, sending
+ * 											the timed commands of a script, then print a timing summary
+ * 	Main --read-journal <file>				print the command timeline of a journal and exit
+ * 	Main --bench-history <dir> [n] [scans]	airspace history write bandwidth, n aircraft per scan (10000)
+ * 	Main --bench-codec [n] [scans]			history compression ratio and decode throughput
+ * 	Main --replay <scenario> <journal|-> [seconds] [runs] [digest]
+ * 											deterministic replay of a scenario and command journal,
+ * 											runs must give identical violations (and match digest)
+ * 	Main --bench-display [max aircraft]		grid frame cost against aircraft count (10 to 100000)
+ * 	Main --bench-radar-delta [n] [seconds]	bytes per second of radar updates, full list against deltas
+ * 	Main --bench-sectors [n] [max sectors]	conflict check time of every sector layout against one engine
+ * 	Main --bench-incremental [n] [scans]	full conflict check against cached intervals, as speeds change
+ * 	Main --bench-broad-phase [n] [scans]	brute force, grid hash and sweep and prune on uniform and clustered traffic
+ * 	Main --bench-advisories [n] [scans]		resolution advisories per second for every violation of dense traffic
+ * 	Main --bench-alerts [n]					top alerts of n violations by time to conflict, against a full sort
+ * 	Main --bench-flight-plans [n] [scans]	the trajectory probe of n aircraft flying plans, cached and not, and
+ * 											its violations and those of straight lines against the flights
+ * 	Main --bench-zones [n] [zones] [scans]	restricted zone incursions of n aircraft through the grid, against every zone
+ * 	Main --bench-tracker [max n] [scans]	tracker updates per second of 10000 to n tracks, batched and one at a time
+ * 	Main --nodes <scenario> <nodes> [seconds] [tcp] [kill <node> <scan>]
+ * 											the sectors split over node processes talking over sockets,
+ * 											checked against one process (--sectors, or one per node)
+ * 	Main --node <index> <nodes> <scenario> [seconds] [tcp]
+ * 											one node process, the others started by hand
+ * 	Main --stress-aircraft [seconds] [readers]
+ * 											concurrent writers and readers of one aircraft, fails on a torn read
+ * 	Main --metrics [socket]					print the metrics of a running simulation (Prometheus text)
+ * 	Main --query <dir> history <id> <t1> <t2>
+ * 	Main --query <dir> nearby <id> <t> <radius> [<t2>]
+ * 											time-travel queries over a recorded history
+ */
+int main(int argc, char* argv[]) {
 	programStartTime = std::chrono::steady_clock::now();
 
+	bool journalSync = false;
+	sector_layout sectors = { 1, 1, true };
+	bool incremental = false;
+	broad_phase_kind broadPhase = BROAD_PHASE_BRUTE;
+	sensor_model sensor = { false, 0, 0, 0, 1, 1 };
+	for(int i = 1; i < argc; i++){
+		string arg = argv[i];
+		if(arg == "--read-journal" && i + 1 < argc){
+			return CommandJournal::readJournal(argv[i + 1], cout) < 0 ? 1 : 0;
+		}else if(arg == "--bench-history" && i + 1 < argc){
+			int aircraftCount = (i + 2 < argc) ? atoi(argv[i + 2]) : 10000;
+			int scans = (i + 3 < argc) ? atoi(argv[i + 3]) : 600;
+			return HistoryRecorder::benchmark(argv[i + 1], aircraftCount, scans, cout);
+		}else if(arg == "--bench-codec"){
+			int aircraftCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 10000;
+			int scans = (i + 2 < argc) ? atoi(argv[i + 2]) : 300;
+			return HistoryEncoder::benchmark(aircraftCount, scans, cout);
+		}else if(arg == "--replay" && i + 2 < argc){
+			int seconds = (i + 3 < argc) ? atoi(argv[i + 3]) : 0;
+			int runs = (i + 4 < argc) ? atoi(argv[i + 4]) : 2;
+			uint64_t digest = (i + 5 < argc) ? strtoull(argv[i + 5], NULL, 16) : 0;
+			return ReplayEngine::replay(argv[i + 1], argv[i + 2], seconds, runs, digest, sectors, incremental, broadPhase, sensor, cout);
+		}else if(arg == "--bench-display"){
+			int maxAircraft = (i + 1 < argc) ? atoi(argv[i + 1]) : 100000;
+			return GridRenderer::benchmark(maxAircraft, cout);
+		}else if(arg == "--bench-radar-delta"){
+			int aircraftCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 10000;
+			int seconds = (i + 2 < argc) ? atoi(argv[i + 2]) : 60;
+			return RadarDeltaEncoder::benchmark(aircraftCount, seconds, cout);
+		}else if(arg == "--bench-sectors"){
+			int aircraftCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 5000;
+			int maxSectors = (i + 2 < argc) ? atoi(argv[i + 2]) : SECTOR_MAX;
+			return SectorEngine::benchmark(std::max(aircraftCount, 2), maxSectors, cout);
+		}else if((arg == "--nodes" && i + 2 < argc) || (arg == "--node" && i + 3 < argc)){
+			bool launcher = arg == "--nodes";
+			node_config config;
+			config.nodeCount = atoi(argv[i + 2]);
+			config.nodeIndex = launcher ? 0 : atoi(argv[i + 1]);
+			string scenario = argv[i + (launcher ? 1 : 3)];
+			int next = i + (launcher ? 3 : 4);
+			config.seconds = (next < argc) ? atoi(argv[next++]) : 60;
+			config.tcp = next < argc && string(argv[next]) == "tcp";
+			if(config.tcp){
+				next++;
+			}
+			config.killNode = -1;
+			config.killScan = 0;
+			if(launcher && next + 2 < argc && string(argv[next]) == "kill"){
+				config.killNode = atoi(argv[next + 1]);
+				config.killScan = atoi(argv[next + 2]);
+			}
+			config.layout = sectors;
+			if(sectors.columns * sectors.rows == 1){
+				config.layout.columns = config.nodeCount;
+			}
+			if(config.nodeCount < 1 || config.nodeCount > config.layout.columns * config.layout.rows
+					|| config.nodeIndex < 0 || config.nodeIndex >= config.nodeCount || config.seconds < 1){
+				cerr << "Usage: Main [--sectors <columns> <rows>] --nodes <scenario> <nodes> [seconds] [tcp] [kill <node> <scan>]" << endl;
+				cerr << "       Main [--sectors <columns> <rows>] --node <index> <nodes> <scenario> [seconds] [tcp]" << endl;
+				cerr << "       at most one node per sector" << endl;
+				return 1;
+			}
+			return launcher ? SectorNode::launch(config, scenario, cout) : SectorNode::runNode(config, scenario, cout);
+		}else if(arg == "--bench-incremental"){
+			int aircraftCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 2000;
+			int scans = (i + 2 < argc) ? atoi(argv[i + 2]) : 30;
+			return ConflictCache::benchmark(std::max(aircraftCount, 2), std::max(scans, 1), cout);
+		}else if(arg == "--bench-broad-phase"){
+			int aircraftCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 5000;
+			int scans = (i + 2 < argc) ? atoi(argv[i + 2]) : 10;
+			return BroadPhase::benchmark(std::max(aircraftCount, 2), std::max(scans, 1), cout);
+		}else if(arg == "--bench-advisories"){
+			int aircraftCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 5000;
+			int scans = (i + 2 < argc) ? atoi(argv[i + 2]) : 3;
+			return ResolutionAdvisor::benchmark(std::max(aircraftCount, 2), std::max(scans, 1), cout);
+		}else if(arg == "--bench-alerts"){
+			int flaggedCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 1000000;
+			return AlertQueue::benchmark(std::max(flaggedCount, 1), cout);
+		}else if(arg == "--bench-flight-plans"){
+			int aircraftCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 2000;
+			int scans = (i + 2 < argc) ? atoi(argv[i + 2]) : 10;
+			return TrajectoryCache::benchmark(std::max(aircraftCount, 2), std::max(scans, 1), cout);
+		}else if(arg == "--bench-zones"){
+			int aircraftCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 10000;
+			int zoneCount = (i + 2 < argc) ? atoi(argv[i + 2]) : 5000;
+			int scans = (i + 3 < argc) ? atoi(argv[i + 3]) : 3;
+			return RestrictedAirspace::benchmark(std::max(aircraftCount, 1), std::max(zoneCount, 1), std::max(scans, 1), cout);
+		}else if(arg == "--bench-tracker"){
+			int maxTracks = (i + 1 < argc) ? atoi(argv[i + 1]) : 100000;
+			int scans = (i + 2 < argc) ? atoi(argv[i + 2]) : 60;
+			return KalmanTracker::benchmark(std::max(maxTracks, 1), std::max(scans, 1), cout);
+		}else if(arg == "--stress-aircraft"){
+			int seconds = (i + 1 < argc) ? atoi(argv[i + 1]) : 5;
+			int readers = (i + 2 < argc) ? atoi(argv[i + 2]) : 4;
+			return Aircraft::stressTest(std::max(seconds, 1), std::max(readers, 1), cout);
+		}else if(arg == "--metrics"){
+			return MetricsExporter::readSocket((i + 1 < argc) ? argv[i + 1] : METRICS_SOCKET, cout);
+		}else if(arg == "--query" && i + 2 < argc){
+			vector<string> m(argv + i + 2, argv + argc);
+			return HistoryQuery::runCommand(argv[i + 1], m, cout) < 0 ? 1 : 0;
+		}else if(arg == "--journal-sync"){
+			journalSync = true;
+		}else if(arg == "--trace"){
+			Trace::enable();
+		}else if(arg == "--broad-phase" && i + 1 < argc){
+			if(!BroadPhase::parseKind(argv[i + 1], broadPhase)){
+				cerr << "Usage: Main --broad-phase {brute|grid|sweep}" << endl;
+				return 1;
+			}
+			i++;
+		}else if(arg == "--incremental"){
+			incremental = true;
+		}else if(arg == "--sensor" && i + 4 < argc){
+			if(!Radar::parseSensor(argv + i + 1, sensor)){
+				cerr << "Usage: Main --sensor <horizontal feet> <vertical feet> <dropout 0 to 1> <update scans>" << endl;
+				return 1;
+			}
+			i += 4;
+		}else if(arg == "--sectors" && i + 2 < argc){
+			sectors.columns = atoi(argv[i + 1]);
+			sectors.rows = atoi(argv[i + 2]);
+			if(sectors.columns < 1 || sectors.rows < 1 || sectors.columns * sectors.rows > SECTOR_MAX){
+				cerr << "Usage: Main --sectors <columns> <rows>, at most " << SECTOR_MAX << " sectors" << endl;
+				return 1;
+			}
+			i += 2;
+		}else if(arg == "--headless" && i + 2 < argc){
+			int seconds = atoi(argv[i + 2]);
+			vector<script_command> script;
+			if(seconds <= 0 || (i + 3 < argc && !ScriptedConsole::loadScript(argv[i + 3], script, cerr))){
+				cerr << "Usage: Main --headless <scenario> <seconds> [script]" << endl;
+				return 1;
+			}
+			ScriptedConsole scriptedConsole(CommunicationSystem(), script, seconds);
+			return startSystem(argv[i + 1], journalSync, sectors, incremental, broadPhase, sensor, &scriptedConsole);
+		}else{
+			cerr << "Unknown option: " << arg << endl;
+			return 1;
+		}
+	}
+
 	// Will have to parse the text file here and file in the the list of
 	// aircrafts then construct the aircraft class with this list
 	// use pThread library to manage priorities
@@ -126,9 +358,7 @@ int main() {
 		cin >> inputOption;
 	}while(inputOption != "Low" && inputOption != "Medium" && inputOption != "High" && inputOption != "Congested");
 
-	startSystem(inputOption);
-
-	return 0;
+	return startSystem(inputOption, journalSync, sectors, incremental, broadPhase, sensor);
 }
 
 
@@ -0,0 +1,197 @@
+#include <sstream>
+#include <limits>
+
+#include "Metrics.h"
+
+/* RESPONSIBILITIES
+ *	- Components register their metrics on first use through metrics() and update them directly.
+ *	- MetricsExporter calls MetricsRegistry::write() every export period and for every client of
+ *		the metrics socket.
+ */
+
+MetricsRegistry& metrics() {
+	static MetricsRegistry registry;
+	return registry;
+}
+
+Histogram::Histogram(const std::vector<double>& iBounds) :
+	mBounds(iBounds), mCounts(new std::atomic<uint64_t>[iBounds.size() + 1]), mSum(0)
+{
+	for(size_t i = 0; i <= mBounds.size(); i++){
+		mCounts[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void Histogram::observe(double value) {
+	size_t bucket = 0;
+	while(bucket < mBounds.size() && value > mBounds[bucket]){
+		bucket++;
+	}
+	mCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	double sum = mSum.load(std::memory_order_relaxed);
+	while(!mSum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)){
+	}
+}
+
+uint64_t Histogram::getCount() const {
+	uint64_t count = 0;
+	for(size_t i = 0; i <= mBounds.size(); i++){
+		count += mCounts[i].load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+double Histogram::getSum() const {
+	return mSum.load(std::memory_order_relaxed);
+}
+
+double Histogram::quantile(double q) const {
+	uint64_t rank = (uint64_t)(q * getCount());
+	uint64_t cumulative = 0;
+	for(size_t i = 0; i < mBounds.size(); i++){
+		cumulative += mCounts[i].load(std::memory_order_relaxed);
+		if(cumulative > rank){
+			return mBounds[i];
+		}
+	}
+	return std::numeric_limits<double>::infinity();
+}
+
+void Histogram::write(std::ostream& out, const std::string& name, const std::string& labels) const {
+	std::string prefix = labels.empty() ? "" : labels + ",";
+	uint64_t cumulative = 0;
+	for(size_t i = 0; i < mBounds.size(); i++){
+		cumulative += mCounts[i].load(std::memory_order_relaxed);
+		out << name << "_bucket{" << prefix << "le=\"" << mBounds[i] << "\"} " << cumulative << "\n";
+	}
+	cumulative += mCounts[mBounds.size()].load(std::memory_order_relaxed);
+	out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << cumulative << "\n";
+
+	std::string braces = labels.empty() ? "" : "{" + labels + "}";
+	out << name << "_sum" << braces << " " << mSum.load(std::memory_order_relaxed) << "\n";
+	out << name << "_count" << braces << " " << cumulative << "\n";
+}
+
+MetricsRegistry::series& MetricsRegistry::find(const std::string& name, const std::string& help,
+		const std::string& type, const std::string& labels) {
+	family* found = nullptr;
+	for(size_t i = 0; i < mFamilies.size() && found == nullptr; i++){
+		if(mFamilies[i]->name == name){
+			found = mFamilies[i].get();
+		}
+	}
+
+	if(found == nullptr){
+		mFamilies.push_back(std::unique_ptr<family>(new family()));
+		found = mFamilies.back().get();
+		found->name = name;
+		found->help = help;
+		found->type = type;
+	}
+
+	for(size_t i = 0; i < found->members.size(); i++){
+		if(found->members[i]->labels == labels){
+			return *found->members[i];
+		}
+	}
+
+	found->members.push_back(std::unique_ptr<series>(new series()));
+	found->members.back()->labels = labels;
+	return *found->members.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	series& s = find(name, help, "counter", labels);
+	if(!s.counter){
+		s.counter.reset(new Counter());
+	}
+	return *s.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	series& s = find(name, help, "gauge", labels);
+	if(!s.gauge){
+		s.gauge.reset(new Gauge());
+	}
+	return *s.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::string& labels,
+		const std::vector<double>& bounds) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	series& s = find(name, help, "histogram", labels);
+	if(!s.histogram){
+		std::vector<double> buckets = bounds;
+		if(buckets.empty()){
+			const double seconds[] = { 0.00001, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 10 };
+			buckets.assign(seconds, seconds + sizeof(seconds) / sizeof(seconds[0]));
+		}
+		s.histogram.reset(new Histogram(buckets));
+	}
+	return *s.histogram;
+}
+
+channel_metrics MetricsRegistry::channel(const std::string& channel) {
+	std::string labels = "channel=\"" + channel + "\"";
+	channel_metrics result;
+	result.opens = &counter("atc_name_open_total", "name_open() calls", labels);
+	result.sends = &counter("atc_ipc_sends_total", "MsgSend() calls", labels);
+	result.failures = &counter("atc_ipc_failures_total", "name_open() or MsgSend() calls that failed", labels);
+	return result;
+}
+
+Histogram* MetricsRegistry::findHistogram(const std::string& name, const std::string& labels) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	for(size_t i = 0; i < mFamilies.size(); i++){
+		if(mFamilies[i]->name != name){
+			continue;
+		}
+		for(size_t j = 0; j < mFamilies[i]->members.size(); j++){
+			if(mFamilies[i]->members[j]->labels == labels){
+				return mFamilies[i]->members[j]->histogram.get();
+			}
+		}
+	}
+	return nullptr;
+}
+
+uint64_t MetricsRegistry::total(const std::string& name) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	uint64_t sum = 0;
+	for(size_t i = 0; i < mFamilies.size(); i++){
+		if(mFamilies[i]->name != name){
+			continue;
+		}
+		for(size_t j = 0; j < mFamilies[i]->members.size(); j++){
+			if(mFamilies[i]->members[j]->counter){
+				sum += mFamilies[i]->members[j]->counter->get();
+			}
+		}
+	}
+	return sum;
+}
+
+void MetricsRegistry::write(std::ostream& out) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for(size_t i = 0; i < mFamilies.size(); i++){
+		const family& f = *mFamilies[i];
+		out << "# HELP " << f.name << " " << f.help << "\n";
+		out << "# TYPE " << f.name << " " << f.type << "\n";
+
+		for(size_t j = 0; j < f.members.size(); j++){
+			const series& s = *f.members[j];
+			std::string braces = s.labels.empty() ? "" : "{" + s.labels + "}";
+			if(s.counter){
+				out << f.name << braces << " " << s.counter->get() << "\n";
+			}else if(s.gauge){
+				out << f.name << braces << " " << s.gauge->get() << "\n";
+			}else if(s.histogram){
+				s.histogram->write(out, f.name, s.labels);
+			}
+		}
+	}
+}
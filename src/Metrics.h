@@ -0,0 +1,114 @@
+#ifndef SRC_METRICS_H_
+#define SRC_METRICS_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <iostream>
+
+/* Responsible for:
+	- Counters, gauges and histograms of the running system (scans, IPC, alerts, logging).
+	- Writing all of them in the Prometheus text format (see MetricsExporter.h for where to).
+ */
+
+/*
+ * Updating a metric is one relaxed atomic operation, and looking one up takes the registry lock,
+ * so call sites look a metric up once (a function static or a member) and keep the reference.
+ * Loops over every aircraft add their count once at the end instead of once per aircraft.
+ *
+ * Labels are given in Prometheus form without the braces, e.g. channel="radar_to_display".
+ * Channels with one instance per aircraft are labelled by their family ("aircraft") to keep the
+ * number of series independent of the fleet size.
+ */
+
+class Counter {
+public:
+	Counter() : mValue(0) {}
+	void add(uint64_t n = 1) { mValue.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t get() const { return mValue.load(std::memory_order_relaxed); }
+private:
+	std::atomic<uint64_t> mValue;
+};
+
+class Gauge {
+public:
+	Gauge() : mValue(0) {}
+	void set(double value) { mValue.store(value, std::memory_order_relaxed); }
+	double get() const { return mValue.load(std::memory_order_relaxed); }
+private:
+	std::atomic<double> mValue;
+};
+
+class Histogram {
+public:
+	// Upper bounds of the buckets, ascending; +Inf is added
+	Histogram(const std::vector<double>& iBounds);
+
+	void observe(double value);
+
+	uint64_t getCount() const;
+	double getSum() const;
+	// Upper bound of the bucket holding the q quantile (0 to 1), +Inf past the last bound
+	double quantile(double q) const;
+
+	void write(std::ostream& out, const std::string& name, const std::string& labels) const;
+
+private:
+	std::vector<double> mBounds;
+	std::unique_ptr<std::atomic<uint64_t>[]> mCounts;	// per bucket, not cumulative, last is +Inf
+	std::atomic<double> mSum;
+};
+
+// The IPC counters of one channel
+typedef struct {
+	Counter* opens;		// name_open() calls
+	Counter* sends;		// MsgSend() calls
+	Counter* failures;	// name_open() or MsgSend() that failed
+} channel_metrics;
+
+class MetricsRegistry {
+public:
+	Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+	Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+	// Default buckets suit durations in seconds, 10 us to 10 s
+	Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+			const std::vector<double>& bounds = std::vector<double>());
+
+	channel_metrics channel(const std::string& channel);
+
+	// For reports: nullptr if nothing registered the series
+	Histogram* findHistogram(const std::string& name, const std::string& labels = "");
+	// Sum over every label set of a counter, 0 if nothing registered it
+	uint64_t total(const std::string& name);
+
+	// Everything, in the Prometheus text exposition format
+	void write(std::ostream& out);
+
+private:
+	typedef struct {
+		std::string labels;
+		std::unique_ptr<Counter> counter;
+		std::unique_ptr<Gauge> gauge;
+		std::unique_ptr<Histogram> histogram;
+	} series;
+
+	typedef struct {
+		std::string name;
+		std::string help;
+		std::string type;
+		std::vector<std::unique_ptr<series> > members;
+	} family;
+
+	std::mutex mMutex;
+	std::vector<std::unique_ptr<family> > mFamilies;
+
+	series& find(const std::string& name, const std::string& help, const std::string& type, const std::string& labels);
+};
+
+// The registry of this process
+MetricsRegistry& metrics();
+
+#endif /* SRC_METRICS_H_ */
@@ -0,0 +1,151 @@
+#include <mutex>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "MetricsExporter.h"
+#include "Metrics.h"
+
+/* RESPONSIBILITIES
+ *	- startSystem() runs MetricsExporter::start() on its own thread. It waits on the listening
+ *		socket between file exports, so neither costs the other components anything.
+ *	- The file is written next to it and renamed, so readers never see half an export.
+ */
+
+extern std::mutex coutMutex;
+
+MetricsExporter::MetricsExporter(std::string iFilePath, std::string iSocketPath, int iPeriodMs) :
+	mFilePath(iFilePath), mSocketPath(iSocketPath), mPeriodMs(iPeriodMs)
+{
+
+}
+
+static bool writeAll(int fd, const std::string& text) {
+	size_t written = 0;
+	while(written < text.size()){
+		ssize_t status = write(fd, text.data() + written, text.size() - written);
+		if(status == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			return false;
+		}
+		written += status;
+	}
+	return true;
+}
+
+void MetricsExporter::writeFile() {
+	std::ostringstream text;
+	metrics().write(text);
+
+	std::string tmpPath = mFilePath + ".tmp";
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if(fd == -1){
+		return;
+	}
+
+	bool ok = writeAll(fd, text.str());
+	close(fd);
+
+	if(!ok || rename(tmpPath.c_str(), mFilePath.c_str()) == -1){
+		perror("MetricsExporter: Cannot write metrics file");
+		unlink(tmpPath.c_str());
+	}
+}
+
+void MetricsExporter::serve(int listenFd) {
+	int client = accept(listenFd, NULL, NULL);
+	if(client == -1){
+		return;
+	}
+
+	std::ostringstream text;
+	metrics().write(text);
+	writeAll(client, text.str());
+	close(client);
+}
+
+void* MetricsExporter::start() {
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenFd != -1){
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, mSocketPath.c_str(), sizeof(address.sun_path) - 1);
+
+		// A socket left over from a previous run
+		unlink(mSocketPath.c_str());
+		if(bind(listenFd, (struct sockaddr*)&address, sizeof(address)) == -1 || listen(listenFd, 4) == -1){
+			perror("MetricsExporter: Cannot listen on metrics socket");
+			close(listenFd);
+			listenFd = -1;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(coutMutex);
+		std::cout << "MetricsExporter: Exporting to " << mFilePath << " every " << mPeriodMs << " ms"
+				<< (listenFd != -1 ? " and on " + mSocketPath : "") << std::endl;
+	}
+
+	std::chrono::steady_clock::time_point nextExport = std::chrono::steady_clock::now();
+	while(true){
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if(now >= nextExport){
+			writeFile();
+			nextExport = now + std::chrono::milliseconds(mPeriodMs);
+		}
+
+		int waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(nextExport - now).count();
+		if(listenFd == -1){
+			usleep(waitMs * 1000);
+			continue;
+		}
+
+		struct pollfd pfd;
+		pfd.fd = listenFd;
+		pfd.events = POLLIN;
+		if(poll(&pfd, 1, waitMs) > 0){
+			serve(listenFd);
+		}
+	}
+
+	return nullptr;
+}
+
+void* MetricsExporter::startThread(void* context) {
+	return static_cast<MetricsExporter*>(context)->start();
+}
+
+int MetricsExporter::readSocket(std::string socketPath, std::ostream& out) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd == -1){
+		perror("MetricsExporter: socket");
+		return 1;
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+	if(connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1){
+		perror(("MetricsExporter: Cannot connect to " + socketPath).c_str());
+		close(fd);
+		return 1;
+	}
+
+	char buffer[4096];
+	ssize_t bytes;
+	while((bytes = read(fd, buffer, sizeof(buffer))) > 0){
+		out.write(buffer, bytes);
+	}
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef SRC_METRICSEXPORTER_H_
+#define SRC_METRICSEXPORTER_H_
+
+#include <string>
+#include <iostream>
+
+/* Responsible for:
+	- Writing the metrics registry to a Prometheus text file every export period
+		(atomically, for a node exporter textfile collector).
+	- Serving the same text on a local UNIX socket: every client that connects gets the
+		current metrics and the connection is closed.
+ */
+
+#define METRICS_PATH "/data/home/qnxuser/metrics.prom"
+#define METRICS_SOCKET "/tmp/atc_metrics.sock"
+
+class MetricsExporter {
+public:
+	MetricsExporter(std::string iFilePath, std::string iSocketPath, int iPeriodMs);
+
+	void* start();
+	static void* startThread(void* context);
+
+	// Client side: prints what the socket serves. Used by "Main --metrics".
+	static int readSocket(std::string socketPath, std::ostream& out);
+
+private:
+	std::string mFilePath;
+	std::string mSocketPath;
+	int mPeriodMs;
+
+	void writeFile();
+	void serve(int listenFd);
+};
+
+#endif /* SRC_METRICSEXPORTER_H_ */
@@ -0,0 +1,97 @@
+#ifndef SRC_OPERATORCOMMAND_H_
+#define SRC_OPERATORCOMMAND_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+/* Responsible for:
+	- An operator command after parsing: which command it is, with its arguments already
+		converted, so the dispatcher never looks at the text again.
+ */
+
+enum command_type {
+	CMD_SHOW_AIRCRAFT,
+	CMD_CHANGE_SPEED,
+	CMD_CHANGE_PRED_TIME,
+	CMD_HISTORY_QUERY,		// history and nearby, answered from the history files
+	CMD_DISPLAY_VIEW,		// zoom, pan and sector
+	CMD_TRACE,
+	CMD_FLEET,				// changespeed or climb of every aircraft a selector picks, in one message
+	CMD_CONFIG,				// show or tune the runtime config, see RuntimeConfig.h
+	CMD_FLIGHT_PLAN,		// route, see FlightPlan.h
+	CMD_RESTRICTED_ZONES	// zones, see RestrictedAirspace.h
+};
+
+enum selector_type {
+	SELECT_IDS,			// 101,1350 or ids(101,1350)
+	SELECT_BOX,			// box(x1,y1,x2,y2), or cell(x,y) of the whole airspace console grid
+	SELECT_BAND,		// band(z1,z2), altitudes
+	SELECT_CONFLICT		// conflict, both aircraft of every violation in the newest scan
+};
+
+typedef struct {
+	selector_type type;
+	std::vector<int> ids;
+	float bounds[4];		// box x1 y1 x2 y2, band z1 z2
+} aircraft_selector;
+
+enum fleet_action {
+	FLEET_CHANGE_SPEED,
+	FLEET_CLIMB
+};
+
+enum config_setting {
+	CONFIG_SHOW,
+	CONFIG_SEPARATION,		// horizontal and vertical feet
+	CONFIG_SCAN_PERIOD,
+	CONFIG_LOG_PERIOD,
+	CONFIG_DISPLAY_REFRESH
+};
+
+#define VIEW_SECTOR_UNCHANGED -2
+
+typedef struct {
+	uint32_t sequence;		// set by CommandPipeline::submit()
+	command_type type;
+	std::string text;		// as typed, for acknowledgements
+	std::chrono::steady_clock::time_point submitted;
+
+	// CMD_CHANGE_SPEED, and CMD_FLEET with FLEET_CHANGE_SPEED
+	int aircraftID;
+	float xSpeed, ySpeed, zSpeed;
+
+	// CMD_FLEET
+	aircraft_selector selector;
+	fleet_action action;
+	float climbFeet;
+
+	// CMD_CHANGE_PRED_TIME
+	int predTime;
+
+	// CMD_FLIGHT_PLAN, the aircraft in selector.ids, x y z of each waypoint (none takes the plan away)
+	std::vector<float> route;
+
+	// CMD_RESTRICTED_ZONES, the zone file to load (empty removes every zone)
+	std::string zonePath;
+
+	// CMD_DISPLAY_VIEW: zoomLevel -1 keeps the level unless zoomChange is +-1
+	int zoomLevel;
+	int zoomChange;
+	int panX, panY;
+	int sector;				// VIEW_SECTOR_UNCHANGED, RADAR_ALL_SECTORS or a sector of "--sectors"
+
+	// CMD_TRACE
+	bool traceOn;
+	std::string tracePath;
+
+	// CMD_CONFIG, configValues[1] only for CONFIG_SEPARATION
+	config_setting setting;
+	int configValues[2];
+
+	// CMD_HISTORY_QUERY, the words of the command (HistoryQuery parses them)
+	std::vector<std::string> words;
+} operator_command;
+
+#endif /* SRC_OPERATORCOMMAND_H_ */
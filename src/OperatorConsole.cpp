@@ -15,17 +15,31 @@
 	- Sets up the CIN to let the operator in the console give inputs.
 	- These inputs are commands which are sent to the communication
 		system using the CommunicationSystem::send(R, m) command
-	- Also logs each request to the VM's memory in a TXT file
+	- Also records each request in the command journal (see CommandJournal.h)
  */
 
 extern std::mutex coutMutex;
 
-OperatorConsole::OperatorConsole(CommunicationSystem iCommSystem) : commSystem(iCommSystem) {
+OperatorConsole::OperatorConsole(CommunicationSystem iCommSystem, bool iJournalSync) :
+		commSystem(iCommSystem), journal(COMMAND_JOURNAL_PATH, iJournalSync, 200) {
 
 }
 
 OperatorConsole::~OperatorConsole() {}
 
+std::vector<std::string> OperatorConsole::splitCommand(const std::string& cmd){
+	std::vector<std::string> components;
+
+	//turn cmd into components seperated by white space
+	std::stringstream ss(cmd);
+	std::string component;
+	while (std::getline(ss, component, ' ')) {
+		components.push_back(component);
+	}
+
+	return components;
+}
+
 void* OperatorConsole::start(){
 	{
 		std::lock_guard<std::mutex> guard(coutMutex);
@@ -42,41 +56,22 @@ void* OperatorConsole::start(){
 
 	std::atomic_bool cinStop;
 	cinStop = false;
-	int fd = creat("/data/home/qnxuser/commandlog.txt", S_IRUSR | S_IWUSR | S_IXUSR);
-	if(fd == -1){
-		perror("OpConsole: Cannot create log file");
-	}
+	journal.open();
 
 	std::string cmd;
 	while(cinStop == false){
 		std::getline(std::cin, cmd);
-		std::vector<std::string> components; //strings seperated by white space
-
-		//turn cmd into components seperated by white space
-		std::stringstream ss(cmd);
-		std::string component;
-		while (std::getline(ss, component, ' ')) {
-			components.push_back(component);
-		}
+		std::vector<std::string> components = splitCommand(cmd); //strings seperated by white space
 
 		if(components.size() == 0 ){
 			continue; //restart while loop, empty command
 		}
 
-		//log command
-		if(fd != -1){
-			//allocate heap
-			char *buffer = new char[cmd.length() + 1];
-
-			//put cmd into buffer
-			strncpy(buffer, cmd.c_str(), cmd.length() +1);
-
-			//write to commandlog.txt
-			write(fd, buffer, cmd.length() + 1);
-			write(fd, "/n", 1);
-
-			//free heap
-			delete[] buffer;
+		//log command, in sync mode it must be on disk before it is sent
+		uint32_t sequence = journal.append(cmd);
+		if(journal.isSyncOnCommit() && !journal.waitForCommit(sequence)){
+			std::lock_guard<std::mutex> guard(coutMutex);
+			std::cout << "OpConsole: Command not journaled, the journal failed or is closed" << std::endl;
 		}
 
 		{
@@ -84,11 +79,8 @@ void* OperatorConsole::start(){
 			std::cout << "OpConsole: Command sent: " << cmd << std::endl;
 		}
 
-		// note: we must listen for the response on another thread
-		int sendStatus = commSystem.send(0, components);
-		if(sendStatus == -1){
-			perror("OpConsole: Command send error");
-		}
+		// Only queues the command, CommSys prints why if it is rejected and acknowledges it once applied
+		commSystem.send(0, components);
 	}
 
 	return nullptr;
@@ -1,17 +1,25 @@
 #ifndef SRC_OPERATORCONSOLE_H_
 #define SRC_OPERATORCONSOLE_H_
 
+#include <string>
+#include <vector>
 #include "CommunicationSystem.h"
+#include "CommandJournal.h"
 
 class OperatorConsole {
 
 private:
 	CommunicationSystem commSystem;
+	CommandJournal journal;
 
 public:
-	OperatorConsole(CommunicationSystem iCommSystem);
+	// iJournalSync makes every command durable (fsync) before it is sent
+	OperatorConsole(CommunicationSystem iCommSystem, bool iJournalSync = false);
 	virtual ~OperatorConsole();
 
+	// Components of a command line, separated by single spaces
+	static std::vector<std::string> splitCommand(const std::string& cmd);
+
 	void* start();
 
 	static void* startThread(void* context);
@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <chrono>
 #include <vector>
 #include <iostream>
 #include <unistd.h>
@@ -9,12 +11,20 @@
 #include "Radar.h"
 #include "Aircraft.h"
 #include "CommunicationSystem.h"
+#include "RadarBus.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+extern RadarBus radarBus;
 
 /*  RESPONSIBILITIES
  *	- Take a runRadar() request, which sends a message to each aircraft for its info.  This
  *		is ran every second by the ATCSystem, which is on a 1 second timer.
- *	- Listen for request from operator for showaircrafts. This triggers runRadar() and returns
- *		all of the aircrafts data to the operator on the display screen
+ *	- With a sensor ("--sensor", see Radar.h), measure the aircraft through it and return the
+ *		tracks of a KalmanTracker instead: checkViolations(), the radar bus and everything after
+ *		them only see the tracks.
+ *	- Listen for request from operator for showaircrafts. This returns the newest scan from the
+ *		radar bus (no extra scan) to the operator on the display screen
  */
 
 typedef struct {
@@ -22,6 +32,7 @@ typedef struct {
 	int aircraftID;
 	float X, Y, Z;
 	float mSpeedX, mSpeedY, mSpeedZ;
+	plan_progress progress;
 	CommunicationSystem commSystem;
 } aircraft_msg;
 
@@ -30,11 +41,38 @@ typedef struct {
 	std::vector<Aircraft> aircraftData;
 } showaircrafts_cmd;
 
-Radar::Radar(std::vector<Aircraft> aircraftList) : initialAircraftList(aircraftList) {
+Radar::Radar(std::vector<Aircraft> aircraftList) : initialAircraftList(aircraftList), mLastScanMs(0), mScans(0) {
+	mSensor.enabled = false;
+	mSensor.horizontalNoise = 0;
+	mSensor.verticalNoise = 0;
+	mSensor.dropout = 0;
+	mSensor.updateScans = 1;
+	mSensor.seed = 1;
 };
 
+void Radar::setSensor(const sensor_model& iSensor) {
+	mSensor = iSensor;
+	mTracker = KalmanTracker(mSensor.horizontalNoise, mSensor.verticalNoise);
+	mRandom.seed(mSensor.seed);
+	mSlots.resize(initialAircraftList.size());
+	for(size_t i = 0; i < initialAircraftList.size(); i++){
+		mSlots[i] = mTracker.slotOf(initialAircraftList[i].getId());
+	}
+}
 
-std::vector<Aircraft> Radar::runRadar() {
+bool Radar::parseSensor(const char* const words[4], sensor_model& sensor) {
+	sensor.enabled = true;
+	sensor.horizontalNoise = atof(words[0]);
+	sensor.verticalNoise = atof(words[1]);
+	sensor.dropout = atof(words[2]);
+	sensor.updateScans = atoi(words[3]);
+	sensor.seed = 1;
+	return sensor.horizontalNoise >= 0 && sensor.verticalNoise >= 0 && sensor.dropout >= 0 && sensor.dropout < 1
+			&& sensor.updateScans >= 1;
+}
+
+
+std::vector<Aircraft> Radar::runRadar(int64_t timeMs) {
     /* I say we skip the PSR part, because:
      * 	We need to know each aircrafts location, but eachs scope is only within its
      * 	respective thread. This means we would have to ask each thread for its info,
@@ -45,6 +83,15 @@ std::vector<Aircraft> Radar::runRadar() {
      * 							- Kyle
      */
 
+    static channel_metrics ipc = metrics().channel("aircraft");
+    static Counter& radarReplies = metrics().counter("atc_aircraft_radar_replies_total", "Radar interrogations answered by aircraft");
+    uint64_t failures = 0;
+    uint64_t replies = 0;
+
+    // One event for the whole interrogation, each aircraft traces its own reply
+    TraceScope trace("runRadar", "radar");
+    trace.setArg("aircraft", initialAircraftList.size());
+
     std::vector<Aircraft> radarFindings;
 
     //go through all of the aircrafts, and send a request for their information
@@ -53,6 +100,7 @@ std::vector<Aircraft> Radar::runRadar() {
     	int coid = name_open(channelName.c_str(), 0);
 		if (coid == -1) {
 			perror("name_open");
+			failures++;
 		}
 
 		aircraft_msg msg;
@@ -62,21 +110,96 @@ std::vector<Aircraft> Radar::runRadar() {
 		int status = MsgSend(coid, &msg, sizeof(msg), &reply, sizeof(reply));
 		if(status == -1) {
 			perror("MsgSend");
+			failures++;
 		}
 
 		//if aircraft didnt reply
 		if(reply.aircraftID == -1){
 			perror("No reply from Aircraft");
+		}else{
+			replies++;
 		}
 
 		Aircraft aircraft(reply.entryTime, reply.aircraftID, reply.X, reply.Y, reply.Z, reply.mSpeedX, reply.mSpeedY, reply.mSpeedZ, reply.commSystem);
+		aircraft.setPlanProgress(reply.progress);
 		radarFindings.push_back(aircraft);
 
 		name_close(coid);
     }
+
+    // Once per scan, not once per aircraft
+    ipc.opens->add(initialAircraftList.size());
+    ipc.sends->add(initialAircraftList.size());
+    ipc.failures->add(failures);
+    radarReplies.add(replies);
+
+    if(mSensor.enabled){
+    	return track(timeMs, radarFindings);
+    }
     return radarFindings;
 }
 
+std::vector<Aircraft> Radar::track(int64_t timeMs, const std::vector<Aircraft>& aircraft) {
+	static Counter& measured = metrics().counter("atc_radar_measurements_total", "Aircraft positions measured by the radar sensor");
+	static Counter& dropped = metrics().counter("atc_radar_dropouts_total", "Measurements the radar sensor lost");
+	static Gauge& tracked = metrics().gauge("atc_radar_tracks", "Aircraft the radar has a track of");
+	static Gauge& trackError = metrics().gauge("atc_radar_track_error_feet", "Root mean square horizontal distance of the tracks from their aircraft, last scan");
+	static Histogram& trackDuration = metrics().histogram("atc_radar_tracker_seconds", "Tracker update of one scan");
+	TRACE_SCOPE("track", "radar");
+
+	// This scan's share of the aircraft, each measured with its own errors
+	std::normal_distribution<float> normal(0, 1);
+	std::uniform_real_distribution<float> chance(0, 1);
+	std::vector<track_measurement> measurements;
+	measurements.reserve(aircraft.size());
+	uint64_t dropouts = 0;
+	for(size_t i = 0; i < aircraft.size(); i++){
+		if((int64_t)aircraft[i].getEntryTime() * 1000 > timeMs || (mScans + aircraft[i].getId()) % mSensor.updateScans != 0){
+			continue;
+		}
+		if(mSensor.dropout > 0 && chance(mRandom) < mSensor.dropout){
+			dropouts++;
+			continue;
+		}
+		aircraft_state state = aircraft[i].getState();
+		track_measurement measurement;
+		measurement.slot = mSlots[i];
+		measurement.x = state.x + mSensor.horizontalNoise * normal(mRandom);
+		measurement.y = state.y + mSensor.horizontalNoise * normal(mRandom);
+		measurement.z = state.z + mSensor.verticalNoise * normal(mRandom);
+		measurements.push_back(measurement);
+	}
+	measured.add(measurements.size());
+	dropped.add(dropouts);
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	float seconds = (mScans == 0) ? 0 : (timeMs - mLastScanMs) / 1000.0f;
+	mTracker.update(seconds, measurements);
+	trackDuration.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+	mLastScanMs = timeMs;
+	mScans++;
+
+	// The tracks in place of the aircraft, in the same order
+	std::vector<Aircraft> tracks;
+	tracks.reserve(aircraft.size());
+	double error = 0;
+	for(size_t i = 0; i < aircraft.size(); i++){
+		if(!mTracker.isTracking(mSlots[i])){
+			continue;
+		}
+		aircraft_state state = mTracker.stateOf(mSlots[i]);
+		aircraft_state truth = aircraft[i].getState();
+		error += (state.x - truth.x) * (state.x - truth.x) + (state.y - truth.y) * (state.y - truth.y);
+
+		tracks.push_back(aircraft[i]);
+		tracks.back().setPos(state.x, state.y, state.z);
+		tracks.back().setSpeed(state.speedX, state.speedY, state.speedZ);
+	}
+	tracked.set(tracks.size());
+	trackError.set(tracks.empty() ? 0 : std::sqrt(error / tracks.size()));
+	return tracks;
+}
+
 // Thread which listens for "showaircrafts"
 void* Radar::startListener() {
 	std::string channelName = "commsys_to_radar";
@@ -85,6 +208,11 @@ void* Radar::startListener() {
 		perror("name_attach");
 	}
 
+	Trace::setThreadName("Radar showaircrafts");
+
+	// Only the newest scan is ever shown
+	std::shared_ptr<RadarSubscription> scans = radarBus.subscribe("showaircrafts", 1, BUS_LATEST);
+
 	int rcvid;
 	showaircrafts_cmd msg;
 
@@ -96,23 +224,34 @@ void* Radar::startListener() {
 		}
 
 		msg.received = true;
+		TRACE_SCOPE("showaircrafts", "ipc");
 
-		// Get all aircraft from a radar scan
-		std::vector<Aircraft> knownAircraft = this->runRadar();
-		msg.aircraftData = knownAircraft;
+		// All aircraft from the newest scan, empty before the first one
+		radar_snapshot_ptr snapshot;
+		if(scans->latest(snapshot)){
+			msg.aircraftData = snapshot->aircraftData;
+		}else{
+			msg.aircraftData.clear();
+		}
 
 		// Send radar result to comm sys
+		static channel_metrics ipc = metrics().channel("radar_to_commsys");
 		std::string channelName = "radar_to_commsys";
 		int coid = name_open(channelName.c_str(), 0);
+		ipc.opens->add();
 		if(coid == -1) {
 			perror("name_open: radar_to_commsys");
+			ipc.failures->add();
 		}
 
 		showaircrafts_cmd reply;
 		int status = MsgSend(coid, &msg, sizeof(msg), &reply, sizeof(reply));
+		ipc.sends->add();
 		if(status == -1){
 			perror("MsgSend");
+			ipc.failures->add();
 		}
+		name_close(coid);
 
 		MsgReply(rcvid, EOK, NULL, 0);
 
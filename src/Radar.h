@@ -20,16 +20,53 @@
  * radar findings, and return this radarFindings list.
  */
 
+/*
+ * Sensor: with "--sensor" the radar doesn't see the aircraft as they are. Each aircraft is measured
+ * every updateScans scans (staggered by id, like a rotating antenna), a measurement is lost with
+ * probability dropout, and a measured position is off by a normal error on each axis. Only the
+ * position is measured. A KalmanTracker smooths the measurements, and the radar returns the
+ * tracks instead of the aircraft: the position and speed the rest of the system sees. An aircraft
+ * shows up once it entered the airspace and was measured once.
+ */
+
 #include "Aircraft.h"
+#include "KalmanTracker.h"
+#include <stdint.h>
+#include <random>
 #include <vector>
 
+typedef struct {
+	bool enabled;				// false: every aircraft as it is, every scan
+	float horizontalNoise;		// feet, standard deviation on x and y
+	float verticalNoise;		// feet, on z
+	float dropout;				// 0 to 1
+	int updateScans;			// scans between two measurements of an aircraft
+	uint32_t seed;				// of the errors and dropouts, a replay sees the same ones every run
+} sensor_model;
+
 class Radar {
 private:
 	std::vector<Aircraft> initialAircraftList;
 
+	sensor_model mSensor;
+	KalmanTracker mTracker;
+	std::vector<uint32_t> mSlots;		// tracker slot of each aircraft of initialAircraftList
+	std::mt19937 mRandom;
+	int64_t mLastScanMs;
+	uint64_t mScans;
+
+	// The tracks of the aircraft of this scan, after measuring them through the sensor
+	std::vector<Aircraft> track(int64_t timeMs, const std::vector<Aircraft>& aircraft);
+
 public:
     Radar(std::vector<Aircraft> aircraftList);
 
+    // Before the first scan
+    void setSensor(const sensor_model& iSensor);
+
+    // "<horizontal feet> <vertical feet> <dropout> <update scans>", false if they make no sensor
+    static bool parseSensor(const char* const words[4], sensor_model& sensor);
+
     int getSizeOfInitialList(){
     	int n = 0;
     	n = initialAircraftList.size();
@@ -39,7 +76,8 @@ public:
     // Controls aircrafts and triggers response from aircraft by id
     void requestPosition(int id);
 
-    std::vector<Aircraft> runRadar();
+    // Every aircraft, or its track with a sensor, at timeMs of the scan
+    std::vector<Aircraft> runRadar(int64_t timeMs);
 
     void* startListener();
 
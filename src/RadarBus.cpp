@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <iostream>
+
+#include "RadarBus.h"
+
+/* RESPONSIBILITIES
+ *	- ATCSystem::scanAirspace() publishes each scan once. The only copy of the aircraft list is
+ *		the one into the shared snapshot.
+ *	- Consumers either run their own thread blocked in next() (radar update publisher, history
+ *		recorder) or take latest() when they need it (display log, showaircrafts), so adding
+ *		a consumer never costs another radar scan.
+ */
+
+RadarSubscription::RadarSubscription(std::string iName, size_t iCapacity, radar_bus_policy iPolicy) :
+	mName(iName), mCapacity(iCapacity < 1 ? 1 : iCapacity), mPolicy(iPolicy),
+	mClosed(false), mDelivered(0), mDropped(0)
+{
+
+}
+
+void RadarSubscription::offer(const radar_snapshot_ptr& snapshot) {
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mClosed){
+		return;
+	}
+
+	if(mQueue.size() >= mCapacity){
+		if(mPolicy == BUS_DROP){
+			mDropped++;
+			return;
+		}else if(mPolicy == BUS_LATEST){
+			mQueue.pop_front();
+			mDropped++;
+		}else{
+			mNotFull.wait(lock, [&]{ return mQueue.size() < mCapacity || mClosed; });
+			if(mClosed){
+				return;
+			}
+		}
+	}
+
+	mQueue.push_back(snapshot);
+	mNotEmpty.notify_one();
+}
+
+bool RadarSubscription::next(radar_snapshot_ptr& snapshot) {
+	std::unique_lock<std::mutex> lock(mMutex);
+	mNotEmpty.wait(lock, [&]{ return !mQueue.empty() || mClosed; });
+	if(mQueue.empty()){
+		return false;
+	}
+
+	snapshot = mQueue.front();
+	mQueue.pop_front();
+	mLast = snapshot;
+	mDelivered++;
+	mNotFull.notify_one();
+	return true;
+}
+
+bool RadarSubscription::latest(radar_snapshot_ptr& snapshot) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	if(!mQueue.empty()){
+		// Everything older than the newest is skipped
+		mDropped += mQueue.size() - 1;
+		mDelivered++;
+		mLast = mQueue.back();
+		mQueue.clear();
+		mNotFull.notify_one();
+	}
+
+	snapshot = mLast;
+	return snapshot != nullptr;
+}
+
+uint64_t RadarSubscription::getDelivered() {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mDelivered;
+}
+
+uint64_t RadarSubscription::getDropped() {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mDropped;
+}
+
+void RadarSubscription::close() {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mClosed = true;
+	mNotEmpty.notify_all();
+	mNotFull.notify_all();
+}
+
+RadarBus::RadarBus() : mSequence(0)
+{
+
+}
+
+std::shared_ptr<RadarSubscription> RadarBus::subscribe(std::string name, size_t capacity, radar_bus_policy policy) {
+	std::shared_ptr<RadarSubscription> subscription = std::make_shared<RadarSubscription>(name, capacity, policy);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mSubscriptions.push_back(subscription);
+	return subscription;
+}
+
+void RadarBus::unsubscribe(const std::shared_ptr<RadarSubscription>& subscription) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mSubscriptions.erase(std::remove(mSubscriptions.begin(), mSubscriptions.end(), subscription), mSubscriptions.end());
+	}
+	subscription->close();
+}
+
+void RadarBus::publish(int64_t timeMs, const std::vector<Aircraft>& aircraftData, const std::vector<violation_pair>& violations) {
+	std::shared_ptr<radar_snapshot> snapshot = std::make_shared<radar_snapshot>();
+	snapshot->timeMs = timeMs;
+	snapshot->aircraftData = aircraftData;
+	snapshot->violations = violations;
+
+	// Offer outside the bus lock, a blocking consumer must not stop others subscribing
+	std::vector<std::shared_ptr<RadarSubscription> > subscriptions;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		snapshot->sequence = ++mSequence;
+		subscriptions = mSubscriptions;
+	}
+
+	radar_snapshot_ptr shared = snapshot;
+	for(size_t i = 0; i < subscriptions.size(); i++){
+		subscriptions[i]->offer(shared);
+	}
+}
+
+void RadarBus::close() {
+	std::lock_guard<std::mutex> lock(mMutex);
+	for(size_t i = 0; i < mSubscriptions.size(); i++){
+		mSubscriptions[i]->close();
+	}
+}
+
+void RadarBus::describe(std::ostream& out) {
+	std::vector<std::shared_ptr<RadarSubscription> > subscriptions;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		subscriptions = mSubscriptions;
+	}
+
+	for(size_t i = 0; i < subscriptions.size(); i++){
+		out << "| " << subscriptions[i]->getName() << ": " << subscriptions[i]->getDelivered()
+			<< " delivered, " << subscriptions[i]->getDropped() << " dropped" << std::endl;
+	}
+}
@@ -0,0 +1,105 @@
+#ifndef SRC_RADARBUS_H_
+#define SRC_RADARBUS_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "Aircraft.h"
+
+/* Responsible for:
+	- Handing every radar scan, published once by the ATCSystem, to any number of consumers
+		in the process (radar update publisher, history recorder, display log, showaircrafts).
+	- A bounded queue per consumer, with the consumer's choice of what happens when it is full.
+ */
+
+/*
+ * Snapshots are shared and never modified after publishing, so a consumer only holds a pointer.
+ *
+ * Policies when a consumer's queue is full:
+ * 	BUS_DROP	the new snapshot is dropped (the consumer sees every scan up to a gap)
+ * 	BUS_LATEST	the oldest queued snapshot is dropped (the consumer always catches up to the newest)
+ * 	BUS_BLOCK	publish() waits for the consumer (nothing is lost, but a slow consumer slows the scan)
+ */
+
+// Two aircraft that will be too close within the prediction time
+typedef struct {
+	int aircraft1ID;
+	int aircraft2ID;
+} violation_pair;
+
+typedef struct {
+	uint64_t sequence;
+	int64_t timeMs;
+	std::vector<Aircraft> aircraftData;
+	std::vector<violation_pair> violations;	// found by the conflict check of this scan
+} radar_snapshot;
+
+typedef std::shared_ptr<const radar_snapshot> radar_snapshot_ptr;
+
+enum radar_bus_policy {
+	BUS_DROP,
+	BUS_LATEST,
+	BUS_BLOCK
+};
+
+class RadarSubscription {
+public:
+	RadarSubscription(std::string iName, size_t iCapacity, radar_bus_policy iPolicy);
+
+	// Waits for the next snapshot. False once the bus is closed and the queue is empty.
+	bool next(radar_snapshot_ptr& snapshot);
+
+	// The newest snapshot seen so far without waiting, emptying the queue. False before the first scan.
+	bool latest(radar_snapshot_ptr& snapshot);
+
+	const std::string& getName() const { return mName; }
+	uint64_t getDelivered();
+	uint64_t getDropped();
+
+private:
+	friend class RadarBus;
+
+	std::string mName;
+	size_t mCapacity;
+	radar_bus_policy mPolicy;
+
+	std::mutex mMutex;
+	std::condition_variable mNotEmpty;
+	std::condition_variable mNotFull;
+	std::deque<radar_snapshot_ptr> mQueue;
+	radar_snapshot_ptr mLast;
+	bool mClosed;
+	uint64_t mDelivered;
+	uint64_t mDropped;
+
+	void offer(const radar_snapshot_ptr& snapshot);
+	void close();
+};
+
+class RadarBus {
+public:
+	RadarBus();
+
+	std::shared_ptr<RadarSubscription> subscribe(std::string name, size_t capacity, radar_bus_policy policy);
+	void unsubscribe(const std::shared_ptr<RadarSubscription>& subscription);
+
+	// Numbers the scan and hands it to every subscription
+	void publish(int64_t timeMs, const std::vector<Aircraft>& aircraftData, const std::vector<violation_pair>& violations);
+
+	// Wakes every consumer waiting in next()
+	void close();
+
+	// Name, delivered and dropped snapshots of every subscription
+	void describe(std::ostream& out);
+
+private:
+	std::mutex mMutex;
+	std::vector<std::shared_ptr<RadarSubscription> > mSubscriptions;
+	uint64_t mSequence;
+};
+
+#endif /* SRC_RADARBUS_H_ */
@@ -0,0 +1,266 @@
+#include <cmath>
+#include <cstring>
+#include <chrono>
+
+#include "RadarDelta.h"
+#include "CommunicationSystem.h"
+
+/* RESPONSIBILITIES
+ *	- RadarPublisher keeps one RadarDeltaEncoder per subscriber and calls encode() when that
+ *		subscriber's update is due. The encoder remembers what it sent, so subscribers with
+ *		different rates or thresholds each get the deltas against their own picture.
+ *	- The Display keeps a RadarDeltaDecoder, applies every update it receives and renders
+ *		the snapshot.
+ */
+
+static const size_t TRACK_RECORD_HEADER = sizeof(int32_t) + sizeof(uint8_t);
+static const size_t TRACK_RECORD_STATE = 6 * sizeof(float);
+
+static char* putTrack(char* cursor, int32_t id, uint8_t kind, const radar_track_state* state) {
+	memcpy(cursor, &id, sizeof(id));
+	cursor += sizeof(id);
+	*cursor++ = kind;
+	if(state != nullptr){
+		memcpy(cursor, &state->x, TRACK_RECORD_STATE);
+		cursor += TRACK_RECORD_STATE;
+	}
+	return cursor;
+}
+
+static bool insideAirspace(const Aircraft& aircraft) {
+	return aircraft.getXPos() >= 0 && aircraft.getYPos() >= 0 &&
+			aircraft.getXPos() < RADAR_AIRSPACE_SIZE && aircraft.getYPos() < RADAR_AIRSPACE_SIZE;
+}
+
+RadarDeltaEncoder::RadarDeltaEncoder(float iMoveThreshold) :
+	mMoveThreshold(iMoveThreshold), mKeyframeNeeded(true), mSequence(0), mLastKeyframeMs(0), mStamp(0)
+{
+
+}
+
+void RadarDeltaEncoder::encode(int64_t timeMs, const std::vector<Aircraft>& aircraftData, std::vector<char>& out) {
+	bool keyframe = mKeyframeNeeded || timeMs - mLastKeyframeMs >= RADAR_KEYFRAME_INTERVAL_MS;
+	if(keyframe){
+		mSent.clear();
+		mLastKeyframeMs = timeMs;
+		mKeyframeNeeded = false;
+	}
+	mStamp++;
+
+	// Worst case every track plus a left record for every track sent before
+	size_t recordSize = TRACK_RECORD_HEADER + TRACK_RECORD_STATE;
+	out.resize(sizeof(radar_update_header) + (aircraftData.size() + mSent.size()) * recordSize);
+	char* cursor = out.data() + sizeof(radar_update_header);
+	uint32_t count = 0;
+
+	float thresholdSquared = mMoveThreshold * mMoveThreshold;
+
+	for(size_t i = 0; i < aircraftData.size(); i++){
+		const Aircraft& aircraft = aircraftData[i];
+		if((int64_t)aircraft.getEntryTime() * 1000 > timeMs || !insideAirspace(aircraft)){
+			continue;
+		}
+
+		radar_track_state now;
+		now.x = aircraft.getXPos();
+		now.y = aircraft.getYPos();
+		now.z = aircraft.getZPos();
+		now.speedX = aircraft.getXSpeed();
+		now.speedY = aircraft.getYSpeed();
+		now.speedZ = aircraft.getZSpeed();
+		now.timeMs = timeMs;
+
+		std::pair<std::unordered_map<int, sent_track>::iterator, bool> inserted =
+				mSent.insert(std::make_pair(aircraft.getId(), sent_track()));
+		sent_track& sent = inserted.first->second;
+		sent.stamp = mStamp;
+
+		if(inserted.second){
+			sent.state = now;
+			cursor = putTrack(cursor, aircraft.getId(), TRACK_ENTERED, &now);
+			count++;
+			continue;
+		}
+
+		const radar_track_state& last = sent.state;
+		bool speedChanged = last.speedX != now.speedX || last.speedY != now.speedY || last.speedZ != now.speedZ;
+		bool moved = false;
+		if(!speedChanged){
+			// Where the subscriber thinks it is
+			float seconds = (timeMs - last.timeMs) / 1000.0f;
+			float dx = last.x + last.speedX * seconds - now.x;
+			float dy = last.y + last.speedY * seconds - now.y;
+			float dz = last.z + last.speedZ * seconds - now.z;
+			moved = dx * dx + dy * dy + dz * dz > thresholdSquared;
+		}
+
+		if(speedChanged || moved){
+			sent.state = now;
+			cursor = putTrack(cursor, aircraft.getId(), TRACK_UPDATED, &now);
+			count++;
+		}
+	}
+
+	// Tracks the subscriber has that weren't in this scan
+	for(std::unordered_map<int, sent_track>::iterator it = mSent.begin(); it != mSent.end(); ){
+		if(it->second.stamp != mStamp){
+			cursor = putTrack(cursor, it->first, TRACK_LEFT, nullptr);
+			count++;
+			it = mSent.erase(it);
+		}else{
+			++it;
+		}
+	}
+
+	radar_update_header header;
+	memset(&header, 0, sizeof(header));
+	header.sequence = ++mSequence;
+	header.count = count;
+	header.timeMs = timeMs;
+	header.keyframe = keyframe ? 1 : 0;
+	memcpy(out.data(), &header, sizeof(header));
+	out.resize(cursor - out.data());
+}
+
+RadarDeltaDecoder::RadarDeltaDecoder() : mSynchronised(false), mSequence(0), mTimeMs(0)
+{
+
+}
+
+bool RadarDeltaDecoder::apply(const char* data, size_t length) {
+	if(length < sizeof(radar_update_header)){
+		return false;
+	}
+
+	radar_update_header header;
+	memcpy(&header, data, sizeof(header));
+
+	if(header.keyframe){
+		mTracks.clear();
+		mSynchronised = true;
+	}else if(!mSynchronised || header.sequence != mSequence + 1){
+		mSynchronised = false;
+		return false;
+	}
+
+	const char* cursor = data + sizeof(header);
+	const char* end = data + length;
+	for(uint32_t i = 0; i < header.count; i++){
+		if(end - cursor < (ptrdiff_t)TRACK_RECORD_HEADER){
+			mSynchronised = false;
+			return false;
+		}
+
+		int32_t id;
+		memcpy(&id, cursor, sizeof(id));
+		uint8_t kind = cursor[sizeof(id)];
+		cursor += TRACK_RECORD_HEADER;
+
+		if(kind == TRACK_LEFT){
+			mTracks.erase(id);
+			continue;
+		}
+
+		if(end - cursor < (ptrdiff_t)TRACK_RECORD_STATE || (kind != TRACK_ENTERED && kind != TRACK_UPDATED)){
+			mSynchronised = false;
+			return false;
+		}
+
+		radar_track_state& track = mTracks[id];
+		memcpy(&track.x, cursor, TRACK_RECORD_STATE);
+		track.timeMs = header.timeMs;
+		cursor += TRACK_RECORD_STATE;
+	}
+
+	mSequence = header.sequence;
+	mTimeMs = header.timeMs;
+	return true;
+}
+
+void RadarDeltaDecoder::snapshot(int64_t timeMs, std::vector<Aircraft>& out) const {
+	out.clear();
+	out.reserve(mTracks.size());
+
+	CommunicationSystem commSystem;
+	for(std::unordered_map<int, radar_track_state>::const_iterator it = mTracks.begin(); it != mTracks.end(); ++it){
+		const radar_track_state& track = it->second;
+		float seconds = (timeMs - track.timeMs) / 1000.0f;
+		out.push_back(Aircraft(0, it->first,
+				track.x + track.speedX * seconds, track.y + track.speedY * seconds, track.z + track.speedZ * seconds,
+				track.speedX, track.speedY, track.speedZ, commSystem));
+	}
+}
+
+int RadarDeltaEncoder::benchmark(int aircraftCount, int seconds, std::ostream& out) {
+	const double changeFractions[] = { 0.0, 0.01, 0.1, 1.0 };
+	CommunicationSystem commSystem;
+
+	out << "+-------------+ Radar update benchmark: " << aircraftCount << " aircraft, " << seconds << " s +-------------+" << std::endl;
+	out << "| changing speed/s | full list bytes/s | delta bytes/s | ratio | max position error | encode us/scan" << std::endl;
+
+	for(size_t c = 0; c < sizeof(changeFractions) / sizeof(changeFractions[0]); c++){
+		std::vector<Aircraft> aircraftData;
+		for(int i = 0; i < aircraftCount; i++){
+			aircraftData.push_back(Aircraft(0, i, 20000 + (i * 7919) % 60000, 20000 + (i * 104729) % 60000, 10000,
+					(i % 9) * 10 - 40, (i % 7) * 10 - 30, 0, commSystem));
+		}
+
+		RadarDeltaEncoder encoder;
+		RadarDeltaDecoder decoder;
+		std::vector<char> update;
+		std::vector<Aircraft> picture;
+		double fullBytes = 0, deltaBytes = 0, encodeSeconds = 0;
+		float maxError = 0;
+		int changesPerSecond = (int)(aircraftCount * changeFractions[c]);
+		unsigned int seed = 12345;
+
+		for(int s = 1; s <= seconds; s++){
+			for(int k = 0; k < changesPerSecond; k++){
+				seed = seed * 1103515245 + 12345;
+				Aircraft& aircraft = aircraftData[(seed >> 8) % aircraftCount];
+				aircraft.setXSpeed(-aircraft.getXSpeed());
+				aircraft.setYSpeed(aircraft.getYSpeed() + 5);
+			}
+			for(int i = 0; i < aircraftCount; i++){
+				Aircraft& aircraft = aircraftData[i];
+				aircraft.setPos(aircraft.getXPos() + aircraft.getXSpeed(), aircraft.getYPos() + aircraft.getYSpeed(),
+						aircraft.getZPos() + aircraft.getZSpeed());
+			}
+
+			int64_t timeMs = (int64_t)s * 1000;
+			auto begin = std::chrono::steady_clock::now();
+			encoder.encode(timeMs, aircraftData, update);
+			encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			// The whole list every scan, as a keyframe would carry it
+			fullBytes += sizeof(radar_update_header) + (double)aircraftCount * (TRACK_RECORD_HEADER + TRACK_RECORD_STATE);
+			if(s > 1){
+				deltaBytes += update.size();
+			}
+
+			decoder.apply(update.data(), update.size());
+			decoder.snapshot(timeMs, picture);
+			std::unordered_map<int, const Aircraft*> byId;
+			for(size_t i = 0; i < picture.size(); i++){
+				byId[picture[i].getId()] = &picture[i];
+			}
+			for(int i = 0; i < aircraftCount; i++){
+				std::unordered_map<int, const Aircraft*>::iterator found = byId.find(aircraftData[i].getId());
+				if(found == byId.end()){
+					continue;
+				}
+				float dx = found->second->getXPos() - aircraftData[i].getXPos();
+				float dy = found->second->getYPos() - aircraftData[i].getYPos();
+				maxError = std::max(maxError, (float)std::sqrt(dx * dx + dy * dy));
+			}
+		}
+
+		// Keyframe excluded, it is paid once per subscriber per minute
+		out << "| " << changeFractions[c] * 100 << "% | " << (long)(fullBytes / seconds) << " | "
+			<< (long)(deltaBytes / (seconds - 1)) << " | " << fullBytes / seconds / std::max(deltaBytes / (seconds - 1), 1.0)
+			<< " | " << maxError << " | " << encodeSeconds * 1e6 / seconds << std::endl;
+	}
+
+	out << "+-------------+ Radar update benchmark end +-------------+" << std::endl;
+	return 0;
+}
@@ -0,0 +1,105 @@
+#ifndef SRC_RADARDELTA_H_
+#define SRC_RADARDELTA_H_
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include "Aircraft.h"
+
+/* Responsible for:
+	- The wire format of radar updates sent to subscribers (the Display and anything else).
+	- Encoding a scan as a keyframe (every track) or as deltas against what that subscriber has
+		already been sent, so the bytes sent follow how much changes, not how many aircraft there are.
+	- Decoding updates back into the subscriber's picture of the airspace.
+ */
+
+/*
+ * An update is a radar_update_header followed by `count` track records, packed:
+ * 	int32 id, uint8 kind, then for TRACK_ENTERED and TRACK_UPDATED six floats
+ * 	(x, y, z, speed x, speed y, speed z). TRACK_LEFT has no payload.
+ *
+ * Between updates the subscriber dead reckons every track from the last position and speed it was
+ * sent. A track is only sent again when its speed changed or its real position is more than the
+ * subscriber's threshold from the dead reckoned one, so aircraft flying straight cost nothing.
+ *
+ * A keyframe replaces the subscriber's whole picture. Deltas carry a sequence number; a decoder
+ * that sees a gap ignores deltas until the next keyframe.
+ */
+
+#define RADAR_AIRSPACE_SIZE 100000
+#define RADAR_KEYFRAME_INTERVAL_MS 60000
+
+enum radar_track_kind {
+	TRACK_ENTERED = 1,	// new to this subscriber
+	TRACK_UPDATED = 2,	// moved beyond the threshold or changed speed
+	TRACK_LEFT = 3		// left the airspace or the radar picture
+};
+
+typedef struct {
+	uint32_t sequence;
+	uint32_t count;
+	int64_t timeMs;
+	uint8_t keyframe;
+	uint8_t reserved[7];
+} radar_update_header;
+
+// What the subscriber knows about one track
+typedef struct {
+	float x, y, z;
+	float speedX, speedY, speedZ;
+	int64_t timeMs;		// when x, y, z were true
+} radar_track_state;
+
+class RadarDeltaEncoder {
+public:
+	RadarDeltaEncoder(float iMoveThreshold = 100);
+
+	// Encodes the scan into out, as a keyframe when one is due or was requested. Aircraft that
+	// haven't entered yet (entry time after timeMs) or are outside the airspace are not sent.
+	void encode(int64_t timeMs, const std::vector<Aircraft>& aircraftData, std::vector<char>& out);
+
+	// Next encode() sends a keyframe, e.g. after a send failed
+	void requestKeyframe() { mKeyframeNeeded = true; }
+
+	void setMoveThreshold(float iMoveThreshold) { mMoveThreshold = iMoveThreshold; }
+
+	// Bytes per second of full snapshots against deltas, for several fractions of aircraft changing speed
+	static int benchmark(int aircraftCount, int seconds, std::ostream& out);
+
+private:
+	float mMoveThreshold;
+	bool mKeyframeNeeded;
+	uint32_t mSequence;
+	int64_t mLastKeyframeMs;
+
+	typedef struct {
+		radar_track_state state;
+		uint32_t stamp;		// encode() that last saw the track
+	} sent_track;
+	std::unordered_map<int, sent_track> mSent;
+	uint32_t mStamp;
+};
+
+class RadarDeltaDecoder {
+public:
+	RadarDeltaDecoder();
+
+	// Applies one update. False if it is malformed or a delta after a gap (wait for a keyframe).
+	bool apply(const char* data, size_t length);
+
+	// The picture dead reckoned to timeMs
+	void snapshot(int64_t timeMs, std::vector<Aircraft>& out) const;
+
+	bool isSynchronised() const { return mSynchronised; }
+	int64_t getTimeMs() const { return mTimeMs; }
+	size_t getTrackCount() const { return mTracks.size(); }
+
+private:
+	bool mSynchronised;
+	uint32_t mSequence;
+	int64_t mTimeMs;
+	std::unordered_map<int, radar_track_state> mTracks;
+};
+
+#endif /* SRC_RADARDELTA_H_ */
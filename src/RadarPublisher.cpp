@@ -0,0 +1,158 @@
+#include <mutex>
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <sys/dispatch.h>
+
+#include "RadarPublisher.h"
+#include "Trace.h"
+
+/* RESPONSIBILITIES
+ *	- ATCSystem::monitorAirspace() calls publish() after every scan. Only subscribers whose period
+ *		is up are encoded and sent, each against what it has been sent before.
+ *	- A subscriber (the Display) attaches its own channel and then calls requestSubscription(),
+ *		which the listener thread turns into subscribe().
+ *	- A subscriber of one sector gets the aircraft whose current position is in it, so aircraft
+ *		handed off to another sector leave its picture.
+ *	- A failed send drops the connection and the next update to that subscriber is a keyframe.
+ */
+
+extern std::mutex coutMutex;
+
+RadarPublisher::RadarPublisher()
+{
+	mLayout.columns = 1;
+	mLayout.rows = 1;
+	mLayout.pinThreads = false;
+
+}
+
+void RadarPublisher::subscribe(const std::string& channelName, int periodMs, float moveThreshold, int sector) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for(size_t i = 0; i < mSubscribers.size(); i++){
+		if(mSubscribers[i].channelName == channelName){
+			mSubscribers[i].periodMs = periodMs;
+			mSubscribers[i].sector = sector;
+			mSubscribers[i].nextUpdateMs = 0;
+			mSubscribers[i].encoder.setMoveThreshold(moveThreshold);
+			mSubscribers[i].encoder.requestKeyframe();
+			return;
+		}
+	}
+
+	subscriber added;
+	added.channelName = channelName;
+	added.periodMs = periodMs;
+	added.sector = sector;
+	added.nextUpdateMs = 0;
+	added.coid = -1;
+	added.encoder.setMoveThreshold(moveThreshold);
+	added.ipc = metrics().channel(channelName);
+	added.bytesSent = &metrics().counter("atc_radar_update_bytes_total", "Bytes of radar updates sent to subscribers",
+			"channel=\"" + channelName + "\"");
+	mSubscribers.push_back(added);
+}
+
+void RadarPublisher::publish(int64_t timeMs, const std::vector<Aircraft>& aircraftData) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for(size_t i = 0; i < mSubscribers.size(); i++){
+		subscriber& sub = mSubscribers[i];
+		if(timeMs < sub.nextUpdateMs){
+			continue;
+		}
+		sub.nextUpdateMs = timeMs + sub.periodMs;
+
+		if(sub.coid == -1){
+			sub.coid = name_open(sub.channelName.c_str(), 0);
+			sub.ipc.opens->add();
+			if(sub.coid == -1){
+				sub.ipc.failures->add();
+				perror(("name_open: " + sub.channelName).c_str());
+				sub.encoder.requestKeyframe();
+				continue;
+			}
+		}
+
+		TraceScope trace("send radar update", "ipc");
+		if(sub.sector == RADAR_ALL_SECTORS){
+			sub.encoder.encode(timeMs, aircraftData, mBuffer);
+		}else{
+			mSectorAircraft.clear();
+			for(size_t a = 0; a < aircraftData.size(); a++){
+				aircraft_state state = aircraftData[a].getState();
+				if(SectorEngine::sectorOf(mLayout, state.x, state.y) == sub.sector){
+					mSectorAircraft.push_back(aircraftData[a]);
+				}
+			}
+			sub.encoder.encode(timeMs, mSectorAircraft, mBuffer);
+		}
+		trace.setArg("bytes", mBuffer.size());
+		sub.ipc.sends->add();
+		sub.bytesSent->add(mBuffer.size());
+		if(MsgSend(sub.coid, mBuffer.data(), mBuffer.size(), NULL, 0) == -1){
+			sub.ipc.failures->add();
+			perror(("MsgSend: " + sub.channelName).c_str());
+			name_close(sub.coid);
+			sub.coid = -1;
+			sub.encoder.requestKeyframe();
+		}
+	}
+}
+
+void RadarPublisher::requestSubscription(const std::string& channelName, int periodMs, float moveThreshold, int sector) {
+	radar_subscribe_msg msg;
+	memset(&msg, 0, sizeof(msg));
+	strncpy(msg.channelName, channelName.c_str(), sizeof(msg.channelName) - 1);
+	msg.periodMs = periodMs;
+	msg.moveThreshold = moveThreshold;
+	msg.sector = sector;
+
+	int coid;
+	while((coid = name_open(RADAR_SUBSCRIBE_CHANNEL, 0)) == -1){
+		sleep(1);
+	}
+
+	if(MsgSend(coid, &msg, sizeof(msg), NULL, 0) == -1){
+		perror("MsgSend: " RADAR_SUBSCRIBE_CHANNEL);
+	}
+	name_close(coid);
+}
+
+void* RadarPublisher::startListener() {
+	name_attach_t *attach = name_attach(NULL, RADAR_SUBSCRIBE_CHANNEL, 0);
+	if(attach == NULL){
+		perror("name_attach");
+		return nullptr;
+	}
+
+	int rcvid;
+	radar_subscribe_msg msg;
+
+	while(true){
+		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), NULL);
+		if(rcvid == -1){
+			perror("MsgReceive");
+			continue;
+		}
+
+		// Reply first: publish() may be sending to this subscriber while holding the lock
+		MsgReply(rcvid, EOK, NULL, 0);
+
+		msg.channelName[sizeof(msg.channelName) - 1] = '\0';
+		subscribe(msg.channelName, msg.periodMs, msg.moveThreshold, msg.sector);
+
+		std::lock_guard<std::mutex> guard(coutMutex);
+		std::cout << "RadarPublisher: " << msg.channelName << " subscribed, every "
+				<< msg.periodMs << " ms, threshold " << msg.moveThreshold;
+		if(msg.sector != RADAR_ALL_SECTORS){
+			std::cout << ", sector " << msg.sector;
+		}
+		std::cout << std::endl;
+	}
+}
+
+void* RadarPublisher::startListenerThread(void* context) {
+	return static_cast<RadarPublisher*>(context)->startListener();
+}
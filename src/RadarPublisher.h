@@ -0,0 +1,71 @@
+#ifndef SRC_RADARPUBLISHER_H_
+#define SRC_RADARPUBLISHER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "Aircraft.h"
+#include "RadarDelta.h"
+#include "Metrics.h"
+#include "SectorEngine.h"
+
+/* Responsible for:
+	- Keeping the list of radar update subscribers, each with its own channel, update period and
+		movement threshold.
+	- Sending each subscriber a keyframe and then deltas (see RadarDelta.h) when its period is up,
+		of the whole airspace or of the aircraft one sector owns.
+ */
+
+#define RADAR_SUBSCRIBE_CHANNEL "atc_radar_subscribe"
+
+// Sent by a subscriber to RADAR_SUBSCRIBE_CHANNEL. Subscribing again changes the period and
+// threshold and asks for a keyframe.
+typedef struct {
+	char channelName[64];
+	int periodMs;
+	float moveThreshold;
+	int sector;			// RADAR_ALL_SECTORS, or only the aircraft this sector owns
+} radar_subscribe_msg;
+
+#define RADAR_ALL_SECTORS -1
+
+class RadarPublisher {
+public:
+	RadarPublisher();
+
+	// Sends every subscriber whose period is up its update for this scan
+	void publish(int64_t timeMs, const std::vector<Aircraft>& aircraftData);
+
+	void subscribe(const std::string& channelName, int periodMs, float moveThreshold, int sector = RADAR_ALL_SECTORS);
+
+	// The sectors a subscriber can ask for, before the first publish()
+	void setSectorLayout(sector_layout iLayout) { mLayout = iLayout; }
+
+	// For subscribers: sends the subscribe message, retrying until the publisher is listening
+	static void requestSubscription(const std::string& channelName, int periodMs, float moveThreshold,
+			int sector = RADAR_ALL_SECTORS);
+
+	void* startListener();
+	static void* startListenerThread(void* context);
+
+private:
+	typedef struct {
+		std::string channelName;
+		int periodMs;
+		int sector;
+		int64_t nextUpdateMs;
+		int coid;
+		RadarDeltaEncoder encoder;
+		channel_metrics ipc;
+		Counter* bytesSent;
+	} subscriber;
+
+	std::mutex mMutex;
+	std::vector<subscriber> mSubscribers;
+	std::vector<char> mBuffer;
+	sector_layout mLayout;
+	std::vector<Aircraft> mSectorAircraft;
+};
+
+#endif /* SRC_RADARPUBLISHER_H_ */
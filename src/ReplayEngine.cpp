@@ -0,0 +1,278 @@
+#include <mutex>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/dispatch.h>
+
+#include "ReplayEngine.h"
+#include "ATCSystem.h"
+#include "Aircraft.h"
+#include "Radar.h"
+#include "Display.h"
+#include "CommunicationSystem.h"
+#include "OperatorConsole.h"
+#include "Scenario.h"
+#include "SimulationClock.h"
+#include "CommandPipeline.h"
+#include "Fleet.h"
+
+/* RESPONSIBILITIES
+ *	- "Main --replay <scenario> <journal>" builds the same components as startSystem(), except that
+ *		the aircraft don't start their position timers and the ATCSystem doesn't start its scan timer.
+ *	- The replay loop then drives time itself (see ReplayEngine.h for the order within a second).
+ *		CommunicationSystem::send() only queues a command, so each one is waited for on the
+ *		CommandPipeline before the replay goes on.
+ *	- Each run happens in a forked child process, so every run starts from fresh components and
+ *		channels. The children send their violation logs back through a pipe to be compared.
+ */
+
+extern CommandPipeline commandPipeline;
+
+ReplayEngine::ReplayEngine(std::string iScenario, std::string iJournalPath, int iDurationSeconds) :
+	mScenario(iScenario), mJournalPath(iJournalPath), mDurationSeconds(iDurationSeconds)
+{
+	mSectors.columns = 1;
+	mSectors.rows = 1;
+	mSectors.pinThreads = false;
+	mIncremental = false;
+	mBroadPhase = BROAD_PHASE_BRUTE;
+	mSensor.enabled = false;
+}
+
+void ReplayEngine::waitForChannel(std::string channelName) {
+	int coid;
+	while((coid = name_open(channelName.c_str(), 0)) == -1){
+		usleep(1000);
+	}
+	name_close(coid);
+}
+
+bool ReplayEngine::run(std::ostream& out, uint64_t& digest) {
+	std::vector<journal_entry> commands;
+	bool truncated = false;
+	if(mJournalPath != "-" && !CommandJournal::loadJournal(mJournalPath, commands, truncated)){
+		out << "Replay: " << mJournalPath << " is not a command journal" << std::endl;
+		return false;
+	}
+
+	std::string data;
+	if(!loadScenario(mScenario, data)){
+		out << "Replay: Cannot read scenario " << mScenario << std::endl;
+		return false;
+	}
+
+	setManualTime(0);
+
+	// The component threads never exit, so everything they use lives until the process ends
+	CommunicationSystem* commSystem = new CommunicationSystem();
+	std::vector<Aircraft>* aircraftList = new std::vector<Aircraft>(parseScenario(data, *commSystem));
+	Radar* radar = new Radar(*aircraftList);
+	if(mSensor.enabled){
+		radar->setSensor(mSensor);
+	}
+	ATCSystem* ATCSys = new ATCSystem(*radar, Display(), *commSystem);
+	ATCSys->setAlertsToDisplay(false);
+	ATCSys->setSectorLayout(mSectors);
+	ATCSys->setIncremental(mIncremental);
+	ATCSys->setBroadPhase(mBroadPhase);
+
+	int durationSeconds = mDurationSeconds;
+	if(durationSeconds <= 0){
+		// Long enough for every aircraft to enter and every command to be applied, plus a prediction window
+		int lastEvent = 0;
+		for(size_t i = 0; i < aircraftList->size(); i++){
+			lastEvent = std::max(lastEvent, (*aircraftList)[i].getEntryTime());
+		}
+		for(size_t i = 0; i < commands.size(); i++){
+			lastEvent = std::max(lastEvent, (int)(commands[i].header.elapsedMs / 1000) + 1);
+		}
+		durationSeconds = lastEvent + 180;
+	}
+
+	for(size_t i = 0; i < aircraftList->size(); i++){
+		Aircraft& aircraft = (*aircraftList)[i];
+		aircraft.setManualClock(true);
+
+		pthread_t aircraftThread;
+		pthread_create(&aircraftThread, NULL, &Aircraft::startThread, &aircraft);
+	}
+
+	pthread_t ATCSysListenerThread;
+	pthread_create(&ATCSysListenerThread, NULL, &ATCSystem::startListenerThread, ATCSys);
+
+	pthread_t radarThread;
+	pthread_create(&radarThread, NULL, &Radar::startListenerThread, radar);
+
+	pthread_t commSystemThread;
+	pthread_create(&commSystemThread, NULL, &CommunicationSystem::startThread, commSystem);
+
+	pthread_t commandPipelineThread;
+	pthread_create(&commandPipelineThread, NULL, &CommandPipeline::startThread, &commandPipeline);
+
+	Fleet* fleet = new Fleet(*aircraftList);
+	pthread_t fleetThread;
+	pthread_create(&fleetThread, NULL, &Fleet::startListenerThread, fleet);
+
+	for(size_t i = 0; i < aircraftList->size(); i++){
+		waitForChannel("aircraft_" + std::to_string((*aircraftList)[i].getId()));
+		waitForChannel("aircraft_commsys_" + std::to_string((*aircraftList)[i].getId()));
+	}
+	waitForChannel("commsys_to_atcsystem");
+	waitForChannel("commsys_to_radar");
+	waitForChannel("radar_to_commsys");
+	waitForChannel(FLEET_CHANNEL);
+
+	std::ostringstream log;
+	size_t nextCommand = 0;
+	int violationCount = 0;
+	std::vector<Aircraft> radarFindings;
+
+	// The real aircraft and scan timers first fire one second after start up
+	for(int T = 1; T <= durationSeconds; T++){
+		int64_t timeMs = (int64_t)T * 1000;
+		setManualTime(timeMs);
+
+		while(nextCommand < commands.size() && commands[nextCommand].header.elapsedMs <= timeMs){
+			const std::string& cmd = commands[nextCommand].command;
+			std::vector<std::string> components = OperatorConsole::splitCommand(cmd);
+			if(!components.empty()){
+				log << "T+" << T << " command " << cmd << "\n";
+				if(commSystem->send(0, components) == -1){
+					log << "T+" << T << " command rejected\n";
+				}
+				commandPipeline.waitForIdle();
+			}
+			nextCommand++;
+		}
+
+		for(size_t i = 0; i < aircraftList->size(); i++){
+			(*aircraftList)[i].advance();
+		}
+
+		std::vector<violation_pair> violations = ATCSys->scanAirspace(timeMs, radarFindings);
+		for(size_t i = 0; i < violations.size(); i++){
+			log << "T+" << T << " violation " << violations[i].aircraft1ID << " " << violations[i].aircraft2ID << "\n";
+		}
+		violationCount += violations.size();
+	}
+
+	// FNV-1a
+	std::string text = log.str();
+	digest = 14695981039346656037ULL;
+	for(size_t i = 0; i < text.size(); i++){
+		digest ^= (unsigned char)text[i];
+		digest *= 1099511628211ULL;
+	}
+
+	out << text;
+	out << "| Seconds: " << durationSeconds << ", aircraft: " << aircraftList->size()
+		<< ", commands: " << nextCommand << (truncated ? " (journal truncated)" : "")
+		<< ", violations: " << violationCount << std::endl;
+	return true;
+}
+
+int ReplayEngine::replay(std::string scenario, std::string journalPath, int durationSeconds, int runs,
+		uint64_t expectedDigest, sector_layout sectors, bool incremental, broad_phase_kind broadPhase, sensor_model sensor,
+		std::ostream& out) {
+	if(runs < 1){
+		runs = 1;
+	}
+
+	out << "+-------------+ Replay: " << scenario << " with " << journalPath << " +-------------+" << std::endl;
+
+	std::string firstLog;
+	uint64_t firstDigest = 0;
+	bool identical = true;
+
+	for(int r = 0; r < runs; r++){
+		int fds[2];
+		if(pipe(fds) == -1){
+			perror("Replay: pipe");
+			return 1;
+		}
+
+		auto begin = std::chrono::steady_clock::now();
+		pid_t pid = fork();
+		if(pid == -1){
+			perror("Replay: fork");
+			return 1;
+		}
+
+		if(pid == 0){
+			// Child: the components' own console output would only interleave with the report
+			close(fds[0]);
+			int devNull = open("/dev/null", O_WRONLY);
+			if(devNull != -1){
+				dup2(devNull, STDOUT_FILENO);
+			}
+
+			std::ostringstream result;
+			uint64_t digest = 0;
+			ReplayEngine engine(scenario, journalPath, durationSeconds);
+			engine.setSectorLayout(sectors);
+			engine.setIncremental(incremental);
+			engine.setBroadPhase(broadPhase);
+			engine.setSensor(sensor);
+			bool ok = engine.run(result, digest);
+
+			std::string text = result.str();
+			ssize_t ignored = write(fds[1], &digest, sizeof(digest));
+			(void)ignored;
+			for(size_t written = 0; written < text.size(); ){
+				ssize_t status = write(fds[1], text.data() + written, text.size() - written);
+				if(status <= 0){
+					break;
+				}
+				written += status;
+			}
+			close(fds[1]);
+			_exit(ok ? 0 : 1);
+		}
+
+		close(fds[1]);
+		uint64_t digest = 0;
+		std::string text;
+		char buffer[4096];
+		ssize_t bytes = read(fds[0], &digest, sizeof(digest));
+		while(bytes > 0 && (bytes = read(fds[0], buffer, sizeof(buffer))) > 0){
+			text.append(buffer, bytes);
+		}
+		close(fds[0]);
+
+		int status = 0;
+		waitpid(pid, &status, 0);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+			out << text;
+			out << "| Run " << r + 1 << " failed" << std::endl;
+			return 1;
+		}
+
+		if(r == 0){
+			firstLog = text;
+			firstDigest = digest;
+			out << text;
+		}else if(text != firstLog){
+			identical = false;
+		}
+
+		out << "| Run " << r + 1 << ": digest 0x" << std::hex << std::setw(16) << std::setfill('0') << digest
+			<< std::dec << std::setfill(' ') << " in " << seconds << " s"
+			<< ((r > 0 && text != firstLog) ? "  DIFFERS FROM RUN 1" : "") << std::endl;
+	}
+
+	bool expected = (expectedDigest == 0 || expectedDigest == firstDigest);
+	if(!expected){
+		out << "| Expected digest 0x" << std::hex << expectedDigest << std::dec << " does not match" << std::endl;
+	}
+
+	out << "+-------------+ Replay " << (identical && expected ? "identical" : "MISMATCH")
+		<< " over " << runs << " runs +-------------+" << std::endl;
+	return (identical && expected) ? 0 : 1;
+}
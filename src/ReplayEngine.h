@@ -0,0 +1,67 @@
+#ifndef SRC_REPLAYENGINE_H_
+#define SRC_REPLAYENGINE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "CommandJournal.h"
+#include "SectorEngine.h"
+#include "BroadPhase.h"
+#include "Radar.h"
+
+/* Responsible for:
+	- Replaying a traffic scenario together with a recorded operator command journal through the
+		real components: commands go through CommunicationSystem::send() to the Aircraft and
+		ATCSystem listener threads, scans go through Radar::runRadar() and ATCSystem::checkViolations().
+	- Running it deterministically and as fast as possible: the simulation clock is set by hand
+		(see SimulationClock.h) and every step waits for the previous one to finish.
+	- Checking that repeated runs produce exactly the same violation output.
+ */
+
+/*	Order of one replay second T:
+ * 	1. the clock is set to T
+ * 	2. every journal command with elapsedMs <= T * 1000 is sent, in journal order
+ * 	3. every aircraft advances one second (Aircraft::advance())
+ * 	4. one scan: Radar::runRadar(), ATCSystem::checkViolations(), violations appended to the output
+ */
+
+class ReplayEngine {
+public:
+	ReplayEngine(std::string iScenario, std::string iJournalPath, int iDurationSeconds);
+
+	// Scans with one conflict check per sector, which must not change the violations
+	void setSectorLayout(sector_layout iLayout) { mSectors = iLayout; }
+
+	// Scans with the incremental conflict check, which must not change them either
+	void setIncremental(bool iIncremental) { mIncremental = iIncremental; }
+
+	// And with a broad phase
+	void setBroadPhase(broad_phase_kind iBroadPhase) { mBroadPhase = iBroadPhase; }
+
+	// Scans through a noisy radar sensor, which changes them, the same way every run
+	void setSensor(const sensor_model& iSensor) { mSensor = iSensor; }
+
+	// Runs one replay in this process. The violation log goes to out, the digest is a hash of it.
+	bool run(std::ostream& out, uint64_t& digest);
+
+	// Runs the replay `runs` times, each in a fresh child process, and compares the violation logs.
+	// With expectedDigest != 0 the digest must also match it (to bisect against a known good build).
+	static int replay(std::string scenario, std::string journalPath, int durationSeconds, int runs,
+			uint64_t expectedDigest, sector_layout sectors, bool incremental, broad_phase_kind broadPhase, sensor_model sensor,
+			std::ostream& out);
+
+private:
+	std::string mScenario;
+	std::string mJournalPath;
+	int mDurationSeconds;
+	sector_layout mSectors;
+	bool mIncremental;
+	broad_phase_kind mBroadPhase;
+	sensor_model mSensor;
+
+	// Waits until a component has attached its channel, so no command or scan is lost at start up
+	static void waitForChannel(std::string channelName);
+};
+
+#endif /* SRC_REPLAYENGINE_H_ */
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "ResolutionAdvisor.h"
+#include "ConflictCheck.h"
+#include "SectorEngine.h"
+#include "BroadPhase.h"
+#include "RadarDelta.h"
+
+/* RESPONSIBILITIES
+ *	- The ATCSystem indexes every scan with alerts and attaches the best advisories to each alert it
+ *		sends to the Display, in order, until ADVISORY_BUDGET_US of the scan is used.
+ *	- The Display prints them as commands the operator can type.
+ *	- "Main --bench-advisories" measures how many violations get advised per second.
+ */
+
+ResolutionAdvisor::ResolutionAdvisor() :
+	mHorizontal(0), mVertical(0), mPredTime(0), mCellSize(1)
+{
+}
+
+static inline int64_t cellOf(float position, float size) {
+	return (int64_t)std::floor(position / size);
+}
+
+static inline uint64_t cellKey(int64_t column, int64_t row) {
+	return ((uint64_t)(uint32_t)column << 32) | (uint32_t)row;
+}
+
+void ResolutionAdvisor::index(const std::vector<Aircraft>& radarFindings, int horizontal, int vertical, int predTime) {
+	mHorizontal = horizontal;
+	mVertical = vertical;
+	mPredTime = predTime;
+
+	// Two projections can only conflict up to a cell apart
+	mCellSize = SECTOR_BUFFER(horizontal);
+
+	size_t n = radarFindings.size();
+	mIds.resize(n);
+	mStates.resize(n);
+	mProjections.resize(n);
+	mPositions.clear();
+	for(std::unordered_map<uint64_t, std::vector<size_t> >::iterator c = mCells.begin(); c != mCells.end(); ++c){
+		c->second.clear();
+	}
+	for(size_t i = 0; i < n; i++){
+		mIds[i] = radarFindings[i].getID();
+		mStates[i] = radarFindings[i].getState();
+		mProjections[i] = projectState(mStates[i], predTime);
+		mPositions[mIds[i]] = i;
+		mCells[cellKey(cellOf(mProjections[i].x, mCellSize), cellOf(mProjections[i].y, mCellSize))].push_back(i);
+	}
+}
+
+const aircraft_state* ResolutionAdvisor::stateOf(int id) const {
+	std::unordered_map<int, size_t>::const_iterator found = mPositions.find(id);
+	return found == mPositions.end() ? nullptr : &mStates[found->second];
+}
+
+int ResolutionAdvisor::conflictsWith(const aircraft_state& projection, size_t self, size_t partner) const {
+	int conflicts = 0;
+	int64_t column = cellOf(projection.x, mCellSize), row = cellOf(projection.y, mCellSize);
+	for(int64_t c = column - 1; c <= column + 1; c++){
+		for(int64_t r = row - 1; r <= row + 1; r++){
+			std::unordered_map<uint64_t, std::vector<size_t> >::const_iterator cell = mCells.find(cellKey(c, r));
+			if(cell == mCells.end()){
+				continue;
+			}
+			for(size_t k = 0; k < cell->second.size(); k++){
+				size_t other = cell->second[k];
+				if(other != self && other != partner && separationLost(projection, mProjections[other], mHorizontal, mVertical)){
+					conflicts++;
+				}
+			}
+		}
+	}
+	return conflicts;
+}
+
+void ResolutionAdvisor::candidates(size_t self, std::vector<advisory>& out) const {
+	const aircraft_state& s = mStates[self];
+	advisory a;
+	a.aircraftID = mIds[self];
+	a.kind = ADVISORY_SPEED;
+	a.climbFeet = 0;
+	a.conflicts = 0;
+
+	// Whole feet per second, the way an operator would type them
+	const float turns[] = { 15, -15, 30, -30, 45, -45, 90, -90 };
+	for(size_t t = 0; t < sizeof(turns) / sizeof(turns[0]); t++){
+		float radians = turns[t] * (float)M_PI / 180;
+		a.speedX = std::round(s.speedX * std::cos(radians) - s.speedY * std::sin(radians));
+		a.speedY = std::round(s.speedX * std::sin(radians) + s.speedY * std::cos(radians));
+		a.speedZ = s.speedZ;
+		out.push_back(a);
+	}
+	const float scales[] = { 0.5, 0.75, 1.25, 1.5 };
+	for(size_t k = 0; k < sizeof(scales) / sizeof(scales[0]); k++){
+		a.speedX = std::round(s.speedX * scales[k]);
+		a.speedY = std::round(s.speedY * scales[k]);
+		a.speedZ = s.speedZ;
+		out.push_back(a);
+	}
+	const float rates[] = { 10, -10, 20, -20 };
+	for(size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++){
+		a.speedX = s.speedX;
+		a.speedY = s.speedY;
+		a.speedZ = s.speedZ + rates[r];
+		out.push_back(a);
+	}
+
+	a.kind = ADVISORY_CLIMB;
+	a.speedX = s.speedX;
+	a.speedY = s.speedY;
+	a.speedZ = s.speedZ;
+	const float climbs[] = { 1000, -1000, 2000, -2000 };
+	for(size_t c = 0; c < sizeof(climbs) / sizeof(climbs[0]); c++){
+		a.climbFeet = climbs[c];
+		out.push_back(a);
+	}
+
+	for(size_t k = 0; k < out.size(); k++){
+		advisory& made = out[k];
+		made.cost = made.kind == ADVISORY_CLIMB ? std::fabs(made.climbFeet) / ADVISORY_CLIMB_COST
+				: std::sqrt((made.speedX - s.speedX) * (made.speedX - s.speedX) + (made.speedY - s.speedY) * (made.speedY - s.speedY)
+						+ (made.speedZ - s.speedZ) * (made.speedZ - s.speedZ));
+	}
+}
+
+int ResolutionAdvisor::advise(const violation_pair& violation, advisory* advisories, int count) {
+	std::unordered_map<int, size_t>::const_iterator first = mPositions.find(violation.aircraft1ID);
+	std::unordered_map<int, size_t>::const_iterator second = mPositions.find(violation.aircraft2ID);
+	if(first == mPositions.end() || second == mPositions.end()){
+		return 0;
+	}
+
+	std::vector<advisory> found;
+	std::vector<advisory> made;
+	const size_t pair[2] = { first->second, second->second };
+	for(int side = 0; side < 2; side++){
+		size_t self = pair[side], partner = pair[1 - side];
+		made.clear();
+		candidates(self, made);
+		for(size_t k = 0; k < made.size(); k++){
+			aircraft_state changed = mStates[self];
+			changed.speedX = made[k].speedX;
+			changed.speedY = made[k].speedY;
+			changed.speedZ = made[k].speedZ;
+			changed.z += made[k].climbFeet;
+			aircraft_state projection = projectState(changed, mPredTime);
+			if(separationLost(projection, mProjections[partner], mHorizontal, mVertical)){
+				continue;
+			}
+			made[k].conflicts = conflictsWith(projection, self, partner);
+			found.push_back(made[k]);
+		}
+	}
+
+	std::sort(found.begin(), found.end(), [](const advisory& a, const advisory& b){
+		return a.conflicts != b.conflicts ? a.conflicts < b.conflicts : a.cost < b.cost;
+	});
+	int given = std::min((int)found.size(), count);
+	std::copy(found.begin(), found.begin() + given, advisories);
+	return given;
+}
+
+std::string ResolutionAdvisor::command(const advisory& a) {
+	std::ostringstream text;
+	if(a.kind == ADVISORY_CLIMB){
+		text << "climb " << a.aircraftID << " " << a.climbFeet;
+	}else{
+		text << "changespeed " << a.aircraftID << " " << a.speedX << " " << a.speedY << " " << a.speedZ;
+	}
+	return text.str();
+}
+
+int ResolutionAdvisor::benchmark(int aircraftCount, int scans, std::ostream& out) {
+	const int horizontal = 3000, vertical = 1000, predTime = 180;
+	CommunicationSystem commSystem;
+
+	// The traffic of the sector benchmark
+	std::vector<Aircraft> radarFindings;
+	unsigned int seed = 12345;
+	for(int i = 0; i < aircraftCount; i++){
+		seed = seed * 1103515245 + 12345;
+		float x = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		seed = seed * 1103515245 + 12345;
+		float y = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		radarFindings.push_back(Aircraft(0, i, x, y, 10000 + (i % 20) * 1000, (i % 9) * 50 - 200, (i % 7) * 50 - 150, 0, commSystem));
+	}
+
+	out << "+-------------+ Advisory benchmark: " << aircraftCount << " aircraft, " << scans << " scans, every violation advised +-------------+" << std::endl;
+	out << "| scan | violations | index ms | advise ms | advisories/s | with an advisory | conflict free | best clears the pair" << std::endl;
+
+	ResolutionAdvisor advisor;
+	BroadPhase broadPhase(BROAD_PHASE_SWEEP);
+	uint64_t totalViolations = 0, totalAdvised = 0, totalCleared = 0;
+	double totalSeconds = 0;
+	for(int scan = 0; scan < scans; scan++){
+		std::vector<aircraft_state> states(aircraftCount), projections(aircraftCount);
+		for(int i = 0; i < aircraftCount; i++){
+			aircraft_state s = radarFindings[i].getState();
+			if(scan > 0){
+				radarFindings[i].setPos(s.x + s.speedX, s.y + s.speedY, s.z + s.speedZ);
+			}
+			states[i] = radarFindings[i].getState();
+			projections[i] = projectState(states[i], predTime);
+		}
+
+		std::vector<std::pair<size_t, size_t> > pairs;
+		std::vector<violation_pair> violations;
+		broadPhase.candidates(states, projections, horizontal, vertical, pairs);
+		for(size_t p = 0; p < pairs.size(); p++){
+			if(separationLost(projections[pairs[p].first], projections[pairs[p].second], horizontal, vertical)){
+				violation_pair violation = { radarFindings[pairs[p].first].getID(), radarFindings[pairs[p].second].getID() };
+				violations.push_back(violation);
+			}
+		}
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		advisor.index(radarFindings, horizontal, vertical, predTime);
+		double indexMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		begin = std::chrono::steady_clock::now();
+		std::vector<advisory> best(violations.size());
+		std::vector<int> given(violations.size());
+		for(size_t v = 0; v < violations.size(); v++){
+			advisory advisories[ADVISORY_MAX];
+			given[v] = advisor.advise(violations[v], advisories, ADVISORY_MAX);
+			if(given[v] > 0){
+				best[v] = advisories[0];
+			}
+		}
+		double adviseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		// The best advisory must clear its pair under the conflict check itself
+		uint64_t advised = 0, conflictFree = 0, cleared = 0;
+		for(size_t v = 0; v < violations.size(); v++){
+			if(given[v] == 0){
+				continue;
+			}
+			advised++;
+			conflictFree += best[v].conflicts == 0;
+			int other = best[v].aircraftID == violations[v].aircraft1ID ? violations[v].aircraft2ID : violations[v].aircraft1ID;
+			// (ids are list positions here)
+			aircraft_state changed = radarFindings[best[v].aircraftID].getState();
+			changed.speedX = best[v].speedX;
+			changed.speedY = best[v].speedY;
+			changed.speedZ = best[v].speedZ;
+			changed.z += best[v].climbFeet;
+			cleared += !separationLost(projectState(changed, predTime), projectState(radarFindings[other].getState(), predTime), horizontal, vertical);
+		}
+		totalViolations += violations.size();
+		totalAdvised += advised;
+		totalCleared += cleared;
+		totalSeconds += adviseSeconds;
+
+		size_t count = std::max(violations.size(), (size_t)1);
+		out << "| " << scan << " | " << violations.size() << " | " << indexMs << " | " << adviseSeconds * 1000 << " | "
+				<< (adviseSeconds > 0 ? violations.size() / adviseSeconds : 0) << " | " << 100.0 * advised / count << "% | "
+				<< 100.0 * conflictFree / count << "% | " << cleared << " of " << advised << std::endl;
+	}
+
+	out << "+-------------+ " << (totalSeconds > 0 ? totalViolations / totalSeconds : 0) << " violations advised per second, "
+			<< totalCleared << " of " << totalAdvised << " best advisories clear their pair +-------------+" << std::endl;
+	return totalCleared == totalAdvised ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+#ifndef SRC_RESOLUTIONADVISOR_H_
+#define SRC_RESOLUTIONADVISOR_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include "Aircraft.h"
+#include "RadarBus.h"
+
+/* Responsible for:
+	- Resolution advisories for a violation: speed, heading, vertical rate and climb changes of
+		either aircraft that clear it, each checked against the whole traffic picture for the
+		conflicts it would cause.
+	- Indexing the projections of a scan in a grid, so a candidate is only checked against the
+		aircraft near its new projection.
+	- Benchmarking advisories per second at high traffic density.
+ */
+
+/*	For each of the two aircraft the candidates are:
+ * 	- turns of 15, 30, 45 and 90 degrees either way, at the same speed
+ * 	- 50%, 75%, 125% and 150% of the horizontal speed
+ * 	- a vertical rate of 10 or 20 feet per second up or down more
+ * 	- a climb or descent of 1000 or 2000 feet (the "climb" command)
+ * 	A candidate is kept if the pair no longer loses separation at the prediction time, which is the
+ * 	test checkViolations() will apply on the next scan. They are ranked by the conflicts the new
+ * 	projection would have with the rest of the traffic, then by how big the change is: a speed
+ * 	change costs its feet per second, a climb one foot per second for every ADVISORY_CLIMB_COST feet.
+ */
+
+#define ADVISORY_MAX 3				// advisories attached to one alert
+#define ADVISORY_BUDGET_US 5000		// per scan, the alerts after that get none
+#define ADVISORY_CLIMB_COST 100
+
+enum advisory_kind {
+	ADVISORY_SPEED,		// changespeed {id} {speedX} {speedY} {speedZ}
+	ADVISORY_CLIMB		// climb {id} {climbFeet}
+};
+
+typedef struct {
+	int aircraftID;
+	int kind;				// advisory_kind
+	float speedX;
+	float speedY;
+	float speedZ;
+	float climbFeet;
+	int conflicts;			// the new projection would lose separation with that many other aircraft
+	float cost;
+} advisory;
+
+class ResolutionAdvisor {
+public:
+	ResolutionAdvisor();
+
+	// The traffic picture of a scan, indexed by projection
+	void index(const std::vector<Aircraft>& radarFindings, int horizontal, int vertical, int predTime);
+
+	// The state of an aircraft in this picture, nullptr if it isn't in it
+	const aircraft_state* stateOf(int id) const;
+
+	// Up to count advisories for a violation of this picture, best first. Returns how many.
+	int advise(const violation_pair& violation, advisory* advisories, int count);
+
+	// The operator command of an advisory
+	static std::string command(const advisory& a);
+
+	static int benchmark(int aircraftCount, int scans, std::ostream& out);
+
+private:
+	std::vector<int> mIds;
+	std::vector<aircraft_state> mStates;
+	std::vector<aircraft_state> mProjections;
+	std::unordered_map<int, size_t> mPositions;		// by id
+	std::unordered_map<uint64_t, std::vector<size_t> > mCells;
+	int mHorizontal;
+	int mVertical;
+	int mPredTime;
+	float mCellSize;
+
+	// Aircraft other than the two given whose projection loses separation with projection
+	int conflictsWith(const aircraft_state& projection, size_t self, size_t partner) const;
+
+	void candidates(size_t self, std::vector<advisory>& out) const;
+};
+
+#endif /* SRC_RESOLUTIONADVISOR_H_ */
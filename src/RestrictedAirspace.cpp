@@ -0,0 +1,314 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "RestrictedAirspace.h"
+#include "RadarDelta.h"
+
+/* RESPONSIBILITIES
+ *	- Main.cpp owns the one RestrictedAirspace of the process, restrictedAirspace. "zones {file}"
+ *		loads a zone file into it and "zones off" empties it (see CommunicationSystem.cpp).
+ *	- ATCSystem::scanAirspace() checks every aircraft against it and sends the incursions to the
+ *		Display with the separation alerts, ranked with them (see AlertQueue.h).
+ *	- "Main --bench-zones" measures the grid against testing every zone.
+ */
+
+static inline int64_t cellOf(float position) {
+	return (int64_t)std::floor(position / ZONE_CELL_FEET);
+}
+
+static inline uint64_t cellKey(int64_t column, int64_t row) {
+	return ((uint64_t)(uint32_t)column << 32) | (uint32_t)row;
+}
+
+ZoneIndex::ZoneIndex(const std::vector<restricted_zone>& iZones) :
+	mZones(iZones)
+{
+	for(uint32_t z = 0; z < mZones.size(); z++){
+		restricted_zone& zone = mZones[z];
+		zone.minX = zone.minY = std::numeric_limits<float>::max();
+		zone.maxX = zone.maxY = -std::numeric_limits<float>::max();
+		for(size_t v = 0; v < zone.polygon.size(); v++){
+			zone.minX = std::min(zone.minX, zone.polygon[v].x);
+			zone.maxX = std::max(zone.maxX, zone.polygon[v].x);
+			zone.minY = std::min(zone.minY, zone.polygon[v].y);
+			zone.maxY = std::max(zone.maxY, zone.polygon[v].y);
+		}
+		for(int64_t c = cellOf(zone.minX); c <= cellOf(zone.maxX); c++){
+			for(int64_t r = cellOf(zone.minY); r <= cellOf(zone.maxY); r++){
+				mCells[cellKey(c, r)].push_back(z);
+			}
+		}
+	}
+}
+
+bool ZoneIndex::contains(const restricted_zone& zone, float x, float y) {
+	// Even-odd rule, a ray towards +x
+	bool inside = false;
+	const std::vector<zone_vertex>& p = zone.polygon;
+	for(size_t i = 0, j = p.size() - 1; i < p.size(); j = i++){
+		if((p[i].y > y) != (p[j].y > y) && x < (p[j].x - p[i].x) * (y - p[i].y) / (p[j].y - p[i].y) + p[i].x){
+			inside = !inside;
+		}
+	}
+	return inside;
+}
+
+bool ZoneIndex::intersect(const restricted_zone& zone, const aircraft_state& state, int predTime, float& entry, float& inside) {
+	// When the path is at the zone's altitudes
+	double begin = 0, end = predTime;
+	if(state.speedZ == 0){
+		if(state.z < zone.floor || state.z > zone.ceiling){
+			return false;
+		}
+	}else{
+		double t1 = (zone.floor - state.z) / state.speedZ, t2 = (zone.ceiling - state.z) / state.speedZ;
+		begin = std::max(begin, std::min(t1, t2));
+		end = std::min(end, std::max(t1, t2));
+		if(begin > end){
+			return false;
+		}
+	}
+
+	// Nowhere near the polygon in that time
+	double xBegin = state.x + state.speedX * begin, xEnd = state.x + state.speedX * end;
+	double yBegin = state.y + state.speedY * begin, yEnd = state.y + state.speedY * end;
+	if(std::max(xBegin, xEnd) < zone.minX || std::min(xBegin, xEnd) > zone.maxX
+			|| std::max(yBegin, yEnd) < zone.minY || std::min(yBegin, yEnd) > zone.maxY){
+		return false;
+	}
+
+	// Where it crosses the edges in that time
+	std::vector<double> times;
+	times.push_back(begin);
+	const std::vector<zone_vertex>& p = zone.polygon;
+	for(size_t i = 0, j = p.size() - 1; i < p.size(); j = i++){
+		double edgeX = p[i].x - p[j].x, edgeY = p[i].y - p[j].y;
+		double denominator = state.speedX * edgeY - state.speedY * edgeX;
+		if(denominator == 0){
+			continue;
+		}
+		double toX = p[j].x - state.x, toY = p[j].y - state.y;
+		double t = (toX * edgeY - toY * edgeX) / denominator;
+		double s = (toX * state.speedY - toY * state.speedX) / denominator;
+		if(s >= 0 && s <= 1 && t > begin && t < end){
+			times.push_back(t);
+		}
+	}
+	times.push_back(end);
+	std::sort(times.begin(), times.end());
+
+	// Each piece between two crossings is wholly inside or outside
+	double first = -1, total = 0;
+	for(size_t k = 0; k + 1 < times.size(); k++){
+		double middle = (times[k] + times[k + 1]) / 2;
+		if(contains(zone, state.x + state.speedX * middle, state.y + state.speedY * middle)){
+			if(first < 0){
+				first = times[k];
+			}
+			total += times[k + 1] - times[k];
+		}
+	}
+	if(first < 0){
+		return false;
+	}
+	entry = first;
+	inside = total;
+	return true;
+}
+
+void ZoneIndex::incursions(int aircraftID, const aircraft_state& state, int predTime, std::vector<zone_incursion>& out) const {
+	if(mZones.empty()){
+		return;
+	}
+
+	// The cells the path crosses, one after the other
+	double x0 = state.x, y0 = state.y;
+	double dx = state.speedX * (double)predTime, dy = state.speedY * (double)predTime;
+	int64_t column = cellOf(x0), row = cellOf(y0);
+	int64_t lastColumn = cellOf(x0 + dx), lastRow = cellOf(y0 + dy);
+	int stepX = dx > 0 ? 1 : -1, stepY = dy > 0 ? 1 : -1;
+	double inf = std::numeric_limits<double>::infinity();
+	double nextX = dx != 0 ? ((column + (dx > 0)) * (double)ZONE_CELL_FEET - x0) / dx : inf;
+	double nextY = dy != 0 ? ((row + (dy > 0)) * (double)ZONE_CELL_FEET - y0) / dy : inf;
+	double deltaX = dx != 0 ? ZONE_CELL_FEET / std::fabs(dx) : inf;
+	double deltaY = dy != 0 ? ZONE_CELL_FEET / std::fabs(dy) : inf;
+
+	std::vector<uint32_t> candidates;
+	int64_t cells = std::llabs(lastColumn - column) + std::llabs(lastRow - row) + 1;
+	for(int64_t c = 0; c < cells; c++){
+		std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator cell = mCells.find(cellKey(column, row));
+		if(cell != mCells.end()){
+			candidates.insert(candidates.end(), cell->second.begin(), cell->second.end());
+		}
+		if(nextX < nextY){
+			column += stepX;
+			nextX += deltaX;
+		}else{
+			row += stepY;
+			nextY += deltaY;
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	for(size_t k = 0; k < candidates.size(); k++){
+		const restricted_zone& zone = mZones[candidates[k]];
+		float entry, inside;
+		if(intersect(zone, state, predTime, entry, inside)){
+			zone_incursion incursion = { aircraftID, zone.id, entry, predTime > 0 ? inside / predTime : 1.0f };
+			out.push_back(incursion);
+		}
+	}
+}
+
+void ZoneIndex::incursionsOfAll(int aircraftID, const aircraft_state& state, int predTime, std::vector<zone_incursion>& out) const {
+	for(size_t z = 0; z < mZones.size(); z++){
+		float entry, inside;
+		if(intersect(mZones[z], state, predTime, entry, inside)){
+			zone_incursion incursion = { aircraftID, mZones[z].id, entry, predTime > 0 ? inside / predTime : 1.0f };
+			out.push_back(incursion);
+		}
+	}
+}
+
+RestrictedAirspace::RestrictedAirspace() {
+	ZoneIndex* empty = new ZoneIndex(std::vector<restricted_zone>());
+	mVersions.push_back(std::unique_ptr<ZoneIndex>(empty));
+	mCurrent.store(empty, std::memory_order_release);
+}
+
+const ZoneIndex* RestrictedAirspace::load(const std::vector<restricted_zone>& zones) {
+	// Built outside the scan, which keeps using the old index until the store
+	ZoneIndex* next = new ZoneIndex(zones);
+
+	std::lock_guard<std::mutex> lock(mLoadMutex);
+	mVersions.push_back(std::unique_ptr<ZoneIndex>(next));
+	mCurrent.store(next, std::memory_order_release);
+	return next;
+}
+
+std::vector<restricted_zone> RestrictedAirspace::parse(const std::string& data) {
+	std::vector<restricted_zone> zones;
+
+	std::stringstream dataStream(data);
+	std::string entry;
+	while(std::getline(dataStream, entry, ';')){
+		std::stringstream ss(entry);
+		restricted_zone zone;
+		char comma;
+		if(!(ss >> zone.id >> comma >> zone.floor >> comma >> zone.ceiling) || zone.floor > zone.ceiling){
+			continue;
+		}
+		zone_vertex vertex;
+		char arrow;
+		while(ss >> arrow && arrow == '>' && ss >> vertex.x >> vertex.y){
+			zone.polygon.push_back(vertex);
+		}
+		if(zone.polygon.size() >= 3){
+			zones.push_back(zone);
+		}
+	}
+	return zones;
+}
+
+bool RestrictedAirspace::readFile(const std::string& path, std::vector<restricted_zone>& zones) {
+	std::ifstream file(path.c_str());
+	if(!file){
+		return false;
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	zones = parse(contents.str());
+	return true;
+}
+
+int RestrictedAirspace::benchmark(int aircraftCount, int zoneCount, int scans, std::ostream& out) {
+	const int predTime = 180;
+
+	// Zones 500 to 2500 feet across and a few thousand feet deep, star shaped so some are concave
+	std::vector<restricted_zone> zones(zoneCount);
+	unsigned int seed = 54321;
+	for(int z = 0; z < zoneCount; z++){
+		seed = seed * 1103515245 + 12345;
+		float centerX = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		seed = seed * 1103515245 + 12345;
+		float centerY = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		seed = seed * 1103515245 + 12345;
+		float radius = 250 + (seed >> 8) % 1001;
+		zones[z].id = z + 1;
+		zones[z].floor = ((seed >> 20) % 4) * 5000.0f;
+		zones[z].ceiling = zones[z].floor + 2000 + ((seed >> 12) % 9) * 1000.0f;
+		for(int v = 0; v < 6; v++){
+			seed = seed * 1103515245 + 12345;
+			float reach = radius * (0.6f + ((seed >> 8) % 41) / 100.0f);
+			float angle = v * (float)M_PI / 3;
+			zone_vertex vertex = { centerX + reach * std::cos(angle), centerY + reach * std::sin(angle) };
+			zones[z].polygon.push_back(vertex);
+		}
+	}
+	ZoneIndex index(zones);
+
+	// The traffic of the sector benchmark, a third of it climbing or descending
+	std::vector<aircraft_state> states(aircraftCount);
+	seed = 12345;
+	for(int i = 0; i < aircraftCount; i++){
+		seed = seed * 1103515245 + 12345;
+		states[i].x = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		seed = seed * 1103515245 + 12345;
+		states[i].y = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		states[i].z = 10000 + (i % 20) * 1000;
+		states[i].speedX = (i % 9) * 50 - 200;
+		states[i].speedY = (i % 7) * 50 - 150;
+		states[i].speedZ = (i % 3 == 0) ? ((i % 2) ? 20 : -20) : 0;
+	}
+
+	out << "+-------------+ Restricted zone benchmark: " << aircraftCount << " aircraft, " << zoneCount << " zones, "
+			<< scans << " scans, predicting " << predTime << " s +-------------+" << std::endl;
+	out << "| scan | inside now | predicted | grid ms | every zone ms | speedup" << std::endl;
+
+	bool same = true;
+	double gridTotal = 0, allTotal = 0;
+	for(int scan = 0; scan < scans; scan++){
+		if(scan > 0){
+			for(int i = 0; i < aircraftCount; i++){
+				states[i].x += states[i].speedX;
+				states[i].y += states[i].speedY;
+				states[i].z += states[i].speedZ;
+			}
+		}
+
+		std::vector<zone_incursion> grid, all;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for(int i = 0; i < aircraftCount; i++){
+			index.incursions(i, states[i], predTime, grid);
+		}
+		double gridMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		begin = std::chrono::steady_clock::now();
+		for(int i = 0; i < aircraftCount; i++){
+			index.incursionsOfAll(i, states[i], predTime, all);
+		}
+		double allMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		same = same && grid.size() == all.size();
+		size_t insideNow = 0;
+		for(size_t k = 0; same && k < grid.size(); k++){
+			same = grid[k].aircraftID == all[k].aircraftID && grid[k].zoneID == all[k].zoneID;
+			insideNow += grid[k].timeToIncursion == 0;
+		}
+		gridTotal += gridMs;
+		allTotal += allMs;
+
+		out << "| " << scan << " | " << insideNow << " | " << grid.size() - insideNow << " | " << gridMs << " | " << allMs
+				<< " | " << (gridMs > 0 ? allMs / gridMs : 0) << "x" << std::endl;
+	}
+
+	out << "+-------------+ " << (same ? "The grid found the incursions of every zone" : "GRID AND EVERY ZONE DISAGREE")
+			<< ", " << (gridTotal > 0 ? allTotal / gridTotal : 0) << "x faster +-------------+" << std::endl;
+	return same ? 0 : 1;
+}
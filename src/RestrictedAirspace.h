@@ -0,0 +1,106 @@
+#ifndef SRC_RESTRICTEDAIRSPACE_H_
+#define SRC_RESTRICTEDAIRSPACE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include "Aircraft.h"
+
+/* Responsible for:
+	- Restricted zones: polygons on the map with an altitude band, loaded by the operator.
+	- Finding every aircraft that is inside a zone, or will fly into one within the prediction
+		time, through a grid over the zones so each aircraft is only tested against the zones
+		along its way.
+	- Benchmarking the grid against testing every zone, with thousands of zones.
+ */
+
+/*	Zone file format, one zone per ';', a vertex after each '>' (at least 3):
+ * 		ZoneID, Floor, Ceiling > X Y > X Y > X Y;
+ * 	e.g. "1, 0, 20000 > 40000 40000 > 60000 40000 > 50000 60000;". Polygons may be concave, the
+ * 	edges must not cross.
+ *
+ * 	An aircraft flies straight (the projection of checkViolations()). The altitude band gives the
+ * 	times its path is at the zone's altitudes; the crossings of the path with the polygon's edges
+ * 	in those times split it into pieces, each wholly inside or outside the polygon. The grid
+ * 	cells are ZONE_CELL_FEET square, a zone is in every cell its bounds touch, and the cells of an
+ * 	aircraft are those its path crosses, walked from one to the next.
+ */
+
+#define ZONE_CELL_FEET 2500
+
+typedef struct {
+	float x, y;
+} zone_vertex;
+
+typedef struct {
+	int id;
+	float floor, ceiling;			// feet
+	std::vector<zone_vertex> polygon;
+	float minX, maxX, minY, maxY;	// bounds of the polygon
+} restricted_zone;
+
+typedef struct {
+	int aircraftID;
+	int zoneID;
+	float timeToIncursion;	// seconds, 0 if it is inside now
+	float severity;			// 0 to 1, the share of the prediction time it spends inside
+} zone_incursion;
+
+// The zones of one load and their grid, never changed once published
+class ZoneIndex {
+public:
+	ZoneIndex(const std::vector<restricted_zone>& iZones);
+
+	size_t size() const { return mZones.size(); }
+
+	// Every zone the aircraft at state is inside now or flies into within predTime, added to out
+	void incursions(int aircraftID, const aircraft_state& state, int predTime, std::vector<zone_incursion>& out) const;
+
+	// The same, testing every zone
+	void incursionsOfAll(int aircraftID, const aircraft_state& state, int predTime, std::vector<zone_incursion>& out) const;
+
+private:
+	std::vector<restricted_zone> mZones;
+	std::unordered_map<uint64_t, std::vector<uint32_t> > mCells;	// cell to the zones touching it
+
+	// Whether the path of state over predTime enters zone, when, and for how long
+	static bool intersect(const restricted_zone& zone, const aircraft_state& state, int predTime, float& entry, float& inside);
+
+	static bool contains(const restricted_zone& zone, float x, float y);
+};
+
+/*
+ * The index in use is swapped in whole, like the runtime config: the scan reads it with one load
+ * and never waits for a load. Every loaded index stays alive; loads are operator commands.
+ */
+class RestrictedAirspace {
+public:
+	RestrictedAirspace();
+
+	// One acquire load, never blocks. No zones until the first load.
+	const ZoneIndex* get() const { return mCurrent.load(std::memory_order_acquire); }
+
+	// Builds the index of zones and publishes it, an empty list removes every zone
+	const ZoneIndex* load(const std::vector<restricted_zone>& zones);
+
+	// Parses every well formed zone, malformed zones are skipped
+	static std::vector<restricted_zone> parse(const std::string& data);
+
+	// Reads and parses the zone file at path, false if it can't be read
+	static bool readFile(const std::string& path, std::vector<restricted_zone>& zones);
+
+	// n aircraft against a number of zones, with the grid and with every zone
+	static int benchmark(int aircraftCount, int zoneCount, int scans, std::ostream& out);
+
+private:
+	std::atomic<const ZoneIndex*> mCurrent;
+	std::mutex mLoadMutex;
+	std::vector<std::unique_ptr<ZoneIndex> > mVersions;
+};
+
+#endif /* SRC_RESTRICTEDAIRSPACE_H_ */
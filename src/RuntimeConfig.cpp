@@ -0,0 +1,45 @@
+#include "RuntimeConfig.h"
+
+/* RESPONSIBILITIES
+ *	- Main.cpp owns the one RuntimeConfig of the process, runtimeConfig.
+ *	- ATCSystem::scanAirspace() reads it once per scan, for the conflict check and the alerts. The scan timer re-arms itself and the
+ *		display log timer when their period changed, the Display re-subscribes to radar updates
+ *		when the refresh changed.
+ *	- "changepred" goes through the ATCSystem, the other tuning commands are applied by the
+ *		CommunicationSystem directly (see CommunicationSystem.cpp).
+ */
+
+RuntimeConfig::RuntimeConfig() {
+	runtime_config* defaults = new runtime_config();
+	defaults->version = 1;
+	defaults->predictionSeconds = 180;
+	defaults->horizontalSeparation = 3000;
+	defaults->verticalSeparation = 1000;
+	defaults->scanPeriodMs = 1000;
+	defaults->logPeriodMs = 30000;
+	defaults->displayRefreshMs = 5000;
+
+	mVersions.push_back(std::unique_ptr<runtime_config>(defaults));
+	mCurrent.store(defaults, std::memory_order_release);
+}
+
+const runtime_config* RuntimeConfig::update(const std::function<void(runtime_config&)>& change) {
+	std::lock_guard<std::mutex> lock(mUpdateMutex);
+
+	runtime_config* next = new runtime_config(*mCurrent.load(std::memory_order_relaxed));
+	change(*next);
+	next->version++;
+
+	mVersions.push_back(std::unique_ptr<runtime_config>(next));
+	mCurrent.store(next, std::memory_order_release);
+	return next;
+}
+
+void RuntimeConfig::write(const runtime_config& config, std::ostream& out) {
+	out << "version " << config.version
+		<< ", prediction " << config.predictionSeconds << " s"
+		<< ", separation " << config.horizontalSeparation << " ft horizontal " << config.verticalSeparation << " ft vertical"
+		<< ", scan every " << config.scanPeriodMs << " ms"
+		<< ", display log every " << config.logPeriodMs << " ms"
+		<< ", display refresh " << config.displayRefreshMs << " ms";
+}
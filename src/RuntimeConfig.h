@@ -0,0 +1,52 @@
+#ifndef SRC_RUNTIMECONFIG_H_
+#define SRC_RUNTIMECONFIG_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <iostream>
+
+/* Responsible for:
+	- The settings operators can tune while the system runs: prediction time, separation minima,
+		scan period, display log period and display refresh.
+	- Handing readers a consistent, versioned set of them with one atomic load.
+ */
+
+typedef struct {
+	uint64_t version;			// 1 for the defaults, +1 per update
+	int predictionSeconds;		// how far forward conflicts are predicted
+	int horizontalSeparation;	// feet, in x and in y
+	int verticalSeparation;		// feet
+	int scanPeriodMs;
+	int logPeriodMs;			// display log (displaylog.txt)
+	int displayRefreshMs;		// console grid
+} runtime_config;
+
+/*
+ * A published config is never changed or freed, so a reader can keep the pointer it got for as
+ * long as it likes (a scan uses one for the whole scan) without any lock. Every update keeps its
+ * old version alive; updates are operator commands, so that is a few hundred bytes an hour.
+ */
+class RuntimeConfig {
+public:
+	RuntimeConfig();
+
+	// One acquire load, never blocks
+	const runtime_config* get() const { return mCurrent.load(std::memory_order_acquire); }
+
+	// Copies the current config, lets change() edit the copy and publishes it as the next version.
+	// Updates are serialised, readers are never held up.
+	const runtime_config* update(const std::function<void(runtime_config&)>& change);
+
+	static void write(const runtime_config& config, std::ostream& out);
+
+private:
+	std::atomic<const runtime_config*> mCurrent;
+	std::mutex mUpdateMutex;
+	std::vector<std::unique_ptr<runtime_config> > mVersions;
+};
+
+#endif /* SRC_RUNTIMECONFIG_H_ */
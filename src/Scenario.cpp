@@ -0,0 +1,91 @@
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+
+#include "Scenario.h"
+#include "MockStorage.h"
+#include "RadarDelta.h"
+#include "FlightPlan.h"
+
+#define RANDOM_SCENARIO "random:"
+
+extern FlightPlans flightPlans;
+
+// n aircraft in the airspace from the start, on 20 flight levels, at up to 200 feet per second
+static std::string randomScenario(int count) {
+	std::ostringstream data;
+	unsigned int seed = 12345;
+	for(int i = 0; i < count; i++){
+		seed = seed * 1103515245 + 12345;
+		int x = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		seed = seed * 1103515245 + 12345;
+		int y = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		data << "0, " << i + 1 << ", " << x << ", " << y << ", " << 10000 + (i % 20) * 1000 << ", "
+				<< (i % 9) * 50 - 200 << ", " << (i % 7) * 50 - 150 << ", 0;" << std::endl;
+	}
+	return data.str();
+}
+
+bool loadScenario(std::string nameOrPath, std::string& data) {
+	MockStorage mockStorage;
+
+	if(nameOrPath == "Low"){
+		data = mockStorage.lowTraffic;
+	}else if(nameOrPath == "Medium"){
+		data = mockStorage.mediumTraffic;
+	}else if(nameOrPath == "High"){
+		data = mockStorage.highTraffic;
+	}else if(nameOrPath == "Congested"){
+		data = mockStorage.congestedTraffic;
+	}else if(nameOrPath.compare(0, sizeof(RANDOM_SCENARIO) - 1, RANDOM_SCENARIO) == 0){
+		int count = atoi(nameOrPath.c_str() + sizeof(RANDOM_SCENARIO) - 1);
+		if(count <= 0){
+			return false;
+		}
+		data = randomScenario(count);
+	}else{
+		std::ifstream file(nameOrPath.c_str());
+		if(!file){
+			return false;
+		}
+		std::stringstream contents;
+		contents << file.rdbuf();
+		data = contents.str();
+	}
+
+	return true;
+}
+
+std::vector<Aircraft> parseScenario(const std::string& data, CommunicationSystem commSystem) {
+	std::vector<Aircraft> aircraftList;
+	std::unordered_map<int, std::vector<waypoint> > routes;
+
+	std::stringstream dataStream(data);
+	std::string line;
+	while (std::getline(dataStream, line, ';')) {
+		std::stringstream ss(line);
+		int entryTime, id;
+		float x, y, z, speedX, speedY, speedZ;
+		char comma;
+
+		if (ss >> entryTime >> comma >> id >> comma >> x >> comma >> y >> comma
+			>> z >> comma >> speedX >> comma >> speedY >> comma >> speedZ) {
+			Aircraft aircraft(entryTime, id, x, y, z, speedX, speedY, speedZ, commSystem);
+			aircraftList.push_back(aircraft);
+
+			// "> x y z" for each waypoint of a flight plan
+			std::vector<waypoint> route;
+			waypoint next;
+			char arrow;
+			while (ss >> arrow && arrow == '>' && ss >> next.x >> next.y >> next.z) {
+				route.push_back(next);
+			}
+			if (!route.empty()) {
+				routes[id] = route;
+			}
+		}
+	}
+
+	flightPlans.replace(routes);
+	return aircraftList;
+}
@@ -0,0 +1,25 @@
+#ifndef SRC_SCENARIO_H_
+#define SRC_SCENARIO_H_
+
+#include <string>
+#include <vector>
+#include "Aircraft.h"
+#include "CommunicationSystem.h"
+
+/* Responsible for:
+	- Turning a traffic scenario into the initial aircraft list.
+	- A scenario is one of the MockStorage densities (Low, Medium, High, Congested), a file in
+		the same format: "EntryTime, ID, X, Y, Z, SpeedX, SpeedY, SpeedZ;" per aircraft, or
+		"random:<n>", n aircraft spread over the airspace (the same n aircraft every time).
+	- An aircraft's entry can end with its flight plan, "> X Y Z" for each waypoint:
+		"0, 7, 10000, 20000, 15000, 250, 0, 0 > 40000 20000 15000 > 60000 50000 17000;"
+ */
+
+// Scenario text of a MockStorage density, or the contents of the file at nameOrPath
+bool loadScenario(std::string nameOrPath, std::string& data);
+
+// Parses every well formed entry, malformed entries are skipped. The flight plans of the scenario
+// replace those of flightPlans.
+std::vector<Aircraft> parseScenario(const std::string& data, CommunicationSystem commSystem);
+
+#endif /* SRC_SCENARIO_H_ */
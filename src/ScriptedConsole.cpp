@@ -0,0 +1,184 @@
+#include <mutex>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+
+#include "ScriptedConsole.h"
+#include "OperatorConsole.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "CommandPipeline.h"
+
+/* RESPONSIBILITIES
+ *	- startSystem() starts the same components as an interactive run, then runs
+ *		ScriptedConsole::run() on the main thread in place of the OperatorConsole thread.
+ *	- Commands are not journaled: the script already is the record of the run. They go through
+ *		the CommandPipeline like typed ones, "rejected" counts those that didn't parse and
+ *		"failed" those whose component didn't apply them.
+ *	- The summary is read from the metrics registry (see Metrics.h), so it shows what the
+ *		components measured themselves. Bucketed timings are given as "<=" the bucket bound.
+ */
+
+extern std::mutex coutMutex;
+extern CommandPipeline commandPipeline;
+
+ScriptedConsole::ScriptedConsole(CommunicationSystem iCommSystem, std::vector<script_command> iScript, int iDurationSeconds) :
+	commSystem(iCommSystem), mScript(iScript), mDurationSeconds(iDurationSeconds)
+{
+
+}
+
+bool ScriptedConsole::loadScript(std::string path, std::vector<script_command>& script, std::ostream& err) {
+	std::ifstream file(path.c_str());
+	if(!file){
+		err << "Headless: Cannot read script " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while(std::getline(file, line)){
+		lineNumber++;
+		size_t start = line.find_first_not_of(" \t\r");
+		if(start == std::string::npos || line[start] == '#'){
+			continue;
+		}
+
+		size_t end = line.find_first_of(" \t", start);
+		std::string time = line.substr(start, end - start);
+		char* parsedEnd;
+		double seconds = strtod(time.c_str(), &parsedEnd);
+		size_t commandStart = (end == std::string::npos) ? std::string::npos : line.find_first_not_of(" \t", end);
+		if(*parsedEnd != '\0' || seconds < 0 || commandStart == std::string::npos){
+			err << "Headless: " << path << ":" << lineNumber << ": expected \"<seconds> <command>\"" << std::endl;
+			return false;
+		}
+
+		size_t commandEnd = line.find_last_not_of(" \t\r");
+		script_command command;
+		command.atMs = (int64_t)llround(seconds * 1000);
+		command.command = line.substr(commandStart, commandEnd + 1 - commandStart);
+		script.push_back(command);
+	}
+
+	std::stable_sort(script.begin(), script.end(), [](const script_command& a, const script_command& b){
+		return a.atMs < b.atMs;
+	});
+	return true;
+}
+
+static std::string formatMs(double seconds) {
+	std::ostringstream text;
+	if(std::isinf(seconds)){
+		text << "> 10000 ms";
+	}else{
+		text << std::fixed << std::setprecision(3) << seconds * 1000 << " ms";
+	}
+	return text.str();
+}
+
+static void writeHistogram(std::ostream& out, const std::string& title, const char* name) {
+	Histogram* histogram = metrics().findHistogram(name);
+	uint64_t count = (histogram != nullptr) ? histogram->getCount() : 0;
+	out << "| " << title << ": " << count;
+	if(count > 0){
+		out << ", mean " << formatMs(histogram->getSum() / count)
+			<< ", p50 <= " << formatMs(histogram->quantile(0.5))
+			<< ", p95 <= " << formatMs(histogram->quantile(0.95))
+			<< ", p99 <= " << formatMs(histogram->quantile(0.99));
+	}
+	out << std::endl;
+}
+
+int ScriptedConsole::run(std::string scenario, size_t aircraftCount, std::ostream& out) {
+	Trace::setThreadName("ScriptedConsole");
+	{
+		std::lock_guard<std::mutex> guard(coutMutex);
+		std::cout << "ScriptedConsole: Running " << mScript.size() << " commands over " << mDurationSeconds << " s" << std::endl;
+	}
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point end = begin + std::chrono::seconds(mDurationSeconds);
+
+	std::vector<double> sendSeconds;
+	int rejected = 0;
+	size_t next = 0;
+	while(next < mScript.size() && mScript[next].atMs < (int64_t)mDurationSeconds * 1000){
+		std::this_thread::sleep_until(begin + std::chrono::milliseconds(mScript[next].atMs));
+
+		const std::string& cmd = mScript[next].command;
+		std::vector<std::string> components = OperatorConsole::splitCommand(cmd);
+		{
+			std::lock_guard<std::mutex> guard(coutMutex);
+			std::cout << "ScriptedConsole: Command sent: " << cmd << std::endl;
+		}
+
+		std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+		int status = commSystem.send(0, components);
+		sendSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - sent).count());
+
+		if(status == -1){
+			rejected++;
+			std::lock_guard<std::mutex> guard(coutMutex);
+			std::cout << "ScriptedConsole: Command rejected: " << cmd << std::endl;
+		}
+		next++;
+	}
+
+	std::this_thread::sleep_until(end);
+	// Every command acknowledged, a stuck component delays this by at most COMMAND_TIMEOUT_MS each
+	commandPipeline.waitForIdle();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	bool traced = Trace::isEnabled();
+	long traceEvents = -1;
+	if(traced){
+		Trace::disable();
+		traceEvents = Trace::writeFile(TRACE_PATH);
+	}
+
+	std::lock_guard<std::mutex> guard(coutMutex);
+	std::cout.flush();
+
+	out << "+-------------+ Headless run: " << scenario << " for " << mDurationSeconds << " s +-------------+" << std::endl;
+	out << "| Aircraft: " << aircraftCount << ", elapsed " << std::fixed << std::setprecision(1) << elapsed << " s"
+		<< std::defaultfloat << std::endl;
+	out << "| Scans: " << metrics().total("atc_scans_total")
+		<< ", timer overruns: " << metrics().total("atc_timer_overruns_total") << std::endl;
+	writeHistogram(out, "Scan duration, scans", "atc_scan_duration_seconds");
+	writeHistogram(out, "Display render, frames", "atc_display_render_seconds");
+
+	uint64_t failed = metrics().total("atc_command_failures_total");
+	out << "| Commands: " << sendSeconds.size() << " sent, " << rejected << " rejected, " << failed << " failed";
+	if(!sendSeconds.empty()){
+		double total = 0;
+		for(size_t i = 0; i < sendSeconds.size(); i++){
+			total += sendSeconds[i];
+		}
+		std::sort(sendSeconds.begin(), sendSeconds.end());
+		out << ", submit mean " << formatMs(total / sendSeconds.size())
+			<< ", p50 " << formatMs(sendSeconds[sendSeconds.size() / 2])
+			<< ", max " << formatMs(sendSeconds.back());
+	}
+	out << std::endl;
+	writeHistogram(out, "Command applied, commands", "atc_command_latency_seconds");
+
+	out << "| Violations found: " << metrics().total("atc_violations_total")
+		<< ", alerts shown: " << metrics().total("atc_display_violation_alerts_total") << std::endl;
+	out << "| IPC sends: " << metrics().total("atc_ipc_sends_total")
+		<< ", failures: " << metrics().total("atc_ipc_failures_total") << std::endl;
+	if(traceEvents >= 0){
+		out << "| Trace: " << traceEvents << " events in " << TRACE_PATH << std::endl;
+	}else if(traced){
+		out << "| Trace: cannot write " << TRACE_PATH << std::endl;
+	}
+	out << "+-------------+ Headless run " << (rejected == 0 && failed == 0 ? "complete" : "had rejected or failed commands") << " +-------------+" << std::endl;
+
+	return (rejected == 0 && failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#ifndef SRC_SCRIPTEDCONSOLE_H_
+#define SRC_SCRIPTEDCONSOLE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "CommunicationSystem.h"
+
+/* Responsible for:
+	- The operator console of a headless run ("Main --headless"): sends the commands of a script
+		through CommunicationSystem::send() at their time instead of reading them from std::cin.
+	- Stopping the run after its duration with a summary of scan and render timing, command
+		send latency, violations and alerts, for unattended load tests and benchmarks.
+ */
+
+/*	Script format, one command per line, times in seconds since the components were started:
+ * 		# comment
+ * 		5 changespeed 3 100 0 0
+ * 		12.5 changepred 60
+ * 	Commands are sent in time order (in file order for equal times).
+ */
+
+typedef struct {
+	int64_t atMs;
+	std::string command;
+} script_command;
+
+class ScriptedConsole {
+public:
+	ScriptedConsole(CommunicationSystem iCommSystem, std::vector<script_command> iScript, int iDurationSeconds);
+
+	// Reports the first malformed line to err
+	static bool loadScript(std::string path, std::vector<script_command>& script, std::ostream& err);
+
+	// Runs the script until the duration is up and writes the summary.
+	// Returns the exit status: 1 if a command was rejected or failed.
+	int run(std::string scenario, size_t aircraftCount, std::ostream& out);
+
+private:
+	CommunicationSystem commSystem;
+	std::vector<script_command> mScript;
+	int mDurationSeconds;
+};
+
+#endif /* SRC_SCRIPTEDCONSOLE_H_ */
@@ -0,0 +1,287 @@
+#include <mutex>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/neutrino.h>
+
+#include "SectorEngine.h"
+#include "ConflictCheck.h"
+#include "RadarDelta.h"
+#include "Trace.h"
+
+/* RESPONSIBILITIES
+ *	- "Main --sectors <columns> <rows>" gives the ATCSystem a SectorEngine, which replaces the
+ *		single conflict check of ATCSystem::checkViolations().
+ *	- The scanning thread hands off aircraft and fills the track set of every sector, then
+ *		wakes the sector workers and waits for all of them. check() runs one scan at a time (the
+ *		ATCSystem serializes its scans too), so the workers never see two scans' tracks. Each worker only reads the projections
+ *		and writes its own sector, so nothing is locked while they run.
+ *	- Handoffs are printed and counted; the display can follow one sector with "sector {n}"
+ *		(see RadarPublisher.h).
+ */
+
+extern std::mutex coutMutex;
+
+SectorEngine::SectorEngine(sector_layout iLayout) :
+	mLayout(iLayout), mGeneration(0), mPending(0), mProjections(nullptr), mHorizontal(0), mVertical(0)
+{
+	mSectors.resize(getSectorCount());
+	for(int s = 0; s < getSectorCount(); s++){
+		std::string label = "sector=\"" + std::to_string(s) + "\"";
+		mSectors[s].pairsTested = 0;
+		mSectors[s].owned = &metrics().gauge("atc_sector_tracks", "Aircraft owned by a sector", label);
+		mSectors[s].buffered = &metrics().gauge("atc_sector_checked_tracks", "Aircraft a sector checks, owned or in its buffer zone", label);
+		mSectors[s].duration = &metrics().histogram("atc_sector_check_seconds", "Conflict check of one sector", label);
+	}
+}
+
+int SectorEngine::sectorOf(const sector_layout& layout, float x, float y) {
+	float width = (float)RADAR_AIRSPACE_SIZE / layout.columns;
+	float height = (float)RADAR_AIRSPACE_SIZE / layout.rows;
+	int column = std::min(std::max((int)(x / width), 0), layout.columns - 1);
+	int row = std::min(std::max((int)(y / height), 0), layout.rows - 1);
+	return row * layout.columns + column;
+}
+
+// Aircraft that entered the airspace and crossed into another sector since the last scan
+void SectorEngine::handOff(int64_t timeMs, const std::vector<Aircraft>& radarFindings, std::vector<int>& owned) {
+	static Counter& handoffs = metrics().counter("atc_sector_handoffs_total", "Aircraft handed from one sector to another");
+
+	owned.assign(getSectorCount(), 0);
+	for(size_t i = 0; i < radarFindings.size(); i++){
+		const Aircraft& aircraft = radarFindings[i];
+		if((int64_t)aircraft.getEntryTime() * 1000 > timeMs){
+			continue;
+		}
+		aircraft_state state = aircraft.getState();
+		int now = sectorOf(mLayout, state.x, state.y);
+		owned[now]++;
+
+		std::pair<std::unordered_map<int, int>::iterator, bool> inserted = mOwners.insert(std::make_pair(aircraft.getId(), now));
+		if(!inserted.second && inserted.first->second != now){
+			handoffs.add();
+			{
+				std::lock_guard<std::mutex> guard(coutMutex);
+				std::cout << "ATCSystem: Flight " << aircraft.getId() << " handed off from sector "
+						<< inserted.first->second << " to sector " << now << std::endl;
+			}
+			inserted.first->second = now;
+		}
+	}
+}
+
+// Every pair of the sector's tracks, keeping the pairs this sector reports
+void SectorEngine::checkSector(sector& work) {
+	const std::vector<aircraft_state>& projections = *mProjections;
+	work.found.clear();
+
+	for(size_t a = 0; a < work.tracks.size(); a++){
+		size_t i = work.tracks[a];
+		bool reports = sectorOf(mLayout, projections[i].x, projections[i].y) == (int)(&work - mSectors.data());
+		if(!reports){
+			continue;
+		}
+		for(size_t b = a + 1; b < work.tracks.size(); b++){
+			size_t j = work.tracks[b];
+			if(separationLost(projections[i], projections[j], mHorizontal, mVertical)){
+				work.found.push_back(std::make_pair(i, j));
+			}
+		}
+		work.pairsTested += work.tracks.size() - a - 1;
+	}
+}
+
+std::vector<violation_pair> SectorEngine::check(int64_t timeMs, const std::vector<Aircraft>& radarFindings,
+		const std::vector<aircraft_state>& projections, int horizontal, int vertical, uint64_t& pairsTested) {
+	std::lock_guard<std::mutex> scanning(mCheckMutex);
+	TRACE_SCOPE("sector check", "conflict");
+
+	std::vector<int> owned;
+	handOff(timeMs, radarFindings, owned);
+
+	// Track sets: the sectors under each projection's buffer zone, in radar list order
+	float buffer = SECTOR_BUFFER(horizontal);
+	for(size_t s = 0; s < mSectors.size(); s++){
+		mSectors[s].tracks.clear();
+		mSectors[s].pairsTested = 0;
+	}
+	for(size_t i = 0; i < projections.size(); i++){
+		int firstColumn = sectorOf(mLayout, projections[i].x - buffer, 0) % mLayout.columns;
+		int lastColumn = sectorOf(mLayout, projections[i].x + buffer, 0) % mLayout.columns;
+		int firstRow = sectorOf(mLayout, 0, projections[i].y - buffer) / mLayout.columns;
+		int lastRow = sectorOf(mLayout, 0, projections[i].y + buffer) / mLayout.columns;
+		for(int row = firstRow; row <= lastRow; row++){
+			for(int column = firstColumn; column <= lastColumn; column++){
+				mSectors[row * mLayout.columns + column].tracks.push_back(i);
+			}
+		}
+	}
+
+	// Wake every worker for this scan and wait for the last one
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mProjections = &projections;
+		mHorizontal = horizontal;
+		mVertical = vertical;
+		mPending = getSectorCount();
+		mGeneration++;
+		mWork.notify_all();
+		mDone.wait(lock, [&]{ return mPending == 0; });
+		mProjections = nullptr;
+	}
+
+	std::vector<std::pair<size_t, size_t> > found;
+	pairsTested = 0;
+	for(size_t s = 0; s < mSectors.size(); s++){
+		found.insert(found.end(), mSectors[s].found.begin(), mSectors[s].found.end());
+		pairsTested += mSectors[s].pairsTested;
+		mSectors[s].owned->set(owned[s]);
+		mSectors[s].buffered->set(mSectors[s].tracks.size());
+	}
+	std::sort(found.begin(), found.end());
+
+	std::vector<violation_pair> violations(found.size());
+	for(size_t k = 0; k < found.size(); k++){
+		violations[k].aircraft1ID = radarFindings[found[k].first].getID();
+		violations[k].aircraft2ID = radarFindings[found[k].second].getID();
+	}
+	return violations;
+}
+
+// Keeps the calling thread on one core, so the sectors don't migrate onto each other's cores
+static void pinToCore(int core) {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if(cores <= 0){
+		return;
+	}
+	unsigned runmask = 1u << (core % std::min(cores, 32L));
+	if(ThreadCtl(_NTO_TCTL_RUNMASK, (void*)(uintptr_t)runmask) == -1){
+		perror("SectorEngine: ThreadCtl runmask");
+	}
+}
+
+void* SectorEngine::runWorker(int s) {
+	if(mLayout.pinThreads){
+		pinToCore(s);
+	}
+	Trace::setThreadName(("Sector " + std::to_string(s)).c_str());
+
+	uint64_t seen = 0;
+	while(true){
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWork.wait(lock, [&]{ return mGeneration != seen; });
+			seen = mGeneration;
+		}
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		{
+			TraceScope trace("check sector", "conflict");
+			trace.setArg("tracks", mSectors[s].tracks.size());
+			checkSector(mSectors[s]);
+		}
+		mSectors[s].duration->observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(--mPending == 0){
+			mDone.notify_one();
+		}
+	}
+	return nullptr;
+}
+
+void* SectorEngine::startWorkerThread(void* context) {
+	worker_context* worker = static_cast<worker_context*>(context);
+	return worker->engine->runWorker(worker->sector);
+}
+
+void SectorEngine::start() {
+	mContexts.resize(getSectorCount());
+	for(int s = 0; s < getSectorCount(); s++){
+		mContexts[s].engine = this;
+		mContexts[s].sector = s;
+		pthread_t workerThread;
+		pthread_create(&workerThread, NULL, &SectorEngine::startWorkerThread, &mContexts[s]);
+		pthread_detach(workerThread);
+	}
+}
+
+int SectorEngine::benchmark(int aircraftCount, int maxSectors, std::ostream& out) {
+	const int horizontal = 3000, vertical = 1000, predTime = 180;
+	const int scans = 5;
+	const int layouts[][2] = { {1, 1}, {2, 1}, {2, 2}, {4, 2}, {4, 4}, {8, 4}, {8, 8} };
+	CommunicationSystem commSystem;
+
+	// Traffic spread over the airspace and a few flight levels
+	std::vector<Aircraft> radarFindings;
+	std::vector<aircraft_state> projections;
+	unsigned int seed = 12345;
+	for(int i = 0; i < aircraftCount; i++){
+		seed = seed * 1103515245 + 12345;
+		float x = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		seed = seed * 1103515245 + 12345;
+		float y = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		radarFindings.push_back(Aircraft(0, i, x, y, 10000 + (i % 20) * 1000, (i % 9) * 50 - 200, (i % 7) * 50 - 150, 0, commSystem));
+		projections.push_back(projectState(radarFindings.back().getState(), predTime));
+	}
+
+	out << "+-------------+ Sector benchmark: " << aircraftCount << " aircraft, " << sysconf(_SC_NPROCESSORS_ONLN)
+			<< " cores, " << scans << " scans per layout +-------------+" << std::endl;
+
+	// The single engine of ATCSystem::checkViolations()
+	std::vector<std::pair<size_t, size_t> > expected;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for(int scan = 0; scan < scans; scan++){
+		expected.clear();
+		for(size_t i = 0; i < projections.size(); i++){
+			for(size_t j = i + 1; j < projections.size(); j++){
+				if(separationLost(projections[i], projections[j], horizontal, vertical)){
+					expected.push_back(std::make_pair(i, j));
+				}
+			}
+		}
+	}
+	double singleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / scans;
+	uint64_t n = aircraftCount;
+	out << "| single engine: " << singleMs << " ms/scan, " << n * (n - 1) / 2 << " pairs, " << expected.size() << " conflicts" << std::endl;
+	out << "| sectors | ms/scan | speedup | pairs tested | largest sector | conflicts | same as single engine" << std::endl;
+
+	bool allSame = true;
+	for(size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++){
+		sector_layout layout = { layouts[l][0], layouts[l][1], true };
+		if(layout.columns * layout.rows > maxSectors){
+			break;
+		}
+
+		// Never freed: the workers run until the process exits
+		SectorEngine* engine = new SectorEngine(layout);
+		engine->start();
+
+		std::vector<violation_pair> violations;
+		uint64_t pairsTested = 0;
+		begin = std::chrono::steady_clock::now();
+		for(int scan = 0; scan < scans; scan++){
+			violations = engine->check(0, radarFindings, projections, horizontal, vertical, pairsTested);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / scans;
+
+		bool same = violations.size() == expected.size();
+		for(size_t k = 0; same && k < expected.size(); k++){
+			same = violations[k].aircraft1ID == radarFindings[expected[k].first].getID()
+					&& violations[k].aircraft2ID == radarFindings[expected[k].second].getID();
+		}
+		allSame = allSame && same;
+
+		size_t largest = 0;
+		for(size_t s = 0; s < engine->mSectors.size(); s++){
+			largest = std::max(largest, engine->mSectors[s].tracks.size());
+		}
+		out << "| " << layout.columns << " x " << layout.rows << " | " << ms << " | " << singleMs / ms << " | "
+				<< pairsTested << " | " << largest << " | " << violations.size() << " | " << (same ? "yes" : "NO") << std::endl;
+	}
+
+	out << "+-------------+ " << (allSame ? "Every layout found the same conflicts" : "LAYOUTS DISAGREE") << " +-------------+" << std::endl;
+	return allSame ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#ifndef SRC_SECTORENGINE_H_
+#define SRC_SECTORENGINE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <iostream>
+#include "Aircraft.h"
+#include "RadarBus.h"
+#include "Metrics.h"
+
+/* Responsible for:
+	- Splitting the airspace into a grid of sectors, each with its own track set and conflict
+		check running on its own thread, pinned to its own core.
+	- Handing aircraft off from sector to sector as they cross a boundary.
+	- Finding conflicts across boundaries through a buffer zone around every sector, and reporting
+		each conflict once, in the same order as the single engine of the ATCSystem.
+ */
+
+/*	How a scan is split:
+ * 	- An aircraft is owned by (handed off to) the sector its current position is in; positions
+ * 		outside the airspace belong to the nearest edge sector.
+ * 	- A sector checks every aircraft whose projected position is inside the sector or its buffer
+ * 		zone, SECTOR_BUFFER() feet wide. Two aircraft can only conflict if their projections are at
+ * 		most that far apart, so every conflict is inside the sector of either projection.
+ * 	- A pair is reported only by the sector holding the projection of its first aircraft (the one
+ * 		earlier in the radar list), so a pair seen by two sectors is reported once.
+ * 	- The pairs of all sectors are sorted by their radar list positions, which is the order the
+ * 		single engine checks them in.
+ */
+
+// Two aircraft conflict when their projected boxes overlap: up to 2 * separation apart, and the
+// bounds are truncated to whole feet
+#define SECTOR_BUFFER(horizontalSeparation) (2 * (horizontalSeparation) + 2)
+
+// A run mask has one bit per core
+#define SECTOR_MAX 64
+
+typedef struct {
+	int columns;	// along x
+	int rows;		// along y
+	bool pinThreads;
+} sector_layout;
+
+class SectorEngine {
+public:
+	SectorEngine(sector_layout iLayout);
+
+	// Starts one worker thread per sector
+	void start();
+
+	int getSectorCount() const { return mLayout.columns * mLayout.rows; }
+
+	// The sector containing x y, positions outside the airspace go to the nearest edge sector
+	static int sectorOf(const sector_layout& layout, float x, float y);
+
+	// One scan: hands off the aircraft that changed sector, then every sector checks its tracks
+	// in parallel. projections are the aircraft of radarFindings at the prediction time. A second
+	// caller waits until the scan in progress is done.
+	std::vector<violation_pair> check(int64_t timeMs, const std::vector<Aircraft>& radarFindings,
+			const std::vector<aircraft_state>& projections, int horizontal, int vertical, uint64_t& pairsTested);
+
+	// Checks the conflicts of every layout up to maxSectors against the single engine, and
+	// reports the time per scan of each
+	static int benchmark(int aircraftCount, int maxSectors, std::ostream& out);
+
+	void* runWorker(int sector);
+	static void* startWorkerThread(void* context);
+
+private:
+	typedef struct {
+		std::vector<size_t> tracks;		// radar list positions, owned and in the buffer zone
+		std::vector<std::pair<size_t, size_t> > found;
+		uint64_t pairsTested;
+		Gauge* owned;
+		Gauge* buffered;
+		Histogram* duration;
+	} sector;
+
+	// what startWorkerThread() gets
+	typedef struct {
+		SectorEngine* engine;
+		int sector;
+	} worker_context;
+
+	sector_layout mLayout;
+	std::vector<sector> mSectors;
+	std::vector<worker_context> mContexts;
+	std::unordered_map<int, int> mOwners;	// aircraft id to the sector it was last handed to
+
+	// held by check() for a whole scan: the track sets, owners and results are one scan's
+	std::mutex mCheckMutex;
+
+	// the scan handed to the workers by generation
+	std::mutex mMutex;
+	std::condition_variable mWork;
+	std::condition_variable mDone;
+	uint64_t mGeneration;
+	int mPending;
+	const std::vector<aircraft_state>* mProjections;
+	int mHorizontal;
+	int mVertical;
+
+	void checkSector(sector& work);
+	void handOff(int64_t timeMs, const std::vector<Aircraft>& radarFindings, std::vector<int>& owned);
+};
+
+#endif /* SRC_SECTORENGINE_H_ */
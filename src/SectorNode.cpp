@@ -0,0 +1,682 @@
+#include <mutex>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "SectorNode.h"
+#include "ConflictCheck.h"
+#include "RuntimeConfig.h"
+#include "Scenario.h"
+
+/* RESPONSIBILITIES
+ *	- "Main --nodes" forks one process per node with launch(), which also runs the whole airspace
+ *		in its own process to check that the nodes together find exactly the same violations.
+ *	- "Main --node" runs one node, the others being started by hand.
+ *	- Every node listens on its own socket, connects to the nodes after it and accepts the nodes
+ *		before it, so each pair of nodes has one connection. A reader thread per peer queues the
+ *		frames it reads, so two nodes sending to each other never block on full socket buffers.
+ */
+
+extern std::mutex coutMutex;
+extern RuntimeConfig runtimeConfig;
+
+static uint64_t monotonicNs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static bool writeFully(int fd, const char* data, size_t length) {
+	while(length > 0){
+		ssize_t written = write(fd, data, length);
+		if(written <= 0){
+			if(written == -1 && errno == EINTR){
+				continue;
+			}
+			return false;
+		}
+		data += written;
+		length -= written;
+	}
+	return true;
+}
+
+static bool readFully(int fd, char* data, size_t length) {
+	while(length > 0){
+		ssize_t got = read(fd, data, length);
+		if(got <= 0){
+			if(got == -1 && errno == EINTR){
+				continue;
+			}
+			return false;
+		}
+		data += got;
+		length -= got;
+	}
+	return true;
+}
+
+static std::string socketPath(int index) {
+	return NODE_SOCKET_PATH + std::to_string(index) + ".sock";
+}
+
+static int listenOn(const node_config& config) {
+	int fd;
+	if(config.tcp){
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		int reuse = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		struct sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(NODE_TCP_PORT + config.nodeIndex);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if(fd == -1 || bind(fd, (struct sockaddr*)&address, sizeof(address)) == -1){
+			perror("SectorNode: bind");
+			return -1;
+		}
+	}else{
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		std::string path = socketPath(config.nodeIndex);
+		strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		unlink(path.c_str());
+		if(fd == -1 || bind(fd, (struct sockaddr*)&address, sizeof(address)) == -1){
+			perror("SectorNode: bind");
+			return -1;
+		}
+	}
+	if(listen(fd, config.nodeCount) == -1){
+		perror("SectorNode: listen");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// One attempt, -1 if the node isn't listening yet
+static int connectTo(const node_config& config, int index) {
+	int fd;
+	int status;
+	if(config.tcp){
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(NODE_TCP_PORT + index);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		status = connect(fd, (struct sockaddr*)&address, sizeof(address));
+		int noDelay = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+	}else{
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, socketPath(index).c_str(), sizeof(address.sun_path) - 1);
+		status = connect(fd, (struct sockaddr*)&address, sizeof(address));
+	}
+	if(status == -1){
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+SectorNode::SectorNode(node_config iConfig, const std::vector<Aircraft>& traffic) :
+	mConfig(iConfig), mTrafficSize(traffic.size())
+{
+	memset(&mStats, 0, sizeof(mStats));
+	mStats.nodeIndex = mConfig.nodeIndex;
+
+	// Each node starts with the aircraft in its own sectors
+	for(size_t i = 0; i < traffic.size(); i++){
+		node_track track;
+		track.id = traffic[i].getId();
+		track.entryTime = traffic[i].getEntryTime();
+		track.state = traffic[i].getState();
+		int sector = SectorEngine::sectorOf(mConfig.layout, track.state.x, track.state.y);
+		if(nodeOfSector(mConfig, sector) == mConfig.nodeIndex){
+			mOwned.push_back(track);
+		}
+	}
+}
+
+int SectorNode::nodeOfSector(const node_config& config, int sector) {
+	int sectors = config.layout.columns * config.layout.rows;
+	return (int)((int64_t)sector * config.nodeCount / sectors);
+}
+
+bool SectorNode::connectPeers() {
+	mPeers.resize(mConfig.nodeCount);
+	for(size_t p = 0; p < mPeers.size(); p++){
+		mPeers[p].fd = -1;
+		mPeers[p].lost = (int)p == mConfig.nodeIndex;
+		mPeers[p].completedScan = 0;
+	}
+
+	int listenFd = listenOn(mConfig);
+	if(listenFd == -1){
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(NODE_CONNECT_TIMEOUT_MS);
+	std::vector<node_track> none;
+
+	// The nodes after this one
+	for(int p = mConfig.nodeIndex + 1; p < mConfig.nodeCount; p++){
+		while((mPeers[p].fd = connectTo(mConfig, p)) == -1){
+			if(std::chrono::steady_clock::now() > deadline){
+				std::lock_guard<std::mutex> guard(coutMutex);
+				std::cout << "SectorNode " << mConfig.nodeIndex << ": node " << p << " is not listening" << std::endl;
+				close(listenFd);
+				return false;
+			}
+			usleep(10000);
+		}
+		sendFrame(p, NODE_HELLO, 0, none);
+	}
+
+	// The nodes before it, which say who they are
+	for(int accepted = 0; accepted < mConfig.nodeIndex; ){
+		struct pollfd waiting = { listenFd, POLLIN, 0 };
+		int remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if(remainingMs <= 0 || poll(&waiting, 1, remainingMs) <= 0){
+			std::lock_guard<std::mutex> guard(coutMutex);
+			std::cout << "SectorNode " << mConfig.nodeIndex << ": only " << accepted << " of the nodes before it connected" << std::endl;
+			close(listenFd);
+			return false;
+		}
+		int fd = accept(listenFd, NULL, NULL);
+		node_frame_header hello;
+		if(fd == -1 || !readFully(fd, (char*)&hello, sizeof(hello)) || hello.type != NODE_HELLO
+				|| hello.node >= mConfig.nodeIndex || mPeers[hello.node].fd != -1){
+			if(fd != -1){
+				close(fd);
+			}
+			continue;
+		}
+		if(mConfig.tcp){
+			int noDelay = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+		}
+		mPeers[hello.node].fd = fd;
+		mStats.bytesReceived += sizeof(hello);
+		accepted++;
+	}
+
+	close(listenFd);
+	if(!mConfig.tcp){
+		unlink(socketPath(mConfig.nodeIndex).c_str());
+	}
+
+	mReaders.resize(mConfig.nodeCount);
+	for(int p = 0; p < mConfig.nodeCount; p++){
+		if(p == mConfig.nodeIndex){
+			continue;
+		}
+		mReaders[p].node = this;
+		mReaders[p].peer = p;
+		pthread_t readerThread;
+		pthread_create(&readerThread, NULL, &SectorNode::startPeerReaderThread, &mReaders[p]);
+		pthread_detach(readerThread);
+	}
+	return true;
+}
+
+bool SectorNode::sendFrame(int peer, uint16_t type, uint32_t scan, const std::vector<node_track>& tracks) {
+	std::vector<char> frame(sizeof(node_frame_header) + tracks.size() * sizeof(node_track));
+	node_frame_header header;
+	memset(&header, 0, sizeof(header));
+	header.type = type;
+	header.node = mConfig.nodeIndex;
+	header.scan = scan;
+	header.count = tracks.size();
+	header.sentNs = monotonicNs();
+	memcpy(frame.data(), &header, sizeof(header));
+	if(!tracks.empty()){
+		memcpy(frame.data() + sizeof(header), tracks.data(), tracks.size() * sizeof(node_track));
+	}
+
+	if(!writeFully(mPeers[peer].fd, frame.data(), frame.size())){
+		losePeer(peer, strerror(errno));
+		return false;
+	}
+	mStats.bytesSent += frame.size();
+	return true;
+}
+
+void SectorNode::losePeer(int peer, const std::string& why) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(mPeers[peer].lost){
+			return;
+		}
+		mPeers[peer].lost = true;
+		mStats.peersLost++;
+		shutdown(mPeers[peer].fd, SHUT_RDWR);
+		mReceived.notify_all();
+	}
+
+	std::lock_guard<std::mutex> guard(coutMutex);
+	std::cout << "SectorNode " << mConfig.nodeIndex << ": lost node " << peer << " (" << why << "), its sectors are no longer checked here" << std::endl;
+}
+
+void* SectorNode::readPeer(int peer) {
+	int fd = mPeers[peer].fd;
+	while(true){
+		received_frame frame;
+		if(!readFully(fd, (char*)&frame.header, sizeof(frame.header))){
+			break;
+		}
+		// The count comes off the socket, a corrupt one must not size the tracks
+		if(frame.header.count > mTrafficSize){
+			losePeer(peer, "frame of " + std::to_string(frame.header.count) + " tracks, more than the scenario has");
+			return nullptr;
+		}
+		frame.tracks.resize(frame.header.count);
+		if(frame.header.count > 0 && !readFully(fd, (char*)frame.tracks.data(), frame.header.count * sizeof(node_track))){
+			break;
+		}
+		frame.receivedNs = monotonicNs();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStats.bytesReceived += sizeof(frame.header) + frame.header.count * sizeof(node_track);
+		if(frame.header.type == NODE_HANDOFF){
+			uint64_t latency = frame.receivedNs - frame.header.sentNs;
+			mStats.handoffLatencyNs += latency * frame.header.count;
+			mStats.maxHandoffLatencyNs = std::max(mStats.maxHandoffLatencyNs, latency);
+		}else if(frame.header.type == NODE_BOUNDARY){
+			mPeers[peer].completedScan = frame.header.scan;
+		}
+		mPeers[peer].frames.push_back(frame);
+		mReceived.notify_all();
+	}
+
+	// A peer that finished its last scan closes its socket, that's not a loss
+	bool finished;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		finished = (int)mPeers[peer].completedScan >= mConfig.seconds;
+	}
+	if(!finished){
+		losePeer(peer, "connection closed");
+	}
+	return nullptr;
+}
+
+void* SectorNode::startPeerReaderThread(void* context) {
+	reader_context* reader = static_cast<reader_context*>(context);
+	return reader->node->readPeer(reader->peer);
+}
+
+bool SectorNode::run(std::ostream& violationsOut, node_stats& stats) {
+	// A peer that dies mid write must not kill this node too
+	signal(SIGPIPE, SIG_IGN);
+
+	if(!connectPeers()){
+		return false;
+	}
+
+	const runtime_config* config = runtimeConfig.get();
+	int horizontal = config->horizontalSeparation;
+	int vertical = config->verticalSeparation;
+	int predTime = config->predictionSeconds;
+	float buffer = SECTOR_BUFFER(horizontal);
+	const sector_layout& layout = mConfig.layout;
+	int sectorCount = layout.columns * layout.rows;
+
+	std::vector<int> hosted;
+	for(int s = 0; s < sectorCount; s++){
+		if(nodeOfSector(mConfig, s) == mConfig.nodeIndex){
+			hosted.push_back(s);
+		}
+	}
+	mStats.sectors = hosted.size();
+
+	std::vector<node_track> tracks;
+	std::vector<aircraft_state> projections;
+	std::vector<size_t> members;
+
+	for(int scan = 1; scan <= mConfig.seconds; scan++){
+		if(mConfig.killNode == mConfig.nodeIndex && scan == mConfig.killScan){
+			// A crash: no goodbye, no flush
+			_exit(2);
+		}
+
+		// 1. one second of flight, like Aircraft::advance()
+		for(size_t i = 0; i < mOwned.size(); i++){
+			aircraft_state& s = mOwned[i].state;
+			if(mOwned[i].entryTime <= scan){
+				s.x += s.speedX;
+				s.y += s.speedY;
+				s.z += s.speedZ;
+			}
+		}
+
+		// 2. handoffs to the node of the sector each track is in now
+		std::vector<std::vector<node_track> > handoffs(mConfig.nodeCount);
+		std::vector<std::vector<node_track> > boundary(mConfig.nodeCount);
+		std::vector<node_track> kept;
+		std::vector<int> owners;
+		for(size_t i = 0; i < mOwned.size(); i++){
+			int node = nodeOfSector(mConfig, SectorEngine::sectorOf(layout, mOwned[i].state.x, mOwned[i].state.y));
+			bool reachable;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				reachable = !mPeers[node].lost;
+			}
+			if(node != mConfig.nodeIndex && reachable){
+				handoffs[node].push_back(mOwned[i]);
+			}else{
+				kept.push_back(mOwned[i]);
+				node = mConfig.nodeIndex;
+			}
+			owners.push_back(node);
+		}
+
+		// 3. tracks whose projection's buffer zone reaches another node's sectors. The tracks just
+		// handed off are sent too, their new owner only adopts them after its own boundary frames.
+		for(size_t i = 0; i < mOwned.size(); i++){
+			aircraft_state projection = projectState(mOwned[i].state, predTime);
+			int firstColumn = SectorEngine::sectorOf(layout, projection.x - buffer, 0) % layout.columns;
+			int lastColumn = SectorEngine::sectorOf(layout, projection.x + buffer, 0) % layout.columns;
+			int firstRow = SectorEngine::sectorOf(layout, 0, projection.y - buffer) / layout.columns;
+			int lastRow = SectorEngine::sectorOf(layout, 0, projection.y + buffer) / layout.columns;
+			int lastNode = -1;
+			for(int row = firstRow; row <= lastRow; row++){
+				for(int column = firstColumn; column <= lastColumn; column++){
+					int node = nodeOfSector(mConfig, row * layout.columns + column);
+					if(node != mConfig.nodeIndex && node != owners[i] && node != lastNode
+							&& (boundary[node].empty() || boundary[node].back().id != mOwned[i].id)){
+						boundary[node].push_back(mOwned[i]);
+					}
+					lastNode = node;
+				}
+			}
+		}
+		mOwned.swap(kept);
+
+		for(int p = 0; p < mConfig.nodeCount; p++){
+			bool lost;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				lost = mPeers[p].lost;
+			}
+			if(lost){
+				continue;
+			}
+			if(!handoffs[p].empty() && sendFrame(p, NODE_HANDOFF, scan, handoffs[p])){
+				mStats.handoffsOut += handoffs[p].size();
+			}
+			if(sendFrame(p, NODE_BOUNDARY, scan, boundary[p])){
+				mStats.boundaryTracksSent += boundary[p].size();
+			}
+		}
+
+		// 4. scan T of every peer still there
+		std::vector<node_track> visitors;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(NODE_PEER_TIMEOUT_MS);
+			for(int p = 0; p < mConfig.nodeCount; p++){
+				bool arrived = mReceived.wait_until(lock, deadline, [&]{ return mPeers[p].lost || (int)mPeers[p].completedScan >= scan; });
+				if(!arrived){
+					lock.unlock();
+					losePeer(p, "nothing for " + std::to_string(NODE_PEER_TIMEOUT_MS) + " ms");
+					lock.lock();
+				}
+
+				std::deque<received_frame>& frames = mPeers[p].frames;
+				while(!frames.empty() && (int)frames.front().header.scan <= scan){
+					received_frame& frame = frames.front();
+					if(frame.header.type == NODE_HANDOFF){
+						mOwned.insert(mOwned.end(), frame.tracks.begin(), frame.tracks.end());
+						mStats.handoffsIn += frame.tracks.size();
+					}else if(frame.header.type == NODE_BOUNDARY && (int)frame.header.scan == scan){
+						visitors.insert(visitors.end(), frame.tracks.begin(), frame.tracks.end());
+					}
+					frames.pop_front();
+				}
+			}
+		}
+
+		// Conflicts in this node's sectors, each reported by the sector of its lower id's projection
+		// (the tracks handed off this scan still count here, their projection can be in these sectors)
+		tracks = mOwned;
+		tracks.insert(tracks.end(), visitors.begin(), visitors.end());
+		for(size_t p = 0; p < handoffs.size(); p++){
+			tracks.insert(tracks.end(), handoffs[p].begin(), handoffs[p].end());
+		}
+		projections.resize(tracks.size());
+		for(size_t i = 0; i < tracks.size(); i++){
+			projections[i] = projectState(tracks[i].state, predTime);
+		}
+
+		for(size_t h = 0; h < hosted.size(); h++){
+			int sector = hosted[h];
+			int column = sector % layout.columns, row = sector / layout.columns;
+			members.clear();
+			for(size_t i = 0; i < tracks.size(); i++){
+				int firstColumn = SectorEngine::sectorOf(layout, projections[i].x - buffer, 0) % layout.columns;
+				int lastColumn = SectorEngine::sectorOf(layout, projections[i].x + buffer, 0) % layout.columns;
+				int firstRow = SectorEngine::sectorOf(layout, 0, projections[i].y - buffer) / layout.columns;
+				int lastRow = SectorEngine::sectorOf(layout, 0, projections[i].y + buffer) / layout.columns;
+				if(column >= firstColumn && column <= lastColumn && row >= firstRow && row <= lastRow){
+					members.push_back(i);
+				}
+			}
+
+			for(size_t a = 0; a < members.size(); a++){
+				const aircraft_state& first = projections[members[a]];
+				if(SectorEngine::sectorOf(layout, first.x, first.y) != sector){
+					continue;
+				}
+				for(size_t b = 0; b < members.size(); b++){
+					size_t i = members[a], j = members[b];
+					if(tracks[j].id <= tracks[i].id){
+						continue;
+					}
+					if(separationLost(projections[i], projections[j], horizontal, vertical)){
+						violationsOut << scan << " " << tracks[i].id << " " << tracks[j].id << "\n";
+						mStats.violations++;
+					}
+				}
+			}
+		}
+		mStats.scans = scan;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStats.tracksOwned = mOwned.size();
+		stats = mStats;
+	}
+	return true;
+}
+
+int SectorNode::runNode(node_config config, std::string scenario, std::ostream& out) {
+	std::string data;
+	if(!loadScenario(scenario, data)){
+		out << "SectorNode: Cannot read scenario " << scenario << std::endl;
+		return 1;
+	}
+	std::vector<Aircraft> traffic = parseScenario(data, CommunicationSystem());
+
+	SectorNode node(config, traffic);
+	std::ostringstream violations;
+	node_stats stats;
+	if(!node.run(violations, stats)){
+		return 1;
+	}
+
+	out << "SectorNode " << config.nodeIndex << ": " << stats.scans << " scans of " << stats.sectors << " sectors, "
+		<< stats.violations << " violations, " << stats.tracksOwned << " tracks owned, handoffs " << stats.handoffsOut
+		<< " out " << stats.handoffsIn << " in, " << stats.bytesSent << " bytes sent, " << stats.peersLost << " nodes lost" << std::endl;
+	return 0;
+}
+
+typedef std::tuple<int, int, int> node_violation;
+
+// The whole airspace in this process, the way the ATCSystem checks it (scan, lower id, higher id)
+static std::vector<node_violation> checkOneProcess(std::vector<Aircraft> traffic, int seconds) {
+	const runtime_config* config = runtimeConfig.get();
+	std::vector<node_violation> violations;
+	std::vector<aircraft_state> projections(traffic.size());
+
+	for(int scan = 1; scan <= seconds; scan++){
+		for(size_t i = 0; i < traffic.size(); i++){
+			aircraft_state state = traffic[i].getState();
+			if(traffic[i].getEntryTime() <= scan){
+				state.x += state.speedX;
+				state.y += state.speedY;
+				state.z += state.speedZ;
+				traffic[i].setPos(state.x, state.y, state.z);
+			}
+			projections[i] = projectState(state, config->predictionSeconds);
+		}
+		for(size_t i = 0; i < traffic.size(); i++){
+			for(size_t j = i + 1; j < traffic.size(); j++){
+				if(separationLost(projections[i], projections[j], config->horizontalSeparation, config->verticalSeparation)){
+					int first = traffic[i].getId(), second = traffic[j].getId();
+					violations.push_back(std::make_tuple(scan, std::min(first, second), std::max(first, second)));
+				}
+			}
+		}
+	}
+	std::sort(violations.begin(), violations.end());
+	return violations;
+}
+
+int SectorNode::launch(node_config config, std::string scenario, std::ostream& out) {
+	std::string data;
+	if(!loadScenario(scenario, data)){
+		out << "SectorNode: Cannot read scenario " << scenario << std::endl;
+		return 1;
+	}
+	std::vector<Aircraft> traffic = parseScenario(data, CommunicationSystem());
+
+	out << "+-------------+ Sector nodes: " << config.nodeCount << " processes, " << config.layout.columns << " x "
+		<< config.layout.rows << " sectors, " << scenario << " (" << traffic.size() << " aircraft), " << config.seconds
+		<< " s, " << (config.tcp ? "loopback TCP" : "UNIX sockets") << " +-------------+" << std::endl;
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	std::vector<pid_t> children(config.nodeCount);
+	std::vector<int> pipes(config.nodeCount);
+	for(int n = 0; n < config.nodeCount; n++){
+		int fds[2];
+		if(pipe(fds) == -1){
+			perror("SectorNode: pipe");
+			return 1;
+		}
+		out.flush();
+		children[n] = fork();
+		if(children[n] == -1){
+			perror("SectorNode: fork");
+			return 1;
+		}
+		if(children[n] == 0){
+			close(fds[0]);
+			node_config own = config;
+			own.nodeIndex = n;
+			SectorNode node(own, traffic);
+			std::ostringstream violations;
+			node_stats stats;
+			bool ok = node.run(violations, stats);
+
+			std::string text = violations.str();
+			if(ok){
+				writeFully(fds[1], (const char*)&stats, sizeof(stats));
+				writeFully(fds[1], text.data(), text.size());
+			}
+			close(fds[1]);
+			_exit(ok ? 0 : 1);
+		}
+		close(fds[1]);
+		pipes[n] = fds[0];
+	}
+
+	// Each node's stats, then its violations
+	std::vector<node_violation> violations;
+	std::vector<node_stats> stats(config.nodeCount);
+	std::vector<bool> finished(config.nodeCount, false);
+	for(int n = 0; n < config.nodeCount; n++){
+		std::string text;
+		char buffer[4096];
+		ssize_t got;
+		finished[n] = readFully(pipes[n], (char*)&stats[n], sizeof(stats[n]));
+		while(finished[n] && (got = read(pipes[n], buffer, sizeof(buffer))) > 0){
+			text.append(buffer, got);
+		}
+		close(pipes[n]);
+
+		std::istringstream lines(text);
+		int scan, first, second;
+		while(lines >> scan >> first >> second){
+			violations.push_back(std::make_tuple(scan, first, second));
+		}
+		int status = 0;
+		waitpid(children[n], &status, 0);
+		finished[n] = finished[n] && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+	double nodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	std::sort(violations.begin(), violations.end());
+
+	out << "| node | sectors | scans | tracks at end | handoffs out | handoffs in | boundary tracks sent | bytes sent | bytes received"
+		<< " | handoff latency mean us | max us | violations | nodes lost" << std::endl;
+	uint64_t bytes = 0, handoffs = 0, boundaryTracks = 0, latencyNs = 0, handoffsIn = 0;
+	bool allFinished = true;
+	for(int n = 0; n < config.nodeCount; n++){
+		if(!finished[n]){
+			out << "| " << n << " | did not finish" << (config.killNode == n ? " (killed at scan " + std::to_string(config.killScan) + ")" : "") << std::endl;
+			allFinished = false;
+			continue;
+		}
+		const node_stats& s = stats[n];
+		out << "| " << n << " | " << s.sectors << " | " << s.scans << " | " << s.tracksOwned << " | " << s.handoffsOut << " | "
+			<< s.handoffsIn << " | " << s.boundaryTracksSent << " | " << s.bytesSent << " | " << s.bytesReceived << " | "
+			<< (s.handoffsIn ? s.handoffLatencyNs / 1000.0 / s.handoffsIn : 0) << " | " << s.maxHandoffLatencyNs / 1000.0
+			<< " | " << s.violations << " | " << s.peersLost << std::endl;
+		bytes += s.bytesSent;
+		handoffs += s.handoffsOut;
+		handoffsIn += s.handoffsIn;
+		latencyNs += s.handoffLatencyNs;
+		boundaryTracks += s.boundaryTracksSent;
+	}
+
+	int seconds = std::max(config.seconds, 1);
+	out << "| Cross-node traffic: " << bytes / seconds << " bytes/scan, " << (double)handoffs / seconds << " handoffs/scan, "
+		<< (double)boundaryTracks / seconds << " boundary tracks/scan, handoff latency mean "
+		<< (handoffsIn ? latencyNs / 1000.0 / handoffsIn : 0) << " us" << std::endl;
+	out << "| Nodes: " << nodeSeconds << " s (" << config.seconds / nodeSeconds << " scans/s)" << std::endl;
+
+	if(!allFinished){
+		out << "+-------------+ A node did not finish, the others carried on without its sectors +-------------+" << std::endl;
+		return config.killNode >= 0 ? 0 : 1;
+	}
+
+	begin = std::chrono::steady_clock::now();
+	std::vector<node_violation> expected = checkOneProcess(traffic, config.seconds);
+	double oneSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	bool same = violations == expected;
+	out << "| One process: " << oneSeconds << " s, " << expected.size() << " violations; nodes: " << violations.size() << " violations" << std::endl;
+	out << "+-------------+ " << (same ? "Nodes found the same violations as one process" : "NODES DISAGREE WITH ONE PROCESS") << " +-------------+" << std::endl;
+	return same ? 0 : 1;
+}
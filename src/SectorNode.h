@@ -0,0 +1,150 @@
+#ifndef SRC_SECTORNODE_H_
+#define SRC_SECTORNODE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include "Aircraft.h"
+#include "SectorEngine.h"
+
+/* Responsible for:
+	- Running sectors of the airspace in separate processes ("nodes"), so that a crash or stall
+		of one node only loses its own sectors.
+	- Exchanging handoffs and boundary tracks between nodes over UNIX-domain or loopback TCP
+		sockets, with a compact binary protocol.
+	- Launching every node of a layout on one box, checking their combined violations against
+		one process, and reporting handoff latency and cross-node traffic.
+ */
+
+/*	One scan T of a node (all nodes step in lockstep on simulated time, as fast as they can):
+ * 	1. every track it owns that has entered the airspace flies one second
+ * 	2. tracks now in a sector of another node are handed off to that node (NODE_HANDOFF)
+ * 	3. tracks whose projection is in the buffer zone of another node's sector are sent to it,
+ * 		the NODE_BOUNDARY frame of scan T also tells the peer the scan is complete
+ * 	4. it waits for scan T of every peer, adopts the handoffs, and checks its own sectors the way
+ * 		SectorEngine does. A pair is reported by the sector holding the projection of the aircraft
+ * 		with the lower id, so the nodes together report every pair once.
+ * 	A peer that closes its socket, or sends nothing for NODE_PEER_TIMEOUT_MS, is lost: the node
+ * 	stops waiting for it and keeps tracks it can no longer hand off.
+ */
+
+/*	Protocol, host byte order (the nodes share a box):
+ * 	node_frame_header (24 bytes), followed by header.count node_track records (32 bytes each)
+ * 	NODE_HELLO		first frame on a connection, header.node says who connected
+ * 	NODE_HANDOFF	tracks the receiver owns from now on
+ * 	NODE_BOUNDARY	tracks near the receiver's sectors, for this scan only; ends the scan
+ */
+
+#define NODE_SOCKET_PATH "/tmp/atc_node_"		// + index + ".sock"
+#define NODE_TCP_PORT 47200						// + index, on 127.0.0.1
+#define NODE_PEER_TIMEOUT_MS 2000
+#define NODE_CONNECT_TIMEOUT_MS 10000
+
+enum node_frame_type {
+	NODE_HELLO = 1,
+	NODE_HANDOFF = 2,
+	NODE_BOUNDARY = 3
+};
+
+typedef struct {
+	uint16_t type;			// node_frame_type
+	uint16_t node;			// sender
+	uint32_t scan;
+	uint32_t count;			// node_track records that follow
+	uint32_t reserved;
+	uint64_t sentNs;		// CLOCK_MONOTONIC when sent, the nodes share the clock
+} node_frame_header;
+
+typedef struct {
+	int32_t id;
+	int32_t entryTime;
+	aircraft_state state;
+} node_track;
+
+typedef struct {
+	sector_layout layout;
+	int nodeCount;
+	int nodeIndex;
+	int seconds;
+	bool tcp;
+	int killNode;			// this node exits without a word at scan killScan (-1: never)
+	int killScan;
+} node_config;
+
+// What a node reports when it is done
+typedef struct {
+	int nodeIndex;
+	int sectors;
+	int scans;
+	int tracksOwned;			// at the end
+	uint64_t handoffsOut;
+	uint64_t handoffsIn;
+	uint64_t boundaryTracksSent;
+	uint64_t bytesSent;
+	uint64_t bytesReceived;
+	uint64_t handoffLatencyNs;	// sum, from send until the receiving node read it
+	uint64_t maxHandoffLatencyNs;
+	uint64_t violations;
+	int peersLost;
+} node_stats;
+
+class SectorNode {
+public:
+	SectorNode(node_config iConfig, const std::vector<Aircraft>& traffic);
+
+	// Node that runs a sector: contiguous blocks of sectors in row major order
+	static int nodeOfSector(const node_config& config, int sector);
+
+	// Connects to every other node and runs config.seconds scans. Every violation is written to
+	// violationsOut as "T id1 id2" (id1 < id2).
+	bool run(std::ostream& violationsOut, node_stats& stats);
+
+	// One node of a layout, for running nodes by hand in separate terminals
+	static int runNode(node_config config, std::string scenario, std::ostream& out);
+
+	// Every node of a layout as a child process, checked against one process
+	static int launch(node_config config, std::string scenario, std::ostream& out);
+
+	void* readPeer(int peer);
+	static void* startPeerReaderThread(void* context);
+
+private:
+	typedef struct {
+		node_frame_header header;
+		std::vector<node_track> tracks;
+		uint64_t receivedNs;
+	} received_frame;
+
+	typedef struct {
+		int fd;
+		bool lost;
+		uint32_t completedScan;		// newest NODE_BOUNDARY read
+		std::deque<received_frame> frames;
+	} peer_link;
+
+	typedef struct {
+		SectorNode* node;
+		int peer;
+	} reader_context;
+
+	node_config mConfig;
+	size_t mTrafficSize;			// aircraft in the scenario, no frame carries more tracks
+	std::vector<node_track> mOwned;
+	std::vector<peer_link> mPeers;
+	std::vector<reader_context> mReaders;
+	node_stats mStats;
+
+	// the reader threads fill the peers' frames
+	std::mutex mMutex;
+	std::condition_variable mReceived;
+
+	bool connectPeers();
+	bool sendFrame(int peer, uint16_t type, uint32_t scan, const std::vector<node_track>& tracks);
+	void losePeer(int peer, const std::string& why);
+};
+
+#endif /* SRC_SECTORNODE_H_ */
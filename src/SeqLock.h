@@ -0,0 +1,111 @@
+#ifndef SRC_SEQLOCK_H_
+#define SRC_SEQLOCK_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+/* Responsible for:
+	- A small value (a few floats) that one thread reads while others write it, where readers
+		must always see one whole write and nobody may block: an aircraft's position and speed.
+ */
+
+/*	How it works:
+ * 	- mSequence is even when the value is stable and odd while a write is in progress.
+ * 	- A writer makes it odd, writes the words, then makes it even again (one higher than before).
+ * 		Writers only wait for each other, and only for the few stores of a write.
+ * 	- A reader copies the words between two loads of mSequence, and copies again if it was odd
+ * 		or changed in between. Readers never write to the lock, so they never slow a writer down.
+ * 	- The words are relaxed atomics, so a copy that races a write is retried, never undefined.
+ */
+template<typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock values are copied word by word");
+	static_assert(sizeof(T) % sizeof(uint32_t) == 0, "SeqLock values must be a whole number of 32 bit words");
+
+public:
+	SeqLock() : mSequence(0) { store(T()); }
+	SeqLock(const T& value) : mSequence(0) { store(value); }
+	SeqLock(const SeqLock& other) : mSequence(0) { store(other.read()); }
+	SeqLock& operator=(const SeqLock& other) { write(other.read()); return *this; }
+
+	// A consistent copy. retries counts the copies thrown away because a write overlapped.
+	T read(unsigned* retries = nullptr) const {
+		uint32_t words[WORDS];
+		unsigned attempts = 0;
+		while(true){
+			uint32_t before = mSequence.load(std::memory_order_acquire);
+			if((before & 1) == 0){
+				for(size_t i = 0; i < WORDS; i++){
+					words[i] = mWords[i].load(std::memory_order_relaxed);
+				}
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if(mSequence.load(std::memory_order_relaxed) == before){
+					break;
+				}
+			}
+			attempts++;
+		}
+		if(retries != nullptr){
+			*retries += attempts;
+		}
+
+		T value;
+		memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+	void write(const T& value) {
+		modify([&value](T& current){ current = value; });
+	}
+
+	// Read, change and write back as one write, so two writers never lose each other's change
+	template<typename F>
+	void modify(F change) {
+		uint32_t sequence = lockWriters();
+		T value = load();
+		change(value);
+		store(value);
+		mSequence.store(sequence + 2, std::memory_order_release);
+	}
+
+private:
+	static const size_t WORDS = sizeof(T) / sizeof(uint32_t);
+
+	// Makes the sequence odd, waiting for another writer to finish if it already is
+	uint32_t lockWriters() {
+		uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+		while((sequence & 1) != 0 ||
+				!mSequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_relaxed)){
+			sequence = mSequence.load(std::memory_order_relaxed);
+		}
+		// No word may be written before the sequence is seen to be odd
+		std::atomic_thread_fence(std::memory_order_release);
+		return sequence;
+	}
+
+	// Only while the writers are locked
+	T load() const {
+		uint32_t words[WORDS];
+		for(size_t i = 0; i < WORDS; i++){
+			words[i] = mWords[i].load(std::memory_order_relaxed);
+		}
+		T value;
+		memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+	void store(const T& value) {
+		uint32_t words[WORDS];
+		memcpy(words, &value, sizeof(T));
+		for(size_t i = 0; i < WORDS; i++){
+			mWords[i].store(words[i], std::memory_order_relaxed);
+		}
+	}
+
+	std::atomic<uint32_t> mSequence;
+	std::atomic<uint32_t> mWords[WORDS];
+};
+
+#endif /* SRC_SEQLOCK_H_ */
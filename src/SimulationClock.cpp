@@ -0,0 +1,31 @@
+#include <atomic>
+#include <chrono>
+
+#include "SimulationClock.h"
+
+extern std::chrono::steady_clock::time_point programStartTime;
+
+// -1 while the real clock is used
+static std::atomic<int64_t> manualTimeMs(-1);
+
+int64_t getElapsedTimeMs() {
+	int64_t manual = manualTimeMs.load(std::memory_order_acquire);
+	if(manual >= 0){
+		return manual;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(now - programStartTime).count();
+}
+
+int getElapsedTime() {
+	return getElapsedTimeMs() / 1000;
+}
+
+void setManualTime(int64_t timeMs) {
+	manualTimeMs.store(timeMs, std::memory_order_release);
+}
+
+bool isManualTime() {
+	return manualTimeMs.load(std::memory_order_acquire) >= 0;
+}
@@ -0,0 +1,23 @@
+#ifndef SRC_SIMULATIONCLOCK_H_
+#define SRC_SIMULATIONCLOCK_H_
+
+#include <stdint.h>
+
+/* Responsible for:
+	- The simulation's notion of "now", used for aircraft entry times, the display and the history.
+	- Normally this is the time since programStartTime. A replay sets it by hand, so the same
+		scenario always sees the same times no matter how fast it runs.
+ */
+
+// Seconds since the simulation started
+int getElapsedTime();
+
+// Milliseconds since the simulation started
+int64_t getElapsedTimeMs();
+
+// From now on getElapsedTime*() return this time instead of the real clock
+void setManualTime(int64_t timeMs);
+
+bool isManualTime();
+
+#endif /* SRC_SIMULATIONCLOCK_H_ */
@@ -0,0 +1,199 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fstream>
+
+#include "Trace.h"
+
+/* RESPONSIBILITIES
+ *	- Components put TRACE_SCOPE (or a named TraceScope) at the top of what they want timed.
+ *	- The "trace on" and "trace off [file]" operator commands, and "Main --trace <file>", turn
+ *		tracing on and off; turning it off writes the file.
+ *	- A thread gets its buffer on its first event. Threads that end give it back for the next
+ *		new thread, so the timer threads (a new one per expiry with SIGEV_THREAD) share a few rows
+ *		instead of adding one each.
+ */
+
+extern std::chrono::steady_clock::time_point programStartTime;
+
+typedef struct {
+	const char* name;
+	const char* category;
+	const char* argName;
+	int64_t argValue;
+	int64_t beginUs;
+	int64_t durationUs;
+} trace_event;
+
+typedef struct {
+	std::mutex mutex;
+	int tid;
+	std::string threadName;
+	std::vector<trace_event> events;
+	uint64_t dropped;
+} trace_buffer;
+
+static std::atomic<bool> traceEnabled(false);
+
+// Every buffer ever handed out, and the ones whose thread has ended
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<trace_buffer> > buffers;
+static std::vector<trace_buffer*> freeBuffers;
+
+static trace_buffer* acquireBuffer() {
+	std::lock_guard<std::mutex> guard(buffersMutex);
+	if(!freeBuffers.empty()){
+		trace_buffer* buffer = freeBuffers.back();
+		freeBuffers.pop_back();
+		// The thread that gave it back may have named it, this one hasn't yet
+		std::lock_guard<std::mutex> bufferGuard(buffer->mutex);
+		buffer->threadName.clear();
+		return buffer;
+	}
+
+	buffers.push_back(std::unique_ptr<trace_buffer>(new trace_buffer()));
+	trace_buffer* buffer = buffers.back().get();
+	buffer->tid = buffers.size();
+	buffer->dropped = 0;
+	return buffer;
+}
+
+// Gives the buffer back when its thread ends
+class ThreadBuffer {
+public:
+	ThreadBuffer() : mBuffer(nullptr) {}
+	~ThreadBuffer() {
+		if(mBuffer != nullptr){
+			std::lock_guard<std::mutex> guard(buffersMutex);
+			freeBuffers.push_back(mBuffer);
+		}
+	}
+
+	trace_buffer* get() {
+		if(mBuffer == nullptr){
+			mBuffer = acquireBuffer();
+		}
+		return mBuffer;
+	}
+
+private:
+	trace_buffer* mBuffer;
+};
+
+static thread_local ThreadBuffer threadBuffer;
+
+void Trace::enable() {
+	{
+		std::lock_guard<std::mutex> guard(buffersMutex);
+		for(size_t i = 0; i < buffers.size(); i++){
+			std::lock_guard<std::mutex> bufferGuard(buffers[i]->mutex);
+			buffers[i]->events.clear();
+			buffers[i]->dropped = 0;
+		}
+	}
+	traceEnabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::disable() {
+	traceEnabled.store(false, std::memory_order_relaxed);
+}
+
+bool Trace::isEnabled() {
+	return traceEnabled.load(std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(const char* name) {
+	trace_buffer* buffer = threadBuffer.get();
+	std::lock_guard<std::mutex> guard(buffer->mutex);
+	buffer->threadName = name;
+}
+
+int64_t Trace::nowUs() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - programStartTime).count();
+}
+
+void Trace::record(const char* name, const char* category, int64_t beginUs, int64_t endUs,
+		const char* argName, int64_t argValue) {
+	trace_buffer* buffer = threadBuffer.get();
+	std::lock_guard<std::mutex> guard(buffer->mutex);
+	if(buffer->events.size() >= TRACE_BUFFER_EVENTS){
+		buffer->dropped++;
+		return;
+	}
+
+	trace_event event;
+	event.name = name;
+	event.category = category;
+	event.argName = argName;
+	event.argValue = argValue;
+	event.beginUs = beginUs;
+	event.durationUs = endUs - beginUs;
+	buffer->events.push_back(event);
+}
+
+// Names are ours, but thread names and file paths could hold anything
+static void writeString(std::ostream& out, const std::string& text) {
+	out << '"';
+	for(size_t i = 0; i < text.size(); i++){
+		char c = text[i];
+		if(c == '"' || c == '\\'){
+			out << '\\' << c;
+		}else if((unsigned char)c < 0x20){
+			out << ' ';
+		}else{
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+long Trace::writeFile(std::string path) {
+	std::ofstream out(path.c_str(), std::ios::trunc);
+	if(!out){
+		return -1;
+	}
+
+	long written = 0;
+	uint64_t dropped = 0;
+	bool first = true;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	std::lock_guard<std::mutex> guard(buffersMutex);
+	for(size_t i = 0; i < buffers.size(); i++){
+		trace_buffer& buffer = *buffers[i];
+		std::lock_guard<std::mutex> bufferGuard(buffer.mutex);
+
+		if(!buffer.threadName.empty()){
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.tid
+					<< ",\"args\":{\"name\":";
+			writeString(out, buffer.threadName);
+			out << "}}";
+			first = false;
+		}
+
+		for(size_t j = 0; j < buffer.events.size(); j++){
+			const trace_event& event = buffer.events[j];
+			out << (first ? "" : ",\n") << "{\"name\":";
+			writeString(out, event.name);
+			out << ",\"cat\":";
+			writeString(out, event.category);
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.tid
+					<< ",\"ts\":" << event.beginUs << ",\"dur\":" << event.durationUs;
+			if(event.argName != nullptr){
+				out << ",\"args\":{";
+				writeString(out, event.argName);
+				out << ":" << event.argValue << "}";
+			}
+			out << "}";
+			first = false;
+			written++;
+		}
+		dropped += buffer.dropped;
+	}
+
+	out << "\n],\"otherData\":{\"droppedEvents\":" << dropped << "}}\n";
+	out.close();
+	return out ? written : -1;
+}
@@ -0,0 +1,77 @@
+#ifndef SRC_TRACE_H_
+#define SRC_TRACE_H_
+
+#include <stdint.h>
+#include <string>
+
+/* Responsible for:
+	- Timing scopes of the running system (radar scans, conflict checks, IPC, rendering, logging)
+		into a buffer per thread while tracing is on.
+	- Writing them as Chrome trace event JSON, to open in chrome://tracing or Perfetto and see
+		what every thread was doing on one timeline.
+ */
+
+#define TRACE_PATH "/data/home/qnxuser/trace.json"
+
+// Events kept per thread, later ones are dropped (and counted) until tracing is turned on again
+#define TRACE_BUFFER_EVENTS 65536
+
+/*
+ * While tracing is off a scope costs one relaxed atomic load. While it is on, it reads the clock
+ * twice and appends to its thread's buffer under that buffer's lock, which only writeFile()
+ * ever contends for.
+ *
+ * Names and categories must be string literals (or otherwise outlive the trace): only the
+ * pointers are stored.
+ */
+class Trace {
+public:
+	// Clears what was traced before
+	static void enable();
+	static void disable();
+	static bool isEnabled();
+
+	// Names the calling thread's row in the trace
+	static void setThreadName(const char* name);
+
+	// Returns the number of events written, or -1
+	static long writeFile(std::string path);
+
+	// Microseconds since programStartTime
+	static int64_t nowUs();
+
+	static void record(const char* name, const char* category, int64_t beginUs, int64_t endUs,
+			const char* argName, int64_t argValue);
+};
+
+class TraceScope {
+public:
+	TraceScope(const char* iName, const char* iCategory) :
+		mName(iName), mCategory(iCategory), mArgName(nullptr), mArgValue(0),
+		mActive(Trace::isEnabled()), mBeginUs(mActive ? Trace::nowUs() : 0) {}
+
+	~TraceScope() {
+		if(mActive){
+			Trace::record(mName, mCategory, mBeginUs, Trace::nowUs(), mArgName, mArgValue);
+		}
+	}
+
+	// Shown with the event, e.g. the number of aircraft in a scan
+	void setArg(const char* name, int64_t value) { mArgName = name; mArgValue = value; }
+
+private:
+	const char* mName;
+	const char* mCategory;
+	const char* mArgName;
+	int64_t mArgValue;
+	bool mActive;
+	int64_t mBeginUs;
+};
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+
+// Times the rest of the enclosing block
+#define TRACE_SCOPE(name, category) TraceScope TRACE_JOIN(traceScope, __LINE__)(name, category)
+
+#endif /* SRC_TRACE_H_ */
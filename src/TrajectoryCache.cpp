@@ -0,0 +1,505 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+#include "TrajectoryCache.h"
+#include "ConflictCheck.h"
+#include "RadarDelta.h"
+
+/* RESPONSIBILITIES
+ *	- ATCSystem::checkViolations() gives it the violations of whichever check it ran (sectors,
+ *		incremental, broad phase or brute force) when any aircraft has a plan. Only the scan timer
+ *		thread uses it.
+ *	- A scan without plans costs one load of the plan table.
+ *	- The sector node processes (--nodes) fly and check straight lines, plans are not sent to them.
+ *	- "Main --bench-flight-plans" measures it.
+ */
+
+TrajectoryCache::TrajectoryCache() :
+	mScan(0), mBuilt(0)
+{
+	mBuiltCounter = &metrics().counter("atc_trajectories_built_total", "Flight plan trajectories computed, for a new plan or speed");
+	mPlannedGauge = &metrics().gauge("atc_planned_aircraft", "Aircraft predicted along their flight plan in the last scan");
+}
+
+uint64_t TrajectoryCache::pairKey(int id1, int id2) {
+	if(id1 > id2){
+		std::swap(id1, id2);
+	}
+	return ((uint64_t)(uint32_t)id1 << 32) | (uint32_t)id2;
+}
+
+bool TrajectoryCache::lossOf(const violation_pair& violation, float& timeToConflict, float& severity) const {
+	std::unordered_map<uint64_t, std::pair<float, float> >::const_iterator found = mLosses.find(pairKey(violation.aircraft1ID, violation.aircraft2ID));
+	if(found == mLosses.end()){
+		return false;
+	}
+	timeToConflict = found->second.first;
+	severity = found->second.second;
+	return true;
+}
+
+static inline float lengthOf(float x, float y, float z) {
+	return std::sqrt(x * x + y * y + z * z);
+}
+
+const TrajectoryCache::cached_legs& TrajectoryCache::legsOf(int id, const flight_plan& plan, float speed) {
+	cached_legs& cached = mLegs[id];
+	cached.seen = mScan;
+	if(!cached.legs.empty() && cached.planVersion == plan.version && std::fabs(cached.speed - speed) <= TRAJECTORY_SPEED_TOLERANCE){
+		return cached;
+	}
+
+	// One segment per waypoint, the last only says when the plan ends
+	cached.planVersion = plan.version;
+	cached.speed = speed;
+	cached.legs.resize(plan.waypoints.size());
+	float time = 0;
+	for(size_t k = 0; k < plan.waypoints.size(); k++){
+		const waypoint& from = plan.waypoints[k];
+		segment& leg = cached.legs[k];
+		leg.start = time;
+		leg.x = from.x;
+		leg.y = from.y;
+		leg.z = from.z;
+		leg.speedX = leg.speedY = leg.speedZ = 0;
+		if(k + 1 < plan.waypoints.size()){
+			const waypoint& to = plan.waypoints[k + 1];
+			float distance = lengthOf(to.x - from.x, to.y - from.y, to.z - from.z);
+			if(distance > 0){
+				leg.speedX = (to.x - from.x) / distance * speed;
+				leg.speedY = (to.y - from.y) / distance * speed;
+				leg.speedZ = (to.z - from.z) / distance * speed;
+				time += distance / speed;
+			}
+		}
+	}
+	mBuilt++;
+	mBuiltCounter->add();
+	return cached;
+}
+
+TrajectoryCache::trajectory TrajectoryCache::predict(int id, const aircraft_state& state, const flight_plan* plan, int leg,
+		float horizon, float padXY, float padZ) {
+	trajectory t;
+	t.first = mSegments.size();
+
+	segment head;
+	head.start = 0;
+	head.x = state.x;
+	head.y = state.y;
+	head.z = state.z;
+	head.speedX = state.speedX;
+	head.speedY = state.speedY;
+	head.speedZ = state.speedZ;
+
+	if(plan == nullptr){
+		mSegments.push_back(head);
+	}else{
+		// Straight at the waypoint it flies to, then the cached legs from there on
+		float speed = lengthOf(state.speedX, state.speedY, state.speedZ);
+		const cached_legs& cached = legsOf(id, *plan, speed);
+		const waypoint& next = plan->waypoints[leg];
+		float distance = lengthOf(next.x - state.x, next.y - state.y, next.z - state.z);
+		if(distance > 0){
+			head.speedX = (next.x - state.x) / distance * speed;
+			head.speedY = (next.y - state.y) / distance * speed;
+			head.speedZ = (next.z - state.z) / distance * speed;
+		}
+		mSegments.push_back(head);
+
+		float shift = distance / speed - cached.legs[leg].start;
+		segment last = head;
+		for(size_t k = leg; k < cached.legs.size() && cached.legs[k].start + shift < horizon; k++){
+			segment s = cached.legs[k];
+			s.start += shift;
+			if(k + 1 == cached.legs.size() || (s.speedX == 0 && s.speedY == 0 && s.speedZ == 0)){
+				// The last waypoint, or two at one place: on the way it arrived
+				s.speedX = last.speedX;
+				s.speedY = last.speedY;
+				s.speedZ = last.speedZ;
+			}
+			mSegments.push_back(s);
+			last = s;
+		}
+	}
+
+	t.count = mSegments.size() - t.first;
+	t.minX = t.minY = t.minZ = std::numeric_limits<float>::max();
+	t.maxX = t.maxY = t.maxZ = -std::numeric_limits<float>::max();
+	for(size_t k = 0; k < t.count; k++){
+		const segment& s = mSegments[t.first + k];
+		float end = (k + 1 < t.count) ? mSegments[t.first + k + 1].start : horizon;
+		float ends[2][3] = { { s.x, s.y, s.z },
+				{ s.x + s.speedX * (end - s.start), s.y + s.speedY * (end - s.start), s.z + s.speedZ * (end - s.start) } };
+		for(int e = 0; e < 2; e++){
+			t.minX = std::min(t.minX, ends[e][0] - padXY);
+			t.maxX = std::max(t.maxX, ends[e][0] + padXY);
+			t.minY = std::min(t.minY, ends[e][1] - padXY);
+			t.maxY = std::max(t.maxY, ends[e][1] + padXY);
+			t.minZ = std::min(t.minZ, ends[e][2] - padZ);
+			t.maxZ = std::max(t.maxZ, ends[e][2] + padZ);
+		}
+	}
+	return t;
+}
+
+bool TrajectoryCache::conflict(const trajectory& a, const trajectory& b, float horizon, float limitXY, float limitZ,
+		float* firstLoss, float* severity) const {
+	if(a.maxX < b.minX || b.maxX < a.minX || a.maxY < b.minY || b.maxY < a.minY || a.maxZ < b.minZ || b.maxZ < a.minZ){
+		return false;
+	}
+
+	// Both fly one segment each between from and to, so their distance changes linearly there
+	size_t i = 0, j = 0;
+	while(i < a.count && j < b.count){
+		const segment& sa = mSegments[a.first + i];
+		const segment& sb = mSegments[b.first + j];
+		double aEnd = (i + 1 < a.count) ? mSegments[a.first + i + 1].start : horizon;
+		double bEnd = (j + 1 < b.count) ? mSegments[b.first + j + 1].start : horizon;
+		double from = std::max(sa.start, sb.start);
+		double to = std::min(std::min(aEnd, bEnd), (double)horizon);
+
+		if(from <= to){
+			const double distance[3] = { (sa.x + sa.speedX * (from - sa.start)) - (sb.x + sb.speedX * (from - sb.start)),
+					(sa.y + sa.speedY * (from - sa.start)) - (sb.y + sb.speedY * (from - sb.start)),
+					(sa.z + sa.speedZ * (from - sa.start)) - (sb.z + sb.speedZ * (from - sb.start)) };
+			const double closing[3] = { (double)sa.speedX - sb.speedX, (double)sa.speedY - sb.speedY, (double)sa.speedZ - sb.speedZ };
+			const double limit[3] = { limitXY, limitXY, limitZ };
+
+			double begin = 0, end = to - from;
+			for(int axis = 0; axis < 3 && begin <= end; axis++){
+				if(closing[axis] == 0){
+					if(std::fabs(distance[axis]) > limit[axis]){
+						end = -1;
+					}
+					continue;
+				}
+				double t1 = (-limit[axis] - distance[axis]) / closing[axis];
+				double t2 = (limit[axis] - distance[axis]) / closing[axis];
+				begin = std::max(begin, std::min(t1, t2));
+				end = std::min(end, std::max(t1, t2));
+			}
+			if(begin <= end){
+				if(firstLoss != nullptr){
+					// How deep they are in the middle of the loss, on the axis where they are the least deep
+					double middle = (begin + end) / 2;
+					*firstLoss = from + begin;
+					*severity = 1;
+					for(int axis = 0; axis < 3; axis++){
+						double depth = 1 - std::fabs(distance[axis] + closing[axis] * middle) / limit[axis];
+						*severity = std::min(*severity, (float)std::max(depth, 0.0));
+					}
+				}
+				return true;
+			}
+		}
+
+		if(aEnd <= bEnd){
+			i++;
+		}else{
+			j++;
+		}
+	}
+	return false;
+}
+
+uint64_t TrajectoryCache::check(const flight_plan_table* plans, const std::vector<Aircraft>& radarFindings,
+		const std::vector<aircraft_state>& states, int horizontal, int vertical, int predTime,
+		std::vector<violation_pair>& violations) {
+	mScan++;
+	size_t n = radarFindings.size();
+	mPlanned.assign(n, 0);
+	mLosses.clear();
+	if(plans->plans.empty()){
+		mLegs.clear();
+		mPlannedGauge->set(0);
+		return 0;
+	}
+
+	// Aircraft with at least one turn left are predicted along their plan
+	std::vector<const flight_plan*> planOf(n, nullptr);
+	std::vector<int> legOf(n, 0);
+	size_t plannedCount = 0;
+	for(size_t i = 0; i < n; i++){
+		const flight_plan* plan = FlightPlans::find(plans, radarFindings[i].getID());
+		if(plan == nullptr){
+			continue;
+		}
+		plan_progress progress = radarFindings[i].getPlanProgress();
+		int leg = (progress.planVersion == plan->version) ? progress.leg : 0;
+		if(leg + 1 < (int)plan->waypoints.size() && lengthOf(states[i].speedX, states[i].speedY, states[i].speedZ) > 0){
+			planOf[i] = plan;
+			legOf[i] = leg;
+			mPlanned[i] = 1;
+			plannedCount++;
+		}
+	}
+
+	// Aircraft whose plan ended, changed or went away
+	for(std::unordered_map<int, cached_legs>::iterator c = mLegs.begin(); c != mLegs.end(); ){
+		if(c->second.seen + 1 < mScan){
+			c = mLegs.erase(c);
+		}else{
+			++c;
+		}
+	}
+	mPlannedGauge->set(plannedCount);
+	if(plannedCount == 0){
+		return 0;
+	}
+
+	float limitXY = 2.0f * horizontal + TRAJECTORY_ROUNDING_FEET;
+	float limitZ = 2.0f * vertical + TRAJECTORY_ROUNDING_FEET;
+	mSegments.clear();
+	std::vector<trajectory> trajectories(n);
+	for(size_t i = 0; i < n; i++){
+		trajectories[i] = predict(radarFindings[i].getID(), states[i], planOf[i], legOf[i], predTime, limitXY / 2, limitZ / 2);
+	}
+
+	// The straight-line verdicts of pairs of straight aircraft stand
+	std::unordered_map<int, size_t> positions;
+	positions.reserve(n);
+	std::unordered_set<int> plannedIds;
+	for(size_t i = 0; i < n; i++){
+		positions.emplace(radarFindings[i].getID(), i);
+		if(mPlanned[i]){
+			plannedIds.insert(radarFindings[i].getID());
+		}
+	}
+	std::vector<std::pair<std::pair<size_t, size_t>, violation_pair> > decided;
+	for(size_t v = 0; v < violations.size(); v++){
+		if(plannedIds.count(violations[v].aircraft1ID) == 0 && plannedIds.count(violations[v].aircraft2ID) == 0){
+			decided.push_back(std::make_pair(std::make_pair(positions[violations[v].aircraft1ID], positions[violations[v].aircraft2ID]), violations[v]));
+		}
+	}
+
+	// Every pair with a planned aircraft whose bounds overlap, swept along x
+	std::vector<size_t> order(n);
+	for(size_t i = 0; i < n; i++){
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&trajectories](size_t a, size_t b){ return trajectories[a].minX < trajectories[b].minX; });
+	std::vector<size_t> open;
+	uint64_t probed = 0;
+	for(size_t k = 0; k < n; k++){
+		size_t i = order[k];
+		for(size_t o = 0; o < open.size(); ){
+			size_t j = open[o];
+			if(trajectories[j].maxX < trajectories[i].minX){
+				open[o] = open.back();
+				open.pop_back();
+				continue;
+			}
+			o++;
+			if(!mPlanned[i] && !mPlanned[j]){
+				continue;
+			}
+			probed++;
+			float firstLoss, severity;
+			if(conflict(trajectories[i], trajectories[j], predTime, limitXY, limitZ, &firstLoss, &severity)){
+				size_t first = std::min(i, j), second = std::max(i, j);
+				violation_pair violation;
+				violation.aircraft1ID = radarFindings[first].getID();
+				violation.aircraft2ID = radarFindings[second].getID();
+				decided.push_back(std::make_pair(std::make_pair(first, second), violation));
+				mLosses[pairKey(violation.aircraft1ID, violation.aircraft2ID)] = std::make_pair(firstLoss, severity);
+			}
+		}
+		open.push_back(i);
+	}
+
+	// In the order of the conflict check
+	std::sort(decided.begin(), decided.end(), [](const std::pair<std::pair<size_t, size_t>, violation_pair>& a,
+			const std::pair<std::pair<size_t, size_t>, violation_pair>& b){ return a.first < b.first; });
+	violations.resize(decided.size());
+	for(size_t v = 0; v < decided.size(); v++){
+		violations[v] = decided[v].second;
+	}
+	return probed;
+}
+
+int TrajectoryCache::benchmark(int aircraftCount, int scans, std::ostream& out) {
+	const int horizontal = 3000, vertical = 1000, predTime = 180;
+	CommunicationSystem commSystem;
+
+	// The traffic of the sector benchmark, every aircraft with a plan of four turns of 30 to 90
+	// degrees, 15000 to 40000 feet apart, some climbing or descending 2000 feet
+	std::vector<Aircraft> radarFindings;
+	std::vector<aircraft_state> states;
+	std::vector<plan_progress> progress;
+	std::unordered_map<int, std::vector<waypoint> > routes;
+	unsigned int seed = 12345;
+	for(int i = 0; i < aircraftCount; i++){
+		seed = seed * 1103515245 + 12345;
+		float x = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		seed = seed * 1103515245 + 12345;
+		float y = (seed >> 8) % RADAR_AIRSPACE_SIZE;
+		aircraft_state state = { x, y, (float)(10000 + (i % 20) * 1000), (float)((i % 9) * 50 - 200), (float)((i % 7) * 50 - 150), 0 };
+		radarFindings.push_back(Aircraft(0, i, state.x, state.y, state.z, state.speedX, state.speedY, state.speedZ, commSystem));
+		states.push_back(state);
+		plan_progress none = { 0, 0 };
+		progress.push_back(none);
+
+		std::vector<waypoint>& route = routes[i];
+		float heading = std::atan2(state.speedY, state.speedX);
+		waypoint at = { state.x, state.y, state.z };
+		for(int k = 0; k < 4; k++){
+			seed = seed * 1103515245 + 12345;
+			float turn = (30 + (seed >> 8) % 61) * (float)M_PI / 180;
+			heading += ((seed >> 20) & 1) ? turn : -turn;
+			seed = seed * 1103515245 + 12345;
+			float length = 15000 + (seed >> 8) % 25001;
+			at.x += length * std::cos(heading);
+			at.y += length * std::sin(heading);
+			at.z += ((seed >> 20) % 3 - 1) * 2000.0f;
+			route.push_back(at);
+		}
+	}
+	FlightPlans plans;
+	const flight_plan_table* table = plans.replace(routes);
+
+	out << "+-------------+ Flight plan benchmark: " << aircraftCount << " aircraft, " << scans << " scans, predicting " << predTime << " s +-------------+" << std::endl;
+	out << "| scan | planned | straight ms | cached ms | built | uncached ms | violations | plans: false alarms, misses | straight lines: false alarms, misses" << std::endl;
+
+	TrajectoryCache cached, uncached, straight;
+	uint64_t totalBuilt = 0, totalMisses = 0;
+	double cachedSeconds = 0, uncachedSeconds = 0;
+	bool same = true;
+	for(int scan = 0; scan < scans; scan++){
+		if(scan > 0){
+			for(int i = 0; i < aircraftCount; i++){
+				FlightPlans::fly(states[i], progress[i], FlightPlans::find(table, i));
+			}
+		}
+		for(int i = 0; i < aircraftCount; i++){
+			radarFindings[i].setPos(states[i].x, states[i].y, states[i].z);
+			radarFindings[i].setSpeed(states[i].speedX, states[i].speedY, states[i].speedZ);
+			radarFindings[i].setPlanProgress(progress[i]);
+		}
+
+		// The check of the straight-line projections, which the trajectories then correct
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		std::vector<aircraft_state> projections(aircraftCount);
+		for(int i = 0; i < aircraftCount; i++){
+			projections[i] = projectState(states[i], predTime);
+		}
+		std::vector<violation_pair> projected;
+		for(int i = 0; i < aircraftCount; i++){
+			for(int j = i + 1; j < aircraftCount; j++){
+				if(separationLost(projections[i], projections[j], horizontal, vertical)){
+					violation_pair violation = { i, j };
+					projected.push_back(violation);
+				}
+			}
+		}
+		double straightMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		std::vector<violation_pair> violations = projected;
+		uint64_t built = cached.getBuilt();
+		begin = std::chrono::steady_clock::now();
+		cached.check(table, radarFindings, states, horizontal, vertical, predTime, violations);
+		double cachedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		built = cached.getBuilt() - built;
+
+		std::vector<violation_pair> rebuilt = projected;
+		uncached.clear();
+		begin = std::chrono::steady_clock::now();
+		uncached.check(table, radarFindings, states, horizontal, vertical, predTime, rebuilt);
+		double uncachedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		same = same && rebuilt.size() == violations.size();
+		for(size_t v = 0; same && v < violations.size(); v++){
+			same = rebuilt[v].aircraft1ID == violations[v].aircraft1ID && rebuilt[v].aircraft2ID == violations[v].aircraft2ID;
+		}
+
+		// What the flights do, every second of the horizon, for the pairs with a planned aircraft
+		std::unordered_set<uint64_t> flown;
+		std::vector<aircraft_state> flying = states;
+		std::vector<plan_progress> flyingProgress = progress;
+		float cellSize = 2.0f * horizontal + 1;
+		for(int second = 0; second <= predTime; second++){
+			std::unordered_map<uint64_t, std::vector<int> > cells;
+			for(int i = 0; i < aircraftCount; i++){
+				int64_t cx = (int64_t)std::floor(flying[i].x / cellSize), cy = (int64_t)std::floor(flying[i].y / cellSize);
+				for(int64_t c = cx - 1; c <= cx + 1; c++){
+					for(int64_t r = cy - 1; r <= cy + 1; r++){
+						std::unordered_map<uint64_t, std::vector<int> >::iterator cell = cells.find(((uint64_t)(uint32_t)c << 32) | (uint32_t)r);
+						if(cell == cells.end()){
+							continue;
+						}
+						for(size_t k = 0; k < cell->second.size(); k++){
+							int j = cell->second[k];
+							if((cached.mPlanned[i] || cached.mPlanned[j])
+									&& std::fabs(flying[i].x - flying[j].x) <= 2.0f * horizontal
+									&& std::fabs(flying[i].y - flying[j].y) <= 2.0f * horizontal
+									&& std::fabs(flying[i].z - flying[j].z) <= 2.0f * vertical){
+								flown.insert(((uint64_t)std::min(i, j) << 32) | std::max(i, j));
+							}
+						}
+					}
+				}
+				cells[((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy].push_back(i);
+			}
+			for(int i = 0; i < aircraftCount; i++){
+				FlightPlans::fly(flying[i], flyingProgress[i], FlightPlans::find(table, i));
+			}
+		}
+
+		// The same pairs as if every aircraft flew straight on
+		std::unordered_set<uint64_t> planned, lines;
+		for(size_t v = 0; v < violations.size(); v++){
+			if(cached.mPlanned[violations[v].aircraft1ID] || cached.mPlanned[violations[v].aircraft2ID]){
+				planned.insert(((uint64_t)violations[v].aircraft1ID << 32) | violations[v].aircraft2ID);
+			}
+		}
+		straight.mSegments.clear();
+		std::vector<trajectory> trajectories(aircraftCount);
+		float limitXY = 2.0f * horizontal + TRAJECTORY_ROUNDING_FEET, limitZ = 2.0f * vertical + TRAJECTORY_ROUNDING_FEET;
+		for(int i = 0; i < aircraftCount; i++){
+			trajectories[i] = straight.predict(i, states[i], nullptr, 0, predTime, limitXY / 2, limitZ / 2);
+		}
+		for(int i = 0; i < aircraftCount; i++){
+			for(int j = i + 1; j < aircraftCount; j++){
+				if((cached.mPlanned[i] || cached.mPlanned[j]) && straight.conflict(trajectories[i], trajectories[j], predTime, limitXY, limitZ)){
+					lines.insert(((uint64_t)i << 32) | j);
+				}
+			}
+		}
+
+		uint64_t planAlarms = 0, planMisses = 0, lineAlarms = 0, lineMisses = 0;
+		for(std::unordered_set<uint64_t>::const_iterator p = planned.begin(); p != planned.end(); ++p){
+			planAlarms += flown.count(*p) == 0;
+		}
+		for(std::unordered_set<uint64_t>::const_iterator p = lines.begin(); p != lines.end(); ++p){
+			lineAlarms += flown.count(*p) == 0;
+		}
+		for(std::unordered_set<uint64_t>::const_iterator p = flown.begin(); p != flown.end(); ++p){
+			planMisses += planned.count(*p) == 0;
+			lineMisses += lines.count(*p) == 0;
+		}
+
+		size_t plannedCount = std::count(cached.mPlanned.begin(), cached.mPlanned.end(), 1);
+		out << "| " << scan << " | " << plannedCount << " | " << straightMs << " | " << cachedMs << " | " << built << " | " << uncachedMs
+				<< " | " << violations.size() << " | " << planAlarms << ", " << planMisses << " of " << flown.size()
+				<< " | " << lineAlarms << ", " << lineMisses << std::endl;
+
+		totalBuilt += built;
+		totalMisses += planMisses;
+		if(scan > 0){
+			cachedSeconds += cachedMs;
+			uncachedSeconds += uncachedMs;
+		}
+	}
+
+	if(scans > 1){
+		out << "| after the first scan: cached " << cachedSeconds / (scans - 1) << " ms/scan, uncached " << uncachedSeconds / (scans - 1)
+				<< " ms/scan, " << totalBuilt << " trajectories built in all" << std::endl;
+	}
+	out << "+-------------+ " << (same ? "Cached and uncached trajectories agree" : "CACHED AND UNCACHED TRAJECTORIES DISAGREE")
+			<< ", " << totalMisses << " conflicts flown missed by the plans +-------------+" << std::endl;
+	return same && totalMisses == 0 ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#ifndef SRC_TRAJECTORYCACHE_H_
+#define SRC_TRAJECTORYCACHE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include "Aircraft.h"
+#include "RadarBus.h"
+#include "FlightPlan.h"
+#include "Metrics.h"
+
+/* Responsible for:
+	- Predicting aircraft with a flight plan as piecewise-linear segments: to the next waypoint,
+		along the legs of the plan, then straight on.
+	- Caching the legs of each planned aircraft, computed again only when its plan or its speed
+		changes, so a scan only adds where the aircraft is now.
+	- Probing a pair with a planned aircraft segment against segment, and deciding its violation
+		instead of the straight-line projection.
+	- Benchmarking the probe with and without the cache, and its accuracy against the flights.
+ */
+
+/*	A pair with a planned aircraft is a violation if the two aircraft lose separation (are within
+ * 	2 * separation on all three axes) at any time in the next predTime seconds, following their
+ * 	trajectories. Pairs of aircraft flying straight keep the test of separationLost() at the
+ * 	prediction time, so without plans the violations are exactly those of before.
+ *
+ * 	An aircraft flying the last leg of its plan, or past it, is predicted straight on, which is
+ * 	what it does. Each segment pair is checked on the time window both fly it: their distance
+ * 	changes linearly there, so the window where it is small enough on each axis is exact.
+ */
+
+#define TRAJECTORY_SPEED_TOLERANCE 0.01		// feet per second, less than that is not a speed change
+#define TRAJECTORY_ROUNDING_FEET 0.5		// added to the separation, for the float positions
+
+class TrajectoryCache {
+public:
+	TrajectoryCache();
+
+	// Decides the pairs of radarFindings with a planned aircraft in violations, which the check of
+	// the straight-line projections found, keeping the order of the conflict check. states are
+	// the aircraft of radarFindings read once. Returns the pairs probed.
+	uint64_t check(const flight_plan_table* plans, const std::vector<Aircraft>& radarFindings,
+			const std::vector<aircraft_state>& states, int horizontal, int vertical, int predTime,
+			std::vector<violation_pair>& violations);
+
+	// When a pair the last check decided along a plan loses separation, and how deep it is in the
+	// middle of the loss (see AlertQueue.h). false for the other pairs.
+	bool lossOf(const violation_pair& violation, float& timeToConflict, float& severity) const;
+
+	size_t getCachedTrajectories() const { return mLegs.size(); }
+
+	// Trajectories computed since the cache was made
+	uint64_t getBuilt() const { return mBuilt; }
+
+	// Empties the cache, the next check computes every trajectory again
+	void clear() { mLegs.clear(); }
+
+	// n aircraft flying plans of a few legs, the probe with and without the cache, and the
+	// violations it and straight lines find against the flights themselves
+	static int benchmark(int aircraftCount, int scans, std::ostream& out);
+
+private:
+	// A straight piece of a trajectory, from start to the start of the next one
+	typedef struct {
+		float start;				// seconds
+		float x, y, z;				// position at start
+		float speedX, speedY, speedZ;
+	} segment;
+
+	// The legs of a plan flown at one speed, the first starting at its first waypoint at 0
+	typedef struct {
+		uint32_t planVersion;
+		float speed;
+		std::vector<segment> legs;
+		uint64_t seen;
+	} cached_legs;
+
+	// Where the segments of one aircraft are in mSegments this scan
+	typedef struct {
+		size_t first;
+		size_t count;
+		float minX, maxX, minY, maxY, minZ, maxZ;	// bounds over the horizon, padded by the separation
+	} trajectory;
+
+	std::unordered_map<int, cached_legs> mLegs;		// by aircraft id
+	std::vector<segment> mSegments;
+	std::vector<char> mPlanned;						// predicted along a plan last check, by radar list position
+	std::unordered_map<uint64_t, std::pair<float, float> > mLosses;	// time and severity of its violations, by pairKey()
+	uint64_t mScan;
+	uint64_t mBuilt;
+
+	Counter* mBuiltCounter;
+	Gauge* mPlannedGauge;
+
+	const cached_legs& legsOf(int id, const flight_plan& plan, float speed);
+
+	// The segments of aircraft id at state from now to horizon, along plan from leg (nullptr for a
+	// straight line)
+	trajectory predict(int id, const aircraft_state& state, const flight_plan* plan, int leg, float horizon,
+			float padXY, float padZ);
+
+	// When they first lose separation and how deep, if they do and firstLoss isn't nullptr
+	bool conflict(const trajectory& a, const trajectory& b, float horizon, float limitXY, float limitZ,
+			float* firstLoss = nullptr, float* severity = nullptr) const;
+
+	static uint64_t pairKey(int id1, int id2);
+};
+
+#endif /* SRC_TRAJECTORYCACHE_H_ */